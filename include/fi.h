@@ -37,6 +37,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <stdarg.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
@@ -131,6 +132,18 @@ int ofi_apply_filter(struct fi_filter *filter, const char *name);
 
 void fi_log_init(void);
 void fi_log_fini(void);
+
+extern int ofi_trace_enabled;
+void ofi_trace_init(void);
+void ofi_trace_fini(void);
+void ofi_trace_forget(void);
+void ofi_trace_log(const struct fi_provider *prov, enum fi_log_level level,
+		   enum fi_log_subsys subsys, const char *func, int line,
+		   const char *fmt, va_list vargs);
+
+extern int ofi_ep_stats_log;
+extern int ofi_wait_spin_max;
+
 void fi_param_init(void);
 void fi_param_fini(void);
 void fi_param_undefine(const struct fi_provider *provider);
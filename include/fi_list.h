@@ -89,6 +89,20 @@ static inline void dlist_remove(struct dlist_entry *item)
 	item->next->prev = item->prev;
 }
 
+/* Move all entries of list to the tail of head, leaving list empty */
+static inline void dlist_splice_tail(struct dlist_entry *head,
+				     struct dlist_entry *list)
+{
+	if (dlist_empty(list))
+		return;
+
+	list->next->prev = head->prev;
+	list->prev->next = head;
+	head->prev->next = list->next;
+	head->prev = list->prev;
+	dlist_init(list);
+}
+
 #define dlist_pop_front(head, type, container, member)			\
 	do {								\
 		container = container_of((head)->next, type, member);	\
@@ -38,7 +38,9 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <fi_list.h>
+#include <fi_lock.h>
 #include <fi_osd.h>
 
 
@@ -138,6 +140,25 @@ typedef int (*util_buf_region_alloc_hndlr) (void *pool_ctx, void *addr, size_t l
 					    void **context);
 typedef void (*util_buf_region_free_hndlr) (void *pool_ctx, void *context);
 
+enum {
+	/* Back regions with huge pages when available */
+	UTIL_BUF_POOL_HUGEPAGE		= 1 << 0,
+	/* Place regions on util_buf_attr.numa_node */
+	UTIL_BUF_POOL_NUMA_BIND		= 1 << 1,
+};
+
+struct util_buf_attr {
+	size_t size;
+	size_t alignment;
+	size_t max_cnt;
+	size_t chunk_cnt;
+	util_buf_region_alloc_hndlr alloc_hndlr;
+	util_buf_region_free_hndlr free_hndlr;
+	void *ctx;
+	uint64_t flags;
+	int numa_node;
+};
+
 struct util_buf_pool {
 	size_t data_sz;
 	size_t entry_sz;
@@ -150,11 +171,15 @@ struct util_buf_pool {
 	util_buf_region_alloc_hndlr alloc_hndlr;
 	util_buf_region_free_hndlr free_hndlr;
 	void *ctx;
+	uint64_t flags;
+	int numa_node;
 };
 
 struct util_buf_region {
 	struct slist_entry entry;
 	char *mem_region;
+	size_t size;
+	uint64_t flags;
 	void *context;
 #if ENABLE_DEBUG
 	size_t num_used;
@@ -170,12 +195,28 @@ union util_buf {
 	uint8_t data[0];
 };
 
+struct util_buf_pool *util_buf_pool_create_attr(struct util_buf_attr *attr);
+
 /* create buffer pool with alloc/free handlers */
-struct util_buf_pool *util_buf_pool_create_ex(size_t size, size_t alignment,
-					      size_t max_cnt, size_t chunk_cnt,
-					      util_buf_region_alloc_hndlr alloc_hndlr,
-					      util_buf_region_free_hndlr free_hndlr,
-					      void *pool_ctx);
+static inline struct util_buf_pool *
+util_buf_pool_create_ex(size_t size, size_t alignment,
+			size_t max_cnt, size_t chunk_cnt,
+			util_buf_region_alloc_hndlr alloc_hndlr,
+			util_buf_region_free_hndlr free_hndlr,
+			void *pool_ctx)
+{
+	struct util_buf_attr attr = {
+		.size		= size,
+		.alignment	= alignment,
+		.max_cnt	= max_cnt,
+		.chunk_cnt	= chunk_cnt,
+		.alloc_hndlr	= alloc_hndlr,
+		.free_hndlr	= free_hndlr,
+		.ctx		= pool_ctx,
+	};
+
+	return util_buf_pool_create_attr(&attr);
+}
 
 /* create buffer pool */
 static inline struct util_buf_pool *util_buf_pool_create(size_t size,
@@ -271,4 +312,132 @@ static inline void *util_buf_get_ctx(struct util_buf_pool *pool, void *buf)
 
 void util_buf_pool_destroy(struct util_buf_pool *pool);
 
+
+/*
+ * Thread-safe buffer pool
+ *
+ * Each thread keeps a private cache of up to two magazines of buffers.
+ * The owner allocates and releases from its cache without locking: the
+ * buffer count and a generation bumped by every change share one word,
+ * which the owner updates with a single compare and swap.  The cache lock
+ * is only taken to move a full magazine in or out of the shared pool,
+ * which is locked as well.  When the shared pool runs out, caches whose
+ * generation has not changed since the previous sweep are emptied before
+ * the pool grows.  A sweep empties a cache by swapping its word, so an
+ * owner racing with it fails its own swap and falls back to the slow path.
+ *
+ * All pools share one thread-specific key.  Its value is an array of
+ * caches indexed by util_buf_ts_pool::index.
+ */
+#define UTIL_BUF_MAG_SIZE	32
+#define UTIL_BUF_CACHE_GEN	(1ULL << 32)
+
+struct util_buf_ts_pool;
+
+struct util_buf_cache {
+	struct dlist_entry entry;
+	/* NULL once the pool has been destroyed */
+	struct util_buf_ts_pool *ts_pool;
+	/* Generation in the high 32 bits, number of buffers in the low */
+	uint64_t state;
+	fastlock_t lock;
+	/* state at the previous sweep, protected by lock */
+	uint64_t seen;
+	void *buf[UTIL_BUF_MAG_SIZE * 2];
+};
+
+static inline size_t util_buf_cache_cnt(uint64_t state)
+{
+	return (size_t) (uint32_t) state;
+}
+
+struct util_buf_ts_tls {
+	size_t size;
+	struct util_buf_cache *cache[];
+};
+
+struct util_buf_ts_pool {
+	struct util_buf_pool *pool;
+	fastlock_t lock;
+	size_t index;
+	struct dlist_entry cache_list;
+};
+
+extern pthread_key_t util_buf_ts_key;
+
+struct util_buf_ts_pool *util_buf_ts_pool_create_attr(struct util_buf_attr *attr);
+
+void util_buf_ts_pool_destroy(struct util_buf_ts_pool *ts_pool);
+
+void *util_buf_ts_refill(struct util_buf_ts_pool *ts_pool);
+void util_buf_ts_drain(struct util_buf_ts_pool *ts_pool, void *buf);
+
+static inline struct util_buf_cache *
+util_buf_ts_cache(struct util_buf_ts_pool *ts_pool)
+{
+	struct util_buf_ts_tls *tls;
+	struct util_buf_cache *cache;
+
+	tls = pthread_getspecific(util_buf_ts_key);
+	if (!tls || ts_pool->index >= tls->size)
+		return NULL;
+
+	cache = tls->cache[ts_pool->index];
+	return (cache && cache->ts_pool == ts_pool) ? cache : NULL;
+}
+
+static inline void *util_buf_ts_alloc(struct util_buf_ts_pool *ts_pool)
+{
+	struct util_buf_cache *cache;
+	uint64_t state;
+	size_t cnt;
+	void *buf;
+
+	cache = util_buf_ts_cache(ts_pool);
+	if (cache) {
+		state = ofi_load_relaxed(&cache->state);
+		cnt = util_buf_cache_cnt(state);
+		if (cnt) {
+			buf = cache->buf[cnt - 1];
+			if (ofi_cas64(&cache->state, state,
+				      state + UTIL_BUF_CACHE_GEN - 1))
+				return buf;
+		}
+	}
+	return util_buf_ts_refill(ts_pool);
+}
+
+static inline void util_buf_ts_release(struct util_buf_ts_pool *ts_pool,
+				       void *buf)
+{
+	struct util_buf_cache *cache;
+	uint64_t state;
+	size_t cnt;
+
+	cache = util_buf_ts_cache(ts_pool);
+	if (cache) {
+		state = ofi_load_relaxed(&cache->state);
+		cnt = util_buf_cache_cnt(state);
+		if (cnt < UTIL_BUF_MAG_SIZE * 2) {
+			/* May be read by a sweep that will then fail */
+			ofi_store_relaxed(&cache->buf[cnt], buf);
+			if (ofi_cas64(&cache->state, state,
+				      state + UTIL_BUF_CACHE_GEN + 1))
+				return;
+		}
+	}
+	util_buf_ts_drain(ts_pool, buf);
+}
+
+static inline void *util_buf_ts_alloc_ex(struct util_buf_ts_pool *ts_pool,
+					 void **context)
+{
+	void *buf;
+
+	buf = util_buf_ts_alloc(ts_pool);
+	if (buf)
+		*context = util_buf_get_ctx(ts_pool->pool, buf);
+	return buf;
+}
+
 #endif /* _FI_MEM_H_ */
@@ -91,13 +91,32 @@ static inline void name ## _free(struct name *cq)		\
 
 #define ofi_cirque_rindex(cq)		((cq)->rcnt & (cq)->size_mask)
 #define ofi_cirque_windex(cq)		((cq)->wcnt & (cq)->size_mask)
+#define ofi_cirque_windex_at(cq, i)	(((cq)->wcnt + (i)) & (cq)->size_mask)
 #define ofi_cirque_head(cq)		(&(cq)->buf[ofi_cirque_rindex(cq)])
 #define ofi_cirque_tail(cq)		(&(cq)->buf[ofi_cirque_windex(cq)])
+#define ofi_cirque_tail_at(cq, i)	(&(cq)->buf[ofi_cirque_windex_at(cq, i)])
 #define ofi_cirque_insert(cq, x)	(cq)->buf[(cq)->wcnt++ & (cq)->size_mask] = x
 #define ofi_cirque_remove(cq)		(&(cq)->buf[(cq)->rcnt++ & (cq)->size_mask])
 #define ofi_cirque_discard(cq)		((cq)->rcnt++)
 #define ofi_cirque_commit(cq)		((cq)->wcnt++)
 
+/*
+ * Single producer/single consumer access without a lock.  Only the
+ * producer updates wcnt and only the consumer updates rcnt.  Each side
+ * publishes its own index with release semantics and observes the other
+ * side's index with acquire semantics, so entry contents written before
+ * a commit are visible once the consumer sees the new wcnt.
+ */
+#define ofi_cirque_spsc_usedcnt(cq)	(ofi_load_acquire(&(cq)->wcnt) - (cq)->rcnt)
+#define ofi_cirque_spsc_freecnt(cq)	\
+	((cq)->size - ((cq)->wcnt - ofi_load_acquire(&(cq)->rcnt)))
+#define ofi_cirque_spsc_isempty(cq)	(ofi_cirque_spsc_usedcnt(cq) == 0)
+#define ofi_cirque_spsc_isfull(cq)	(ofi_cirque_spsc_freecnt(cq) <= 0)
+#define ofi_cirque_spsc_commit(cq)	ofi_store_release(&(cq)->wcnt, (cq)->wcnt + 1)
+#define ofi_cirque_spsc_commit_cnt(cq, n) \
+	ofi_store_release(&(cq)->wcnt, (cq)->wcnt + (n))
+#define ofi_cirque_spsc_discard(cq)	ofi_store_release(&(cq)->rcnt, (cq)->rcnt + 1)
+
 
 /*
  * Simple ring buffer
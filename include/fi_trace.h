@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _FI_TRACE_H_
+#define _FI_TRACE_H_
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/*
+ * Binary log trace format
+ *
+ * The file starts with an ofi_trace_file_hdr, followed by records.  All
+ * records are a multiple of 8 bytes and start with an ofi_trace_hdr.
+ *
+ * Strings (provider names, functions and format strings) are written once
+ * per thread as OFI_TRACE_STR records, and referenced by id afterwards.
+ * The id is a hash of the string, so equal ids always name equal strings.
+ * Log records carry the raw arguments of the format string, one 8 byte
+ * slot per argument.  A string argument is a slot holding its length,
+ * followed by its bytes padded to 8 bytes.
+ */
+#define OFI_TRACE_MAGIC		"OFITRACE"
+#define OFI_TRACE_VERSION	1
+#define OFI_TRACE_STR_MAX	255
+
+struct ofi_trace_file_hdr {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	pid;
+};
+
+enum {
+	OFI_TRACE_LOG,
+	OFI_TRACE_STR,
+	OFI_TRACE_DROP,
+};
+
+/* A log record whose arguments did not fit is cut short */
+#define OFI_TRACE_TRUNC		(1 << 0)
+
+struct ofi_trace_hdr {
+	uint8_t		type;
+	uint8_t		flags;
+	uint16_t	len;		/* in 8 byte words, including header */
+	uint32_t	thread;
+};
+
+struct ofi_trace_log {
+	struct ofi_trace_hdr hdr;
+	uint64_t	time;		/* us */
+	uint64_t	prov;
+	uint64_t	func;
+	uint64_t	fmt;
+	uint32_t	line;
+	uint8_t		level;
+	uint8_t		subsys;
+	uint16_t	resv;
+	uint64_t	args[];
+};
+
+struct ofi_trace_str {
+	struct ofi_trace_hdr hdr;
+	uint64_t	id;
+	char		str[];
+};
+
+/* Count of records a thread dropped because its ring was full */
+struct ofi_trace_drop {
+	struct ofi_trace_hdr hdr;
+	uint64_t	count;
+};
+
+static inline size_t ofi_trace_words(size_t bytes)
+{
+	return (bytes + 7) / 8;
+}
+
+enum ofi_trace_type {
+	OFI_TRACE_ARG_NONE,	/* %% */
+	OFI_TRACE_ARG_INT,
+	OFI_TRACE_ARG_LONG,
+	OFI_TRACE_ARG_LLONG,
+	OFI_TRACE_ARG_INTMAX,
+	OFI_TRACE_ARG_SIZE,
+	OFI_TRACE_ARG_PTRDIFF,
+	OFI_TRACE_ARG_DOUBLE,
+	OFI_TRACE_ARG_LDOUBLE,
+	OFI_TRACE_ARG_PTR,
+	OFI_TRACE_ARG_STR,
+};
+
+struct ofi_trace_conv {
+	const char	*start;		/* the '%' */
+	size_t		len;
+	int		stars;		/* '*' width and precision arguments */
+	int		is_signed;
+	enum ofi_trace_type type;
+};
+
+/*
+ * Find the next printf conversion in fmt.  Returns a pointer past it, or
+ * NULL if there are no more conversions.
+ */
+static inline const char *
+ofi_trace_parse(const char *fmt, struct ofi_trace_conv *conv)
+{
+	const char *p;
+	int lmod = 0;
+
+	fmt = strchr(fmt, '%');
+	if (!fmt)
+		return NULL;
+
+	conv->start = fmt;
+	conv->stars = 0;
+	conv->is_signed = 0;
+	p = fmt + 1;
+
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	for (; *p && strchr("0123456789.*", *p); p++) {
+		if (*p == '*')
+			conv->stars++;
+	}
+
+	for (; *p && strchr("hlLqjzt", *p); p++)
+		lmod = (lmod << 8) | *p;
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+		conv->is_signed = 1;
+		/* fall through */
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+	case 'c':
+		switch (lmod) {
+		case 'l':
+			conv->type = OFI_TRACE_ARG_LONG;
+			break;
+		case ('l' << 8) | 'l':
+		case 'q':
+			conv->type = OFI_TRACE_ARG_LLONG;
+			break;
+		case 'j':
+			conv->type = OFI_TRACE_ARG_INTMAX;
+			break;
+		case 'z':
+			conv->type = OFI_TRACE_ARG_SIZE;
+			break;
+		case 't':
+			conv->type = OFI_TRACE_ARG_PTRDIFF;
+			break;
+		default:
+			conv->type = OFI_TRACE_ARG_INT;
+			break;
+		}
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		conv->type = lmod == 'L' ?
+			     OFI_TRACE_ARG_LDOUBLE : OFI_TRACE_ARG_DOUBLE;
+		break;
+	case 's':
+		conv->type = OFI_TRACE_ARG_STR;
+		break;
+	case 'p':
+	case 'n':
+		conv->type = OFI_TRACE_ARG_PTR;
+		break;
+	case '\0':
+		/* Malformed trailing '%' */
+		conv->type = OFI_TRACE_ARG_NONE;
+		conv->len = p - fmt;
+		return p;
+	default:
+		conv->type = OFI_TRACE_ARG_NONE;
+		break;
+	}
+
+	conv->len = p + 1 - fmt;
+	return p + 1;
+}
+
+#endif /* _FI_TRACE_H_ */
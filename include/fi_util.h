@@ -187,6 +187,8 @@ struct util_domain {
 	int			mr_mode;
 	uint32_t		addr_format;
 	enum fi_av_type		av_type;
+	enum fi_threading	threading;
+	enum fi_progress	data_progress;
 };
 
 int ofi_domain_init(struct fid_fabric *fabric_fid, const struct fi_info *info,
@@ -228,8 +230,55 @@ struct util_ep {
 	ofi_ep_progress_func	progress;
 	struct util_cmap	*cmap;
 	fastlock_t		lock;
+	struct fi_ep_stats	stats;
 };
 
+/*
+ * Endpoint statistics are updated with relaxed atomics from the data path,
+ * and are only meant to be read as a snapshot through FI_OPT_EP_STATS.
+ */
+#define ofi_ep_stat_add(ep, name, val)	\
+	ofi_add_relaxed(&(ep)->stats.name, (uint64_t) (val))
+#define ofi_ep_stat_inc(ep, name)	ofi_ep_stat_add(ep, name, 1)
+
+/* Account for the result of posting a transmit or receive operation */
+static inline ssize_t ofi_ep_stat_tx(struct util_ep *ep, ssize_t ret)
+{
+	if (!ret)
+		ofi_ep_stat_inc(ep, tx_posted);
+	else if (ret == -FI_EAGAIN)
+		ofi_ep_stat_inc(ep, eagain);
+	return ret;
+}
+
+static inline ssize_t ofi_ep_stat_rx(struct util_ep *ep, ssize_t ret)
+{
+	if (!ret)
+		ofi_ep_stat_inc(ep, rx_posted);
+	else if (ret == -FI_EAGAIN)
+		ofi_ep_stat_inc(ep, eagain);
+	return ret;
+}
+
+static inline void ofi_ep_stat_unexp_inc(struct util_ep *ep)
+{
+	uint64_t cur;
+
+	ofi_ep_stat_inc(ep, unexp_total);
+	cur = ofi_add_relaxed(&ep->stats.unexp_cur, 1) + 1;
+	if (cur > ofi_load_relaxed(&ep->stats.unexp_max))
+		ofi_store_relaxed(&ep->stats.unexp_max, cur);
+}
+
+static inline void ofi_ep_stat_unexp_dec(struct util_ep *ep)
+{
+	ofi_add_relaxed(&ep->stats.unexp_cur, (uint64_t) -1);
+}
+
+int ofi_ep_getopt_stats(struct util_ep *ep, void *optval, size_t *optlen);
+int ofi_ep_setopt_stats(struct util_ep *ep, const void *optval,
+			size_t optlen);
+
 int ofi_ep_bind_av(struct util_ep *util_ep, struct util_av *av);
 int ofi_ep_bind_eq(struct util_ep *ep, struct util_eq *eq);
 int ofi_ep_bind_cq(struct util_ep *ep, struct util_cq *cq, uint64_t flags);
@@ -241,6 +290,42 @@ int ofi_endpoint_init(struct fid_domain *domain, const struct util_prov *util_pr
 
 int ofi_endpoint_close(struct util_ep *util_ep);
 
+/*
+ * Poll set membership
+ *
+ * CQs, counters and EQs whose state only changes when an event is written
+ * to them join the poll set of their wait object through a util_poll_entry.
+ * Writers mark the entry ready, and the poll set only checks members that
+ * have been marked since it last found them empty.  Objects that need
+ * fi_poll to drive progress are added with fi_poll_add instead and are
+ * checked on every call.
+ */
+struct util_poll;
+
+struct util_poll_entry {
+	struct dlist_entry	entry;
+	struct dlist_entry	ready_entry;
+	struct util_poll	*pollset;
+	struct fid		*fid;
+	int			ready;
+};
+
+void ofi_poll_entry_init(struct util_poll_entry *entry, struct fid *fid);
+void ofi_poll_set_ready(struct util_poll_entry *entry);
+
+/*
+ * Blocking reads of CQs and counters poll for completions, yielding the
+ * CPU between attempts, before sleeping on the wait object.  The time spent
+ * polling follows a moving average of how long recent calls waited, bounded
+ * by FI_WAIT_SPIN_MAX.
+ */
+struct util_wait_spin {
+	uint64_t		avg_us;
+};
+
+uint64_t ofi_wait_spin_budget(struct util_wait_spin *spin, int timeout);
+void ofi_wait_spin_update(struct util_wait_spin *spin, uint64_t start_us);
+
 /*
  * Completion queue
  *
@@ -279,6 +364,16 @@ struct util_cq {
 	fi_cq_read_func		read_entry;
 	int			internal_wait;
 	ofi_cq_progress_func	progress;
+	struct util_poll_entry	poll_entry;
+	struct util_wait_spin	spin;
+
+	/* With FI_THREAD_DOMAIN or FI_THREAD_COMPLETION there is a single
+	 * writer and a single reader of cirq, so successful completions are
+	 * exchanged without cq_lock.  Code that writes to cirq directly must
+	 * publish entries with ofi_cirque_spsc_commit().  err_list is always
+	 * protected by cq_lock.
+	 */
+	int			spsc;
 };
 
 int ofi_cq_init(const struct fi_provider *prov, struct fid_domain *domain,
@@ -300,10 +395,35 @@ ssize_t ofi_cq_sreadfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 int ofi_cq_signal(struct fid_cq *cq_fid);
 int ofi_cq_write(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 		 void *buf, uint64_t data, uint64_t tag);
+int ofi_cq_insert_error(struct util_cq *cq,
+			const struct fi_cq_err_entry *err_entry);
 int ofi_cq_write_error(struct util_cq *cq,
 		       const struct fi_cq_err_entry *err_entry);
 int ofi_cq_write_error_peek(struct util_cq *cq, uint64_t tag, void *context);
 
+/*
+ * Batched completion writes.  ofi_cq_write_reserve() returns how many of
+ * the requested slots are free at the tail of the CQ.  Callers fill the
+ * slots returned by ofi_cq_reserved_entry() and must then call
+ * ofi_cq_write_commit(), which publishes the first count entries with a
+ * single index update and signals the wait object once.  In locked mode
+ * cq_lock is held from reserve until commit.
+ */
+size_t ofi_cq_write_reserve(struct util_cq *cq, size_t count);
+void ofi_cq_write_commit(struct util_cq *cq, size_t count);
+ssize_t ofi_cq_write_batch(struct util_cq *cq,
+			   const struct fi_cq_tagged_entry *comps, size_t count);
+
+static inline struct fi_cq_tagged_entry *
+ofi_cq_reserved_entry(struct util_cq *cq, size_t index)
+{
+	return ofi_cirque_tail_at(cq->cirq, index);
+}
+
+/* Providers that publish entries to cirq directly must call this after
+ * ofi_cirque_spsc_commit() instead of signaling the wait object. */
+void ofi_cq_wakeup(struct util_cq *cq);
+
 /*
  * Counter
  */
@@ -326,6 +446,8 @@ struct util_cntr {
 	fastlock_t		ep_list_lock;
 
 	ofi_cntr_progress_func	progress;
+	struct util_poll_entry	poll_entry;
+	struct util_wait_spin	spin;
 };
 
 int ofi_check_bind_cntr_flags(struct util_ep *ep, struct util_cntr *cntr,
@@ -461,6 +583,9 @@ struct util_cmap_attr {
 	ofi_cmap_connect_func 		connect;
 	ofi_cmap_event_handler_func	event_handler;
 	ofi_cmap_signal_func		signal;
+	/* Maximum number of connection requests in flight while connecting
+	 * to AV addresses in the background. 0 connects on first use only */
+	size_t				eager_max;
 };
 
 struct util_cmap {
@@ -469,6 +594,9 @@ struct util_cmap {
 
 	/* cmap handles that correspond to addresses in AV */
 	struct util_cmap_handle **handles_av;
+	/* Connected subset of handles_av. Entries are published with release
+	 * semantics under the lock and may be read without it. */
+	struct util_cmap_handle **handles_conn;
 
 	/* Store all cmap handles (inclusive of handles_av) in an indexer.
 	 * This allows reverse lookup of the handle using the index. */
@@ -480,12 +608,21 @@ struct util_cmap {
 	struct util_cmap_attr attr;
 	pthread_t event_handler_thread;
 	fastlock_t lock;
+
+	/* Handles in CMAP_CONNREQ_SENT state */
+	size_t connreq_cnt;
+	/* AV addresses waiting to be connected in the background, used as
+	 * a ring of av->count entries */
+	fi_addr_t *eager_queue;
+	size_t eager_head;
+	size_t eager_cnt;
 };
 
 struct util_cmap_handle *ofi_cmap_key2handle(struct util_cmap *cmap, uint64_t key);
 int ofi_cmap_get_handle(struct util_cmap *cmap, fi_addr_t fi_addr,
 			struct util_cmap_handle **handle);
 void ofi_cmap_update(struct util_cmap *cmap, const void *addr, fi_addr_t fi_addr);
+int ofi_cmap_connect_av(struct util_cmap *cmap);
 
 void ofi_cmap_process_connect(struct util_cmap *cmap,
 			      struct util_cmap_handle *handle,
@@ -511,12 +648,25 @@ struct util_poll {
 	fastlock_t		lock;
 	ofi_atomic32_t		ref;
 	const struct fi_provider *prov;
+
+	/* entry_list is protected by lock, ready_list and the ready flag of
+	 * each entry by ready_lock.  scan requests that all entries be checked
+	 * on the next call, after a wakeup that no writer accounted for.
+	 */
+	struct dlist_entry	entry_list;
+	struct dlist_entry	ready_list;
+	fastlock_t		ready_lock;
+	int			scan;
 };
 
 int fi_poll_create_(const struct fi_provider *prov, struct fid_domain *domain,
 		    struct fi_poll_attr *attr, struct fid_poll **pollset);
 int fi_poll_create(struct fid_domain *domain, struct fi_poll_attr *attr,
 		   struct fid_poll **pollset);
+void ofi_poll_add_entry(struct util_poll *pollset,
+			struct util_poll_entry *entry);
+void ofi_poll_del_entry(struct util_poll_entry *entry);
+void ofi_poll_scan(struct util_poll *pollset);
 
 
 /*
@@ -542,12 +692,24 @@ int fi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
 		 struct util_wait *wait);
 int fi_wait_cleanup(struct util_wait *wait);
 
+/*
+ * sleepers counts the threads that may block on epoll_fd.  With lazy set,
+ * the signal is only written while it is non-zero, which is only safe if
+ * util_wait_fd_try() can see every event without it.  That holds when all
+ * members are util CQs, counters and EQs, so only providers built on those
+ * open such wait sets, through ofi_wait_fd_open_lazy().  Once epoll_fd has
+ * been returned by FI_GETWAIT, the application may block on it at any
+ * time, so it is counted as a sleeper for the lifetime of the wait set.
+ */
 struct util_wait_fd {
 	struct util_wait	util_wait;
 	struct fd_signal	signal;
 	fi_epoll_t		epoll_fd;
 	struct dlist_entry	fd_list;
 	fastlock_t		lock;
+	ofi_atomic32_t		sleepers;
+	int			exported;
+	int			lazy;
 };
 
 typedef int (*ofi_wait_fd_try_func)(void *arg);
@@ -561,6 +723,8 @@ struct ofi_wait_fd_entry {
 
 int ofi_wait_fd_open(struct fid_fabric *fabric, struct fi_wait_attr *attr,
 		struct fid_wait **waitset);
+int ofi_wait_fd_open_lazy(struct fid_fabric *fabric, struct fi_wait_attr *attr,
+			  struct fid_wait **waitset);
 int ofi_wait_fd_add(struct util_wait *wait, int fd, ofi_wait_fd_try_func try,
 		    void *arg, void *context);
 int ofi_wait_fd_del(struct util_wait *wait, int fd);
@@ -579,6 +743,7 @@ struct util_eq {
 
 	struct slist		list;
 	int			internal_wait;
+	struct util_poll_entry	poll_entry;
 };
 
 struct util_event {
@@ -648,6 +813,112 @@ int ofi_mr_verify(struct ofi_mr_map *map, uintptr_t *io_addr,
 		  size_t len, uint64_t key, uint64_t access,
 		  void **context);
 
+/*
+ * Memory registration cache
+ *
+ * Registrations are looked up by (address, length, access).  Entries that
+ * are no longer in use stay registered on an LRU list, and are evicted once
+ * max_cached_cnt or max_cached_size would be exceeded.  If nothing can be
+ * evicted the region is registered uncached and released on last use.
+ * The owner sets the limits, entry_data_size, and the add/delete region
+ * callbacks before calling ofi_mr_cache_init().
+ *
+ * The cache does not monitor the address space.  Regions that the
+ * application frees while they are cached remain registered.
+ */
+struct ofi_mr_cache_entry {
+	struct iovec		iov;
+	uint64_t		access;
+	unsigned int		use_cnt;
+	int			cached;
+	struct dlist_entry	lru_entry;
+	uint8_t			data[];
+};
+
+struct ofi_mr_cache {
+	const struct fi_provider *prov;
+	size_t			max_cached_cnt;
+	size_t			max_cached_size;
+	size_t			entry_data_size;
+	int			(*add_region)(struct ofi_mr_cache *cache,
+					      struct ofi_mr_cache_entry *entry);
+	void			(*delete_region)(struct ofi_mr_cache *cache,
+						 struct ofi_mr_cache_entry *entry);
+
+	void			*rbtree;
+	struct dlist_entry	lru_list;
+	size_t			cached_cnt;
+	size_t			cached_size;
+	/* In use regions that did not fit in the cache */
+	size_t			uncached_cnt;
+	uint64_t		search_cnt;
+	uint64_t		hit_cnt;
+	fastlock_t		lock;
+};
+
+int ofi_mr_cache_init(const struct fi_provider *prov,
+		      struct ofi_mr_cache *cache);
+int ofi_mr_cache_cleanup(struct ofi_mr_cache *cache);
+int ofi_mr_cache_search(struct ofi_mr_cache *cache, const struct iovec *iov,
+			uint64_t access, struct ofi_mr_cache_entry **entry);
+void ofi_mr_cache_delete(struct ofi_mr_cache *cache,
+			 struct ofi_mr_cache_entry *entry);
+
+
+/*
+ * Hierarchical timer wheel
+ *
+ * Timers are kept in OFI_TIMER_LEVELS levels of OFI_TIMER_SLOTS slots.
+ * Level 0 holds timers due within OFI_TIMER_SLOTS ticks of the current
+ * time; each higher level covers OFI_TIMER_SLOTS times the range of the
+ * level below, and its slots are cascaded down as time reaches them.
+ * Starting and stopping a timer is O(1), and running the wheel skips over
+ * empty levels, so its cost does not depend on the number of timers that
+ * are pending but not yet due.
+ *
+ * Time is an opaque, monotonic tick count supplied by the caller.  The
+ * wheel is not thread safe; the owner serializes access to it.
+ */
+#define OFI_TIMER_BITS		6
+#define OFI_TIMER_SLOTS		(1 << OFI_TIMER_BITS)
+#define OFI_TIMER_MASK		(OFI_TIMER_SLOTS - 1)
+#define OFI_TIMER_LEVELS	4
+
+struct ofi_timer_wheel;
+struct ofi_timer;
+typedef void (*ofi_timer_cb)(struct ofi_timer_wheel *wheel,
+			     struct ofi_timer *timer);
+
+struct ofi_timer {
+	struct dlist_entry	entry;
+	uint64_t		expires;
+	int			level;
+	ofi_timer_cb		cb;
+};
+
+struct ofi_timer_wheel {
+	uint64_t		now;
+	size_t			cnt[OFI_TIMER_LEVELS];
+	struct dlist_entry	slot[OFI_TIMER_LEVELS][OFI_TIMER_SLOTS];
+};
+
+static inline void ofi_timer_init(struct ofi_timer *timer, ofi_timer_cb cb)
+{
+	dlist_init(&timer->entry);
+	timer->cb = cb;
+}
+
+static inline int ofi_timer_pending(struct ofi_timer *timer)
+{
+	return !dlist_empty(&timer->entry);
+}
+
+void ofi_timer_wheel_init(struct ofi_timer_wheel *wheel, uint64_t now);
+void ofi_timer_start(struct ofi_timer_wheel *wheel, struct ofi_timer *timer,
+		     uint64_t expires);
+void ofi_timer_stop(struct ofi_timer_wheel *wheel, struct ofi_timer *timer);
+void ofi_timer_wheel_run(struct ofi_timer_wheel *wheel, uint64_t now);
+
 
 /*
  * Attributes and capabilities
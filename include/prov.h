@@ -147,6 +147,17 @@ RXM_INI ;
 #  define RXM_INIT NULL
 #endif
 
+#if (HAVE_SHM) && (HAVE_SHM_DL)
+#  define SHM_INI FI_EXT_INI
+#  define SHM_INIT NULL
+#elif (HAVE_SHM)
+#  define SHM_INI INI_SIG(fi_shm_ini)
+#  define SHM_INIT fi_shm_ini()
+SHM_INI ;
+#else
+#  define SHM_INIT NULL
+#endif
+
 #if (HAVE_RXD) && (HAVE_RXD_DL)
 #  define RXD_INI FI_EXT_INI
 #  define RXD_INIT NULL
@@ -60,6 +60,22 @@ enum {
 enum {
 	FI_OPT_MIN_MULTI_RECV,		/* size_t */
 	FI_OPT_CM_DATA_SIZE,		/* size_t */
+	FI_OPT_EP_STATS,		/* struct fi_ep_stats */
+};
+
+struct fi_ep_stats {
+	uint64_t		tx_posted;
+	uint64_t		tx_completed;
+	uint64_t		rx_posted;
+	uint64_t		rx_completed;
+	uint64_t		errors;
+	uint64_t		eagain;
+	uint64_t		unexp_total;
+	uint64_t		unexp_cur;
+	uint64_t		unexp_max;
+	uint64_t		retransmits;
+	uint64_t		rndv;
+	uint64_t		buf_exhausted;
 };
 
 struct fi_ops_ep {
@@ -92,6 +92,11 @@ static inline void ofi_freealign(void *memptr)
 	free(memptr);
 }
 
+ssize_t ofi_get_hugepage_size(void);
+int ofi_alloc_hugepage_buf(void **memptr, size_t size);
+int ofi_free_hugepage_buf(void *memptr, size_t size);
+int ofi_mbind_node(void *addr, size_t len, int node);
+
 static inline void ofi_osd_init(void)
 {
 }
@@ -212,4 +217,12 @@ OFI_DEF_COMPLEX_OPS(long_double)
 #define ofi_atomic_sub_and_fetch(radix, ptr, val) __sync_sub_and_fetch((ptr), (val))
 #endif /* HAVE_BUILTIN_ATOMICS */
 
+#define ofi_load_acquire(ptr)		__atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define ofi_store_release(ptr, val)	__atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define ofi_load_relaxed(ptr)		__atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define ofi_store_relaxed(ptr, val)	__atomic_store_n((ptr), (val), __ATOMIC_RELAXED)
+#define ofi_add_relaxed(ptr, val)	__atomic_fetch_add((ptr), (val), __ATOMIC_RELAXED)
+/* Full barrier compare and swap on a 64-bit word, nonzero on success */
+#define ofi_cas64(ptr, old, val)	__sync_bool_compare_and_swap((ptr), (old), (val))
+
 #endif /* _FI_UNIX_OSD_H_ */
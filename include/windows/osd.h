@@ -676,6 +676,33 @@ static inline void ofi_freealign(void *memptr)
 	_aligned_free(memptr);
 }
 
+static inline ssize_t ofi_get_hugepage_size(void)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int ofi_alloc_hugepage_buf(void **memptr, size_t size)
+{
+	OFI_UNUSED(memptr);
+	OFI_UNUSED(size);
+	return -FI_ENOSYS;
+}
+
+static inline int ofi_free_hugepage_buf(void *memptr, size_t size)
+{
+	OFI_UNUSED(memptr);
+	OFI_UNUSED(size);
+	return -FI_ENOSYS;
+}
+
+static inline int ofi_mbind_node(void *addr, size_t len, int node)
+{
+	OFI_UNUSED(addr);
+	OFI_UNUSED(len);
+	OFI_UNUSED(node);
+	return -FI_ENOSYS;
+}
+
 static inline void ofi_osd_init(void)
 {
 	WORD wsa_version;
@@ -875,6 +902,22 @@ typedef LONGLONG ofi_atomic_int_64_t;
 #define ofi_atomic_sub_and_fetch(radix, ptr, val) InterlockedAdd##radix((ofi_atomic_int_##radix##_t *)(ptr), -(ofi_atomic_int_##radix##_t)(val))
 #endif /* HAVE_BUILTIN_ATOMICS */
 
+/* MSVC gives volatile accesses acquire/release semantics.  These are only
+ * used on size_t ring indices. */
+#define ofi_load_acquire(ptr)		(*(volatile size_t *)(ptr))
+#define ofi_store_release(ptr, val)	(*(volatile size_t *)(ptr) = (val))
+
+/* Relaxed operations on 64-bit statistics counters */
+#define ofi_load_relaxed(ptr)		(*(volatile uint64_t *)(ptr))
+#define ofi_store_relaxed(ptr, val)	(*(volatile uint64_t *)(ptr) = (val))
+#define ofi_add_relaxed(ptr, val)	\
+	InterlockedExchangeAddNoFence64((LONG64 volatile *)(ptr), (LONG64)(val))
+
+/* Full barrier compare and swap on a 64-bit word, nonzero on success */
+#define ofi_cas64(ptr, old, val)					\
+	(InterlockedCompareExchange64((LONG64 volatile *)(ptr),		\
+		(LONG64)(val), (LONG64)(old)) == (LONG64)(old))
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,6 +50,7 @@
 typedef CRITICAL_SECTION	pthread_mutex_t;
 typedef CONDITION_VARIABLE	pthread_cond_t;
 typedef HANDLE			pthread_t;
+typedef DWORD			pthread_key_t;
 
 static inline int pthread_mutex_lock(pthread_mutex_t* mutex)
 {
@@ -137,6 +138,34 @@ static inline pthread_t pthread_self(void)
 	return (pthread_t) ENOSYS;
 }
 
+/* Fiber local storage runs its callback on thread exit, like pthread keys */
+static inline int pthread_key_create(pthread_key_t *key, void (*destructor)(void *))
+{
+	*key = FlsAlloc((PFLS_CALLBACK_FUNCTION) destructor);
+	return *key == FLS_OUT_OF_INDEXES ? ENOMEM : 0;
+}
+
+#define pthread_key_delete(key) (FlsFree(key) ? 0 : EINVAL)
+#define pthread_getspecific(key) FlsGetValue(key)
+#define pthread_setspecific(key, val) (FlsSetValue(key, (PVOID) (val)) ? 0 : ENOMEM)
+
+typedef INIT_ONCE		pthread_once_t;
+#define PTHREAD_ONCE_INIT	INIT_ONCE_STATIC_INIT
+
+static BOOL CALLBACK ofi_once_starter(PINIT_ONCE once, PVOID arg, PVOID *ctx)
+{
+	(void) once;
+	(void) ctx;
+	((void (*)(void)) arg)();
+	return TRUE;
+}
+
+static inline int pthread_once(pthread_once_t *once, void (*routine)(void))
+{
+	return InitOnceExecuteOnce(once, ofi_once_starter, (PVOID) routine,
+				   NULL) ? 0 : EINVAL;
+}
+
 /*
  * TODO: temporary solution
  * Need to re-implement
@@ -52,6 +52,9 @@ int mlx_cq_open (
 		return status;
 	}
 
+	/* UCX callbacks write to the CQ from any thread */
+	u_cq->spsc = 0;
+
 	*cq_fid = &(u_cq->cq_fid);
 	return FI_SUCCESS;
 }
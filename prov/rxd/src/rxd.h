@@ -75,9 +75,20 @@
 #define RXD_TX_POOL_CHUNK_CNT	1024
 #define RXD_RX_POOL_CHUNK_CNT	1024
 
-#define RXD_MAX_RX_CREDITS	16
-#define RXD_MAX_PEER_TX		8
-#define RXD_MAX_UNACKED		128
+/* receive window granted per message, bounded by the SACK bitmap */
+#define RXD_MAX_RX_WIN		RXD_SACK_BITS
+
+/* per peer congestion window, in packets */
+#define RXD_INIT_CWND		16
+#define RXD_MIN_CWND		2
+#define RXD_MAX_CWND		1024
+
+/* retransmission timeout, in usec */
+#define RXD_INIT_RTO		1000
+#define RXD_MIN_RTO		1000
+#define RXD_MAX_RTO		4000000
+/* a stalled receive repeats its ack before the sender's RTO expires */
+#define RXD_NACK_TIMEOUT	(RXD_MIN_RTO / 2)
 
 #define RXD_EP_MAX_UNEXP_PKT	512
 #define RXD_EP_MAX_UNEXP_MSG	128
@@ -86,8 +97,13 @@
 #define RXD_NO_COMPLETION	(1ULL << 62)
 
 #define RXD_MAX_PKT_RETRY	50
+#define RXD_MAX_RETRY_SHIFT	12
+#define RXD_SACK_BITS		64
+#define RXD_PROGRESS_BATCH	16
 
 extern int rxd_progress_spin_count;
+extern int rxd_use_hugepages;
+extern int rxd_numa_node;
 extern int rxd_reposted_bufs;
 
 extern struct fi_provider rxd_prov;
@@ -128,13 +144,24 @@ struct rxd_av {
 };
 
 struct rxd_cq;
-typedef int (*rxd_cq_write_fn)(struct rxd_cq *cq,
-			       struct fi_cq_tagged_entry *cq_entry);
+typedef void (*rxd_cq_write_fn)(struct fi_cq_tagged_entry *comp,
+				const struct fi_cq_tagged_entry *cq_entry);
 struct rxd_cq {
 	struct util_cq util_cq;
 	rxd_cq_write_fn write_fn;
 };
 
+/*
+ * Completions generated while holding the ep lock are staged here and
+ * written to the CQ with a single reserve/commit before the lock is
+ * released.
+ */
+struct rxd_cq_batch {
+	struct rxd_cq *cq;
+	size_t count;
+	struct fi_cq_tagged_entry comp[RXD_PROGRESS_BATCH];
+};
+
 struct rxd_peer {
 	uint64_t		nxt_msg_id;
 	uint64_t		exp_msg_id;
@@ -142,7 +169,18 @@ struct rxd_peer {
 	fi_addr_t		fiaddr;
 
 	enum util_cmap_state	state;
-	uint16_t		active_tx_cnt;
+
+	/* AIMD congestion window, counted in packets in flight */
+	uint32_t		cwnd;
+	uint32_t		ssthresh;
+	uint32_t		cwnd_cnt;
+	uint32_t		unacked;
+	uint64_t		recover_time;
+
+	/* smoothed RTT and retransmission timeout, in usec */
+	uint64_t		srtt;
+	uint64_t		rttvar;
+	uint64_t		rto;
 };
 
 struct rxd_ep {
@@ -162,6 +200,7 @@ struct rxd_ep {
 
 	int do_local_mr;
 	struct dlist_entry wait_rx_list;
+	struct dlist_entry ack_list;
 	struct dlist_entry unexp_tag_list;
 	struct dlist_entry unexp_msg_list;
 	uint16_t num_unexp_pkt;
@@ -173,6 +212,10 @@ struct rxd_ep {
 
 	struct rxd_tx_entry_fs *tx_entry_fs;
 	struct dlist_entry tx_entry_list;
+	/* tx entries with data in the window that could not be sent yet */
+	struct dlist_entry tx_blocked_list;
+	/* retry and nack timers, in usec */
+	struct ofi_timer_wheel timer_wheel;
 
 	struct rxd_rx_entry_fs *rx_entry_fs;
 	struct dlist_entry rx_entry_list;
@@ -182,6 +225,10 @@ struct rxd_ep {
 
 	struct rxd_trecv_fs *trecv_fs;
 	struct dlist_entry trecv_list;
+
+	/* completions staged under lock, see rxd_ep_flush_comp() */
+	struct rxd_cq_batch tx_comp;
+	struct rxd_cq_batch rx_comp;
 	fastlock_t lock;
 };
 
@@ -225,8 +272,11 @@ struct rxd_rx_entry {
 	fi_addr_t source;
 	struct rxd_peer *peer_info;
 	struct rxd_rx_buf *unexp_buf;
-	uint64_t nack_stamp;
+	struct ofi_timer nack_timer;
+	/* bit i set: segment exp_seg_no + i has been received */
+	uint64_t sack;
 	struct dlist_entry entry;
+	struct dlist_entry ack_entry;
 
 	union {
 		struct rxd_recv_entry *recv;
@@ -256,10 +306,11 @@ struct rxd_tx_entry {
 	uint64_t bytes_sent;
 	uint32_t seg_no;
 	uint32_t window;
-	uint64_t retry_time;
+	struct ofi_timer retry_timer;
 	uint8_t retry_cnt;
 
 	struct dlist_entry entry;
+	struct dlist_entry blocked_entry;
 	struct dlist_entry pkt_list;
 
 	uint8_t op_type;
@@ -327,11 +378,27 @@ struct rxd_pkt_data {
 	char data[];
 };
 
+/*
+ * ctrl.seg_no is the next segment expected by the receiver.  Bit i of
+ * sack is set if segment seg_no + i has already been received out of order.
+ */
+struct rxd_pkt_ack {
+	struct ofi_ctrl_hdr ctrl;
+	uint64_t sack;
+};
+
+static inline size_t rxd_ep_data_seg_size(struct rxd_ep *ep)
+{
+	return rxd_ep_domain(ep)->max_mtu_sz - sizeof(struct rxd_pkt_data);
+}
+
 #define RXD_PKT_FIRST	(1 << 0)
 #define RXD_PKT_LAST	(1 << 1)
 #define RXD_LOCAL_COMP	(1 << 2)
 #define RXD_REMOTE_ACK	(1 << 3)
 #define RXD_NOT_ACKED	RXD_REMOTE_ACK
+#define RXD_FAST_RETRY	(1 << 4)
+#define RXD_PKT_RETRIED	(1 << 5)
 
 struct rxd_pkt_meta {
 	struct fi_context context;
@@ -340,6 +407,7 @@ struct rxd_pkt_meta {
 	struct rxd_ep *ep;
 	struct fid_mr *mr;
 	int flags;
+	uint64_t send_time;
 
 	/* TODO: use iov and remove data copies */
 	char pkt_data[]; /* rxd_pkt_data*, followed by data */
@@ -390,8 +458,13 @@ void rxd_ep_handle_data_msg(struct rxd_ep *ep, struct rxd_peer *peer,
 			    struct iovec *iov, size_t iov_count,
 			    struct ofi_ctrl_hdr *ctrl, void *data,
 			    struct rxd_rx_buf *rx_buf);
-void rxd_ep_free_acked_pkts(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
-			    uint32_t seg_no);
+void rxd_ep_ack_pkts(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
+		     uint32_t seg_no, uint64_t sack);
+void rxd_ep_release_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
+			struct rxd_pkt_meta *pkt);
+void rxd_ep_send_pending_acks(struct rxd_ep *ep);
+void rxd_ep_retry_lost_start(struct rxd_ep *ep, fi_addr_t peer,
+			     uint64_t msg_seq);
 ssize_t rxd_ep_start_xfer(struct rxd_ep *ep, struct rxd_peer *peer,
 			  uint8_t op, struct rxd_tx_entry *tx_entry);
 ssize_t rxd_ep_connect(struct rxd_ep *ep, struct rxd_peer *peer, fi_addr_t addr);
@@ -403,10 +476,15 @@ int rxd_mr_verify(struct rxd_domain *rxd_domain, ssize_t len,
 struct rxd_tx_entry *rxd_tx_entry_alloc(struct rxd_ep *ep,
 	struct rxd_peer *peer, fi_addr_t addr, uint64_t flags, uint8_t op);
 void rxd_tx_entry_progress(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry);
+void rxd_tx_entry_timeout(struct ofi_timer_wheel *wheel, struct ofi_timer *timer);
 void rxd_tx_entry_discard(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry);
 void rxd_tx_entry_free(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry);
 void rxd_tx_entry_done(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry);
-void rxd_set_timeout(struct rxd_tx_entry *tx_entry);
+void rxd_set_timeout(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry);
+void rxd_rx_entry_nack(struct ofi_timer_wheel *wheel, struct ofi_timer *timer);
+
+void rxd_peer_init(struct rxd_peer *peer);
+void rxd_peer_congested(struct rxd_peer *peer, int timeout);
 
 void rxd_tx_pkt_free(struct rxd_pkt_meta *pkt_meta);
 void rxd_rx_entry_free(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry);
@@ -414,7 +492,10 @@ void rxd_rx_entry_free(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry);
 
 /* CQ sub-functions */
 void rxd_cq_report_error(struct rxd_cq *cq, struct fi_cq_err_entry *err_entry);
-void rxd_cq_report_tx_comp(struct rxd_cq *cq, struct rxd_tx_entry *tx_entry);
+void rxd_cq_report_tx_comp(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry);
+void rxd_ep_write_comp(struct rxd_ep *ep, struct rxd_cq *cq,
+		       const struct fi_cq_tagged_entry *cq_entry);
+void rxd_ep_flush_comp(struct rxd_ep *ep);
 void rxd_cntr_report_tx_comp(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry);
 
 #endif
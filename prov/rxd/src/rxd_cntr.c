@@ -80,6 +80,7 @@ void rxd_cntr_report_tx_comp(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry)
 		return;
 	}
 
+	ofi_ep_stat_inc(&ep->util_ep, tx_completed);
 	if (cntr)
 		cntr->cntr_fid.ops->add(&cntr->cntr_fid, 1);
 }
@@ -64,97 +64,73 @@ static const char *rxd_cq_strerror(struct fid_cq *cq_fid, int prov_errno,
 	return str;
 }
 
-static int rxd_cq_write_ctx(struct rxd_cq *cq,
-			     struct fi_cq_tagged_entry *cq_entry)
+static void rxd_cq_write_ctx(struct fi_cq_tagged_entry *comp,
+			     const struct fi_cq_tagged_entry *cq_entry)
 {
-	struct fi_cq_tagged_entry *comp;
-	if (ofi_cirque_isfull(cq->util_cq.cirq))
-		return -FI_ENOSPC;
-
-	comp = ofi_cirque_tail(cq->util_cq.cirq);
 	comp->op_context = cq_entry->op_context;
-	ofi_cirque_commit(cq->util_cq.cirq);
-	return 0;
+	comp->flags = cq_entry->flags;
+	comp->len = 0;
+	comp->buf = NULL;
+	comp->data = 0;
+	comp->tag = 0;
 }
 
-static int rxd_cq_write_ctx_signal(struct rxd_cq *cq,
-				    struct fi_cq_tagged_entry *cq_entry)
+static void rxd_cq_write_msg(struct fi_cq_tagged_entry *comp,
+			     const struct fi_cq_tagged_entry *cq_entry)
 {
-	int ret = rxd_cq_write_ctx(cq, cq_entry);
-	cq->util_cq.wait->signal(cq->util_cq.wait);
-	return ret;
+	rxd_cq_write_ctx(comp, cq_entry);
+	comp->len = cq_entry->len;
 }
 
-static int rxd_cq_write_msg(struct rxd_cq *cq,
-			     struct fi_cq_tagged_entry *cq_entry)
+static void rxd_cq_write_data(struct fi_cq_tagged_entry *comp,
+			      const struct fi_cq_tagged_entry *cq_entry)
 {
-	struct fi_cq_tagged_entry *comp;
-	if (ofi_cirque_isfull(cq->util_cq.cirq))
-		return -FI_ENOSPC;
-
-	comp = ofi_cirque_tail(cq->util_cq.cirq);
-	comp->op_context = cq_entry->op_context;
-	comp->flags = cq_entry->flags;
-	comp->len = cq_entry->len;
-	ofi_cirque_commit(cq->util_cq.cirq);
-	return 0;
+	*comp = *cq_entry;
+	comp->tag = 0;
 }
 
-static int rxd_cq_write_msg_signal(struct rxd_cq *cq,
-				    struct fi_cq_tagged_entry *cq_entry)
+static void rxd_cq_write_tagged(struct fi_cq_tagged_entry *comp,
+				const struct fi_cq_tagged_entry *cq_entry)
 {
-	int ret = rxd_cq_write_msg(cq, cq_entry);
-	cq->util_cq.wait->signal(cq->util_cq.wait);
-	return ret;
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL,
+		"report completion: %p\n", cq_entry->tag);
+	*comp = *cq_entry;
 }
 
-static int rxd_cq_write_data(struct rxd_cq *cq,
-			      struct fi_cq_tagged_entry *cq_entry)
+static void rxd_ep_flush_batch(struct rxd_cq_batch *batch)
 {
-	struct fi_cq_tagged_entry *comp;
-	if (ofi_cirque_isfull(cq->util_cq.cirq))
-		return -FI_ENOSPC;
+	ssize_t ret;
 
-	comp = ofi_cirque_tail(cq->util_cq.cirq);
-	comp->op_context = cq_entry->op_context;
-	comp->flags = cq_entry->flags;
-	comp->len = cq_entry->len;
-	comp->buf = cq_entry->buf;
-	comp->data = cq_entry->data;
-	ofi_cirque_commit(cq->util_cq.cirq);
-	return 0;
-}
+	if (!batch->count)
+		return;
 
-static int rxd_cq_write_data_signal(struct rxd_cq *cq,
-				     struct fi_cq_tagged_entry *cq_entry)
-{
-	int ret = rxd_cq_write_data(cq, cq_entry);
-	cq->util_cq.wait->signal(cq->util_cq.wait);
-	return ret;
+	ret = ofi_cq_write_batch(&batch->cq->util_cq, batch->comp,
+				 batch->count);
+	if (ret != batch->count)
+		FI_WARN(&rxd_prov, FI_LOG_CQ,
+			"CQ overrun, dropped %zu completions\n",
+			batch->count - (ret < 0 ? 0 : ret));
+	batch->count = 0;
 }
 
-static int rxd_cq_write_tagged(struct rxd_cq *cq,
-				struct fi_cq_tagged_entry *cq_entry)
+void rxd_ep_write_comp(struct rxd_ep *ep, struct rxd_cq *cq,
+		       const struct fi_cq_tagged_entry *cq_entry)
 {
-	struct fi_cq_tagged_entry *comp;
-	if (ofi_cirque_isfull(cq->util_cq.cirq))
-		return -FI_ENOSPC;
+	struct rxd_cq_batch *batch;
 
-	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL,
-		"report completion: %p\n", cq_entry->tag);
+	batch = (cq == rxd_ep_tx_cq(ep)) ? &ep->tx_comp : &ep->rx_comp;
+	if (batch->count == RXD_PROGRESS_BATCH)
+		rxd_ep_flush_batch(batch);
 
-	comp = ofi_cirque_tail(cq->util_cq.cirq);
-	*comp = *cq_entry;
-	ofi_cirque_commit(cq->util_cq.cirq);
-	return 0;
+	batch->cq = cq;
+	cq->write_fn(&batch->comp[batch->count++], cq_entry);
 }
 
-static int rxd_cq_write_tagged_signal(struct rxd_cq *cq,
-				       struct fi_cq_tagged_entry *cq_entry)
+/* Must be called before releasing ep->lock after writing completions */
+void rxd_ep_flush_comp(struct rxd_ep *ep)
 {
-	int ret = rxd_cq_write_tagged(cq, cq_entry);
-	cq->util_cq.wait->signal(cq->util_cq.wait);
-	return ret;
+	rxd_ep_flush_batch(&ep->tx_comp);
+	rxd_ep_flush_batch(&ep->rx_comp);
 }
 
 static int rxd_check_start_pkt_order(struct rxd_ep *ep, struct rxd_peer *peer,
@@ -261,6 +237,7 @@ int rxd_tx_pkt_match(struct dlist_entry *item, const void *arg)
 }
 
 static void rxd_handle_ack(struct rxd_ep *ep, struct ofi_ctrl_hdr *ctrl,
+			   struct fi_cq_msg_entry *comp,
 			   struct rxd_rx_buf *rx_buf)
 {
 	struct rxd_tx_entry *tx_entry;
@@ -275,13 +252,20 @@ static void rxd_handle_ack(struct rxd_ep *ep, struct ofi_ctrl_hdr *ctrl,
 	if (tx_entry->msg_id != ctrl->msg_id)
 		goto out;
 
-	rxd_ep_free_acked_pkts(ep, tx_entry, ctrl->seg_no);
+	rxd_ep_ack_pkts(ep, tx_entry, ctrl->seg_no,
+			(comp->len >= sizeof(struct rxd_pkt_ack)) ?
+			((struct rxd_pkt_ack *) ctrl)->sack : 0);
+
+	/* the peer is responsive, restart the retry back-off */
+	tx_entry->retry_cnt = 0;
+	rxd_set_timeout(ep, tx_entry);
+
 	if ((tx_entry->bytes_sent == tx_entry->op_hdr.size) &&
 	    dlist_empty(&tx_entry->pkt_list)) {
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL,
 			"reporting TX completion : %p\n", tx_entry);
 		if (tx_entry->op_type != RXD_TX_READ_REQ) {
-			rxd_cq_report_tx_comp(rxd_ep_tx_cq(ep), tx_entry);
+			rxd_cq_report_tx_comp(ep, tx_entry);
 			rxd_cntr_report_tx_comp(ep, tx_entry);
 			rxd_tx_entry_free(ep, tx_entry);
 		}
@@ -292,11 +276,39 @@ static void rxd_handle_ack(struct rxd_ep *ep, struct ofi_ctrl_hdr *ctrl,
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL,
 		       "ack- msg_id: %" PRIu64 ", window: %d\n",
 		       ctrl->msg_id, tx_entry->window);
+		if (tx_entry->seg_no < tx_entry->window)
+			rxd_tx_entry_progress(ep, tx_entry);
 	}
 out:
 	rxd_ep_repost_buff(rx_buf);
 }
 
+/*
+ * A nack reports, in rx_key, the sequence number of the message whose start
+ * packet the peer is still waiting for.  The nacked message itself was
+ * received out of order and will be resent after that one.
+ */
+static void rxd_handle_nack(struct rxd_ep *ep, struct ofi_ctrl_hdr *ctrl,
+			    struct rxd_rx_buf *rx_buf)
+{
+	struct rxd_tx_entry *tx_entry;
+	uint64_t idx;
+
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL,
+	       "nack- msg_id: %" PRIu64 ", expected: %" PRIu64 "\n",
+	       ctrl->msg_id, ctrl->rx_key);
+
+	idx = ctrl->msg_id & RXD_TX_IDX_BITS;
+	tx_entry = &ep->tx_entry_fs->buf[idx];
+	if (tx_entry->msg_id == ctrl->msg_id) {
+		tx_entry->retry_cnt = 0;
+		rxd_set_timeout(ep, tx_entry);
+		rxd_ep_retry_lost_start(ep, tx_entry->peer, ctrl->rx_key);
+	}
+
+	rxd_ep_repost_buff(rx_buf);
+}
+
 /*
  * Discarded transfers were discarded by the receiving side, so we abort
  * transferring the rest of the data.  However, the completion is still
@@ -318,7 +330,7 @@ static void rxd_handle_discard(struct rxd_ep *ep, struct ofi_ctrl_hdr *ctrl,
 	idx = ctrl->msg_id & RXD_TX_IDX_BITS;
 	tx_entry = &ep->tx_entry_fs->buf[idx];
 	if (tx_entry->msg_id == ctrl->msg_id) {
-		rxd_cq_report_tx_comp(rxd_ep_tx_cq(ep), tx_entry);
+		rxd_cq_report_tx_comp(ep, tx_entry);
 		rxd_cntr_report_tx_comp(ep, tx_entry);
 		rxd_tx_entry_done(ep, tx_entry);
 	}
@@ -338,11 +350,7 @@ void rxd_tx_entry_done(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry)
 	while (!dlist_empty(&tx_entry->pkt_list)) {
 		pkt_meta = container_of(tx_entry->pkt_list.next,
 					struct rxd_pkt_meta, entry);
-		dlist_remove(&pkt_meta->entry);
-		if (pkt_meta->flags & RXD_LOCAL_COMP)
-			rxd_tx_pkt_free(pkt_meta);
-		else
-			pkt_meta->flags |= RXD_REMOTE_ACK;
+		rxd_ep_release_pkt(ep, tx_entry, pkt_meta);
 	}
 	rxd_tx_entry_free(ep, tx_entry);
 }
@@ -385,17 +393,27 @@ out:
 	rxd_ep_repost_buff(rx_buf);
 }
 
+/*
+ * Slide the receive window forward: top up the segments granted to the
+ * sender to RXD_MAX_RX_WIN, limited by the remaining message size and the
+ * receive buffers available.  rx_entry->credits is the number of granted
+ * segments not yet consumed, i.e. last_win_seg - exp_seg_no.
+ */
 static void rxd_set_rx_credits(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry)
 {
-	size_t num_pkts, avail, size_left;
+	size_t num_pkts, avail, size_left, seg_size;
 
+	seg_size = rxd_ep_data_seg_size(ep);
 	size_left = rx_entry->op_hdr.size - rx_entry->done;
-	num_pkts = (size_left + rxd_ep_domain(ep)->max_mtu_sz - 1) /
-		    rxd_ep_domain(ep)->max_mtu_sz;
-	avail = MIN(ep->credits, num_pkts);
-	rx_entry->credits = MIN(avail, RXD_MAX_RX_CREDITS);
-	rx_entry->last_win_seg += rx_entry->credits;
-	ep->credits -= rx_entry->credits;
+	num_pkts = (size_left + seg_size - 1) / seg_size;
+	if (num_pkts <= rx_entry->credits)
+		return;
+
+	avail = MIN(ep->credits, num_pkts - rx_entry->credits);
+	avail = MIN(avail, RXD_MAX_RX_WIN - rx_entry->credits);
+	rx_entry->credits += avail;
+	rx_entry->last_win_seg += avail;
+	ep->credits -= avail;
 }
 
 static struct rxd_rx_entry *rxd_rx_entry_alloc(struct rxd_ep *ep)
@@ -408,6 +426,8 @@ static struct rxd_rx_entry *rxd_rx_entry_alloc(struct rxd_ep *ep)
 	rx_entry = freestack_pop(ep->rx_entry_fs);
 	rx_entry->key = rx_entry - &ep->rx_entry_fs->buf[0];
 	dlist_insert_tail(&rx_entry->entry, &ep->rx_entry_list);
+	dlist_init(&rx_entry->ack_entry);
+	ofi_timer_init(&rx_entry->nack_timer, rxd_rx_entry_nack);
 	return rx_entry;
 }
 
@@ -432,6 +452,56 @@ static void rxd_progress_wait_rx(struct rxd_ep *ep,
 	rxd_ep_reply_ack(ep, &ctrl, ofi_ctrl_ack, rx_entry->credits,
 		       rx_entry->key, rx_entry->peer_info->conn_data,
 		       ctrl.conn_id);
+	ofi_timer_start(&ep->timer_wheel, &rx_entry->nack_timer,
+			fi_gettime_us() + RXD_NACK_TIMEOUT);
+}
+
+static void rxd_rx_entry_ack(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry)
+{
+	struct ofi_ctrl_hdr ctrl;
+
+	rxd_set_rx_credits(ep, rx_entry);
+	ctrl.msg_id = rx_entry->msg_id;
+	ctrl.seg_no = rx_entry->exp_seg_no - 1;
+	ctrl.conn_id = rx_entry->peer;
+
+	rxd_ep_reply_ack(ep, &ctrl, ofi_ctrl_ack, rx_entry->credits,
+			 rx_entry->key, rx_entry->peer_info->conn_data,
+			 ctrl.conn_id);
+}
+
+void rxd_ep_send_pending_acks(struct rxd_ep *ep)
+{
+	struct rxd_rx_entry *rx_entry;
+
+	while (!dlist_empty(&ep->ack_list)) {
+		rx_entry = container_of(ep->ack_list.next,
+					struct rxd_rx_entry, ack_entry);
+		dlist_remove(&rx_entry->ack_entry);
+		dlist_init(&rx_entry->ack_entry);
+
+		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "deferred ack [%p] - %d\n",
+		       rx_entry->msg_id, rx_entry->exp_seg_no);
+		rxd_rx_entry_ack(ep, rx_entry);
+	}
+}
+
+/*
+ * No data arrived for a partially received message since its window was
+ * last granted.  The ack may have been lost, so repeat it, along with the
+ * SACK state, before the sender times out and resends the whole window.
+ */
+void rxd_rx_entry_nack(struct ofi_timer_wheel *wheel, struct ofi_timer *timer)
+{
+	struct rxd_ep *ep;
+	struct rxd_rx_entry *rx_entry;
+
+	ep = container_of(wheel, struct rxd_ep, timer_wheel);
+	rx_entry = container_of(timer, struct rxd_rx_entry, nack_timer);
+
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "rx stalled [%p] - %d\n",
+	       rx_entry->msg_id, rx_entry->exp_seg_no);
+	rxd_rx_entry_ack(ep, rx_entry);
 }
 
 static void rxd_check_waiting_rx(struct rxd_ep *ep)
@@ -453,6 +523,8 @@ void rxd_rx_entry_free(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry)
 {
 	rx_entry->key = -1;
 	dlist_remove(&rx_entry->entry);
+	dlist_remove(&rx_entry->ack_entry);
+	ofi_timer_stop(&ep->timer_wheel, &rx_entry->nack_timer);
 	freestack_push(ep->rx_entry_fs, rx_entry);
 
 	if (ep->credits && !dlist_empty(&ep->wait_rx_list))
@@ -528,21 +600,12 @@ struct rxd_trecv_entry *rxd_get_trecv_entry(struct rxd_ep *ep,
 
 void rxd_cq_report_error(struct rxd_cq *cq, struct fi_cq_err_entry *err_entry)
 {
-	struct fi_cq_tagged_entry cq_entry = {0};
-	struct util_cq_err_entry *entry = calloc(1, sizeof(*entry));
-	if (!entry) {
+	if (ofi_cq_write_error(&cq->util_cq, err_entry))
 		FI_WARN(&rxd_prov, FI_LOG_CQ,
 			"out of memory, cannot report CQ error\n");
-		return;
-	}
-
-	entry->err_entry = *err_entry;
-	slist_insert_tail(&entry->list_entry, &cq->util_cq.err_list);
-	cq_entry.flags = UTIL_FLAG_ERROR;
-	cq->write_fn(cq, &cq_entry);
 }
 
-void rxd_cq_report_tx_comp(struct rxd_cq *cq, struct rxd_tx_entry *tx_entry)
+void rxd_cq_report_tx_comp(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry)
 {
 	struct fi_cq_tagged_entry cq_entry = {0};
 
@@ -584,7 +647,7 @@ void rxd_cq_report_tx_comp(struct rxd_cq *cq, struct rxd_tx_entry *tx_entry)
 		return;
 	}
 
-	cq->write_fn(cq, &cq_entry);
+	rxd_ep_write_comp(ep, rxd_ep_tx_cq(ep), &cq_entry);
 }
 
 void rxd_ep_handle_data_msg(struct rxd_ep *ep, struct rxd_peer *peer,
@@ -611,17 +674,42 @@ void rxd_ep_handle_data_msg(struct rxd_ep *ep, struct rxd_peer *peer,
 		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "TODO: message truncated\n");
 	}
 
-	if (rx_entry->credits == 0) {
+	/* Consume the segments that were received ahead of this one */
+	for (rx_entry->sack >>= 1; rx_entry->sack & 1; rx_entry->sack >>= 1) {
+		rx_entry->done += MIN(rxd_ep_data_seg_size(ep),
+				      rx_entry->op_hdr.size - rx_entry->done);
+		rx_entry->credits--;
+		rx_entry->exp_seg_no++;
+		ep->credits++;
+	}
+
+	/*
+	 * Ack right away once the window is used up or the message is
+	 * complete.  Otherwise the ack is deferred to the end of the progress
+	 * pass, so a sender limited by its congestion window keeps receiving
+	 * acks without one being sent per segment.
+	 */
+	if (rx_entry->credits == 0 || rx_entry->op_hdr.size == rx_entry->done) {
 		rxd_set_rx_credits(ep, rx_entry);
 
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "replying ack [%p] - %d\n",
 			ctrl->msg_id, ctrl->seg_no);
 
+		dlist_remove(&rx_entry->ack_entry);
+		dlist_init(&rx_entry->ack_entry);
 		rxd_ep_reply_ack(ep, ctrl, ofi_ctrl_ack, rx_entry->credits,
 			       rx_entry->key, peer->conn_data, ctrl->conn_id);
+	} else if (dlist_empty(&rx_entry->ack_entry)) {
+		dlist_insert_tail(&rx_entry->ack_entry, &ep->ack_list);
 	}
 
 	if (rx_entry->op_hdr.size != rx_entry->done) {
+		if (rx_entry->credits)
+			ofi_timer_start(&ep->timer_wheel, &rx_entry->nack_timer,
+					fi_gettime_us() + RXD_NACK_TIMEOUT);
+		else
+			ofi_timer_stop(&ep->timer_wheel, &rx_entry->nack_timer);
+
 		if (rx_entry->credits == 0) {
 			dlist_init(&rx_entry->wait_entry);
 			dlist_insert_tail(&rx_entry->wait_entry, &ep->wait_rx_list);
@@ -647,7 +735,8 @@ void rxd_ep_handle_data_msg(struct rxd_ep *ep, struct rxd_peer *peer,
 		cq_entry.len = rx_entry->done;
 		cq_entry.buf = rx_entry->recv->iov[0].iov_base;
 		cq_entry.data = rx_entry->op_hdr.data;
-		rxd_rx_cq->write_fn(rxd_rx_cq, &cq_entry);
+		rxd_ep_write_comp(ep, rxd_rx_cq, &cq_entry);
+		ofi_ep_stat_inc(&ep->util_ep, rx_completed);
 		break;
 	case ofi_op_tagged:
 		freestack_push(ep->trecv_fs, rx_entry->trecv);
@@ -660,14 +749,15 @@ void rxd_ep_handle_data_msg(struct rxd_ep *ep, struct rxd_peer *peer,
 		cq_entry.buf = rx_entry->trecv->iov[0].iov_base;
 		cq_entry.data = rx_entry->op_hdr.data;
 		cq_entry.tag = rx_entry->trecv->msg.tag;\
-		rxd_rx_cq->write_fn(rxd_rx_cq, &cq_entry);
+		rxd_ep_write_comp(ep, rxd_rx_cq, &cq_entry);
+		ofi_ep_stat_inc(&ep->util_ep, rx_completed);
 		break;
 	case ofi_op_atomic:
 		/* Handle cntr */ 
 		cntr = ep->util_ep.rem_wr_cntr;
 		/* Handle CQ comp */
 		cq_entry.flags |= FI_ATOMIC;
-		rxd_rx_cq->write_fn(rxd_rx_cq, &cq_entry);
+		rxd_ep_write_comp(ep, rxd_rx_cq, &cq_entry);
 		break;
 	case ofi_op_write:
 		/* Handle cntr */
@@ -679,11 +769,11 @@ void rxd_ep_handle_data_msg(struct rxd_ep *ep, struct rxd_peer *peer,
 			cq_entry.len = rx_entry->done;
 			cq_entry.buf = rx_entry->write.iov[0].iov_base;
 			cq_entry.data = rx_entry->op_hdr.data;
-			rxd_rx_cq->write_fn(rxd_rx_cq, &cq_entry);
+			rxd_ep_write_comp(ep, rxd_rx_cq, &cq_entry);
 		}
 		break;
 	case ofi_op_read_rsp:
-		rxd_cq_report_tx_comp(rxd_ep_tx_cq(ep), rx_entry->read_rsp.tx_entry);
+		rxd_cq_report_tx_comp(ep, rx_entry->read_rsp.tx_entry);
 		rxd_cntr_report_tx_comp(ep, rx_entry->read_rsp.tx_entry);
 		rxd_tx_entry_done(ep, rx_entry->read_rsp.tx_entry);
 		break;
@@ -739,6 +829,7 @@ void rxd_ep_check_unexp_msg_list(struct rxd_ep *ep, struct rxd_recv_entry *recv_
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "progressing unexp msg entry\n");
 		dlist_remove(&recv_entry->entry);
 		ep->num_unexp_msg--;
+		ofi_ep_stat_unexp_dec(&ep->util_ep);
 
 		rx_entry = container_of(match, struct rxd_rx_entry, unexp_entry);
 		rx_entry->recv = recv_entry;
@@ -778,6 +869,7 @@ void rxd_ep_check_unexp_tag_list(struct rxd_ep *ep, struct rxd_trecv_entry *trec
 		dlist_remove(match);
 		dlist_remove(&trecv_entry->entry);
 		ep->num_unexp_msg--;
+		ofi_ep_stat_unexp_dec(&ep->util_ep);
 
 		rx_entry = container_of(match, struct rxd_rx_entry, unexp_entry);
 		rx_entry->trecv = trecv_entry;
@@ -792,13 +884,65 @@ void rxd_ep_check_unexp_tag_list(struct rxd_ep *ep, struct rxd_trecv_entry *trec
 	}
 }
 
+static int rxd_rx_entry_iov(struct rxd_rx_entry *rx_entry,
+			    struct iovec **iov, size_t *iov_count)
+{
+	switch (rx_entry->op_hdr.op) {
+	case ofi_op_msg:
+		*iov = rx_entry->recv->iov;
+		*iov_count = rx_entry->recv->msg.iov_count;
+		return 0;
+	case ofi_op_tagged:
+		*iov = rx_entry->trecv->iov;
+		*iov_count = rx_entry->trecv->msg.iov_count;
+		return 0;
+	case ofi_op_write:
+		*iov = rx_entry->write.iov;
+		*iov_count = rx_entry->op_hdr.iov_count;
+		return 0;
+	case ofi_op_read_rsp:
+		*iov = rx_entry->read_rsp.tx_entry->read_req.dst_iov;
+		*iov_count = rx_entry->read_rsp.tx_entry->read_req.msg.iov_count;
+		return 0;
+	default:
+		return -FI_EINVAL;
+	}
+}
+
+/*
+ * A segment past the expected one, but inside the window granted to the
+ * sender, is placed directly into the target buffer and recorded in the
+ * SACK bitmap.  It is accounted for once the missing segments arrive.
+ */
+static void rxd_rx_entry_sack(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry,
+			      struct ofi_ctrl_hdr *ctrl, void *data)
+{
+	struct iovec *iov;
+	size_t iov_count;
+	uint32_t bit;
+
+	bit = ctrl->seg_no - rx_entry->exp_seg_no;
+	if (ctrl->seg_no >= rx_entry->last_win_seg || bit >= RXD_SACK_BITS ||
+	    (rx_entry->sack & (1ULL << bit)))
+		return;
+
+	if (rxd_rx_entry_iov(rx_entry, &iov, &iov_count))
+		return;
+
+	ofi_copy_to_iov(iov, iov_count,
+			rx_entry->done + bit * rxd_ep_data_seg_size(ep),
+			data, ctrl->seg_size);
+	rx_entry->sack |= 1ULL << bit;
+}
+
 static void rxd_handle_data(struct rxd_ep *ep, struct rxd_peer *peer,
 			    struct ofi_ctrl_hdr *ctrl, struct fi_cq_msg_entry *comp,
 			    struct rxd_rx_buf *rx_buf)
 {
 	struct rxd_rx_entry *rx_entry;
-	struct rxd_tx_entry *tx_entry;
 	struct rxd_pkt_data *pkt_data = (struct rxd_pkt_data *) ctrl;
+	struct iovec *iov;
+	size_t iov_count;
 	uint16_t credits;
 	int ret;
 
@@ -816,14 +960,18 @@ static void rxd_handle_data(struct rxd_ep *ep, struct rxd_peer *peer,
 				ctrl->seg_no, rx_entry->exp_seg_no, ctrl->rx_key,
 				ctrl->msg_id);
 
-			credits = ((rx_entry->msg_id == ctrl->msg_id) &&
-				  (rx_entry->last_win_seg == ctrl->seg_no)) ?
-				  rx_entry->credits : 0;
+			/* resend the current window in case its ack was lost */
+			credits = (rx_entry->msg_id == ctrl->msg_id) ?
+				  rx_entry->last_win_seg - rx_entry->exp_seg_no : 0;
 			rxd_ep_reply_ack(ep, ctrl, ofi_ctrl_ack, credits,
 				       ctrl->rx_key, peer->conn_data,
 				       ctrl->conn_id);
 			goto repost;
 		} else {
+			if (rx_entry->msg_id == ctrl->msg_id)
+				rxd_rx_entry_sack(ep, rx_entry, ctrl,
+						  pkt_data->data);
+
 			FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "invalid pkt: segno: %d "
 			       "expected:%d, rx-key:%d, ctrl_msg_id: %ld, "
 			       "rx_entry_msg_id: %ld\n",
@@ -841,34 +989,13 @@ static void rxd_handle_data(struct rxd_ep *ep, struct rxd_peer *peer,
 		}
 	}
 
-	rx_entry->nack_stamp = 0;
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "expected pkt: %d\n", ctrl->seg_no);
-	switch (rx_entry->op_hdr.op) {
-	case ofi_op_msg:
-		rxd_ep_handle_data_msg(ep, peer, rx_entry, rx_entry->recv->iov,
-				     rx_entry->recv->msg.iov_count, ctrl,
-				     pkt_data->data, rx_buf);
-		break;
-	case ofi_op_tagged:
-		rxd_ep_handle_data_msg(ep, peer, rx_entry, rx_entry->trecv->iov,
-				     rx_entry->trecv->msg.iov_count, ctrl,
-				     pkt_data->data, rx_buf);
-		break;
-	case ofi_op_write:
-		rxd_ep_handle_data_msg(ep, peer, rx_entry, rx_entry->write.iov,
-				       rx_entry->op_hdr.iov_count, ctrl,
-				       pkt_data->data, rx_buf);
-		break;
-	case ofi_op_read_rsp:
-		tx_entry = rx_entry->read_rsp.tx_entry;
-		rxd_ep_handle_data_msg(ep, peer, rx_entry, tx_entry->read_req.dst_iov,
-				       tx_entry->read_req.msg.iov_count, ctrl,
-				       pkt_data->data, rx_buf);
-		break;
-	case ofi_op_atomic:
-	default:
+	if (rxd_rx_entry_iov(rx_entry, &iov, &iov_count)) {
 		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "invalid op type\n");
+		goto repost;
 	}
+	rxd_ep_handle_data_msg(ep, peer, rx_entry, iov, iov_count, ctrl,
+			       pkt_data->data, rx_buf);
 
 repost:
 	rxd_ep_repost_buff(rx_buf);
@@ -894,6 +1021,7 @@ int rxd_process_start_data(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry,
 				dlist_insert_tail(&rx_entry->unexp_entry, &ep->unexp_msg_list);
 				rx_entry->unexp_buf = rx_buf;
 				ep->num_unexp_msg++;
+				ofi_ep_stat_unexp_inc(&ep->util_ep);
 				return -FI_ENOENT;
 			} else {
 				FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "dropping msg\n");
@@ -912,6 +1040,7 @@ int rxd_process_start_data(struct rxd_ep *ep, struct rxd_rx_entry *rx_entry,
 				dlist_insert_tail(&rx_entry->unexp_entry, &ep->unexp_tag_list);
 				rx_entry->unexp_buf = rx_buf;
 				ep->num_unexp_msg++;
+				ofi_ep_stat_unexp_inc(&ep->util_ep);
 				return -FI_ENOENT;
 			} else {
 				FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "dropping msg\n");
@@ -1026,6 +1155,10 @@ static void rxd_handle_start_data(struct rxd_ep *ep, struct rxd_peer *peer,
 		} else {
 			FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "unexpected pkt: %d\n",
 				ctrl->seg_no);
+			/* an earlier start packet was lost, report the gap */
+			rxd_ep_reply_ack(ep, ctrl, ofi_ctrl_nack, 0,
+					 peer->exp_msg_id, peer->conn_data,
+					 ctrl->conn_id);
 			goto repost;
 		}
 	}
@@ -1044,6 +1177,7 @@ static void rxd_handle_start_data(struct rxd_ep *ep, struct rxd_peer *peer,
 		rxd_av_fi_addr(rxd_ep_av(ep), ctrl->conn_id) : FI_ADDR_UNSPEC;
 	rx_entry->credits = 1;
 	rx_entry->last_win_seg = 1;
+	rx_entry->sack = 0;
 
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "Assign rx_entry :%d for  %p\n",
 	       rx_entry->key, rx_entry->msg_id);
@@ -1095,7 +1229,10 @@ void rxd_handle_recv_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
 		rxd_handle_conn_req(ep, ctrl, comp, rx_buf);
 		break;
 	case ofi_ctrl_ack:
-		rxd_handle_ack(ep, ctrl, rx_buf);
+		rxd_handle_ack(ep, ctrl, comp, rx_buf);
+		break;
+	case ofi_ctrl_nack:
+		rxd_handle_nack(ep, ctrl, rx_buf);
 		break;
 	case ofi_ctrl_discard:
 		rxd_handle_discard(ep, ctrl, rx_buf);
@@ -1179,20 +1316,16 @@ int rxd_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 	switch (attr->format) {
 	case FI_CQ_FORMAT_UNSPEC:
 	case FI_CQ_FORMAT_CONTEXT:
-		cq->write_fn = cq->util_cq.wait ?
-			rxd_cq_write_ctx_signal : rxd_cq_write_ctx;
+		cq->write_fn = rxd_cq_write_ctx;
 		break;
 	case FI_CQ_FORMAT_MSG:
-		cq->write_fn = cq->util_cq.wait ?
-			rxd_cq_write_msg_signal : rxd_cq_write_msg;
+		cq->write_fn = rxd_cq_write_msg;
 		break;
 	case FI_CQ_FORMAT_DATA:
-		cq->write_fn = cq->util_cq.wait ?
-			rxd_cq_write_data_signal : rxd_cq_write_data;
+		cq->write_fn = rxd_cq_write_data;
 		break;
 	case FI_CQ_FORMAT_TAGGED:
-		cq->write_fn = cq->util_cq.wait ?
-			rxd_cq_write_tagged_signal : rxd_cq_write_tagged;
+		cq->write_fn = rxd_cq_write_tagged;
 		break;
 	default:
 		ret = -FI_EINVAL;
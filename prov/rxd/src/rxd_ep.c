@@ -37,6 +37,8 @@
 #include "rxd.h"
 
 int rxd_progress_spin_count = 1000;
+int rxd_use_hugepages;
+int rxd_numa_node = -1;
 int rxd_reposted_bufs = 0;
 
 static ssize_t rxd_ep_cancel(fid_t fid, void *context)
@@ -61,6 +63,7 @@ static ssize_t rxd_ep_cancel(fid_t fid, void *context)
 		err_entry.err = FI_ECANCELED;
 		err_entry.prov_errno = -FI_ECANCELED;
 		rxd_cq_report_error(rxd_ep_rx_cq(ep), &err_entry);
+		ofi_ep_stat_inc(&ep->util_ep, errors);
 		goto out;
 	}
 
@@ -77,6 +80,7 @@ static ssize_t rxd_ep_cancel(fid_t fid, void *context)
 		err_entry.err = FI_ECANCELED;
 		err_entry.prov_errno = -FI_ECANCELED;
 		rxd_cq_report_error(rxd_ep_rx_cq(ep), &err_entry);
+		ofi_ep_stat_inc(&ep->util_ep, errors);
 		goto out;
 	}
 
@@ -88,13 +92,25 @@ out:
 static int rxd_ep_getopt(fid_t fid, int level, int optname,
 		   void *optval, size_t *optlen)
 {
-	return -FI_ENOSYS;
+	struct rxd_ep *ep;
+
+	if (level != FI_OPT_ENDPOINT || optname != FI_OPT_EP_STATS)
+		return -FI_ENOSYS;
+
+	ep = container_of(fid, struct rxd_ep, util_ep.ep_fid.fid);
+	return ofi_ep_getopt_stats(&ep->util_ep, optval, optlen);
 }
 
 static int rxd_ep_setopt(fid_t fid, int level, int optname,
 		   const void *optval, size_t optlen)
 {
-	return -FI_ENOSYS;
+	struct rxd_ep *ep;
+
+	if (level != FI_OPT_ENDPOINT || optname != FI_OPT_EP_STATS)
+		return -FI_ENOSYS;
+
+	ep = container_of(fid, struct rxd_ep, util_ep.ep_fid.fid);
+	return ofi_ep_setopt_stats(&ep->util_ep, optval, optlen);
 }
 
 struct fi_ops_ep rxd_ops_ep = {
@@ -141,10 +157,11 @@ static ssize_t rxd_ep_recvmsg(struct fid_ep *ep, const struct fi_msg *msg,
 
 	if (!dlist_empty(&rxd_ep->unexp_msg_list)) {
 		rxd_ep_check_unexp_msg_list(rxd_ep, recv_entry);
+		rxd_ep_flush_comp(rxd_ep);
 	}
 out:
 	fastlock_release(&rxd_ep->lock);
-	return ret;
+	return ofi_ep_stat_rx(&rxd_ep->util_ep, ret);
 }
 
 static ssize_t rxd_ep_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
@@ -261,13 +278,85 @@ struct rxd_peer *rxd_ep_getpeer_info(struct rxd_ep *ep, fi_addr_t addr)
 	return &ep->peer_info[addr];
 }
 
+void rxd_peer_init(struct rxd_peer *peer)
+{
+	peer->cwnd = RXD_INIT_CWND;
+	peer->ssthresh = RXD_MAX_CWND;
+	peer->rto = RXD_INIT_RTO;
+}
+
 /*
- * Exponential back-off starting at 1ms, max 4s.
+ * RTT estimation and RTO calculation follow RFC 6298.  Samples are only
+ * taken from packets that were never retransmitted (Karn's algorithm).
  */
-void rxd_set_timeout(struct rxd_tx_entry *tx_entry)
+static void rxd_peer_rtt_sample(struct rxd_peer *peer, uint64_t rtt)
 {
-	tx_entry->retry_time = fi_gettime_ms() +
-				MIN(1 << tx_entry->retry_cnt, 4000);
+	uint64_t delta;
+
+	rtt = MAX(rtt, 1);
+	if (!peer->srtt) {
+		peer->srtt = rtt;
+		peer->rttvar = rtt / 2;
+	} else {
+		delta = (peer->srtt > rtt) ? peer->srtt - rtt : rtt - peer->srtt;
+		peer->rttvar = (3 * peer->rttvar + delta) / 4;
+		peer->srtt = (7 * peer->srtt + rtt) / 8;
+	}
+	peer->rto = MIN(MAX(peer->srtt + 4 * peer->rttvar, RXD_MIN_RTO),
+			RXD_MAX_RTO);
+}
+
+/*
+ * Additive increase: the window doubles every round trip while below
+ * ssthresh (slow start) and grows by one packet per window afterwards.
+ */
+static void rxd_peer_cwnd_inc(struct rxd_peer *peer, uint32_t acked)
+{
+	if (peer->cwnd < peer->ssthresh) {
+		peer->cwnd += acked;
+	} else {
+		peer->cwnd_cnt += acked;
+		if (peer->cwnd_cnt >= peer->cwnd) {
+			peer->cwnd_cnt -= peer->cwnd;
+			peer->cwnd++;
+		}
+	}
+	peer->cwnd = MIN(peer->cwnd, RXD_MAX_CWND);
+}
+
+/*
+ * Multiplicative decrease on loss.  A timeout restarts from the minimum
+ * window.  Losses reported within one round trip of the last reduction
+ * belong to the same congestion event and are ignored.
+ */
+void rxd_peer_congested(struct rxd_peer *peer, int timeout)
+{
+	uint64_t now;
+
+	now = fi_gettime_us();
+	if (now < peer->recover_time)
+		return;
+
+	peer->ssthresh = MAX(peer->cwnd / 2, RXD_MIN_CWND);
+	peer->cwnd = timeout ? RXD_MIN_CWND : peer->ssthresh;
+	peer->cwnd_cnt = 0;
+	peer->recover_time = now + (peer->srtt ? peer->srtt : peer->rto);
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "congestion %s, cwnd: %d\n",
+	       timeout ? "timeout" : "loss", peer->cwnd);
+}
+
+/*
+ * Exponential back-off starting at the peer's RTO, max 4s.
+ */
+void rxd_set_timeout(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry)
+{
+	struct rxd_peer *peer;
+
+	peer = rxd_ep_getpeer_info(ep, tx_entry->peer);
+	ofi_timer_start(&ep->timer_wheel, &tx_entry->retry_timer,
+		fi_gettime_us() +
+		MIN(peer->rto << MIN(tx_entry->retry_cnt, RXD_MAX_RETRY_SHIFT),
+		    RXD_MAX_RTO));
 }
 
 static void rxd_init_ctrl_hdr(struct ofi_ctrl_hdr *ctrl,
@@ -322,6 +411,7 @@ static struct rxd_pkt_meta *rxd_tx_pkt_alloc(struct rxd_ep *ep)
 
 	if (!pkt_meta) {
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "No free tx pkt\n");
+		ofi_ep_stat_inc(&ep->util_ep, buf_exhausted);
 		return NULL;
 	}
 
@@ -332,6 +422,18 @@ static struct rxd_pkt_meta *rxd_tx_pkt_alloc(struct rxd_ep *ep)
 	return pkt_meta;
 }
 
+/*
+ * Packets on a tx_entry's pkt_list are in flight to the peer until they
+ * are acked, and count against the peer's congestion window.
+ */
+static void rxd_ep_track_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
+			     struct rxd_pkt_meta *pkt)
+{
+	pkt->send_time = fi_gettime_us();
+	dlist_insert_tail(&pkt->entry, &tx_entry->pkt_list);
+	rxd_ep_getpeer_info(ep, tx_entry->peer)->unacked++;
+}
+
 static uint64_t rxd_ep_start_seg_size(struct rxd_ep *ep, uint64_t msg_size)
 {
 	return MIN(rxd_ep_domain(ep)->max_mtu_sz -
@@ -348,11 +450,12 @@ struct rxd_tx_entry *rxd_tx_entry_alloc(struct rxd_ep *ep,
 		return NULL;
 	}
 
-	if (peer->active_tx_cnt == RXD_MAX_PEER_TX)
+	/* Read responses are requested by the peer and are paced by the
+	 * data window, so only locally initiated transfers wait for room
+	 * in the congestion window */
+	if (op != RXD_TX_READ_RSP && peer->unacked >= peer->cwnd)
 		return NULL;
 
-	peer->active_tx_cnt++;
-
 	tx_entry = freestack_pop(ep->tx_entry_fs);
 	tx_entry->peer = addr;
 	tx_entry->flags = flags;
@@ -361,16 +464,16 @@ struct rxd_tx_entry *rxd_tx_entry_alloc(struct rxd_ep *ep,
 	tx_entry->window = 1;
 	tx_entry->retry_cnt = 0;
 	tx_entry->op_type = op;
+	ofi_timer_init(&tx_entry->retry_timer, rxd_tx_entry_timeout);
+	dlist_init(&tx_entry->blocked_entry);
 	dlist_init(&tx_entry->pkt_list);
 	return tx_entry;
 }
 
 void rxd_tx_entry_free(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry)
 {
-	struct rxd_peer *peer;
-
-	peer = rxd_ep_getpeer_info(ep, tx_entry->peer);
-	peer->active_tx_cnt--;
+	ofi_timer_stop(&ep->timer_wheel, &tx_entry->retry_timer);
+	dlist_remove(&tx_entry->blocked_entry);
 	/* reset ID to invalid state to avoid ID collision */
 	tx_entry->msg_id = UINT64_MAX;
 	dlist_remove(&tx_entry->entry);
@@ -426,8 +529,8 @@ static void rxd_ep_init_data_pkt(struct rxd_ep *ep, struct rxd_peer *peer,
 {
 	uint16_t seg_size;
 
-	seg_size = rxd_ep_domain(ep)->max_mtu_sz - sizeof(struct rxd_pkt_data);
-	seg_size = MIN(seg_size, tx_entry->op_hdr.size - tx_entry->bytes_sent);
+	seg_size = MIN(rxd_ep_data_seg_size(ep),
+		       tx_entry->op_hdr.size - tx_entry->bytes_sent);
 
 	rxd_init_ctrl_hdr(&pkt->ctrl, ofi_ctrl_data, seg_size, tx_entry->seg_no,
 			   tx_entry->msg_id, tx_entry->rx_key, peer->conn_data);
@@ -462,20 +565,39 @@ static ssize_t rxd_ep_post_data_msg(struct rxd_ep *ep,
 	if (ret) {
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "send %d failed\n",
 		       pkt->ctrl.seg_no);
+		/* nothing in flight, let the retry path resend it */
+		pkt_meta->flags |= RXD_LOCAL_COMP;
 	}
 
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "msg data %p, seg %d\n",
 		pkt->ctrl.msg_id, pkt->ctrl.seg_no);
-	dlist_insert_tail(&pkt_meta->entry, &tx_entry->pkt_list);
+	rxd_ep_track_pkt(ep, tx_entry, pkt_meta);
 
 	return ret;
 }
 
-void rxd_ep_free_acked_pkts(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
-			    uint32_t last_acked)
+void rxd_ep_release_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
+			struct rxd_pkt_meta *pkt)
+{
+	rxd_ep_getpeer_info(ep, tx_entry->peer)->unacked--;
+	dlist_remove(&pkt->entry);
+	if (pkt->flags & RXD_LOCAL_COMP)
+		rxd_tx_pkt_free(pkt);
+	else
+		pkt->flags |= RXD_REMOTE_ACK;
+}
+
+/*
+ * Returns the send time of the last packet released, if that packet was
+ * never retransmitted, or 0 when no RTT sample can be taken.
+ */
+static uint64_t rxd_ep_free_acked_pkts(struct rxd_ep *ep,
+				       struct rxd_tx_entry *tx_entry,
+				       uint32_t last_acked)
 {
 	struct rxd_pkt_meta *pkt;
 	struct ofi_ctrl_hdr *ctrl;
+	uint64_t send_time = 0;
 
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "freeing all [%p] pkts < %d\n",
 		tx_entry->msg_id, last_acked);
@@ -489,12 +611,10 @@ void rxd_ep_free_acked_pkts(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
 
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "freeing [%p] pkt:%d\n",
 			tx_entry->msg_id, ctrl->seg_no);
-		dlist_remove(&pkt->entry);
-		if (pkt->flags & RXD_LOCAL_COMP)
-			rxd_tx_pkt_free(pkt);
-		else
-			pkt->flags |= RXD_REMOTE_ACK;
+		send_time = (pkt->flags & RXD_PKT_RETRIED) ? 0 : pkt->send_time;
+		rxd_ep_release_pkt(ep, tx_entry, pkt);
 	};
+	return send_time;
 }
 
 static int rxd_ep_retry_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
@@ -504,6 +624,11 @@ static int rxd_ep_retry_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
 	struct ofi_ctrl_hdr *ctrl;
 
 	ctrl = (struct ofi_ctrl_hdr *)pkt->pkt_data;
+
+	/* Keep at most one send of a packet outstanding, so that a late send
+	 * completion cannot release a packet that was already acked */
+	if (!(pkt->flags & RXD_LOCAL_COMP))
+		return -FI_EAGAIN;
 //	if (pkt->retries > RXD_MAX_PKT_RETRY) {
 //		/* todo: report error */
 //		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "Pkt delivery failed\n", ctrl->seg_no);
@@ -526,7 +651,11 @@ static int rxd_ep_retry_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
 //	if (ret != -FI_EAGAIN)
 //		pkt->retries++;
 
-	if (ret && ret != -FI_EAGAIN) {
+	if (!ret) {
+		pkt->flags &= ~RXD_LOCAL_COMP;
+		pkt->flags |= RXD_PKT_RETRIED;
+		ofi_ep_stat_inc(&ep->util_ep, retransmits);
+	} else if (ret != -FI_EAGAIN) {
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "Pkt sent failed seg: %d, ret: %d\n",
 			ctrl->seg_no, ret);
 	}
@@ -534,34 +663,171 @@ static int rxd_ep_retry_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
 	return ret;
 }
 
-//void rxd_resend_pkt(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry )
-//{
-//	struct dlist_entry *pkt_item;
-//	struct rxd_pkt_meta *pkt;
-//	struct ofi_ctrl_hdr *ctrl;
-//
-//	dlist_foreach(&tx_entry->pkt_list, pkt_item) {
-//		pkt = container_of(pkt_item, struct rxd_pkt_meta, entry);
-//		ctrl = (struct ofi_ctrl_hdr *) pkt->pkt_data;
-//
-//		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "resending pkt %d, %p\n",
-//			ctrl->seg_no, ctrl->msg_id);
-//
-//		rxd_ep_retry_pkt(ep, tx_entry, pkt);
-//	}
-//}
+static int rxd_ep_fast_retry_pkt(struct rxd_ep *ep,
+				 struct rxd_tx_entry *tx_entry,
+				 struct rxd_pkt_meta *pkt)
+{
+	if ((pkt->flags & RXD_FAST_RETRY) || rxd_ep_retry_pkt(ep, tx_entry, pkt))
+		return 0;
+
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "fast retransmit [%p] pkt:%d\n",
+	       tx_entry->msg_id, ((struct ofi_ctrl_hdr *) pkt->pkt_data)->seg_no);
+	pkt->flags |= RXD_FAST_RETRY;
+	return 1;
+}
+
+/*
+ * Release packets that the receiver reported in its SACK bitmap and fast
+ * retransmit the holes below the highest selectively acked segment, rather
+ * than waiting for the retry timeout.  Each packet is fast retransmitted at
+ * most once; further losses are recovered by the timeout.  Returns the
+ * number of packets retransmitted.
+ */
+static int rxd_ep_sack_pkts(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
+			    uint32_t seg_no, uint64_t sack)
+{
+	struct dlist_entry *pkt_item, *tmp;
+	struct rxd_pkt_meta *pkt;
+	struct ofi_ctrl_hdr *ctrl;
+	uint32_t last_sacked;
+	int lost = 0;
+
+	if (!sack)
+		return 0;
+
+	last_sacked = seg_no + RXD_SACK_BITS - 1 - __builtin_clzll(sack);
+	dlist_foreach_safe(&tx_entry->pkt_list, pkt_item, tmp) {
+		pkt = container_of(pkt_item, struct rxd_pkt_meta, entry);
+		ctrl = (struct ofi_ctrl_hdr *) pkt->pkt_data;
+		if (ctrl->seg_no < seg_no)
+			continue;
+		if (ctrl->seg_no > last_sacked)
+			break;
+
+		if (sack & (1ULL << (ctrl->seg_no - seg_no))) {
+			FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "sacked [%p] pkt:%d\n",
+			       tx_entry->msg_id, ctrl->seg_no);
+			rxd_ep_release_pkt(ep, tx_entry, pkt);
+		} else {
+			lost += rxd_ep_fast_retry_pkt(ep, tx_entry, pkt);
+		}
+	}
+	return lost;
+}
+
+/*
+ * Process an ack carrying the receiver's next expected segment and its
+ * SACK bitmap.  Clean acks open the peer's congestion window and provide
+ * RTT samples; holes reported by the bitmap close it.
+ */
+void rxd_ep_ack_pkts(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry,
+		     uint32_t seg_no, uint64_t sack)
+{
+	struct rxd_peer *peer;
+	uint64_t send_time;
+	uint32_t unacked;
+
+	peer = rxd_ep_getpeer_info(ep, tx_entry->peer);
+	unacked = peer->unacked;
+
+	send_time = rxd_ep_free_acked_pkts(ep, tx_entry, seg_no);
+	if (send_time)
+		rxd_peer_rtt_sample(peer, fi_gettime_us() - send_time);
+
+	if (rxd_ep_sack_pkts(ep, tx_entry, seg_no, sack))
+		rxd_peer_congested(peer, 0);
+	else if (peer->unacked < unacked)
+		rxd_peer_cwnd_inc(peer, unacked - peer->unacked);
+}
+
+/*
+ * The peer received a start packet out of order, so the start packet of
+ * message msg_seq to that peer was lost.
+ */
+void rxd_ep_retry_lost_start(struct rxd_ep *ep, fi_addr_t peer,
+			     uint64_t msg_seq)
+{
+	struct dlist_entry *tx_item;
+	struct rxd_tx_entry *tx_entry;
+
+	dlist_foreach(&ep->tx_entry_list, tx_item) {
+		tx_entry = container_of(tx_item, struct rxd_tx_entry, entry);
+		if (tx_entry->peer != peer ||
+		    (tx_entry->msg_id >> RXD_MAX_TX_BITS) != msg_seq)
+			continue;
+
+		if (!dlist_empty(&tx_entry->pkt_list) &&
+		    rxd_ep_fast_retry_pkt(ep, tx_entry,
+				container_of(tx_entry->pkt_list.next,
+					     struct rxd_pkt_meta, entry)))
+			rxd_peer_congested(rxd_ep_getpeer_info(ep, peer), 0);
+		break;
+	}
+}
+
+static int rxd_ep_retry_pkts(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry)
+{
+	struct dlist_entry *pkt_item;
+	struct rxd_pkt_meta *pkt;
+	int cnt = 0;
+
+	dlist_foreach(&tx_entry->pkt_list, pkt_item) {
+		pkt = container_of(pkt_item, struct rxd_pkt_meta, entry);
+		if (!rxd_ep_retry_pkt(ep, tx_entry, pkt))
+			cnt++;
+	}
+	return cnt;
+}
+
+/*
+ * Losses reported through acks are fast retransmitted, so unacked packets
+ * are only resent once the retry timer expires.
+ */
+void rxd_tx_entry_timeout(struct ofi_timer_wheel *wheel, struct ofi_timer *timer)
+{
+	struct rxd_ep *ep;
+	struct rxd_tx_entry *tx_entry;
+
+	ep = container_of(wheel, struct rxd_ep, timer_wheel);
+	tx_entry = container_of(timer, struct rxd_tx_entry, retry_timer);
+
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "retry timeout [%p]\n",
+	       tx_entry->msg_id);
+	if (rxd_ep_retry_pkts(ep, tx_entry))
+		rxd_peer_congested(rxd_ep_getpeer_info(ep, tx_entry->peer), 1);
+	if (tx_entry->retry_cnt < RXD_MAX_PKT_RETRY)
+		tx_entry->retry_cnt++;
+	rxd_set_timeout(ep, tx_entry);
+}
 
 void rxd_tx_entry_progress(struct rxd_ep *ep, struct rxd_tx_entry *tx_entry)
 {
+	struct rxd_peer *peer;
+	int sent = 0;
+
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "tx: %p [%p]\n",
 		tx_entry, tx_entry->msg_id);
 
+	peer = rxd_ep_getpeer_info(ep, tx_entry->peer);
 	while ((tx_entry->seg_no < tx_entry->window) &&
-	       (tx_entry->bytes_sent != tx_entry->op_hdr.size)) {
+	       (tx_entry->bytes_sent != tx_entry->op_hdr.size) &&
+	       (peer->unacked < peer->cwnd)) {
 		if (rxd_ep_post_data_msg(ep, tx_entry))
 			break;
+		sent = 1;
 	}
-	rxd_set_timeout(tx_entry);
+	if (sent)
+		rxd_set_timeout(ep, tx_entry);
+
+	/* Data left in the window is sent from the progress loop once the
+	 * congestion window or the packet pool has room again */
+	dlist_remove(&tx_entry->blocked_entry);
+	if ((tx_entry->seg_no < tx_entry->window) &&
+	    (tx_entry->bytes_sent != tx_entry->op_hdr.size))
+		dlist_insert_tail(&tx_entry->blocked_entry,
+				  &ep->tx_blocked_list);
+	else
+		dlist_init(&tx_entry->blocked_entry);
 }
 
 int rxd_ep_reply_ack(struct rxd_ep *ep, struct ofi_ctrl_hdr *in_ctrl,
@@ -570,25 +836,41 @@ int rxd_ep_reply_ack(struct rxd_ep *ep, struct ofi_ctrl_hdr *in_ctrl,
 {
 	ssize_t ret;
 	struct rxd_pkt_meta *pkt_meta;
-	struct rxd_pkt_data *pkt;
+	struct rxd_pkt_ack *pkt;
 	struct rxd_rx_entry *rx_entry;
+	uint32_t seg_no;
+	uint64_t sack;
 
 	pkt_meta = rxd_tx_pkt_alloc(ep);
 	if (!pkt_meta)
 		return -FI_ENOMEM;
 
-	rx_entry = (rx_key != UINT64_MAX) ? &ep->rx_entry_fs->buf[rx_key] : NULL;
+	rx_entry = (type == ofi_ctrl_ack && rx_key != UINT64_MAX) ?
+		   &ep->rx_entry_fs->buf[rx_key] : NULL;
+	if (type != ofi_ctrl_ack) {
+		seg_no = 0;
+		sack = 0;
+	} else if (rx_entry && rx_entry->msg_id == in_ctrl->msg_id) {
+		seg_no = rx_entry->exp_seg_no;
+		sack = rx_entry->sack;
+	} else {
+		/* The message was fully received and its rx_entry has been
+		 * released, so every segment the sender holds is acked. */
+		seg_no = UINT32_MAX;
+		sack = 0;
+	}
 
-	pkt = (struct rxd_pkt_data *)pkt_meta->pkt_data;
-	rxd_init_ctrl_hdr(&pkt->ctrl, type, seg_size,
-			  rx_entry ? rx_entry->exp_seg_no : 0,
+	pkt = (struct rxd_pkt_ack *)pkt_meta->pkt_data;
+	rxd_init_ctrl_hdr(&pkt->ctrl, type, seg_size, seg_no,
 			  in_ctrl->msg_id, rx_key, source);
+	pkt->sack = sack;
 
-	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "sending ack [%p] - segno: %d, window: %d\n",
-		pkt->ctrl.msg_id, pkt->ctrl.seg_no, pkt->ctrl.seg_size);
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "sending ack [%p] - segno: %d, "
+	       "window: %d, sack: 0x%" PRIx64 "\n", pkt->ctrl.msg_id,
+	       pkt->ctrl.seg_no, pkt->ctrl.seg_size, pkt->sack);
 
 	pkt_meta->flags = RXD_NOT_ACKED;
-	ret = fi_send(ep->dg_ep, pkt, sizeof(struct rxd_pkt_data),
+	ret = fi_send(ep->dg_ep, pkt, sizeof(*pkt),
 		      rxd_mr_desc(pkt_meta->mr, ep),
 		      dest, &pkt_meta->context);
 	if (ret)
@@ -696,12 +978,14 @@ ssize_t rxd_ep_start_xfer(struct rxd_ep *ep, struct rxd_peer *peer,
 	if (ret) {
 		FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "send %d failed\n",
 		       pkt->ctrl.seg_no);
+		/* nothing in flight, let the retry path resend it */
+		pkt_meta->flags |= RXD_LOCAL_COMP;
 	}
 
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "start msg %p, size: %ld\n",
 	       pkt->ctrl.msg_id, tx_entry->op_hdr.size);
-	rxd_set_timeout(tx_entry);
-	dlist_insert_tail(&pkt_meta->entry, &tx_entry->pkt_list);
+	rxd_set_timeout(ep, tx_entry);
+	rxd_ep_track_pkt(ep, tx_entry, pkt_meta);
 	dlist_insert_tail(&tx_entry->entry, &ep->tx_entry_list);
 	peer->nxt_msg_id++;
 
@@ -747,8 +1031,8 @@ ssize_t rxd_ep_connect(struct rxd_ep *ep, struct rxd_peer *peer, fi_addr_t addr)
 		goto err;
 
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "sent conn %p\n", pkt->ctrl.msg_id);
-	rxd_set_timeout(tx_entry);
-	dlist_insert_tail(&pkt_meta->entry, &tx_entry->pkt_list);
+	rxd_set_timeout(ep, tx_entry);
+	rxd_ep_track_pkt(ep, tx_entry, pkt_meta);
 	dlist_insert_tail(&tx_entry->entry, &ep->tx_entry_list);
 	peer->nxt_msg_id++;
 	peer->state = CMAP_CONNREQ_SENT;
@@ -781,7 +1065,8 @@ static ssize_t rxd_ep_sendmsg(struct fid_ep *ep, const struct fi_msg *msg,
 			rxd_ep->util_ep.progress(&rxd_ep->util_ep);
 			ret = -FI_EAGAIN;
 		}
-		return ret ? ret : -FI_EAGAIN;
+		return ofi_ep_stat_tx(&rxd_ep->util_ep,
+				      ret ? ret : -FI_EAGAIN);
 	}
 
 	tx_entry = rxd_tx_entry_alloc(rxd_ep, peer, peer_addr, flags,
@@ -800,7 +1085,7 @@ static ssize_t rxd_ep_sendmsg(struct fid_ep *ep, const struct fi_msg *msg,
 
 out:
 	fastlock_release(&rxd_ep->lock);
-	return ret;
+	return ofi_ep_stat_tx(&rxd_ep->util_ep, ret);
 }
 
 static ssize_t rxd_ep_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
@@ -926,6 +1211,7 @@ static void rxd_trx_discard_recv(struct rxd_ep *ep,
 
 	dlist_remove(&rx_entry->unexp_entry);
 	ep->num_unexp_msg--;
+	ofi_ep_stat_unexp_dec(&ep->util_ep);
 
 	pkt_meta = rxd_tx_pkt_alloc(ep);
 	if (!pkt_meta)
@@ -965,6 +1251,7 @@ static ssize_t rxd_trx_peek_recv(struct rxd_ep *ep,
 		err_entry.err = FI_ENOMSG;
 		err_entry.prov_errno = -FI_ENOMSG;
 		rxd_cq_report_error(rxd_ep_rx_cq(ep), &err_entry);
+		ofi_ep_stat_inc(&ep->util_ep, errors);
 		return 0;
 	}
 
@@ -980,11 +1267,12 @@ static ssize_t rxd_trx_peek_recv(struct rxd_ep *ep,
 		context = (struct fi_context *)msg->context;
 		context->internal[0] = rx_entry;
 		dlist_remove(match);
+		ofi_ep_stat_unexp_dec(&ep->util_ep);
 	} else if (flags & FI_DISCARD) {
 		rxd_trx_discard_recv(ep, rx_entry);
 	}
 
-	rxd_ep_rx_cq(ep)->write_fn(rxd_ep_rx_cq(ep), &cq_entry);
+	rxd_ep_write_comp(ep, rxd_ep_rx_cq(ep), &cq_entry);
 	return 0;
 }
 
@@ -1072,8 +1360,9 @@ static ssize_t rxd_ep_trecvmsg(struct fid_ep *ep, const struct fi_msg_tagged *ms
 		rxd_ep_check_unexp_tag_list(rxd_ep, trecv_entry);
 	}
 out:
+	rxd_ep_flush_comp(rxd_ep);
 	fastlock_release(&rxd_ep->lock);
-	return ret;
+	return ofi_ep_stat_rx(&rxd_ep->util_ep, ret);
 }
 
 static ssize_t rxd_ep_trecv(struct fid_ep *ep, void *buf, size_t len, void *desc,
@@ -1140,7 +1429,8 @@ static ssize_t rxd_ep_tsendmsg(struct fid_ep *ep, const struct fi_msg_tagged *ms
 			rxd_ep->util_ep.progress(&rxd_ep->util_ep);
 			ret = -FI_EAGAIN;
 		}
-		return ret ? ret : -FI_EAGAIN;
+		return ofi_ep_stat_tx(&rxd_ep->util_ep,
+				      ret ? ret : -FI_EAGAIN);
 	}
 
 	tx_entry = rxd_tx_entry_alloc(rxd_ep, peer, peer_addr, flags,
@@ -1159,7 +1449,7 @@ static ssize_t rxd_ep_tsendmsg(struct fid_ep *ep, const struct fi_msg_tagged *ms
 
 out:
 	fastlock_release(&rxd_ep->lock);
-	return ret;
+	return ofi_ep_stat_tx(&rxd_ep->util_ep, ret);
 }
 
 static ssize_t rxd_ep_tsend(struct fid_ep *ep, const void *buf, size_t len,
@@ -1373,6 +1663,7 @@ static int rxd_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
 {
 	struct rxd_ep *ep;
 	struct rxd_av *av;
+	size_t i;
 	int ret = 0;
 
 	ep = container_of(ep_fid, struct rxd_ep, util_ep.ep_fid.fid);
@@ -1391,6 +1682,8 @@ static int rxd_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
 		ep->max_peers = av->util_av.count;
 		if (!ep->peer_info)
 			return -FI_ENOMEM;
+		for (i = 0; i < ep->max_peers; i++)
+			rxd_peer_init(&ep->peer_info[i]);
 		break;
 	case FI_CLASS_CQ:
 		ret = rxd_ep_bind_cq(ep, container_of(bfid, struct rxd_cq,
@@ -1466,64 +1759,51 @@ struct fi_ops_cm rxd_ep_cm = {
 
 static void rxd_ep_progress(struct util_ep *util_ep)
 {
-	struct dlist_entry *tx_item, *pkt_item;
+	struct dlist_entry blocked, *item, *tmp;
 	struct rxd_tx_entry *tx_entry;
-	struct fi_cq_msg_entry cq_entry;
-	struct rxd_pkt_meta *pkt;
+	struct fi_cq_msg_entry cq_entry[RXD_PROGRESS_BATCH];
 	struct rxd_ep *ep;
-	uint64_t cur_time;
-	ssize_t ret;
+	size_t count;
+	ssize_t ret, j;
 	int i;
 
 	ep = container_of(util_ep, struct rxd_ep, util_ep);
 
 	fastlock_acquire(&ep->lock);
+
 	for(ret = 1, i = 0;
 	    ret > 0 && (!rxd_progress_spin_count || i < rxd_progress_spin_count);
-	    i++) {
-		ret = fi_cq_read(ep->dg_cq, &cq_entry, 1);
+	    i += ret) {
+		count = rxd_progress_spin_count ?
+			MIN(RXD_PROGRESS_BATCH, rxd_progress_spin_count - i) :
+			RXD_PROGRESS_BATCH;
+		ret = fi_cq_read(ep->dg_cq, cq_entry, count);
 		if (ret == -FI_EAGAIN)
 			break;
 
-		if (cq_entry.flags & FI_SEND)
-			rxd_handle_send_comp(&cq_entry);
-		else if (cq_entry.flags & FI_RECV)
-			rxd_handle_recv_comp(ep, &cq_entry);
-		else
-			assert (0);
+		for (j = 0; j < ret; j++) {
+			if (cq_entry[j].flags & FI_SEND)
+				rxd_handle_send_comp(&cq_entry[j]);
+			else if (cq_entry[j].flags & FI_RECV)
+				rxd_handle_recv_comp(ep, &cq_entry[j]);
+			else
+				assert (0);
+		}
 	}
 
-	cur_time = fi_gettime_us();
-	dlist_foreach(&ep->tx_entry_list, tx_item) {
-		tx_entry = container_of(tx_item, struct rxd_tx_entry, entry);
-
-		if (tx_entry->seg_no < tx_entry->window) {
-			rxd_tx_entry_progress(ep, tx_entry);
-		} else if ((tx_entry->retry_time > cur_time) /* &&
-			 dlist_empty(&tx_entry->pkt_list)*/ ) {
+	rxd_ep_send_pending_acks(ep);
 
-			FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "Progressing waiting entry [%p]\n",
-				tx_entry->msg_id);
+	dlist_init(&blocked);
+	dlist_splice_tail(&blocked, &ep->tx_blocked_list);
+	dlist_foreach_safe(&blocked, item, tmp) {
+		tx_entry = container_of(item, struct rxd_tx_entry,
+					blocked_entry);
+		rxd_tx_entry_progress(ep, tx_entry);
+	}
 
-			rxd_tx_entry_progress(ep, tx_entry);
-//			rxd_set_timeout(tx_entry);
-		}
+	ofi_timer_wheel_run(&ep->timer_wheel, fi_gettime_us());
 
-		dlist_foreach(&tx_entry->pkt_list, pkt_item) {
-			pkt = container_of(pkt_item, struct rxd_pkt_meta, entry);
-//			/* TODO: This if check is repeated.  Create a function
-//			 * to perform this check, and figure out what the check
-//			 * is actually doing with the bit-shift, multiply operation.
-//			 */
-//			if (curr_stamp > pkt->us_stamp &&
-//			    curr_stamp - pkt->us_stamp >
-//			    (((uint64_t) 1) << ((uint64_t) pkt->retries + 1)) *
-//			     RXD_RETRY_TIMEOUT) {
-//				pkt->us_stamp = curr_stamp;
-				rxd_ep_retry_pkt(ep, tx_entry, pkt);
-//			}
-		}
-	}
+	rxd_ep_flush_comp(ep);
 	fastlock_release(&ep->lock);
 }
 
@@ -1547,21 +1827,28 @@ static void rxd_buf_region_free_hndlr(void *pool_ctx, void *context)
 
 int rxd_ep_create_buf_pools(struct rxd_ep *ep, struct fi_info *fi_info)
 {
-	ep->tx_pkt_pool = util_buf_pool_create_ex(
-		rxd_ep_domain(ep)->max_mtu_sz + sizeof(struct rxd_pkt_meta),
-		RXD_BUF_POOL_ALIGNMENT, 0, RXD_TX_POOL_CHUNK_CNT,
-	        (fi_info->mode & FI_LOCAL_MR) ? rxd_buf_region_alloc_hndlr : NULL,
-		(fi_info->mode & FI_LOCAL_MR) ? rxd_buf_region_free_hndlr : NULL,
-		rxd_ep_domain(ep));
+	struct util_buf_attr attr = {
+		.size		= rxd_ep_domain(ep)->max_mtu_sz +
+				  sizeof(struct rxd_pkt_meta),
+		.alignment	= RXD_BUF_POOL_ALIGNMENT,
+		.chunk_cnt	= RXD_TX_POOL_CHUNK_CNT,
+		.alloc_hndlr	= (fi_info->mode & FI_LOCAL_MR) ?
+				  rxd_buf_region_alloc_hndlr : NULL,
+		.free_hndlr	= (fi_info->mode & FI_LOCAL_MR) ?
+				  rxd_buf_region_free_hndlr : NULL,
+		.ctx		= rxd_ep_domain(ep),
+		.flags		= (rxd_use_hugepages ? UTIL_BUF_POOL_HUGEPAGE : 0) |
+				  (rxd_numa_node >= 0 ? UTIL_BUF_POOL_NUMA_BIND : 0),
+		.numa_node	= rxd_numa_node,
+	};
+
+	ep->tx_pkt_pool = util_buf_pool_create_attr(&attr);
 	if (!ep->tx_pkt_pool)
 		return -FI_ENOMEM;
 
-	ep->rx_pkt_pool = util_buf_pool_create_ex(
-		rxd_ep_domain(ep)->max_mtu_sz + sizeof (struct rxd_rx_buf),
-		RXD_BUF_POOL_ALIGNMENT, 0, RXD_RX_POOL_CHUNK_CNT,
-	        (fi_info->mode & FI_LOCAL_MR) ? rxd_buf_region_alloc_hndlr : NULL,
-		(fi_info->mode & FI_LOCAL_MR) ? rxd_buf_region_free_hndlr : NULL,
-		rxd_ep_domain(ep));
+	attr.size = rxd_ep_domain(ep)->max_mtu_sz + sizeof(struct rxd_rx_buf);
+	attr.chunk_cnt = RXD_RX_POOL_CHUNK_CNT;
+	ep->rx_pkt_pool = util_buf_pool_create_attr(&attr);
 	if (!ep->rx_pkt_pool)
 		goto err;
 
@@ -1670,11 +1957,14 @@ int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 	rxd_ep->util_ep.ep_fid.rma = &rxd_ops_rma;
 
 	dlist_init(&rxd_ep->tx_entry_list);
+	dlist_init(&rxd_ep->tx_blocked_list);
 	dlist_init(&rxd_ep->rx_entry_list);
 	dlist_init(&rxd_ep->wait_rx_list);
+	dlist_init(&rxd_ep->ack_list);
 	dlist_init(&rxd_ep->unexp_msg_list);
 	dlist_init(&rxd_ep->unexp_tag_list);
 	slist_init(&rxd_ep->rx_pkt_list);
+	ofi_timer_wheel_init(&rxd_ep->timer_wheel, fi_gettime_us());
 	fastlock_init(&rxd_ep->lock);
 
 	*ep = &rxd_ep->util_ep.ep_fid;
@@ -40,7 +40,7 @@ static struct fi_ops_fabric rxd_fabric_ops = {
 	.domain = &rxd_domain_open,
 	.passive_ep = fi_no_passive_ep,
 	.eq_open = ofi_eq_create,
-	.wait_open = ofi_wait_fd_open,
+	.wait_open = ofi_wait_fd_open_lazy,
 	.trywait = ofi_trywait
 };
 
@@ -113,6 +113,8 @@ int rxd_fabric(struct fi_fabric_attr *attr, struct fid_fabric **fabric,
 	fi_freeinfo(dg_info);
 
 	fi_param_get_int(&rxd_prov, "spin_count", &rxd_progress_spin_count);
+	fi_param_get_bool(&rxd_prov, "use_hugepages", &rxd_use_hugepages);
+	fi_param_get_int(&rxd_prov, "numa_node", &rxd_numa_node);
 
 	return 0;
 err4:
@@ -83,6 +83,12 @@ RXD_INI
 {
 	fi_param_define(&rxd_prov, "spin_count", FI_PARAM_INT,
 			"Number of iterations to receive packets (0 - infinite)");
+	fi_param_define(&rxd_prov, "use_hugepages", FI_PARAM_BOOL,
+			"Back packet buffers with huge pages when available "
+			"(default: no)");
+	fi_param_define(&rxd_prov, "numa_node", FI_PARAM_INT,
+			"NUMA node to allocate packet buffers on (default: "
+			"not bound)");
 
 	return &rxd_prov;
 }
@@ -57,7 +57,8 @@ ssize_t	rxd_ep_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 			rxd_ep->util_ep.progress(&rxd_ep->util_ep);
 			ret = -FI_EAGAIN;
 		}
-		return ret ? ret : -FI_EAGAIN;
+		return ofi_ep_stat_tx(&rxd_ep->util_ep,
+				      ret ? ret : -FI_EAGAIN);
 	}
 
 	tx_entry = rxd_tx_entry_alloc(rxd_ep, peer, peer_addr, flags,
@@ -78,7 +79,7 @@ ssize_t	rxd_ep_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 
 out:
 	fastlock_release(&rxd_ep->lock);
-	return ret;
+	return ofi_ep_stat_tx(&rxd_ep->util_ep, ret);
 }
 
 static ssize_t rxd_ep_read(struct fid_ep *ep, void *buf, size_t len,
@@ -159,7 +160,8 @@ ssize_t	rxd_ep_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 			rxd_ep->util_ep.progress(&rxd_ep->util_ep);
 			ret = -FI_EAGAIN;
 		}
-		return ret ? ret : -FI_EAGAIN;
+		return ofi_ep_stat_tx(&rxd_ep->util_ep,
+				      ret ? ret : -FI_EAGAIN);
 	}
 
 	tx_entry = rxd_tx_entry_alloc(rxd_ep, peer, peer_addr, flags,
@@ -180,7 +182,7 @@ ssize_t	rxd_ep_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 
 out:
 	fastlock_release(&rxd_ep->lock);
-	return ret;
+	return ofi_ep_stat_tx(&rxd_ep->util_ep, ret);
 }
 
 static ssize_t rxd_ep_write(struct fid_ep *ep, const void *buf,
@@ -61,6 +61,13 @@
 
 #define RXM_BUF_SIZE 16384
 #define RXM_IOV_LIMIT 4
+#define RXM_CQ_READ_BATCH 16
+#define RXM_MR_CACHE_MAX_SIZE (1UL << 30)
+#define RXM_LMT_CHUNK_SIZE (1UL << 20)
+#define RXM_LMT_READS 4
+#define RXM_LMT_MAX_READS 8
+#define RXM_SAR_LIMIT (1UL << 18)
+#define RXM_SAR_MAX_SEGS 64
 
 #define RXM_MR_VIRT_ADDR(info) ((info->domain_attr->mr_mode == FI_MR_BASIC) ||\
 				info->domain_attr->mr_mode & FI_MR_VIRT_ADDR)
@@ -101,6 +108,15 @@ do {									\
 extern struct fi_provider rxm_prov;
 extern struct util_prov rxm_util_prov;
 extern struct fi_ops_rma rxm_ops_rma;
+extern size_t rxm_mr_cache_max_cnt;
+extern size_t rxm_mr_cache_max_size;
+extern size_t rxm_lmt_chunk_size;
+extern size_t rxm_lmt_max_reads;
+extern size_t rxm_buffer_size;
+extern size_t rxm_sar_limit;
+extern size_t rxm_eager_connect;
+extern int rxm_use_hugepages;
+extern int rxm_numa_node;
 
 struct rxm_fabric {
 	struct util_fabric util_fabric;
@@ -110,12 +126,24 @@ struct rxm_fabric {
 struct rxm_conn {
 	struct fid_ep *msg_ep;
 	struct util_cmap_handle handle;
+	/* Sends issued before the connection was established. They are
+	 * posted from the progress and send paths once it is, and later
+	 * sends are queued behind them until the queue drains. The queue
+	 * and deferred_entry are protected by rxm_ep->deferred_lock.
+	 * tx_deferred is set while the connection is on deferred_conn_list
+	 * and may be read without the lock. */
+	struct dlist_entry deferred_tx_queue;
+	struct dlist_entry deferred_entry;
+	ofi_atomic32_t tx_deferred;
 };
 
 struct rxm_domain {
 	struct util_domain util_domain;
 	struct fid_domain *msg_domain;
+	/* Registrations made internally for large message transfers */
+	struct ofi_mr_cache mr_cache;
 	uint8_t mr_local;
+	uint8_t mr_cache_enabled;
 };
 
 struct rxm_mr {
@@ -162,7 +190,8 @@ struct rxm_rma_iov {
 	FUNC(RXM_LMT_READ),	\
 	FUNC(RXM_LMT_ACK_SENT), \
 	FUNC(RXM_LMT_ACK_RECVD),\
-	FUNC(RXM_LMT_FINISH),
+	FUNC(RXM_LMT_FINISH),	\
+	FUNC(RXM_SAR_TX),
 
 enum rxm_proto_state {
 	RXM_PROTO_STATES(OFI_ENUM_VAL)
@@ -183,7 +212,10 @@ struct rxm_recv_match_attr {
 };
 
 struct rxm_unexp_msg {
+	/* Arrival order across all sources and tags */
 	struct dlist_entry entry;
+	/* Chained in recv_queue->unexp_hash by (addr, tag) */
+	struct dlist_entry hash_entry;
 	fi_addr_t addr;
 	uint64_t tag;
 };
@@ -206,6 +238,18 @@ struct rxm_buf {
 	struct fid_ep *msg_ep;
 };
 
+/* One chunk read of a large message transfer */
+struct rxm_lmt_read {
+	/* Must stay at top */
+	struct fi_context fi_context;
+
+	enum rxm_proto_state state;
+
+	struct rxm_rx_buf *rx_buf;
+	struct rxm_iov iov;
+	struct fid_mr *mr[RXM_IOV_LIMIT];
+};
+
 struct rxm_rx_buf {
 	/* Must stay at top */
 	struct rxm_buf hdr;
@@ -216,20 +260,58 @@ struct rxm_rx_buf {
 	struct rxm_recv_entry *recv_entry;
 	struct rxm_unexp_msg unexp_msg;
 	uint64_t comp_flags;
-
-	/* Used for large messages */
-	struct rxm_iov match_iov[RXM_IOV_LIMIT];
+	/* Payload bytes received in this buffer */
+	size_t data_len;
+
+	/* Used for segmented (SAR) messages. The first segment is kept on
+	 * rxm_ep->sar_list once matched, until all segments have arrived.
+	 * Later segments that arrive before then are copied to sar_seg_list
+	 * and their buffers reposted. */
+	struct dlist_entry sar_entry;
+	uint64_t sar_recvd;
+
+	/* Used for large messages. The message is read in chunks of at most
+	 * rxm_lmt_chunk_size, with up to rxm_lmt_max_reads reads in flight.
+	 * rma_index/rma_offset track the next remote byte to read and
+	 * iov_index/iov_offset the matching position in the receive iov.
+	 * The read contexts come from lmt_read_pool while the message is
+	 * being read, so reposting the buffer does not clear them.  A failed
+	 * read is held in lmt_err until the reads in flight complete, and is
+	 * returned to the sender in the ack.  A message that can't post a
+	 * read or its ack is queued on lmt_retry_list. */
 	struct rxm_rma_iov *rma_iov;
-	size_t index;
-	struct fid_mr *mr[RXM_IOV_LIMIT];
+	size_t rma_index;
+	uint64_t rma_offset;
+	size_t iov_index;
+	size_t iov_offset;
+	size_t lmt_reads;
+	int lmt_err;
+	struct rxm_lmt_read *lmt_read;
+	struct dlist_entry lmt_retry_entry;
 
 	struct rxm_pkt pkt;
 };
 
+/* SAR segment received before the first segment of its message was
+ * matched */
+struct rxm_sar_seg {
+	struct dlist_entry entry;
+	uint64_t conn_id;
+	uint64_t msg_id;
+	uint32_t seg_no;
+	size_t len;
+	uint8_t data[];
+};
+
 struct rxm_tx_buf {
 	/* Must stay at top */
 	struct rxm_buf hdr;
 
+	/* Owner of a SAR segment, and its place on rxm_ep->sar_tx_list
+	 * while it waits to be posted */
+	struct rxm_tx_entry *tx_entry;
+	struct dlist_entry sar_entry;
+
 	struct rxm_pkt pkt;
 };
 
@@ -249,6 +331,14 @@ struct rxm_tx_entry {
 	/* Used for large messages */
 	struct fid_mr *mr[RXM_IOV_LIMIT];
 	struct rxm_rx_buf *rx_buf;
+
+	/* SAR segments not yet completed, and the first error posting one */
+	ofi_atomic32_t sar_segs;
+	int sar_err;
+
+	/* Used for sends queued on a connection being established */
+	struct dlist_entry deferred_entry;
+	size_t pkt_size;
 };
 DECLARE_FREESTACK(struct rxm_tx_entry, rxm_txe_fs);
 
@@ -263,6 +353,8 @@ struct rxm_recv_entry {
 	uint64_t tag;
 	uint64_t ignore;
 	uint64_t comp_flags;
+	/* Post order, used to pick the oldest match across hash and list */
+	uint64_t seq;
 };
 DECLARE_FREESTACK(struct rxm_recv_entry, rxm_recv_fs);
 
@@ -277,20 +369,41 @@ enum rxm_recv_queue_type {
 	RXM_RECV_QUEUE_TAGGED,
 };
 
+/*
+ * Posted receives with no ignore bits are hashed by (addr, tag) in
+ * recv_hash. Receives with ignore bits set are kept in post order on
+ * recv_list. An incoming message is matched against its hash bucket(s)
+ * and recv_list, and the receive with the lowest seq wins, so matching
+ * order is the same as for a single ordered list.
+ *
+ * Unexpected messages are kept in arrival order on unexp_msg_list and
+ * are also hashed by (addr, tag) in unexp_hash.
+ */
 struct rxm_recv_queue {
 	enum rxm_recv_queue_type type;
 	struct rxm_recv_fs *fs;
+	struct dlist_entry *recv_hash;
 	struct dlist_entry recv_list;
+	struct dlist_entry *unexp_hash;
 	struct dlist_entry unexp_msg_list;
+	size_t hash_mask;
+	uint64_t seq;
+	/* Incoming messages carry the source fi_addr (FI_SOURCE or
+	 * FI_DIRECTED_RECV) instead of FI_ADDR_UNSPEC */
+	int msg_src;
 	dlist_func_t *match_recv;
 	dlist_func_t *match_unexp;
 	fastlock_t lock;
 };
 
 struct rxm_buf_pool {
-	struct util_buf_pool *pool;
+	struct util_buf_ts_pool *pool;
+	/* Outstanding buffers, released when the pool is destroyed */
 	struct dlist_entry buf_list;
 	uint8_t local_mr;
+	uint8_t track;
+	/* Outstanding buffers are expected at destroy and released quietly */
+	uint8_t release_all;
 	fastlock_t lock;
 };
 
@@ -307,10 +420,57 @@ struct rxm_ep {
 
 	struct rxm_buf_pool 	tx_pool;
 	struct rxm_buf_pool 	rx_pool;
+	struct util_buf_ts_pool	*lmt_read_pool;
+	struct dlist_entry	lmt_retry_list;
+	fastlock_t		lmt_retry_lock;
+	ofi_atomic32_t		lmt_retry_cnt;
 
 	struct rxm_send_queue 	send_queue;
 	struct rxm_recv_queue 	recv_queue;
 	struct rxm_recv_queue 	trecv_queue;
+
+	struct dlist_entry	sar_list;
+	struct dlist_entry	sar_seg_list;
+	struct util_buf_pool	*sar_seg_pool;
+	/* Segments of sends in progress that the MSG EP had no room for.
+	 * Segments of a closed connection have their msg_ep cleared. */
+	struct dlist_entry	sar_tx_list;
+	ofi_atomic32_t		sar_tx_cnt;
+	fastlock_t		sar_lock;
+
+	/* Connections with queued sends, and sends queued on connections
+	 * that have since been freed, which are completed in error.
+	 * deferred_tx_cnt counts all queued sends. */
+	struct dlist_entry	deferred_conn_list;
+	struct dlist_entry	deferred_fail_list;
+	fastlock_t		deferred_lock;
+	ofi_atomic32_t		deferred_tx_cnt;
+
+	/* Completions the util CQs had no room for, written from progress
+	 * before anything else is read from the msg CQ */
+	struct slist		comp_overflow;
+	fastlock_t		comp_overflow_lock;
+	ofi_atomic32_t		comp_overflow_cnt;
+};
+
+struct rxm_cq_overflow {
+	struct slist_entry entry;
+	struct util_cq *cq;
+	size_t count;
+	struct fi_cq_tagged_entry comp[];
+};
+
+struct rxm_cq_comp {
+	struct util_cq *cq;
+	size_t count;
+	struct fi_cq_tagged_entry comp[RXM_CQ_READ_BATCH];
+};
+
+/* Completions staged by one rxm_cq_progress() pass */
+struct rxm_cq_batch {
+	struct rxm_ep *ep;
+	struct rxm_cq_comp tx;
+	struct rxm_cq_comp rx;
 };
 
 extern struct fi_provider rxm_prov;
@@ -355,7 +515,7 @@ int rxm_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 int rxm_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 			 struct fid_cq **cq_fid, void *context);
 void rxm_cq_progress(struct rxm_ep *rxm_ep);
-int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf);
+int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf, struct rxm_cq_batch *batch);
 
 int rxm_endpoint(struct fid_domain *domain, struct fi_info *info,
 			  struct fid_ep **ep, void *context);
@@ -368,6 +528,13 @@ int rxm_conn_process_connreq(struct rxm_ep *rxm_ep, struct fi_info *msg_info,
 struct util_cmap_handle *rxm_conn_alloc(void);
 void rxm_conn_close(struct util_cmap_handle *handle);
 void rxm_conn_free(struct util_cmap_handle *handle);
+int rxm_conn_defer_tx(struct rxm_conn *rxm_conn,
+		      struct rxm_tx_entry *tx_entry);
+void rxm_ep_progress_deferred_tx(struct rxm_ep *rxm_ep);
+void rxm_ep_fail_deferred_tx(struct rxm_ep *rxm_ep);
+void rxm_ep_progress_sar_tx(struct rxm_ep *rxm_ep);
+void rxm_ep_abort_sar_tx(struct rxm_ep *rxm_ep, struct fid_ep *msg_ep);
+void rxm_sar_tx_drop(struct rxm_tx_entry *tx_entry, size_t cnt, int err);
 int rxm_conn_signal(struct util_ep *util_ep, void *context,
 		    enum ofi_cmap_signal signal);
 
@@ -380,6 +547,10 @@ void rxm_pkt_init(struct rxm_pkt *pkt);
 int rxm_ep_msg_mr_regv(struct rxm_ep *rxm_ep, const struct iovec *iov,
 		       size_t count, uint64_t access, struct fid_mr **mr);
 void rxm_ep_msg_mr_closev(struct fid_mr **mr, size_t count);
+int rxm_ep_msg_mr_cache_regv(struct rxm_ep *rxm_ep, const struct iovec *iov,
+			     size_t count, uint64_t access, struct fid_mr **mr);
+void rxm_ep_msg_mr_cache_closev(struct rxm_ep *rxm_ep, struct fid_mr **mr,
+				size_t count);
 struct rxm_buf *rxm_buf_get(struct rxm_buf_pool *pool);
 void rxm_buf_release(struct rxm_buf_pool *pool, struct rxm_buf *buf);
 
@@ -388,3 +559,25 @@ struct rxm_recv_entry *rxm_recv_entry_get(struct rxm_recv_queue *queue);
 
 void rxm_tx_entry_release(struct rxm_send_queue *queue, struct rxm_tx_entry *entry);
 void rxm_recv_entry_release(struct rxm_recv_queue *queue, struct rxm_recv_entry *entry);
+
+int rxm_recv_match_init(struct rxm_recv_queue *recv_queue, size_t size);
+void rxm_recv_match_close(struct rxm_recv_queue *recv_queue);
+/* The following require recv_queue->lock to be held */
+void rxm_recv_entry_insert(struct rxm_recv_queue *recv_queue,
+			   struct rxm_recv_entry *recv_entry);
+struct rxm_recv_entry *
+rxm_recv_entry_match(struct rxm_recv_queue *recv_queue,
+		     struct rxm_recv_match_attr *attr);
+struct rxm_recv_entry *
+rxm_recv_entry_remove_context(struct rxm_recv_queue *recv_queue, void *context);
+void rxm_unexp_msg_insert(struct rxm_recv_queue *recv_queue,
+			  struct rxm_unexp_msg *unexp_msg);
+struct rxm_unexp_msg *
+rxm_unexp_msg_match(struct rxm_recv_queue *recv_queue,
+		    struct rxm_recv_match_attr *attr);
+
+static inline void rxm_unexp_msg_remove(struct rxm_unexp_msg *unexp_msg)
+{
+	dlist_remove(&unexp_msg->entry);
+	dlist_remove(&unexp_msg->hash_entry);
+}
@@ -108,16 +108,179 @@ void rxm_conn_close(struct util_cmap_handle *handle)
 	rxm_conn->msg_ep = NULL;
 }
 
+static void rxm_conn_fail_tx(struct rxm_tx_entry *tx_entry, int err)
+{
+	struct rxm_ep *rxm_ep = tx_entry->ep;
+	struct fi_cq_err_entry err_entry = {0};
+
+	FI_WARN(&rxm_prov, FI_LOG_EP_DATA,
+		"Unable to post deferred send: %s\n", fi_strerror(err));
+
+	if (tx_entry->state == RXM_LMT_TX &&
+	    !OFI_CHECK_MR_LOCAL(rxm_ep->rxm_info))
+		rxm_ep_msg_mr_cache_closev(rxm_ep, tx_entry->mr,
+					   tx_entry->count);
+
+	err_entry.op_context = tx_entry->context;
+	err_entry.flags = tx_entry->comp_flags;
+	err_entry.err = err;
+	err_entry.prov_errno = -err;
+	if (ofi_cq_write_error(rxm_ep->util_ep.tx_cq, &err_entry))
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to report error\n");
+	ofi_ep_stat_inc(&rxm_ep->util_ep, errors);
+
+	rxm_buf_release(&rxm_ep->tx_pool, (struct rxm_buf *)tx_entry->tx_buf);
+	rxm_tx_entry_release(&rxm_ep->send_queue, tx_entry);
+}
+
+/* Wake up a thread blocked on the tx CQ so that it posts queued sends */
+static void rxm_conn_wakeup_tx(struct rxm_ep *rxm_ep)
+{
+	if (rxm_ep->util_ep.tx_cq)
+		ofi_cq_wakeup(rxm_ep->util_ep.tx_cq);
+}
+
+/*
+ * Called from the conn event handler. Sends and SAR segments still queued
+ * on the connection are completed in error by the application thread, from
+ * progress.
+ */
 void rxm_conn_free(struct util_cmap_handle *handle)
 {
+	struct rxm_conn *rxm_conn = container_of(handle, struct rxm_conn, handle);
+	struct rxm_ep *rxm_ep = container_of(handle->cmap->ep, struct rxm_ep,
+					     util_ep);
+
+	rxm_ep_abort_sar_tx(rxm_ep, rxm_conn->msg_ep);
 	rxm_conn_close(handle);
-	free(container_of(handle, struct rxm_conn, handle));
+
+	fastlock_acquire(&rxm_ep->deferred_lock);
+	if (ofi_atomic_get32(&rxm_conn->tx_deferred)) {
+		dlist_splice_tail(&rxm_ep->deferred_fail_list,
+				  &rxm_conn->deferred_tx_queue);
+		dlist_remove(&rxm_conn->deferred_entry);
+		rxm_conn_wakeup_tx(rxm_ep);
+	}
+	fastlock_release(&rxm_ep->deferred_lock);
+	free(rxm_conn);
 }
 
 struct util_cmap_handle *rxm_conn_alloc(void)
 {
 	struct rxm_conn *rxm_conn = calloc(1, sizeof(*rxm_conn));
-	return rxm_conn ? &rxm_conn->handle : NULL;
+	if (!rxm_conn)
+		return NULL;
+	dlist_init(&rxm_conn->deferred_tx_queue);
+	ofi_atomic_initialize32(&rxm_conn->tx_deferred, 0);
+	return &rxm_conn->handle;
+}
+
+/*
+ * Queue a send on a connection that is being established. Returns
+ * -FI_EALREADY if the connection is usable and has nothing queued, in
+ * which case the caller posts the send itself.
+ */
+int rxm_conn_defer_tx(struct rxm_conn *rxm_conn,
+		      struct rxm_tx_entry *tx_entry)
+{
+	struct util_cmap *cmap = rxm_conn->handle.cmap;
+	struct rxm_ep *rxm_ep = tx_entry->ep;
+	int ret = 0;
+
+	fastlock_acquire(&cmap->lock);
+	fastlock_acquire(&rxm_ep->deferred_lock);
+	if (rxm_conn->handle.state == CMAP_SHUTDOWN) {
+		ret = -FI_EAGAIN;
+	} else if (rxm_conn->handle.state == CMAP_CONNECTED &&
+		   !ofi_atomic_get32(&rxm_conn->tx_deferred)) {
+		ret = -FI_EALREADY;
+	} else {
+		if (!ofi_atomic_get32(&rxm_conn->tx_deferred)) {
+			dlist_insert_tail(&rxm_conn->deferred_entry,
+					  &rxm_ep->deferred_conn_list);
+			ofi_atomic_set32(&rxm_conn->tx_deferred, 1);
+		}
+		dlist_insert_tail(&tx_entry->deferred_entry,
+				  &rxm_conn->deferred_tx_queue);
+		ofi_atomic_inc32(&rxm_ep->deferred_tx_cnt);
+	}
+	fastlock_release(&rxm_ep->deferred_lock);
+	fastlock_release(&cmap->lock);
+	return ret;
+}
+
+/* Caller must hold rxm_ep->deferred_lock */
+static void rxm_ep_fail_deferred_list(struct rxm_ep *rxm_ep)
+{
+	struct rxm_tx_entry *tx_entry;
+
+	while (!dlist_empty(&rxm_ep->deferred_fail_list)) {
+		dlist_pop_front(&rxm_ep->deferred_fail_list,
+				struct rxm_tx_entry, tx_entry, deferred_entry);
+		ofi_atomic_dec32(&rxm_ep->deferred_tx_cnt);
+		rxm_conn_fail_tx(tx_entry, FI_ECONNABORTED);
+	}
+}
+
+/*
+ * Post the sends queued on connections that have been established. The
+ * queue of a connection is drained before tx_deferred is cleared, so sends
+ * issued meanwhile are queued behind the ones being posted and keep their
+ * order. Sends that the MSG EP cannot take yet are left queued for the
+ * next call.
+ */
+void rxm_ep_progress_deferred_tx(struct rxm_ep *rxm_ep)
+{
+	struct util_cmap *cmap = rxm_ep->util_ep.cmap;
+	struct rxm_conn *rxm_conn;
+	struct rxm_tx_entry *tx_entry;
+	struct rxm_tx_buf *tx_buf;
+	struct dlist_entry *tmp;
+	ssize_t ret;
+
+	fastlock_acquire(&cmap->lock);
+	fastlock_acquire(&rxm_ep->deferred_lock);
+	rxm_ep_fail_deferred_list(rxm_ep);
+
+	dlist_foreach_container_safe(&rxm_ep->deferred_conn_list, rxm_conn,
+				     deferred_entry, tmp) {
+		if (rxm_conn->handle.state != CMAP_CONNECTED)
+			continue;
+
+		while (!dlist_empty(&rxm_conn->deferred_tx_queue)) {
+			tx_entry = container_of(rxm_conn->deferred_tx_queue.next,
+						struct rxm_tx_entry,
+						deferred_entry);
+			tx_buf = tx_entry->tx_buf;
+			tx_buf->hdr.msg_ep = rxm_conn->msg_ep;
+			tx_buf->pkt.ctrl_hdr.conn_id =
+				rxm_conn->handle.remote_key;
+
+			ret = fi_send(rxm_conn->msg_ep, &tx_buf->pkt,
+				      tx_entry->pkt_size, tx_buf->hdr.desc, 0,
+				      tx_entry);
+			if (ret == -FI_EAGAIN)
+				goto unlock;
+
+			dlist_remove(&tx_entry->deferred_entry);
+			ofi_atomic_dec32(&rxm_ep->deferred_tx_cnt);
+			if (ret)
+				rxm_conn_fail_tx(tx_entry, (int)-ret);
+		}
+		dlist_remove(&rxm_conn->deferred_entry);
+		ofi_atomic_set32(&rxm_conn->tx_deferred, 0);
+	}
+unlock:
+	fastlock_release(&rxm_ep->deferred_lock);
+	fastlock_release(&cmap->lock);
+}
+
+/* Called on EP close, once the conn event handler has exited */
+void rxm_ep_fail_deferred_tx(struct rxm_ep *rxm_ep)
+{
+	fastlock_acquire(&rxm_ep->deferred_lock);
+	rxm_ep_fail_deferred_list(rxm_ep);
+	fastlock_release(&rxm_ep->deferred_lock);
 }
 
 int rxm_msg_process_connreq(struct rxm_ep *rxm_ep, struct fi_info *msg_info,
@@ -201,6 +364,7 @@ void *rxm_conn_event_handler(void *arg)
 	size_t len = sizeof(*entry) + datalen;
 	struct rxm_ep *rxm_ep = container_of(arg, struct rxm_ep, util_ep);
 	struct rxm_cm_data *cm_data;
+	struct rxm_conn *rxm_conn;
 	uint32_t event;
 	ssize_t rd;
 
@@ -243,6 +407,10 @@ void *rxm_conn_event_handler(void *arg)
 						 entry->fid->context,
 						 (rd - sizeof(*entry)) ?
 						 &cm_data->conn_id : NULL);
+			rxm_conn = container_of(entry->fid->context,
+						struct rxm_conn, handle);
+			if (ofi_atomic_get32(&rxm_conn->tx_deferred))
+				rxm_conn_wakeup_tx(rxm_ep);
 			break;
 		case FI_SHUTDOWN:
 			FI_DBG(&rxm_prov, FI_LOG_FABRIC,
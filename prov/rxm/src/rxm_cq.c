@@ -103,13 +103,141 @@ static void rxm_cq_log_comp(uint64_t flags)
 }
 #endif
 
-int rxm_finish_recv(struct rxm_rx_buf *rx_buf)
+static int rxm_cq_batch_flush_cq(struct rxm_cq_comp *cq_comp)
+{
+	ssize_t ret;
+
+	if (!cq_comp->count)
+		return 0;
+
+	ret = ofi_cq_write_batch(cq_comp->cq, cq_comp->comp, cq_comp->count);
+	if (ret < 0)
+		return (int) ret;
+
+	cq_comp->count -= ret;
+	memmove(cq_comp->comp, &cq_comp->comp[ret],
+		cq_comp->count * sizeof(*cq_comp->comp));
+	return cq_comp->count ? -FI_EAGAIN : 0;
+}
+
+/* Park completions the util CQ had no room for on the ep.  They are
+ * written by rxm_cq_overflow_flush() ahead of any new msg CQ entries. */
+static void rxm_cq_overflow_add(struct rxm_ep *rxm_ep,
+				struct rxm_cq_comp *cq_comp)
+{
+	struct rxm_cq_overflow *overflow;
+
+	if (!cq_comp->count)
+		return;
+
+	overflow = malloc(sizeof(*overflow) +
+			  cq_comp->count * sizeof(*overflow->comp));
+	if (!overflow) {
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to queue %zu "
+			"completions, CQ overrun\n", cq_comp->count);
+		cq_comp->count = 0;
+		return;
+	}
+
+	overflow->cq = cq_comp->cq;
+	overflow->count = cq_comp->count;
+	memcpy(overflow->comp, cq_comp->comp,
+	       cq_comp->count * sizeof(*cq_comp->comp));
+	cq_comp->count = 0;
+
+	fastlock_acquire(&rxm_ep->comp_overflow_lock);
+	slist_insert_tail(&overflow->entry, &rxm_ep->comp_overflow);
+	ofi_atomic_inc32(&rxm_ep->comp_overflow_cnt);
+	fastlock_release(&rxm_ep->comp_overflow_lock);
+}
+
+static int rxm_cq_overflow_flush(struct rxm_ep *rxm_ep)
+{
+	struct rxm_cq_overflow *overflow;
+	ssize_t ret = 0;
+
+	fastlock_acquire(&rxm_ep->comp_overflow_lock);
+	while (!slist_empty(&rxm_ep->comp_overflow)) {
+		overflow = container_of(rxm_ep->comp_overflow.head,
+					struct rxm_cq_overflow, entry);
+		ret = ofi_cq_write_batch(overflow->cq, overflow->comp,
+					 overflow->count);
+		if (ret < 0)
+			break;
+
+		overflow->count -= ret;
+		if (overflow->count) {
+			memmove(overflow->comp, &overflow->comp[ret],
+				overflow->count * sizeof(*overflow->comp));
+			ret = -FI_EAGAIN;
+			break;
+		}
+		slist_remove_head(&rxm_ep->comp_overflow);
+		ofi_atomic_dec32(&rxm_ep->comp_overflow_cnt);
+		free(overflow);
+	}
+	fastlock_release(&rxm_ep->comp_overflow_lock);
+	return ret < 0 ? (int) ret : 0;
+}
+
+/* Completions raised while draining the msg CQ are staged in batch and
+ * written with one reserve/commit per util CQ.  Writers outside of
+ * rxm_cq_progress() pass a NULL batch and write directly. */
+static int rxm_cq_write(struct rxm_cq_batch *batch, struct util_cq *cq,
+			void *context, uint64_t flags, size_t len, void *buf,
+			uint64_t data, uint64_t tag)
+{
+	struct fi_cq_tagged_entry *comp;
+	struct rxm_cq_comp *cq_comp;
+
+	if (!batch)
+		return ofi_cq_write(cq, context, flags, len, buf, data, tag);
+
+	cq_comp = (cq == batch->tx.cq) ? &batch->tx : &batch->rx;
+	assert(cq == cq_comp->cq);
+	if (cq_comp->count == RXM_CQ_READ_BATCH &&
+	    rxm_cq_batch_flush_cq(cq_comp))
+		rxm_cq_overflow_add(batch->ep, cq_comp);
+
+	comp = &cq_comp->comp[cq_comp->count++];
+	comp->op_context = context;
+	comp->flags = flags;
+	comp->len = len;
+	comp->buf = buf;
+	comp->data = data;
+	comp->tag = tag;
+	return 0;
+}
+
+static void rxm_cq_batch_init(struct rxm_cq_batch *batch, struct rxm_ep *rxm_ep)
+{
+	batch->ep = rxm_ep;
+	batch->tx.cq = rxm_ep->util_ep.tx_cq;
+	batch->rx.cq = rxm_ep->util_ep.rx_cq;
+	batch->tx.count = 0;
+	batch->rx.count = 0;
+}
+
+/* Whatever the util CQs can't take now is kept on the overflow list,
+ * behind any completions already parked there. */
+static void rxm_cq_batch_flush(struct rxm_cq_batch *batch)
+{
+	if (!ofi_atomic_get32(&batch->ep->comp_overflow_cnt) ||
+	    !rxm_cq_overflow_flush(batch->ep)) {
+		rxm_cq_batch_flush_cq(&batch->tx);
+		rxm_cq_batch_flush_cq(&batch->rx);
+	}
+	rxm_cq_overflow_add(batch->ep, &batch->tx);
+	rxm_cq_overflow_add(batch->ep, &batch->rx);
+}
+
+int rxm_finish_recv(struct rxm_rx_buf *rx_buf, struct rxm_cq_batch *batch)
 {
 	int ret;
 
 	if (rx_buf->recv_entry->flags & FI_COMPLETION) {
 		FI_DBG(&rxm_prov, FI_LOG_CQ, "writing recv completion\n");
-		ret = ofi_cq_write(rx_buf->ep->util_ep.rx_cq,
+		ret = rxm_cq_write(batch, rx_buf->ep->util_ep.rx_cq,
 				   rx_buf->recv_entry->context,
 				   rx_buf->recv_entry->comp_flags,
 				   rx_buf->pkt.hdr.size, NULL,
@@ -120,17 +248,19 @@ int rxm_finish_recv(struct rxm_rx_buf *rx_buf)
 			return ret;
 		}
 	}
+	ofi_ep_stat_inc(&rx_buf->ep->util_ep, rx_completed);
 
 	rxm_recv_entry_release(rx_buf->recv_queue, rx_buf->recv_entry);
 	return rxm_ep_repost_buf(rx_buf);
 }
 
-static int rxm_finish_send_nobuf(struct rxm_tx_entry *tx_entry)
+static int rxm_finish_send_nobuf(struct rxm_tx_entry *tx_entry,
+				 struct rxm_cq_batch *batch)
 {
 	int ret;
 
 	if (tx_entry->flags & FI_COMPLETION) {
-		ret = ofi_cq_write(tx_entry->ep->util_ep.tx_cq,
+		ret = rxm_cq_write(batch, tx_entry->ep->util_ep.tx_cq,
 				   tx_entry->context, tx_entry->comp_flags, 0,
 				   NULL, 0, 0);
 		if (ret) {
@@ -140,14 +270,16 @@ static int rxm_finish_send_nobuf(struct rxm_tx_entry *tx_entry)
 		}
 		rxm_cq_log_comp(tx_entry->comp_flags);
 	}
+	ofi_ep_stat_inc(&tx_entry->ep->util_ep, tx_completed);
 	rxm_tx_entry_release(&tx_entry->ep->send_queue, tx_entry);
 	return 0;
 }
 
-int rxm_finish_send(struct rxm_tx_entry *tx_entry)
+static int rxm_finish_send(struct rxm_tx_entry *tx_entry,
+			   struct rxm_cq_batch *batch)
 {
 	rxm_buf_release(&tx_entry->ep->tx_pool, (struct rxm_buf *)tx_entry->tx_buf);
-	return rxm_finish_send_nobuf(tx_entry);
+	return rxm_finish_send_nobuf(tx_entry, batch);
 }
 
 /* Get a match_iov derived from iov whose size matches given length */
@@ -181,69 +313,339 @@ static int rxm_match_iov(const struct iovec *iov, void **desc,
 	return 0;
 }
 
-static int rxm_match_rma_iov(struct rxm_recv_entry *recv_entry,
-			     struct rxm_rma_iov *rma_iov,
-			     struct rxm_iov *match_iov)
+/* Advance the receive iov cursor past the bytes described by match_iov */
+static void rxm_lmt_advance_iov(struct rxm_rx_buf *rx_buf,
+				struct rxm_iov *match_iov)
+{
+	struct rxm_recv_entry *recv_entry = rx_buf->recv_entry;
+	size_t last = rx_buf->iov_index + match_iov->count - 1;
+	size_t used;
+
+	used = (match_iov->count == 1 ? rx_buf->iov_offset : 0) +
+		match_iov->iov[match_iov->count - 1].iov_len;
+
+	if (used == recv_entry->iov[last].iov_len) {
+		rx_buf->iov_index = last + 1;
+		rx_buf->iov_offset = 0;
+	} else {
+		rx_buf->iov_index = last;
+		rx_buf->iov_offset = used;
+	}
+}
+
+static struct rxm_lmt_read *rxm_lmt_read_get(struct rxm_rx_buf *rx_buf)
+{
+	size_t i;
+
+	for (i = 0; i < rxm_lmt_max_reads; i++) {
+		if (rx_buf->lmt_read[i].state == RXM_NONE)
+			return &rx_buf->lmt_read[i];
+	}
+	return NULL;
+}
+
+static void rxm_lmt_read_release(struct rxm_lmt_read *lmt_read)
 {
-	uint64_t offset = 0;
-	size_t i, j;
-	uint8_t count;
+	struct rxm_rx_buf *rx_buf = lmt_read->rx_buf;
+
+	if (!OFI_CHECK_MR_LOCAL(rx_buf->ep->rxm_info))
+		rxm_ep_msg_mr_cache_closev(rx_buf->ep, lmt_read->mr,
+					   lmt_read->iov.count);
+	lmt_read->state = RXM_NONE;
+}
+
+/* Build and post the read of the next chunk of the message */
+static int rxm_lmt_read_chunk(struct rxm_rx_buf *rx_buf,
+			      struct rxm_lmt_read *lmt_read)
+{
+	struct rxm_recv_entry *recv_entry = rx_buf->recv_entry;
+	struct ofi_rma_iov *rma_iov = &rx_buf->rma_iov->iov[rx_buf->rma_index];
+	size_t len, i;
 	int ret;
 
-	assert(rma_iov->count <= RXM_IOV_LIMIT);
+	len = rma_iov->len - rx_buf->rma_offset;
+	if (rxm_lmt_chunk_size)
+		len = MIN(len, rxm_lmt_chunk_size);
 
-	for (i = 0, j = 0; i < rma_iov->count; i++) {
-		ret = rxm_match_iov(&recv_entry->iov[j],
-			      &recv_entry->desc[j], recv_entry->count,
-			      offset, rma_iov->iov[i].len, &match_iov[i]);
+	ret = rxm_match_iov(&recv_entry->iov[rx_buf->iov_index],
+			    &recv_entry->desc[rx_buf->iov_index],
+			    recv_entry->count - rx_buf->iov_index,
+			    rx_buf->iov_offset, len, &lmt_read->iov);
+	if (ret)
+		return ret;
+
+	/* Registering this chunk overlaps with reads already in flight */
+	if (!OFI_CHECK_MR_LOCAL(rx_buf->ep->rxm_info)) {
+		ret = rxm_ep_msg_mr_cache_regv(rx_buf->ep, lmt_read->iov.iov,
+					       lmt_read->iov.count, FI_WRITE,
+					       lmt_read->mr);
 		if (ret)
 			return ret;
-		count = match_iov[i].count;
-		offset = match_iov[i].iov[match_iov[i].count].iov_len;
-
-		if (offset == recv_entry->iov[j + count - 1].iov_len) {
-			/* This iov has been completely used */
-			j += count;
-			offset = 0;
-		} else {
-			j += count - 1;
-		}
+
+		/* A vectored registration only sets mr[0] */
+		for (i = 0; i < lmt_read->iov.count; i++)
+			lmt_read->iov.desc[i] = lmt_read->mr[i] ?
+				lmt_read->mr[i] : lmt_read->mr[0];
 	}
+
+	for (i = 0; i < lmt_read->iov.count; i++)
+		lmt_read->iov.desc[i] = fi_mr_desc(lmt_read->iov.desc[i]);
+
+	lmt_read->rx_buf = rx_buf;
+	lmt_read->state = RXM_LMT_READ;
+
+	ret = fi_readv(rx_buf->conn->msg_ep, lmt_read->iov.iov,
+		       lmt_read->iov.desc, lmt_read->iov.count, 0,
+		       rma_iov->addr + rx_buf->rma_offset, rma_iov->key,
+		       lmt_read);
+	if (ret) {
+		rxm_lmt_read_release(lmt_read);
+		return ret;
+	}
+
+	rxm_lmt_advance_iov(rx_buf, &lmt_read->iov);
+	rx_buf->rma_offset += len;
+	if (rx_buf->rma_offset == rma_iov->len) {
+		rx_buf->rma_index++;
+		rx_buf->rma_offset = 0;
+	}
+	rx_buf->lmt_reads++;
 	return 0;
 }
 
+static void rxm_lmt_read_free(struct rxm_rx_buf *rx_buf)
+{
+	util_buf_ts_release(rx_buf->ep->lmt_read_pool, rx_buf->lmt_read);
+	rx_buf->lmt_read = NULL;
+}
+
+/* Complete the receive of a large message in error, once the sender has
+ * been sent a failed ack or if no ack can be sent at all. */
+static int rxm_lmt_recv_error(struct rxm_rx_buf *rx_buf, int err)
+{
+	struct fi_cq_err_entry err_entry = {0};
+	int ret;
+
+	FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to read large message: %s\n",
+		fi_strerror(-err));
+	if (rx_buf->lmt_read)
+		rxm_lmt_read_free(rx_buf);
+
+	err_entry.op_context = rx_buf->recv_entry->context;
+	err_entry.flags = rx_buf->recv_entry->comp_flags;
+	err_entry.tag = rx_buf->pkt.hdr.tag;
+	err_entry.data = rx_buf->pkt.hdr.data;
+	err_entry.err = -err;
+	err_entry.prov_errno = err;
+	ofi_ep_stat_inc(&rx_buf->ep->util_ep, errors);
+	ret = ofi_cq_write_error(rx_buf->ep->util_ep.rx_cq, &err_entry);
+	if (ret)
+		FI_WARN(&rxm_prov, FI_LOG_CQ,
+			"Unable to write recv error completion\n");
+
+	rxm_recv_entry_release(rx_buf->recv_queue, rx_buf->recv_entry);
+	return rxm_ep_repost_buf(rx_buf);
+}
+
+static int rxm_lmt_send_ack(struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_tx_entry *tx_entry;
+	struct rxm_tx_buf *tx_buf;
+	int ret;
+
+	assert(rx_buf->conn);
+
+	tx_buf = (struct rxm_tx_buf *)rxm_buf_get(&rx_buf->ep->tx_pool);
+	if (!tx_buf) {
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "TX queue full!\n");
+		return -FI_EAGAIN;
+	}
+
+	if (!(tx_entry = rxm_tx_entry_get(&rx_buf->ep->send_queue))) {
+		ret = -FI_EAGAIN;
+		goto err1;
+	}
+
+	RXM_LOG_STATE(FI_LOG_CQ, rx_buf->pkt, RXM_LMT_READ, RXM_LMT_ACK_SENT);
+	rx_buf->hdr.state = RXM_LMT_ACK_SENT;
+
+	tx_entry->state 	= rx_buf->hdr.state;
+	tx_entry->ep 		= rx_buf->ep;
+	tx_entry->context 	= rx_buf;
+	tx_entry->tx_buf 	= tx_buf;
+
+	rxm_pkt_init(&tx_buf->pkt);
+	tx_buf->pkt.ctrl_hdr.type 	= ofi_ctrl_ack;
+	tx_buf->pkt.ctrl_hdr.conn_id 	= rx_buf->conn->handle.remote_key;
+	tx_buf->pkt.ctrl_hdr.msg_id 	= rx_buf->pkt.ctrl_hdr.msg_id;
+	tx_buf->pkt.hdr.op 		= rx_buf->pkt.hdr.op;
+	/* Non-zero if the message could not be read */
+	tx_buf->pkt.hdr.data		= (uint64_t) -rx_buf->lmt_err;
+
+	ret = fi_send(rx_buf->conn->msg_ep, &tx_buf->pkt, sizeof(tx_buf->pkt),
+		      tx_buf->hdr.desc, 0, tx_entry);
+	if (ret) {
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to send ACK\n");
+		rx_buf->hdr.state = RXM_LMT_READ;
+		goto err2;
+	}
+	return 0;
+err2:
+	rxm_tx_entry_release(&rx_buf->ep->send_queue, tx_entry);
+err1:
+	rxm_buf_release(&rx_buf->ep->tx_pool, (struct rxm_buf *)tx_buf);
+	return ret;
+}
+
+/* Keep up to rxm_lmt_max_reads chunk reads outstanding for the message */
 static int rxm_lmt_rma_read(struct rxm_rx_buf *rx_buf)
 {
-	struct rxm_iov *match_iov = &rx_buf->match_iov[rx_buf->index];
+	struct rxm_lmt_read *lmt_read;
+	int ret;
+
+	while (rx_buf->rma_index < rx_buf->rma_iov->count) {
+		lmt_read = rxm_lmt_read_get(rx_buf);
+		if (!lmt_read)
+			break;
+
+		ret = rxm_lmt_read_chunk(rx_buf, lmt_read);
+		if (ret) {
+			/* Outstanding reads will retry on completion */
+			if (ret == -FI_EAGAIN && rx_buf->lmt_reads)
+				break;
+
+			/* Reads in flight still target the receive buffer,
+			 * so the error is reported once they complete */
+			if (rx_buf->lmt_reads) {
+				rx_buf->lmt_err = ret;
+				break;
+			}
+			return ret;
+		}
+	}
+	return 0;
+}
+
+/* Post the next reads of a large message, or its ack once the message
+ * has been read or has failed.  -FI_EAGAIN is returned only when nothing
+ * is in flight for the message, so nothing else will drive it. */
+static int rxm_lmt_post(struct rxm_rx_buf *rx_buf)
+{
+	int ret;
+
+	if (!rx_buf->lmt_err && rx_buf->rma_index < rx_buf->rma_iov->count) {
+		ret = rxm_lmt_rma_read(rx_buf);
+		if (ret == -FI_EAGAIN)
+			return ret;
+		if (ret)
+			rx_buf->lmt_err = ret;
+	}
+
+	if (rx_buf->lmt_reads)
+		return 0;
+
+	if (rx_buf->lmt_read)
+		rxm_lmt_read_free(rx_buf);
+	return rxm_lmt_send_ack(rx_buf);
+}
+
+/* Messages that could not post a read or their ack are retried from
+ * rxm_cq_progress() */
+static int rxm_lmt_continue(struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_ep *rxm_ep = rx_buf->ep;
 	int ret;
 
-	ret = fi_readv(rx_buf->conn->msg_ep, match_iov->iov, match_iov->desc,
-		       match_iov->count, 0, rx_buf->rma_iov->iov[0].addr,
-		       rx_buf->rma_iov->iov[0].key, rx_buf);
+	ret = rxm_lmt_post(rx_buf);
+	if (ret == -FI_EAGAIN) {
+		fastlock_acquire(&rxm_ep->lmt_retry_lock);
+		dlist_insert_tail(&rx_buf->lmt_retry_entry,
+				  &rxm_ep->lmt_retry_list);
+		ofi_atomic_inc32(&rxm_ep->lmt_retry_cnt);
+		fastlock_release(&rxm_ep->lmt_retry_lock);
+		return 0;
+	}
 	if (ret)
-		return ret;
-	rx_buf->index++;
+		return rxm_lmt_recv_error(rx_buf, rx_buf->lmt_err ?
+					  rx_buf->lmt_err : ret);
 	return 0;
 }
 
-static int rxm_lmt_tx_finish(struct rxm_tx_entry *tx_entry)
+static void rxm_lmt_progress_retry(struct rxm_ep *rxm_ep)
 {
+	struct rxm_rx_buf *rx_buf;
+	int ret;
+
+	fastlock_acquire(&rxm_ep->lmt_retry_lock);
+	while (!dlist_empty(&rxm_ep->lmt_retry_list)) {
+		rx_buf = container_of(rxm_ep->lmt_retry_list.next,
+				      struct rxm_rx_buf, lmt_retry_entry);
+		/* Unlink first, the buffer may be reposted as soon as its
+		 * ack is posted */
+		dlist_remove(&rx_buf->lmt_retry_entry);
+		ret = rxm_lmt_post(rx_buf);
+		if (ret == -FI_EAGAIN) {
+			dlist_insert_head(&rx_buf->lmt_retry_entry,
+					  &rxm_ep->lmt_retry_list);
+			break;
+		}
+
+		ofi_atomic_dec32(&rxm_ep->lmt_retry_cnt);
+		if (ret)
+			rxm_lmt_recv_error(rx_buf, rx_buf->lmt_err ?
+					   rx_buf->lmt_err : ret);
+	}
+	fastlock_release(&rxm_ep->lmt_retry_lock);
+}
+
+/* The receiver acks with a non-zero status if it could not read the
+ * message.  The send is then completed in error. */
+static void rxm_lmt_tx_error(struct rxm_tx_entry *tx_entry, int err)
+{
+	struct rxm_ep *rxm_ep = tx_entry->ep;
+	struct fi_cq_err_entry err_entry = {0};
+
+	FI_WARN(&rxm_prov, FI_LOG_CQ, "Peer failed to read large message: "
+		"%s\n", fi_strerror(err));
+
+	err_entry.op_context = tx_entry->context;
+	err_entry.flags = tx_entry->comp_flags;
+	err_entry.err = err;
+	err_entry.prov_errno = -err;
+	if (ofi_cq_write_error(rxm_ep->util_ep.tx_cq, &err_entry))
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to report error\n");
+	ofi_ep_stat_inc(&rxm_ep->util_ep, errors);
+
+	rxm_buf_release(&rxm_ep->tx_pool, (struct rxm_buf *)tx_entry->tx_buf);
+	rxm_tx_entry_release(&rxm_ep->send_queue, tx_entry);
+}
+
+static int rxm_lmt_tx_finish(struct rxm_tx_entry *tx_entry,
+			     struct rxm_cq_batch *batch)
+{
+	struct rxm_rx_buf *rx_buf = tx_entry->rx_buf;
 	int ret;
 
 	RXM_LOG_STATE_TX(FI_LOG_CQ, tx_entry, RXM_LMT_FINISH);
 	tx_entry->state = RXM_LMT_FINISH;
 
 	if (!OFI_CHECK_MR_LOCAL(tx_entry->ep->rxm_info))
-		rxm_ep_msg_mr_closev(tx_entry->mr, tx_entry->count);
+		rxm_ep_msg_mr_cache_closev(tx_entry->ep, tx_entry->mr,
+					   tx_entry->count);
 
-	ret = rxm_finish_send(tx_entry);
-	if (ret)
-		return ret;
+	if (OFI_UNLIKELY(rx_buf->pkt.hdr.data)) {
+		rxm_lmt_tx_error(tx_entry, (int) rx_buf->pkt.hdr.data);
+	} else {
+		ret = rxm_finish_send(tx_entry, batch);
+		if (ret)
+			return ret;
+	}
 
-	return rxm_ep_repost_buf(tx_entry->rx_buf);
+	return rxm_ep_repost_buf(rx_buf);
 }
 
-static int rxm_lmt_handle_ack(struct rxm_rx_buf *rx_buf)
+static int rxm_lmt_handle_ack(struct rxm_rx_buf *rx_buf,
+			      struct rxm_cq_batch *batch)
 {
 	struct rxm_tx_entry *tx_entry;
 	int index;
@@ -262,7 +664,7 @@ static int rxm_lmt_handle_ack(struct rxm_rx_buf *rx_buf)
 	tx_entry->rx_buf = rx_buf;
 
 	if (tx_entry->state == RXM_LMT_ACK_WAIT) {
-		return rxm_lmt_tx_finish(tx_entry);
+		return rxm_lmt_tx_finish(tx_entry, batch);
 	} else {
 		assert(tx_entry->state == RXM_LMT_TX);
 		RXM_LOG_STATE_TX(FI_LOG_CQ, tx_entry, RXM_LMT_ACK_RECVD);
@@ -271,13 +673,173 @@ static int rxm_lmt_handle_ack(struct rxm_rx_buf *rx_buf)
 	}
 }
 
-int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf)
+static int rxm_sar_match_seg(struct dlist_entry *item, const void *arg)
 {
-	struct rxm_iov mr_match_iov;
-	size_t i, rma_total_len = 0;
+	const struct rxm_rx_buf *rx_buf = arg;
+	struct rxm_sar_seg *seg;
+
+	seg = container_of(item, struct rxm_sar_seg, entry);
+	return (seg->conn_id == rx_buf->pkt.ctrl_hdr.conn_id) &&
+	       (seg->msg_id == rx_buf->pkt.ctrl_hdr.msg_id);
+}
+
+static int rxm_sar_match_head(struct dlist_entry *item, const void *arg)
+{
+	const struct rxm_rx_buf *rx_buf = arg;
+	struct rxm_rx_buf *head;
+
+	head = container_of(item, struct rxm_rx_buf, sar_entry);
+	return (head->pkt.ctrl_hdr.conn_id == rx_buf->pkt.ctrl_hdr.conn_id) &&
+	       (head->pkt.ctrl_hdr.msg_id == rx_buf->pkt.ctrl_hdr.msg_id);
+}
+
+/* Segments are placed at seg_no times the payload size of the first one */
+static void rxm_sar_copy_seg(struct rxm_rx_buf *head, uint32_t seg_no,
+			     void *data, size_t len)
+{
+	if (head->recv_entry)
+		ofi_copy_to_iov(head->recv_entry->iov, head->recv_entry->count,
+				seg_no * head->data_len, data, len);
+	head->sar_recvd += len;
+}
+
+static int rxm_sar_finish(struct rxm_rx_buf *head, struct rxm_cq_batch *batch)
+{
+	/* A discarded message has no recv_entry to complete */
+	if (head->recv_entry)
+		return rxm_finish_recv(head, batch);
+	return rxm_ep_repost_buf(head);
+}
+
+/* First segment of a message has been matched to a receive */
+static int rxm_sar_handle_head(struct rxm_rx_buf *rx_buf,
+			       struct rxm_cq_batch *batch)
+{
+	struct rxm_ep *rxm_ep = rx_buf->ep;
+	struct dlist_entry *item;
+	struct rxm_sar_seg *seg;
+
+	if (rx_buf->recv_entry)
+		ofi_copy_to_iov(rx_buf->recv_entry->iov,
+				rx_buf->recv_entry->count, 0,
+				rx_buf->pkt.data, rx_buf->data_len);
+	rx_buf->sar_recvd = rx_buf->data_len;
+
+	fastlock_acquire(&rxm_ep->sar_lock);
+	while ((item = dlist_remove_first_match(&rxm_ep->sar_seg_list,
+						rxm_sar_match_seg, rx_buf))) {
+		seg = container_of(item, struct rxm_sar_seg, entry);
+		rxm_sar_copy_seg(rx_buf, seg->seg_no, seg->data, seg->len);
+		util_buf_release(rxm_ep->sar_seg_pool, seg);
+	}
+	if (rx_buf->sar_recvd < rx_buf->pkt.hdr.size) {
+		dlist_insert_tail(&rx_buf->sar_entry, &rxm_ep->sar_list);
+		fastlock_release(&rxm_ep->sar_lock);
+		return 0;
+	}
+	fastlock_release(&rxm_ep->sar_lock);
+
+	return rxm_sar_finish(rx_buf, batch);
+}
+
+/* Later segment of a message.  The first segment may still be waiting for a
+ * matching receive.  In that case the payload is copied aside, so that
+ * unexpected segments do not hold on to posted receive buffers. */
+static int rxm_sar_handle_seg(struct rxm_rx_buf *rx_buf,
+			      struct rxm_cq_batch *batch)
+{
+	struct rxm_ep *rxm_ep = rx_buf->ep;
+	struct dlist_entry *item;
+	struct rxm_rx_buf *head;
+	struct rxm_sar_seg *seg;
 	int ret;
 
-	if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_large_data) {
+	fastlock_acquire(&rxm_ep->sar_lock);
+	item = dlist_find_first_match(&rxm_ep->sar_list, rxm_sar_match_head,
+				      rx_buf);
+	if (!item) {
+		seg = util_buf_alloc(rxm_ep->sar_seg_pool);
+		if (!seg) {
+			fastlock_release(&rxm_ep->sar_lock);
+			FI_WARN(&rxm_prov, FI_LOG_CQ,
+				"Unable to store unexpected segment\n");
+			return -FI_ENOMEM;
+		}
+		seg->conn_id = rx_buf->pkt.ctrl_hdr.conn_id;
+		seg->msg_id = rx_buf->pkt.ctrl_hdr.msg_id;
+		seg->seg_no = rx_buf->pkt.ctrl_hdr.seg_no;
+		seg->len = rx_buf->data_len;
+		memcpy(seg->data, rx_buf->pkt.data, seg->len);
+		dlist_insert_tail(&seg->entry, &rxm_ep->sar_seg_list);
+		fastlock_release(&rxm_ep->sar_lock);
+		return rxm_ep_repost_buf(rx_buf);
+	}
+
+	head = container_of(item, struct rxm_rx_buf, sar_entry);
+	rxm_sar_copy_seg(head, rx_buf->pkt.ctrl_hdr.seg_no, rx_buf->pkt.data,
+			 rx_buf->data_len);
+	if (head->sar_recvd < head->pkt.hdr.size)
+		head = NULL;
+	else
+		dlist_remove(&head->sar_entry);
+	fastlock_release(&rxm_ep->sar_lock);
+
+	ret = rxm_ep_repost_buf(rx_buf);
+	if (ret || !head)
+		return ret;
+
+	return rxm_sar_finish(head, batch);
+}
+
+/* Called once every segment of a SAR send has completed or been dropped */
+static int rxm_sar_tx_finish(struct rxm_tx_entry *tx_entry,
+			     struct rxm_cq_batch *batch)
+{
+	struct rxm_ep *rxm_ep = tx_entry->ep;
+	struct fi_cq_err_entry err_entry = {0};
+
+	if (!tx_entry->sar_err)
+		return rxm_finish_send_nobuf(tx_entry, batch);
+
+	err_entry.op_context = tx_entry->context;
+	err_entry.flags = tx_entry->comp_flags;
+	err_entry.err = tx_entry->sar_err;
+	err_entry.prov_errno = -tx_entry->sar_err;
+	if (ofi_cq_write_error(rxm_ep->util_ep.tx_cq, &err_entry))
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to report error\n");
+	ofi_ep_stat_inc(&rxm_ep->util_ep, errors);
+	rxm_tx_entry_release(&rxm_ep->send_queue, tx_entry);
+	return 0;
+}
+
+/* Account for cnt segments of a SAR send that will never be posted */
+void rxm_sar_tx_drop(struct rxm_tx_entry *tx_entry, size_t cnt, int err)
+{
+	if (!tx_entry->sar_err)
+		tx_entry->sar_err = err;
+	if (!ofi_atomic_sub32(&tx_entry->sar_segs, (int) cnt))
+		rxm_sar_tx_finish(tx_entry, NULL);
+}
+
+static int rxm_sar_tx_comp(struct rxm_tx_buf *tx_buf,
+			   struct rxm_cq_batch *batch)
+{
+	struct rxm_tx_entry *tx_entry = tx_buf->tx_entry;
+
+	rxm_buf_release(&tx_entry->ep->tx_pool, (struct rxm_buf *)tx_buf);
+	if (ofi_atomic_dec32(&tx_entry->sar_segs))
+		return 0;
+
+	return rxm_sar_tx_finish(tx_entry, batch);
+}
+
+int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf, struct rxm_cq_batch *batch)
+{
+	size_t i, rma_total_len = 0;
+
+	if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_start_data) {
+		return rxm_sar_handle_head(rx_buf, batch);
+	} else if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_large_data) {
 		if (!rx_buf->conn) {
 			rx_buf->conn = rxm_key2conn(rx_buf->ep, rx_buf->pkt.ctrl_hdr.conn_id);
 			if (!rx_buf->conn)
@@ -289,10 +851,9 @@ int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf)
 		       rx_buf->pkt.ctrl_hdr.msg_id);
 
 		rx_buf->rma_iov = (struct rxm_rma_iov *)rx_buf->pkt.data;
-		rx_buf->index = 0;
 
 		for (i = 0; i < rx_buf->rma_iov->count; i++)
-			rma_total_len += rx_buf->rma_iov->iov->len;
+			rma_total_len += rx_buf->rma_iov->iov[i].len;
 
 		if (rma_total_len > ofi_total_iov_len(rx_buf->recv_entry->iov,
 				      rx_buf->recv_entry->count)) {
@@ -301,48 +862,27 @@ int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf)
 			return -FI_ETRUNC; // TODO copy data and write to CQ error
 		}
 
-		if (!OFI_CHECK_MR_LOCAL(rx_buf->ep->rxm_info)) {
-			ret = rxm_match_iov(rx_buf->recv_entry->iov,
-					    rx_buf->recv_entry->desc,
-					    rx_buf->recv_entry->count, 0,
-					    rma_total_len, &mr_match_iov);
-			if (ret)
-				return ret;
-
-			ret = rxm_ep_msg_mr_regv(rx_buf->ep, mr_match_iov.iov,
-						 mr_match_iov.count, FI_WRITE,
-						 rx_buf->mr);
-			if (ret)
-				return ret;
-
-			rx_buf->recv_entry->count = mr_match_iov.count;
-
-			for (i = 0; i < rx_buf->recv_entry->count; i++)
-				rx_buf->recv_entry->desc[i] = rx_buf->mr[i];
-		}
-
-		for (i = 0; i < rx_buf->recv_entry->count; i++)
-			rx_buf->recv_entry->desc[i] = fi_mr_desc(rx_buf->recv_entry->desc[i]);
-
-		ret = rxm_match_rma_iov(rx_buf->recv_entry, rx_buf->rma_iov,
-				    rx_buf->match_iov);
-		if (ret)
-			return ret;
+		rx_buf->lmt_read = util_buf_ts_alloc(rx_buf->ep->lmt_read_pool);
+		if (!rx_buf->lmt_read)
+			return -FI_ENOMEM;
+		for (i = 0; i < rxm_lmt_max_reads; i++)
+			rx_buf->lmt_read[i].state = RXM_NONE;
 
 		RXM_LOG_STATE_RX(FI_LOG_CQ, rx_buf, RXM_LMT_READ);
 		rx_buf->hdr.state = RXM_LMT_READ;
-		return rxm_lmt_rma_read(rx_buf);
+		return rxm_lmt_continue(rx_buf);
 	} else {
 		ofi_copy_to_iov(rx_buf->recv_entry->iov, rx_buf->recv_entry->count, 0,
 				rx_buf->pkt.data, rx_buf->pkt.hdr.size);
-		return rxm_finish_recv(rx_buf);
+		return rxm_finish_recv(rx_buf, batch);
 	}
 }
 
-int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
+static int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf,
+				struct rxm_cq_batch *batch)
 {
 	struct rxm_recv_match_attr match_attr;
-	struct dlist_entry *entry;
+	struct rxm_recv_entry *recv_entry;
 	struct rxm_recv_queue *recv_queue;
 	struct util_cq *util_cq;
 
@@ -364,6 +904,7 @@ int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
 	switch(rx_buf->pkt.hdr.op) {
 	case ofi_op_msg:
 		FI_DBG(&rxm_prov, FI_LOG_CQ, "Got MSG op\n");
+		match_attr.tag = 0;
 		recv_queue = &rx_buf->ep->recv_queue;
 		break;
 	case ofi_op_tagged:
@@ -380,9 +921,8 @@ int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
 	rx_buf->recv_queue = recv_queue;
 
 	fastlock_acquire(&recv_queue->lock);
-	entry = dlist_remove_first_match(&recv_queue->recv_list,
-					 recv_queue->match_recv, &match_attr);
-	if (!entry) {
+	recv_entry = rxm_recv_entry_match(recv_queue, &match_attr);
+	if (!recv_entry) {
 		RXM_DBG_ADDR_TAG(FI_LOG_CQ, "No matching recv found for "
 				 "incoming msg", match_attr.addr,
 				 match_attr.tag);
@@ -390,72 +930,40 @@ int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
 		       "queue\n");
 		rx_buf->unexp_msg.addr = match_attr.addr;
 		rx_buf->unexp_msg.tag = match_attr.tag;
-		dlist_insert_tail(&rx_buf->unexp_msg.entry, &recv_queue->unexp_msg_list);
+		rxm_unexp_msg_insert(recv_queue, &rx_buf->unexp_msg);
 		fastlock_release(&recv_queue->lock);
+		ofi_ep_stat_unexp_inc(&rx_buf->ep->util_ep);
 		return 0;
 	}
 	fastlock_release(&recv_queue->lock);
 
-	rx_buf->recv_entry = container_of(entry, struct rxm_recv_entry, entry);
-	return rxm_cq_handle_data(rx_buf);
+	rx_buf->recv_entry = recv_entry;
+	return rxm_cq_handle_data(rx_buf, batch);
 }
 
-static int rxm_lmt_send_ack(struct rxm_rx_buf *rx_buf)
+static int rxm_lmt_read_comp(struct rxm_lmt_read *lmt_read)
 {
-	struct rxm_tx_entry *tx_entry;
-	struct rxm_tx_buf *tx_buf;
-	int ret;
+	struct rxm_rx_buf *rx_buf = lmt_read->rx_buf;
 
-	assert(rx_buf->conn);
+	rxm_lmt_read_release(lmt_read);
+	rx_buf->lmt_reads--;
 
-	tx_buf = (struct rxm_tx_buf *)rxm_buf_get(&rx_buf->ep->tx_pool);
-	if (!tx_buf) {
-		FI_WARN(&rxm_prov, FI_LOG_CQ, "TX queue full!\n");
-		return -FI_EAGAIN;
-	}
-
-	if (!(tx_entry = rxm_tx_entry_get(&rx_buf->ep->send_queue))) {
-		ret = -FI_EAGAIN;
-		goto err1;
-	}
-
-	RXM_LOG_STATE(FI_LOG_CQ, rx_buf->pkt, RXM_LMT_READ, RXM_LMT_ACK_SENT);
-	rx_buf->hdr.state = RXM_LMT_ACK_SENT;
-
-	tx_entry->state 	= rx_buf->hdr.state;
-	tx_entry->ep 		= rx_buf->ep;
-	tx_entry->context 	= rx_buf;
-	tx_entry->tx_buf 	= tx_buf;
-
-	rxm_pkt_init(&tx_buf->pkt);
-	tx_buf->pkt.ctrl_hdr.type 	= ofi_ctrl_ack;
-	tx_buf->pkt.ctrl_hdr.conn_id 	= rx_buf->conn->handle.remote_key;
-	tx_buf->pkt.ctrl_hdr.msg_id 	= rx_buf->pkt.ctrl_hdr.msg_id;
-	tx_buf->pkt.hdr.op 		= rx_buf->pkt.hdr.op;
+	/* The ack of a failed message waits for the reads in flight */
+	if (rx_buf->lmt_err && rx_buf->lmt_reads)
+		return 0;
 
-	ret = fi_send(rx_buf->conn->msg_ep, &tx_buf->pkt, sizeof(tx_buf->pkt),
-		      tx_buf->hdr.desc, 0, tx_entry);
-	if (ret) {
-		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to send ACK\n");
-		rx_buf->hdr.state = RXM_NONE;
-		goto err2;
-	}
-	return 0;
-err2:
-	rxm_tx_entry_release(&rx_buf->ep->send_queue, tx_entry);
-err1:
-	rxm_buf_release(&rx_buf->ep->tx_pool, (struct rxm_buf *)tx_buf);
-	return ret;
+	return rxm_lmt_continue(rx_buf);
 }
 
 static int rxm_handle_remote_write(struct rxm_ep *rxm_ep,
-				   struct fi_cq_tagged_entry *comp)
+				   struct fi_cq_tagged_entry *comp,
+				   struct rxm_cq_batch *batch)
 {
 	int ret;
 
 	FI_DBG(&rxm_prov, FI_LOG_CQ, "writing remote write completion\n");
-	ret = ofi_cq_write(rxm_ep->util_ep.rx_cq, NULL, comp->flags, 0, NULL,
-			   comp->data, 0);
+	ret = rxm_cq_write(batch, rxm_ep->util_ep.rx_cq, NULL, comp->flags, 0,
+			   NULL, comp->data, 0);
 	if (ret) {
 		FI_WARN(&rxm_prov, FI_LOG_CQ,
 				"Unable to write remote write completion\n");
@@ -467,7 +975,8 @@ static int rxm_handle_remote_write(struct rxm_ep *rxm_ep,
 }
 
 static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
-			      struct fi_cq_tagged_entry *comp)
+			      struct fi_cq_tagged_entry *comp,
+			      struct rxm_cq_batch *batch)
 {
 	enum rxm_proto_state state = RXM_GET_PROTO_STATE(comp);
 	struct rxm_rx_buf *rx_buf = comp->op_context;
@@ -476,22 +985,26 @@ static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
 	/* Remote write events may not consume a posted recv so op context
 	 * and hence state would be NULL */
 	if (comp->flags & FI_REMOTE_WRITE)
-		return rxm_handle_remote_write(rxm_ep, comp);
+		return rxm_handle_remote_write(rxm_ep, comp, batch);
 
 	switch (state) {
 	case RXM_TX_NOBUF:
 		assert(comp->flags & (FI_SEND | FI_WRITE | FI_READ));
-		return rxm_finish_send_nobuf(tx_entry);
+		return rxm_finish_send_nobuf(tx_entry, batch);
 	case RXM_TX:
 		assert(comp->flags & (FI_SEND | FI_WRITE));
-		return rxm_finish_send(tx_entry);
+		return rxm_finish_send(tx_entry, batch);
 	case RXM_RX:
 		assert(!(comp->flags & FI_REMOTE_READ));
+		rx_buf->data_len = comp->len - sizeof(struct rxm_pkt);
 
 		if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_ack)
-			return rxm_lmt_handle_ack(rx_buf);
+			return rxm_lmt_handle_ack(rx_buf, batch);
+		else if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_data &&
+			 rx_buf->pkt.ctrl_hdr.seg_no)
+			return rxm_sar_handle_seg(rx_buf, batch);
 		else
-			return rxm_handle_recv_comp(comp->op_context);
+			return rxm_handle_recv_comp(comp->op_context, batch);
 	case RXM_LMT_TX:
 		assert(comp->flags & FI_SEND);
 		RXM_LOG_STATE_TX(FI_LOG_CQ, tx_entry, RXM_LMT_ACK_WAIT);
@@ -499,24 +1012,25 @@ static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
 		return 0;
 	case RXM_LMT_ACK_RECVD:
 		assert(comp->flags & FI_SEND);
-		return rxm_lmt_tx_finish(tx_entry);
+		return rxm_lmt_tx_finish(tx_entry, batch);
 	case RXM_LMT_READ:
 		assert(comp->flags & FI_READ);
-		if (rx_buf->index < rx_buf->rma_iov->count)
-			return rxm_lmt_rma_read(rx_buf);
-		else
-			return rxm_lmt_send_ack(rx_buf);
+		return rxm_lmt_read_comp(comp->op_context);
 	case RXM_LMT_ACK_SENT:
 		assert(comp->flags & FI_SEND);
 		rx_buf = tx_entry->context;
 		rxm_tx_entry_release(&tx_entry->ep->send_queue, tx_entry);
 		rxm_buf_release(&rx_buf->ep->tx_pool, (struct rxm_buf *)tx_entry->tx_buf);
 
+		if (rx_buf->lmt_err)
+			return rxm_lmt_recv_error(rx_buf, rx_buf->lmt_err);
+
 		RXM_LOG_STATE_RX(FI_LOG_CQ, rx_buf, RXM_LMT_FINISH);
 		rx_buf->hdr.state = RXM_LMT_FINISH;
-		if (!OFI_CHECK_MR_LOCAL(rx_buf->ep->rxm_info))
-			rxm_ep_msg_mr_closev(rx_buf->mr, RXM_IOV_LIMIT);
-		return rxm_finish_recv(rx_buf);
+		return rxm_finish_recv(rx_buf, batch);
+	case RXM_SAR_TX:
+		assert(comp->flags & FI_SEND);
+		return rxm_sar_tx_comp(comp->op_context, batch);
 	default:
 		FI_WARN(&rxm_prov, FI_LOG_CQ, "Invalid state!\n");
 		assert(0);
@@ -524,16 +1038,18 @@ static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
 	}
 }
 
-static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *comp)
+static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *comp,
+			   size_t count)
 {
 	struct rxm_tx_entry *tx_entry;
 	struct rxm_rx_buf *rx_buf;
+	struct rxm_ep *rxm_ep;
 	struct fi_cq_err_entry err_entry;
 	struct util_cq *util_cq;
 	void *op_context;
 	ssize_t ret;
 
-	ret = fi_cq_read(msg_cq, comp, 1);
+	ret = fi_cq_read(msg_cq, comp, count);
 	if (ret >= 0 || ret == -FI_EAGAIN)
 		return ret;
 
@@ -554,16 +1070,28 @@ static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *com
 	case RXM_TX:
 	case RXM_LMT_TX:
 		tx_entry = (struct rxm_tx_entry *)op_context;
-		util_cq = tx_entry->ep->util_ep.tx_cq;
+		rxm_ep = tx_entry->ep;
+		util_cq = rxm_ep->util_ep.tx_cq;
 		break;
 	case RXM_LMT_ACK_SENT:
 		tx_entry = (struct rxm_tx_entry *)op_context;
-		util_cq = tx_entry->ep->util_ep.rx_cq;
+		rxm_ep = tx_entry->ep;
+		util_cq = rxm_ep->util_ep.rx_cq;
+		break;
+	case RXM_SAR_TX:
+		tx_entry = ((struct rxm_tx_buf *)op_context)->tx_entry;
+		rxm_ep = tx_entry->ep;
+		util_cq = rxm_ep->util_ep.tx_cq;
 		break;
 	case RXM_RX:
-	case RXM_LMT_READ:
 		rx_buf = (struct rxm_rx_buf *)op_context;
-		util_cq = rx_buf->ep->util_ep.rx_cq;
+		rxm_ep = rx_buf->ep;
+		util_cq = rxm_ep->util_ep.rx_cq;
+		break;
+	case RXM_LMT_READ:
+		rx_buf = ((struct rxm_lmt_read *)op_context)->rx_buf;
+		rxm_ep = rx_buf->ep;
+		util_cq = rxm_ep->util_ep.rx_cq;
 		break;
 	default:
 		FI_WARN(&rxm_prov, FI_LOG_CQ, "Invalid state!\n");
@@ -573,33 +1101,69 @@ static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *com
 		assert(0);
 		return err_entry.err;
 	}
+	ofi_ep_stat_inc(&rxm_ep->util_ep, errors);
 	return ofi_cq_write_error(util_cq, &err_entry);
 }
 
+static void rxm_cq_handle_comp_error(struct rxm_ep *rxm_ep,
+				     struct fi_cq_tagged_entry *comp, int err)
+{
+	// TODO report error on RXM EP/domain since EP/CQ is broken.
+	FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to process msg cq completion "
+		"(state %d, flags 0x%" PRIx64 "): %s\n",
+		RXM_GET_PROTO_STATE(comp), comp->flags, fi_strerror(-err));
+	ofi_ep_stat_inc(&rxm_ep->util_ep, errors);
+}
+
 void rxm_cq_progress(struct rxm_ep *rxm_ep)
 {
-	struct fi_cq_tagged_entry comp;
-	ssize_t ret, comp_read = 0;
+	struct fi_cq_tagged_entry comp[RXM_CQ_READ_BATCH];
+	struct rxm_cq_batch batch_buf, *batch;
+	ssize_t ret, i, count, comp_read = 0;
 
-	do {
-		ret = rxm_cq_read(rxm_ep->msg_cq, &comp);
-		if (ret == -FI_EAGAIN)
-			break;
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_ep->deferred_tx_cnt)))
+		rxm_ep_progress_deferred_tx(rxm_ep);
+
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_ep->sar_tx_cnt)))
+		rxm_ep_progress_sar_tx(rxm_ep);
+
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_ep->lmt_retry_cnt)))
+		rxm_lmt_progress_retry(rxm_ep);
 
+	/* Leave the msg CQ alone until the parked completions are written */
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_ep->comp_overflow_cnt)) &&
+	    rxm_cq_overflow_flush(rxm_ep))
+		return;
+
+	/* FI_SOURCE stores the source address at the CQ write index while
+	 * matching, which requires the recv completion be written at once */
+	if (rxm_ep->rxm_info->caps & FI_SOURCE) {
+		batch = NULL;
+	} else {
+		batch = &batch_buf;
+		rxm_cq_batch_init(batch, rxm_ep);
+	}
+
+	do {
+		count = MIN(RXM_CQ_READ_BATCH,
+			    rxm_ep->comp_per_progress - comp_read);
+		/* An error entry has been reported to the util CQ by
+		 * rxm_cq_read() */
+		ret = rxm_cq_read(rxm_ep->msg_cq, comp, count);
 		if (ret < 0)
-			goto err;
+			break;
 
-		if (ret) {
-			comp_read += ret;
-			ret = rxm_cq_handle_comp(rxm_ep, &comp);
-			if (ret)
-				goto err;
+		comp_read += ret;
+		for (i = 0, count = ret; i < count; i++) {
+			ret = rxm_cq_handle_comp(rxm_ep, &comp[i], batch);
+			if (OFI_UNLIKELY(ret))
+				rxm_cq_handle_comp_error(rxm_ep, &comp[i],
+							 (int) ret);
 		}
 	} while (comp_read < rxm_ep->comp_per_progress);
-	return;
-err:
-	// TODO report error on RXM EP/domain since EP/CQ is broken.
-	return;
+
+	if (batch)
+		rxm_cq_batch_flush(batch);
 }
 
 static int rxm_cq_close(struct fid *fid)
@@ -57,6 +57,13 @@ static int rxm_domain_close(fid_t fid)
 
 	rxm_domain = container_of(fid, struct rxm_domain, util_domain.domain_fid.fid);
 
+	if (rxm_domain->mr_cache_enabled) {
+		ret = ofi_mr_cache_cleanup(&rxm_domain->mr_cache);
+		if (ret)
+			return ret;
+		rxm_domain->mr_cache_enabled = 0;
+	}
+
 	ret = fi_close(&rxm_domain->msg_domain->fid);
 	if (ret)
 		return ret;
@@ -141,6 +148,55 @@ err:
 	return ret;
 }
 
+static int rxm_mr_cache_add_region(struct ofi_mr_cache *cache,
+				   struct ofi_mr_cache_entry *entry)
+{
+	struct rxm_domain *rxm_domain;
+	struct fid_mr **mr = (struct fid_mr **)entry->data;
+	int ret;
+
+	rxm_domain = container_of(cache, struct rxm_domain, mr_cache);
+
+	/* The entry is passed as context so that it can be found from the
+	 * fid_mr when the registration is released */
+	ret = fi_mr_reg(rxm_domain->msg_domain, entry->iov.iov_base,
+			entry->iov.iov_len, entry->access, 0, 0, 0, mr, entry);
+	if (ret)
+		FI_WARN(&rxm_prov, FI_LOG_DOMAIN, "Unable to register MSG MR\n");
+	return ret;
+}
+
+static void rxm_mr_cache_delete_region(struct ofi_mr_cache *cache,
+				       struct ofi_mr_cache_entry *entry)
+{
+	struct fid_mr *mr = *(struct fid_mr **)entry->data;
+
+	if (fi_close(&mr->fid))
+		FI_WARN(&rxm_prov, FI_LOG_DOMAIN, "Unable to close MSG MR\n");
+}
+
+static int rxm_mr_cache_init(struct rxm_domain *rxm_domain)
+{
+	struct ofi_mr_cache *cache = &rxm_domain->mr_cache;
+	int ret;
+
+	if (!rxm_mr_cache_max_cnt)
+		return 0;
+
+	cache->max_cached_cnt = rxm_mr_cache_max_cnt;
+	cache->max_cached_size = rxm_mr_cache_max_size;
+	cache->entry_data_size = sizeof(struct fid_mr *);
+	cache->add_region = rxm_mr_cache_add_region;
+	cache->delete_region = rxm_mr_cache_delete_region;
+
+	ret = ofi_mr_cache_init(&rxm_prov, cache);
+	if (ret)
+		return ret;
+
+	rxm_domain->mr_cache_enabled = 1;
+	return 0;
+}
+
 static struct fi_ops_mr rxm_domain_mr_ops = {
 	.size = sizeof(struct fi_ops_mr),
 	.reg = rxm_mr_reg,
@@ -192,8 +248,16 @@ int rxm_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 	rxm_domain->mr_local = OFI_CHECK_MR_LOCAL(msg_info) &&
 				!OFI_CHECK_MR_LOCAL(info);
 
+	if (!OFI_CHECK_MR_LOCAL(info)) {
+		ret = rxm_mr_cache_init(rxm_domain);
+		if (ret)
+			goto err4;
+	}
+
 	fi_freeinfo(msg_info);
 	return 0;
+err4:
+	ofi_domain_close(&rxm_domain->util_domain);
 err3:
 	fi_close(&rxm_domain->msg_domain->fid);
 err2:
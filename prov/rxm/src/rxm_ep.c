@@ -57,14 +57,6 @@ static int rxm_match_recv_entry_tagged(struct dlist_entry *item, const void *arg
 		rxm_match_tag(recv_entry->tag, recv_entry->ignore, attr->tag);
 }
 
-static int rxm_match_recv_entry_context(struct dlist_entry *item, const void *context)
-{
-	struct rxm_recv_entry *recv_entry;
-
-	recv_entry = container_of(item, struct rxm_recv_entry, entry);
-	return recv_entry->context == context;
-}
-
 static int rxm_match_unexp_msg(struct dlist_entry *item, const void *arg)
 {
 	struct rxm_recv_match_attr *attr = (struct rxm_recv_match_attr *)arg;
@@ -104,10 +96,12 @@ static int rxm_mr_buf_reg(void *pool_ctx, void *addr, size_t len, void **context
 
 void rxm_buf_release(struct rxm_buf_pool *pool, struct rxm_buf *buf)
 {
-	fastlock_acquire(&pool->lock);
-	dlist_remove(&buf->entry);
-	util_buf_release(pool->pool, buf);
-	fastlock_release(&pool->lock);
+	if (pool->track) {
+		fastlock_acquire(&pool->lock);
+		dlist_remove(&buf->entry);
+		fastlock_release(&pool->lock);
+	}
+	util_buf_ts_release(pool->pool, buf);
 }
 
 struct rxm_buf *rxm_buf_get(struct rxm_buf_pool *pool)
@@ -115,19 +109,19 @@ struct rxm_buf *rxm_buf_get(struct rxm_buf_pool *pool)
 	struct rxm_buf *buf;
 	void *mr = NULL;
 
-	fastlock_acquire(&pool->lock);
 	if (pool->local_mr)
-		buf = util_buf_alloc_ex(pool->pool, (void **)&mr);
+		buf = util_buf_ts_alloc_ex(pool->pool, (void **)&mr);
 	else
-		buf = util_buf_alloc(pool->pool);
-	if (!buf) {
-		fastlock_release(&pool->lock);
+		buf = util_buf_ts_alloc(pool->pool);
+	if (!buf)
 		return NULL;
-	}
 	memset(buf, 0, sizeof(*buf));
 
-	dlist_insert_tail(&buf->entry, &pool->buf_list);
-	fastlock_release(&pool->lock);
+	if (pool->track) {
+		fastlock_acquire(&pool->lock);
+		dlist_insert_tail(&buf->entry, &pool->buf_list);
+		fastlock_release(&pool->lock);
+	}
 
 	if (pool->local_mr && mr)
 		buf->desc = fi_mr_desc((struct fid_mr *)mr);
@@ -138,30 +132,54 @@ static void rxm_buf_pool_destroy(struct rxm_buf_pool *pool)
 {
 	struct dlist_entry *entry;
 	struct rxm_buf *buf;
+	size_t cnt = 0;
 
 	while(!dlist_empty(&pool->buf_list)) {
 		entry = pool->buf_list.next;
 		buf = container_of(entry, struct rxm_buf, entry);
 		rxm_buf_release(pool, buf);
+		cnt++;
 	}
+
+	/* Pools tracked only in debug builds should be empty by now */
+	if (cnt && !pool->release_all)
+		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL,
+			"%zu buffers still in use at close\n", cnt);
 	fastlock_destroy(&pool->lock);
-	util_buf_pool_destroy(pool->pool);
+	util_buf_ts_pool_destroy(pool->pool);
 }
 
+/*
+ * Receive buffers stay posted to the msg endpoints until the pool is
+ * destroyed, so they are tracked to be released then.  Transmit buffers
+ * are only tracked in debug builds, where buffers not returned by the
+ * time the pool is destroyed are reported; otherwise they never touch a
+ * shared lock.
+ */
 static int rxm_buf_pool_create(int local_mr, size_t chunk_count, size_t size,
-		struct rxm_buf_pool *pool, void *pool_ctx)
-{
-	pool->pool = local_mr ?
-		util_buf_pool_create_ex(RXM_BUF_SIZE + size, 16, 0, chunk_count,
-					rxm_mr_buf_reg, rxm_mr_buf_close,
-					pool_ctx) :
-		util_buf_pool_create(RXM_BUF_SIZE, 16, 0, chunk_count);
+		struct rxm_buf_pool *pool, void *pool_ctx, int track)
+{
+	struct util_buf_attr attr = {
+		.size		= rxm_buffer_size + size,
+		.alignment	= 16,
+		.chunk_cnt	= chunk_count,
+		.alloc_hndlr	= local_mr ? rxm_mr_buf_reg : NULL,
+		.free_hndlr	= local_mr ? rxm_mr_buf_close : NULL,
+		.ctx		= pool_ctx,
+		.flags		= (rxm_use_hugepages ? UTIL_BUF_POOL_HUGEPAGE : 0) |
+				  (rxm_numa_node >= 0 ? UTIL_BUF_POOL_NUMA_BIND : 0),
+		.numa_node	= rxm_numa_node,
+	};
+
+	pool->pool = util_buf_ts_pool_create_attr(&attr);
 	if (!pool->pool) {
 		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL, "Unable to create buf pool\n");
 		return -FI_ENOMEM;
 	}
 	dlist_init(&pool->buf_list);
 	pool->local_mr = local_mr;
+	pool->release_all = track;
+	pool->track = track || ENABLE_DEBUG;
 	fastlock_init(&pool->lock);
 	return 0;
 }
@@ -177,16 +195,26 @@ static int rxm_send_queue_init(struct rxm_send_queue *send_queue, size_t size)
 	return 0;
 }
 
-static int rxm_recv_queue_init(struct rxm_recv_queue *recv_queue, size_t size,
+static int rxm_recv_queue_init(struct rxm_ep *rxm_ep,
+			       struct rxm_recv_queue *recv_queue, size_t size,
 			       enum rxm_recv_queue_type type)
 {
+	int ret;
+
 	recv_queue->type = type;
 	recv_queue->fs = rxm_recv_fs_create(size);
 	if (!recv_queue->fs)
 		return -FI_ENOMEM;
 
-	dlist_init(&recv_queue->recv_list);
-	dlist_init(&recv_queue->unexp_msg_list);
+	ret = rxm_recv_match_init(recv_queue, size);
+	if (ret) {
+		rxm_recv_fs_free(recv_queue->fs);
+		recv_queue->fs = NULL;
+		return ret;
+	}
+
+	recv_queue->msg_src = !!(rxm_ep->rxm_info->caps &
+				 (FI_SOURCE | FI_DIRECTED_RECV));
 	if (type == RXM_RECV_QUEUE_MSG) {
 		recv_queue->match_recv = rxm_match_recv_entry;
 		recv_queue->match_unexp = rxm_match_unexp_msg;
@@ -209,12 +237,18 @@ static void rxm_recv_queue_close(struct rxm_recv_queue *recv_queue)
 {
 	if (recv_queue->fs)
 		rxm_recv_fs_free(recv_queue->fs);
+	rxm_recv_match_close(recv_queue);
 	fastlock_destroy(&recv_queue->lock);
 	// TODO cleanup recv_list and unexp msg list
 }
 
 static int rxm_ep_txrx_res_open(struct rxm_ep *rxm_ep)
 {
+	struct util_buf_attr lmt_attr = {
+		.size		= sizeof(struct rxm_lmt_read) * rxm_lmt_max_reads,
+		.alignment	= 16,
+		.chunk_cnt	= 64,
+	};
 	struct rxm_domain *rxm_domain;
 	int ret;
 
@@ -226,45 +260,91 @@ static int rxm_ep_txrx_res_open(struct rxm_ep *rxm_ep)
 	ret = rxm_buf_pool_create(OFI_CHECK_MR_LOCAL(rxm_ep->msg_info),
 				  rxm_ep->msg_info->tx_attr->size,
 				  sizeof(struct rxm_tx_buf), &rxm_ep->tx_pool,
-				  rxm_domain->msg_domain);
+				  rxm_domain->msg_domain, 0);
 	if (ret)
 	        return ret;
 
 	ret = rxm_buf_pool_create(OFI_CHECK_MR_LOCAL(rxm_ep->msg_info),
 				  rxm_ep->msg_info->rx_attr->size,
 				  sizeof(struct rxm_rx_buf), &rxm_ep->rx_pool,
-				  rxm_domain->msg_domain);
+				  rxm_domain->msg_domain, 1);
 	if (ret)
 		goto err1;
 
+	rxm_ep->lmt_read_pool = util_buf_ts_pool_create_attr(&lmt_attr);
+	if (!rxm_ep->lmt_read_pool) {
+		ret = -FI_ENOMEM;
+		goto err2;
+	}
+
 	ret = rxm_send_queue_init(&rxm_ep->send_queue, rxm_ep->rxm_info->tx_attr->size);
 	if (ret)
-		goto err2;
+		goto err3;
 
-	ret = rxm_recv_queue_init(&rxm_ep->recv_queue, rxm_ep->rxm_info->rx_attr->size,
+	ret = rxm_recv_queue_init(rxm_ep, &rxm_ep->recv_queue, rxm_ep->rxm_info->rx_attr->size,
 				  RXM_RECV_QUEUE_MSG);
 	if (ret)
-		goto err3;
+		goto err4;
 
-	ret = rxm_recv_queue_init(&rxm_ep->trecv_queue, rxm_ep->rxm_info->rx_attr->size,
+	ret = rxm_recv_queue_init(rxm_ep, &rxm_ep->trecv_queue, rxm_ep->rxm_info->rx_attr->size,
 				  RXM_RECV_QUEUE_TAGGED);
 	if (ret)
-		goto err4;
+		goto err5;
+
+	rxm_ep->sar_seg_pool = util_buf_pool_create(sizeof(struct rxm_sar_seg) +
+						    rxm_buffer_size, 16, 0, 64);
+	if (!rxm_ep->sar_seg_pool) {
+		ret = -FI_ENOMEM;
+		goto err6;
+	}
+
+	dlist_init(&rxm_ep->lmt_retry_list);
+	fastlock_init(&rxm_ep->lmt_retry_lock);
+	ofi_atomic_initialize32(&rxm_ep->lmt_retry_cnt, 0);
+
+	dlist_init(&rxm_ep->sar_list);
+	dlist_init(&rxm_ep->sar_seg_list);
+	dlist_init(&rxm_ep->sar_tx_list);
+	ofi_atomic_initialize32(&rxm_ep->sar_tx_cnt, 0);
+	fastlock_init(&rxm_ep->sar_lock);
+
+	dlist_init(&rxm_ep->deferred_conn_list);
+	dlist_init(&rxm_ep->deferred_fail_list);
+	fastlock_init(&rxm_ep->deferred_lock);
+	ofi_atomic_initialize32(&rxm_ep->deferred_tx_cnt, 0);
 
+	slist_init(&rxm_ep->comp_overflow);
+	fastlock_init(&rxm_ep->comp_overflow_lock);
+	ofi_atomic_initialize32(&rxm_ep->comp_overflow_cnt, 0);
 	return 0;
-err4:
+err6:
+	rxm_recv_queue_close(&rxm_ep->trecv_queue);
+err5:
 	rxm_recv_queue_close(&rxm_ep->recv_queue);
-err3:
+err4:
 	rxm_send_queue_close(&rxm_ep->send_queue);
+err3:
+	util_buf_ts_pool_destroy(rxm_ep->lmt_read_pool);
 err2:
-	rxm_buf_pool_destroy(&rxm_ep->tx_pool);
-err1:
 	rxm_buf_pool_destroy(&rxm_ep->rx_pool);
+err1:
+	rxm_buf_pool_destroy(&rxm_ep->tx_pool);
 	return ret;
 }
 
 static void rxm_ep_txrx_res_close(struct rxm_ep *rxm_ep)
 {
+	struct slist_entry *entry;
+
+	while (!slist_empty(&rxm_ep->comp_overflow)) {
+		entry = slist_remove_head(&rxm_ep->comp_overflow);
+		free(container_of(entry, struct rxm_cq_overflow, entry));
+	}
+	fastlock_destroy(&rxm_ep->comp_overflow_lock);
+	fastlock_destroy(&rxm_ep->deferred_lock);
+	fastlock_destroy(&rxm_ep->sar_lock);
+	fastlock_destroy(&rxm_ep->lmt_retry_lock);
+	util_buf_pool_destroy(rxm_ep->sar_seg_pool);
 
 	rxm_recv_queue_close(&rxm_ep->trecv_queue);
 	rxm_recv_queue_close(&rxm_ep->recv_queue);
@@ -272,6 +352,7 @@ static void rxm_ep_txrx_res_close(struct rxm_ep *rxm_ep)
 
 	rxm_buf_pool_destroy(&rxm_ep->rx_pool);
 	rxm_buf_pool_destroy(&rxm_ep->tx_pool);
+	util_buf_ts_pool_destroy(rxm_ep->lmt_read_pool);
 }
 
 int rxm_ep_repost_buf(struct rxm_rx_buf *rx_buf)
@@ -285,7 +366,7 @@ int rxm_ep_repost_buf(struct rxm_rx_buf *rx_buf)
 	rx_buf->hdr.state = RXM_RX;
 	rx_buf->ep = rxm_ep;
 
-	ret = fi_recv(rx_buf->hdr.msg_ep, &rx_buf->pkt, RXM_BUF_SIZE,
+	ret = fi_recv(rx_buf->hdr.msg_ep, &rx_buf->pkt, rxm_buffer_size,
 		      rx_buf->hdr.desc, FI_ADDR_UNSPEC, rx_buf);
 	if (ret)
 		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL, "Unable to repost buf\n");
@@ -344,13 +425,25 @@ static struct fi_ops_cm rxm_ops_cm = {
 int rxm_getopt(fid_t fid, int level, int optname,
 		void *optval, size_t *optlen)
 {
-	return -FI_ENOPROTOOPT;
+	struct rxm_ep *rxm_ep;
+
+	if (level != FI_OPT_ENDPOINT || optname != FI_OPT_EP_STATS)
+		return -FI_ENOPROTOOPT;
+
+	rxm_ep = container_of(fid, struct rxm_ep, util_ep.ep_fid.fid);
+	return ofi_ep_getopt_stats(&rxm_ep->util_ep, optval, optlen);
 }
 
 int rxm_setopt(fid_t fid, int level, int optname,
 		const void *optval, size_t optlen)
 {
-	return -FI_ENOPROTOOPT;
+	struct rxm_ep *rxm_ep;
+
+	if (level != FI_OPT_ENDPOINT || optname != FI_OPT_EP_STATS)
+		return -FI_ENOPROTOOPT;
+
+	rxm_ep = container_of(fid, struct rxm_ep, util_ep.ep_fid.fid);
+	return ofi_ep_setopt_stats(&rxm_ep->util_ep, optval, optlen);
 }
 
 static int rxm_ep_cancel_recv(struct rxm_ep *rxm_ep,
@@ -358,15 +451,11 @@ static int rxm_ep_cancel_recv(struct rxm_ep *rxm_ep,
 {
 	struct fi_cq_err_entry err_entry;
 	struct rxm_recv_entry *recv_entry;
-	struct dlist_entry *entry;
 
 	fastlock_acquire(&recv_queue->lock);
-	entry = dlist_remove_first_match(&recv_queue->recv_list,
-					 rxm_match_recv_entry_context,
-					 context);
+	recv_entry = rxm_recv_entry_remove_context(recv_queue, context);
 	fastlock_release(&recv_queue->lock);
-	if (entry) {
-		recv_entry = container_of(entry, struct rxm_recv_entry, entry);
+	if (recv_entry) {
 		memset(&err_entry, 0, sizeof(err_entry));
 		err_entry.op_context = recv_entry->context;
 		if (recv_queue->type == RXM_RECV_QUEUE_TAGGED) {
@@ -416,24 +505,20 @@ rxm_check_unexp_msg_list(struct rxm_recv_queue *recv_queue, fi_addr_t addr,
 			 uint64_t tag, uint64_t ignore)
 {
 	struct rxm_recv_match_attr match_attr;
-	struct dlist_entry *entry;
-
-	if (dlist_empty(&recv_queue->unexp_msg_list))
-		return NULL;
+	struct rxm_unexp_msg *unexp_msg;
 
 	match_attr.addr 	= addr;
 	match_attr.tag 		= tag;
 	match_attr.ignore 	= ignore;
 
-	entry = dlist_find_first_match(&recv_queue->unexp_msg_list,
-				       recv_queue->match_unexp, &match_attr);
-	if (!entry)
+	unexp_msg = rxm_unexp_msg_match(recv_queue, &match_attr);
+	if (!unexp_msg)
 		return NULL;
 
 	RXM_DBG_ADDR_TAG(FI_LOG_EP_DATA, "Match for posted recv found in unexp"
 			 " msg list\n", match_attr.addr, match_attr.tag);
 
-	return container_of(entry, struct rxm_rx_buf, unexp_msg.entry);
+	return container_of(unexp_msg, struct rxm_rx_buf, unexp_msg);
 }
 
 static int rxm_ep_discard_recv(struct rxm_ep *rxm_ep, struct rxm_rx_buf *rx_buf,
@@ -448,6 +533,12 @@ static int rxm_ep_discard_recv(struct rxm_ep *rxm_ep, struct rxm_rx_buf *rx_buf,
 			    0, NULL, rx_buf->pkt.hdr.data, rx_buf->pkt.hdr.tag);
 	if (ret)
 		return ret;
+
+	/* Remaining segments still have to be consumed */
+	if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_start_data) {
+		rx_buf->recv_entry = NULL;
+		return rxm_cq_handle_data(rx_buf, NULL);
+	}
 	return rxm_ep_repost_buf(rx_buf);
 }
 
@@ -474,7 +565,8 @@ static int rxm_ep_peek_recv(struct rxm_ep *rxm_ep, fi_addr_t addr, uint64_t tag,
 	FI_DBG(&rxm_prov, FI_LOG_EP_DATA, "Message found\n");
 
 	if (flags & FI_DISCARD) {
-		dlist_remove(&rx_buf->unexp_msg.entry);
+		rxm_unexp_msg_remove(&rx_buf->unexp_msg);
+		ofi_ep_stat_unexp_dec(&rxm_ep->util_ep);
 		fastlock_release(&recv_queue->lock);
 		return rxm_ep_discard_recv(rxm_ep, rx_buf, context);
 	}
@@ -482,7 +574,8 @@ static int rxm_ep_peek_recv(struct rxm_ep *rxm_ep, fi_addr_t addr, uint64_t tag,
 	if (flags & FI_CLAIM) {
 		FI_DBG(&rxm_prov, FI_LOG_EP_DATA, "Marking message for Claim\n");
 		((struct fi_context *)context)->internal[0] = rx_buf;
-		dlist_remove(&rx_buf->unexp_msg.entry);
+		rxm_unexp_msg_remove(&rx_buf->unexp_msg);
+		ofi_ep_stat_unexp_dec(&rxm_ep->util_ep);
 	}
 	fastlock_release(&recv_queue->lock);
 
@@ -490,10 +583,10 @@ static int rxm_ep_peek_recv(struct rxm_ep *rxm_ep, fi_addr_t addr, uint64_t tag,
 			    0, NULL, rx_buf->pkt.hdr.data, rx_buf->pkt.hdr.tag);
 }
 
-static int rxm_ep_recv_common(struct rxm_ep *rxm_ep, const struct iovec *iov,
-			      void **desc, size_t count, fi_addr_t src_addr,
-			      uint64_t tag, uint64_t ignore, void *context,
-			      uint64_t flags, struct rxm_recv_queue *recv_queue)
+static int rxm_ep_post_recv(struct rxm_ep *rxm_ep, const struct iovec *iov,
+			    void **desc, size_t count, fi_addr_t src_addr,
+			    uint64_t tag, uint64_t ignore, void *context,
+			    uint64_t flags, struct rxm_recv_queue *recv_queue)
 {
 	struct rxm_recv_entry *recv_entry;
 	struct rxm_rx_buf *rx_buf;
@@ -521,8 +614,10 @@ static int rxm_ep_recv_common(struct rxm_ep *rxm_ep, const struct iovec *iov,
 		fastlock_acquire(&recv_queue->lock);
 		rx_buf = rxm_check_unexp_msg_list(recv_queue, src_addr, tag,
 						  ignore);
-		if (rx_buf)
-			dlist_remove(&rx_buf->unexp_msg.entry);
+		if (rx_buf) {
+			rxm_unexp_msg_remove(&rx_buf->unexp_msg);
+			ofi_ep_stat_unexp_dec(&rxm_ep->util_ep);
+		}
 		fastlock_release(&recv_queue->lock);
 	}
 
@@ -554,18 +649,29 @@ static int rxm_ep_recv_common(struct rxm_ep *rxm_ep, const struct iovec *iov,
 
 	if (rx_buf) {
 		rx_buf->recv_entry = recv_entry;
-		return rxm_cq_handle_data(rx_buf);
+		return rxm_cq_handle_data(rx_buf, NULL);
 	}
 
 	RXM_DBG_ADDR_TAG(FI_LOG_EP_DATA, "Enqueuing recv", recv_entry->addr,
 			 recv_entry->tag);
 
 	fastlock_acquire(&recv_queue->lock);
-	dlist_insert_tail(&recv_entry->entry, &recv_queue->recv_list);
+	rxm_recv_entry_insert(recv_queue, recv_entry);
 	fastlock_release(&recv_queue->lock);
 	return 0;
 }
 
+static int rxm_ep_recv_common(struct rxm_ep *rxm_ep, const struct iovec *iov,
+			      void **desc, size_t count, fi_addr_t src_addr,
+			      uint64_t tag, uint64_t ignore, void *context,
+			      uint64_t flags, struct rxm_recv_queue *recv_queue)
+{
+	return (int) ofi_ep_stat_rx(&rxm_ep->util_ep,
+			rxm_ep_post_recv(rxm_ep, iov, desc, count, src_addr,
+					 tag, ignore, context, flags,
+					 recv_queue));
+}
+
 static ssize_t rxm_ep_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 			       uint64_t flags)
 {
@@ -649,10 +755,21 @@ int rxm_ep_msg_mr_regv(struct rxm_ep *rxm_ep, const struct iovec *iov,
 
 	rxm_domain = container_of(rxm_ep->util_ep.domain, struct rxm_domain, util_domain);
 
-	// TODO do fi_mr_regv if provider supports it
+	/* A single registration covers the whole iov. Only mr[0] is set and
+	 * the remaining entries are cleared. */
+	if (count > 1 && rxm_ep->msg_info->domain_attr->mr_iov_limit >= count) {
+		ret = fi_mr_regv(rxm_domain->msg_domain, iov, count, access,
+				 0, 0, 0, &mr[0], NULL);
+		if (ret)
+			return ret;
+		for (i = 1; i < count; i++)
+			mr[i] = NULL;
+		return 0;
+	}
+
 	for (i = 0; i < count; i++) {
-		ret = fi_mr_reg(rxm_domain->msg_domain, iov->iov_base,
-				iov->iov_len, access, 0, 0, 0, &mr[i], NULL);
+		ret = fi_mr_reg(rxm_domain->msg_domain, iov[i].iov_base,
+				iov[i].iov_len, access, 0, 0, 0, &mr[i], NULL);
 		if (ret)
 			goto err;
 	}
@@ -662,6 +779,54 @@ err:
 	return ret;
 }
 
+int rxm_ep_msg_mr_cache_regv(struct rxm_ep *rxm_ep, const struct iovec *iov,
+			     size_t count, uint64_t access, struct fid_mr **mr)
+{
+	struct rxm_domain *rxm_domain;
+	struct ofi_mr_cache_entry *entry;
+	int ret;
+	size_t i;
+
+	rxm_domain = container_of(rxm_ep->util_ep.domain, struct rxm_domain, util_domain);
+
+	if (!rxm_domain->mr_cache_enabled)
+		return rxm_ep_msg_mr_regv(rxm_ep, iov, count, access, mr);
+
+	for (i = 0; i < count; i++) {
+		ret = ofi_mr_cache_search(&rxm_domain->mr_cache, &iov[i],
+					  access, &entry);
+		if (ret)
+			goto err;
+		mr[i] = *(struct fid_mr **)entry->data;
+	}
+	return 0;
+err:
+	rxm_ep_msg_mr_cache_closev(rxm_ep, mr, i);
+	return ret;
+}
+
+void rxm_ep_msg_mr_cache_closev(struct rxm_ep *rxm_ep, struct fid_mr **mr,
+				size_t count)
+{
+	struct rxm_domain *rxm_domain;
+	size_t i;
+
+	rxm_domain = container_of(rxm_ep->util_ep.domain, struct rxm_domain, util_domain);
+
+	if (!rxm_domain->mr_cache_enabled) {
+		rxm_ep_msg_mr_closev(mr, count);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (mr[i]) {
+			ofi_mr_cache_delete(&rxm_domain->mr_cache,
+					    mr[i]->fid.context);
+			mr[i] = NULL;
+		}
+	}
+}
+
 static ssize_t rxm_rma_iov_init(struct rxm_ep *rxm_ep, void *buf,
 				const struct iovec *iov, size_t count,
 				struct fid_mr **mr)
@@ -669,25 +834,211 @@ static ssize_t rxm_rma_iov_init(struct rxm_ep *rxm_ep, void *buf,
 	struct rxm_rma_iov *rma_iov = (struct rxm_rma_iov *)buf;
 	size_t i;
 
+	/* A region registered through fi_mr_regv is addressed as one
+	 * contiguous range starting at the first iov's address, or at
+	 * offset 0 without FI_MR_VIRT_ADDR, so a single entry describes
+	 * the whole iov. */
+	if (count > 1 && !mr[1]) {
+		rma_iov->iov[0].addr = RXM_MR_VIRT_ADDR(rxm_ep->msg_info) ?
+			(uintptr_t)iov[0].iov_base : 0;
+		rma_iov->iov[0].len = (uint64_t)ofi_total_iov_len(iov, count);
+		rma_iov->iov[0].key = fi_mr_key(mr[0]);
+		rma_iov->count = 1;
+		return sizeof(*rma_iov) + sizeof(*rma_iov->iov);
+	}
+
 	for (i = 0; i < count; i++) {
 		rma_iov->iov[i].addr = RXM_MR_VIRT_ADDR(rxm_ep->msg_info) ?
-			(uintptr_t)iov->iov_base : 0;
-		rma_iov->iov[i].len = (uint64_t)iov->iov_len;
+			(uintptr_t)iov[i].iov_base : 0;
+		rma_iov->iov[i].len = (uint64_t)iov[i].iov_len;
 		rma_iov->iov[i].key = fi_mr_key(mr[i]);
 	}
 	rma_iov->count = count;
 	return sizeof(*rma_iov) + sizeof(*rma_iov->iov) * count;
 }
 
+static void rxm_ep_sar_bufs_release(struct rxm_ep *rxm_ep,
+				   struct rxm_tx_buf **tx_buf, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		rxm_buf_release(&rxm_ep->tx_pool, (struct rxm_buf *)tx_buf[i]);
+}
+
+/* The first segment carries the total size, and is always a full one */
+static ssize_t rxm_ep_sar_post_seg(struct rxm_ep *rxm_ep,
+				   struct rxm_tx_buf *tx_buf)
+{
+	size_t len = tx_buf->pkt.ctrl_hdr.seg_no ? tx_buf->pkt.hdr.size :
+		     rxm_ep->rxm_info->tx_attr->inject_size;
+
+	return fi_send(tx_buf->hdr.msg_ep, &tx_buf->pkt,
+		       sizeof(struct rxm_pkt) + len, tx_buf->hdr.desc, 0,
+		       tx_buf);
+}
+
+/* Caller must hold rxm_ep->sar_lock */
+static void rxm_ep_sar_queue_segs(struct rxm_ep *rxm_ep,
+				  struct rxm_tx_buf **tx_buf, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		dlist_insert_tail(&tx_buf[i]->sar_entry, &rxm_ep->sar_tx_list);
+	ofi_atomic_add32(&rxm_ep->sar_tx_cnt, (int) count);
+}
+
+/*
+ * Post the SAR segments queued by rxm_ep_send_sar(), in order.  Segments
+ * of connections that have been closed, or that fail to post, are dropped
+ * and their send is completed in error.
+ */
+void rxm_ep_progress_sar_tx(struct rxm_ep *rxm_ep)
+{
+	struct rxm_tx_entry *tx_entry;
+	struct rxm_tx_buf *tx_buf;
+	ssize_t ret;
+
+	fastlock_acquire(&rxm_ep->sar_lock);
+	while (!dlist_empty(&rxm_ep->sar_tx_list)) {
+		tx_buf = container_of(rxm_ep->sar_tx_list.next,
+				      struct rxm_tx_buf, sar_entry);
+		if (tx_buf->hdr.msg_ep) {
+			ret = rxm_ep_sar_post_seg(rxm_ep, tx_buf);
+			if (ret == -FI_EAGAIN)
+				break;
+		} else {
+			ret = -FI_ECONNABORTED;
+		}
+
+		dlist_remove(&tx_buf->sar_entry);
+		ofi_atomic_dec32(&rxm_ep->sar_tx_cnt);
+		if (ret) {
+			FI_WARN(&rxm_prov, FI_LOG_EP_DATA, "Unable to post "
+				"SAR segment: %s\n", fi_strerror((int) -ret));
+			tx_entry = tx_buf->tx_entry;
+			rxm_ep_sar_bufs_release(rxm_ep, &tx_buf, 1);
+			rxm_sar_tx_drop(tx_entry, 1, (int) -ret);
+		}
+	}
+	fastlock_release(&rxm_ep->sar_lock);
+}
+
+/* Called before msg_ep is closed */
+void rxm_ep_abort_sar_tx(struct rxm_ep *rxm_ep, struct fid_ep *msg_ep)
+{
+	struct rxm_tx_buf *tx_buf;
+
+	fastlock_acquire(&rxm_ep->sar_lock);
+	dlist_foreach_container(&rxm_ep->sar_tx_list, struct rxm_tx_buf,
+				tx_buf, sar_entry) {
+		if (tx_buf->hdr.msg_ep == msg_ep)
+			tx_buf->hdr.msg_ep = NULL;
+	}
+	fastlock_release(&rxm_ep->sar_lock);
+}
+
+/*
+ * Send a message as a series of buffered segments. The first segment is a
+ * normal packet of type ofi_ctrl_start_data that is matched by the
+ * receiver. Later segments are ofi_ctrl_data packets with seg_no set,
+ * identified by conn_id and msg_id, and placed at seg_no times the payload
+ * size of the first segment. The caller's tx_entry and its tx_buf (which
+ * carries the first segment) are released here on failure.
+ *
+ * Once the first segment has been posted the send is accepted.  Segments
+ * the MSG EP has no room for are queued on sar_tx_list and posted from
+ * progress, behind any queued earlier.
+ */
+static ssize_t rxm_ep_send_sar(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
+			       struct rxm_tx_entry *tx_entry,
+			       const struct iovec *iov, size_t count)
+{
+	struct rxm_tx_buf *tx_buf[RXM_SAR_MAX_SEGS];
+	struct rxm_pkt *first = &tx_entry->tx_buf->pkt;
+	size_t seg_size = rxm_ep->rxm_info->tx_attr->inject_size;
+	size_t total = first->hdr.size;
+	size_t i, offset, len, seg_cnt;
+	ssize_t ret;
+
+	seg_cnt = (total + seg_size - 1) / seg_size;
+	assert(seg_cnt > 1 && seg_cnt <= RXM_SAR_MAX_SEGS);
+
+	tx_buf[0] = tx_entry->tx_buf;
+	for (i = 1; i < seg_cnt; i++) {
+		tx_buf[i] = (struct rxm_tx_buf *)rxm_buf_get(&rxm_ep->tx_pool);
+		if (!tx_buf[i]) {
+			FI_WARN(&rxm_prov, FI_LOG_EP_DATA, "TX queue full!\n");
+			ofi_ep_stat_inc(&rxm_ep->util_ep, buf_exhausted);
+			ret = -FI_EAGAIN;
+			goto err;
+		}
+		rxm_pkt_init(&tx_buf[i]->pkt);
+		tx_buf[i]->pkt.ctrl_hdr.type = ofi_ctrl_data;
+		tx_buf[i]->pkt.ctrl_hdr.conn_id = first->ctrl_hdr.conn_id;
+		tx_buf[i]->pkt.ctrl_hdr.msg_id = first->ctrl_hdr.msg_id;
+		tx_buf[i]->pkt.ctrl_hdr.seg_no = i;
+		tx_buf[i]->pkt.hdr.op = first->hdr.op;
+		tx_buf[i]->hdr.msg_ep = rxm_conn->msg_ep;
+	}
+	first->ctrl_hdr.type = ofi_ctrl_start_data;
+
+	for (i = 0, offset = 0; i < seg_cnt; i++, offset += len) {
+		len = MIN(seg_size, total - offset);
+		ofi_copy_from_iov(tx_buf[i]->pkt.data, len, iov, count, offset);
+		tx_buf[i]->pkt.hdr.size = (i == 0) ? total : len;
+		tx_buf[i]->hdr.state = RXM_SAR_TX;
+		tx_buf[i]->tx_entry = tx_entry;
+	}
+	RXM_LOG_STATE_TX(FI_LOG_EP_DATA, tx_entry, RXM_SAR_TX);
+	tx_entry->state = RXM_SAR_TX;
+	tx_entry->tx_buf = NULL;
+	tx_entry->sar_err = 0;
+	ofi_atomic_initialize32(&tx_entry->sar_segs, seg_cnt);
+
+	ret = rxm_ep_sar_post_seg(rxm_ep, tx_buf[0]);
+	if (ret) {
+		i = seg_cnt;
+		goto err;
+	}
+
+	fastlock_acquire(&rxm_ep->sar_lock);
+	for (i = 1; i < seg_cnt; i++) {
+		if (!dlist_empty(&rxm_ep->sar_tx_list))
+			break;
+		ret = rxm_ep_sar_post_seg(rxm_ep, tx_buf[i]);
+		if (ret == -FI_EAGAIN)
+			break;
+		if (ret) {
+			FI_WARN(&rxm_prov, FI_LOG_EP_DATA,
+				"fi_send for MSG provider failed after %zu "
+				"of %zu segments\n", i, seg_cnt);
+			rxm_ep_sar_bufs_release(rxm_ep, &tx_buf[i],
+						seg_cnt - i);
+			rxm_sar_tx_drop(tx_entry, seg_cnt - i, (int) -ret);
+			i = seg_cnt;
+			break;
+		}
+	}
+	if (i < seg_cnt)
+		rxm_ep_sar_queue_segs(rxm_ep, &tx_buf[i], seg_cnt - i);
+	fastlock_release(&rxm_ep->sar_lock);
+	return 0;
+err:
+	rxm_ep_sar_bufs_release(rxm_ep, tx_buf, i);
+	rxm_tx_entry_release(&rxm_ep->send_queue, tx_entry);
+	return ret;
+}
+
 // TODO handle all flags
 static ssize_t
-rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
-		   size_t count, fi_addr_t dest_addr, void *context,
-		   uint64_t data, uint64_t flags, uint64_t tag, int op,
-		   uint64_t comp_flags)
+rxm_ep_post_send(struct rxm_ep *rxm_ep, const struct iovec *iov, void **desc,
+		 size_t count, fi_addr_t dest_addr, void *context,
+		 uint64_t data, uint64_t flags, uint64_t tag, int op,
+		 uint64_t comp_flags)
 {
-	struct util_cmap_handle *handle;
-	struct rxm_ep *rxm_ep;
+	struct util_cmap_handle *handle = NULL;
 	struct rxm_conn *rxm_conn;
 	struct rxm_tx_entry *tx_entry;
 	struct rxm_tx_buf *tx_buf;
@@ -695,19 +1046,29 @@ rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 	struct fid_mr **mr_iov;
 	size_t pkt_size = 0;
 	ssize_t size;
-	uint8_t progress = 0;
+	uint8_t progress = 0, defer = 0;
 	int ret;
 
-	rxm_ep = container_of(ep_fid, struct rxm_ep, util_ep.ep_fid.fid);
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_ep->deferred_tx_cnt)))
+		rxm_ep_progress_deferred_tx(rxm_ep);
 
 	ret = ofi_cmap_get_handle(rxm_ep->util_ep.cmap, dest_addr, &handle);
-	if (ret)
-		return ret;
+	if (OFI_UNLIKELY(ret)) {
+		/* The connection is being established. The send is queued
+		 * on it instead of having the application retry. */
+		if (ret != -FI_EAGAIN || !handle)
+			return ret;
+		defer = 1;
+	}
 	rxm_conn = container_of(handle, struct rxm_conn, handle);
+	/* Earlier sends are still queued */
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_conn->tx_deferred)))
+		defer = 1;
 
 	tx_buf = (struct rxm_tx_buf *)rxm_buf_get(&rxm_ep->tx_pool);
 	if (!tx_buf) {
 		FI_WARN(&rxm_prov, FI_LOG_EP_DATA, "TX queue full!\n");
+		ofi_ep_stat_inc(&rxm_ep->util_ep, buf_exhausted);
 		return -FI_EAGAIN;
 	}
 
@@ -747,11 +1108,25 @@ rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 						   rxm_txe_fs_index(rxm_ep->send_queue.fs,
 								    tx_entry));
 		fastlock_release(&rxm_ep->send_queue.lock);
+
+		if (pkt->hdr.size <= MIN(rxm_sar_limit, RXM_SAR_MAX_SEGS *
+				rxm_ep->rxm_info->tx_attr->inject_size)) {
+			/* Segmented sends are not queued */
+			if (defer) {
+				ret = -FI_EAGAIN;
+				goto done;
+			}
+			return rxm_ep_send_sar(rxm_ep, rxm_conn, tx_entry,
+					       iov, count);
+		}
+
 		pkt->ctrl_hdr.type = ofi_ctrl_large_data;
 
 		if (!OFI_CHECK_MR_LOCAL(rxm_ep->rxm_info)) {
-			ret = rxm_ep_msg_mr_regv(rxm_ep, iov, tx_entry->count,
-						 FI_REMOTE_READ, tx_entry->mr);
+			ret = rxm_ep_msg_mr_cache_regv(rxm_ep, iov,
+						       tx_entry->count,
+						       FI_REMOTE_READ,
+						       tx_entry->mr);
 			if (ret)
 				goto done;
 			mr_iov = tx_entry->mr;
@@ -769,6 +1144,7 @@ rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 		pkt_size = sizeof(*pkt) + size;
 		RXM_LOG_STATE_TX(FI_LOG_EP_DATA, tx_entry, RXM_LMT_TX);
 		tx_entry->state = RXM_LMT_TX;
+		ofi_ep_stat_inc(&rxm_ep->util_ep, rndv);
 	} else {
 		pkt->ctrl_hdr.type = ofi_ctrl_data;
 		ofi_copy_from_iov(pkt->data, pkt->hdr.size, iov, count, 0);
@@ -776,6 +1152,18 @@ rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 		tx_entry->state = RXM_TX;
 	}
 
+	if (OFI_UNLIKELY(defer)) {
+		tx_entry->pkt_size = pkt_size;
+		ret = rxm_conn_defer_tx(rxm_conn, tx_entry);
+		if (!ret)
+			return 0;
+		if (ret != -FI_EALREADY)
+			goto done;
+		/* Connected meanwhile, possibly on a different MSG EP */
+		tx_buf->hdr.msg_ep = rxm_conn->msg_ep;
+		pkt->ctrl_hdr.conn_id = rxm_conn->handle.remote_key;
+	}
+
 	if ((flags & FI_INJECT) && !(flags & FI_COMPLETION)) {
 		if (pkt_size <= rxm_ep->msg_info->tx_attr->inject_size) {
 			if (tx_entry->state == RXM_LMT_TX) {
@@ -815,6 +1203,21 @@ done:
 	return ret;
 }
 
+static ssize_t
+rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+		   size_t count, fi_addr_t dest_addr, void *context,
+		   uint64_t data, uint64_t flags, uint64_t tag, int op,
+		   uint64_t comp_flags)
+{
+	struct rxm_ep *rxm_ep = container_of(ep_fid, struct rxm_ep,
+					     util_ep.ep_fid.fid);
+
+	return ofi_ep_stat_tx(&rxm_ep->util_ep,
+			rxm_ep_post_send(rxm_ep, iov, desc, count, dest_addr,
+					 context, data, flags, tag, op,
+					 comp_flags));
+}
+
 #define rxm_ep_tx_flags_inject(ep_fid) \
 	((rxm_ep_tx_flags(ep_fid) & ~FI_COMPLETION) | FI_INJECT)
 
@@ -1088,8 +1491,10 @@ static int rxm_ep_close(struct fid *fid)
 			retv = ret;
 	}
 
-	if (rxm_ep->util_ep.cmap)
+	if (rxm_ep->util_ep.cmap) {
 		ofi_cmap_free(rxm_ep->util_ep.cmap);
+		rxm_ep_fail_deferred_tx(rxm_ep);
+	}
 
 	ret = rxm_listener_close(rxm_ep);
 	if (ret)
@@ -1151,6 +1556,7 @@ static int rxm_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
 		attr.connect 		= rxm_conn_connect;
 		attr.event_handler	= rxm_conn_event_handler;
 		attr.signal		= rxm_conn_signal;
+		attr.eager_max		= rxm_eager_connect;
 
 		rxm_ep->util_ep.cmap = ofi_cmap_alloc(&rxm_ep->util_ep, &attr);
 		free(name);
@@ -1210,6 +1616,10 @@ static int rxm_ep_ctrl(struct fid *fid, int command, void *arg)
 				return ret;
 			}
 		}
+
+		ret = ofi_cmap_connect_av(rxm_ep->util_ep.cmap);
+		if (ret)
+			return ret;
 		break;
 	default:
 		return -FI_ENOSYS;
@@ -129,16 +129,77 @@ static int rxm_init_info(void)
 
 	if (!fi_param_get_int(&rxm_prov, "buffer_size", &param)) {
 		if (param > sizeof(struct rxm_pkt)) {
-			rxm_info.tx_attr->inject_size = param;
+			rxm_buffer_size = param;
 		} else {
 			FI_WARN(&rxm_prov, FI_LOG_CORE,
 				"Requested buffer size too small\n");
 			return -FI_EINVAL;
 		}
-	} else {
-		rxm_info.tx_attr->inject_size = RXM_BUF_SIZE;
 	}
-	rxm_info.tx_attr->inject_size -= sizeof(struct rxm_pkt);
+	rxm_info.tx_attr->inject_size = rxm_buffer_size - sizeof(struct rxm_pkt);
+
+	if (!fi_param_get_int(&rxm_prov, "sar_limit", &param)) {
+		if (param >= 0)
+			rxm_sar_limit = param;
+		else
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid SAR limit, using default\n");
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "mr_cache_max_count", &param)) {
+		if (param >= 0)
+			rxm_mr_cache_max_cnt = param;
+		else
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid MR cache count, using default\n");
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "mr_cache_max_size", &param)) {
+		if (param > 0)
+			rxm_mr_cache_max_size = param;
+		else
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid MR cache size, using default\n");
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "lmt_chunk_size", &param)) {
+		if (param >= 0)
+			rxm_lmt_chunk_size = param;
+		else
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid large message chunk size, using "
+				"default\n");
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "lmt_max_reads", &param)) {
+		if (param > 0)
+			rxm_lmt_max_reads = MIN(param, RXM_LMT_MAX_READS);
+		else
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid large message read count, using "
+				"default\n");
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "eager_connect", &param)) {
+		if (param >= 0)
+			rxm_eager_connect = param;
+		else
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid eager connection count, connecting "
+				"on first use\n");
+	}
+
+	fi_param_get_bool(&rxm_prov, "use_hugepages", &rxm_use_hugepages);
+
+	if (!fi_param_get_int(&rxm_prov, "numa_node", &param)) {
+		if (param >= 0)
+			rxm_numa_node = param;
+		else
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid NUMA node, buffers will not be "
+				"bound\n");
+	}
+
 	rxm_util_prov.info = &rxm_info;
 	return 0;
 }
@@ -191,6 +252,16 @@ static void rxm_fini(void)
 	/* yawn */
 }
 
+size_t rxm_mr_cache_max_cnt;
+size_t rxm_mr_cache_max_size = RXM_MR_CACHE_MAX_SIZE;
+size_t rxm_lmt_chunk_size = RXM_LMT_CHUNK_SIZE;
+size_t rxm_lmt_max_reads = RXM_LMT_READS;
+size_t rxm_buffer_size = RXM_BUF_SIZE;
+size_t rxm_sar_limit = RXM_SAR_LIMIT;
+size_t rxm_eager_connect;
+int rxm_use_hugepages;
+int rxm_numa_node = -1;
+
 struct fi_provider rxm_prov = {
 	.name = OFI_UTIL_PREFIX "rxm",
 	.version = FI_VERSION(RXM_MAJOR_VERSION, RXM_MINOR_VERSION),
@@ -206,6 +277,39 @@ RXM_INI
 			"Defines the transmit buffer size. Transmit data would "
 			"be copied upto this size (default: ~16k). This would "
 			"also affect the supported inject size");
+	fi_param_define(&rxm_prov, "sar_limit", FI_PARAM_INT,
+			"Messages larger than the inject size and up to this "
+			"size are sent as a series of buffered segments "
+			"instead of using the rendezvous protocol "
+			"(default: 256 KiB). Set to 0 to disable");
+	fi_param_define(&rxm_prov, "mr_cache_max_count", FI_PARAM_INT,
+			"Maximum number of memory registrations kept cached "
+			"for large message transfers (default: 0, cache "
+			"disabled). The cache does not detect freed or "
+			"remapped buffers; only enable it if buffers used "
+			"for large transfers stay mapped until the domain "
+			"is closed");
+	fi_param_define(&rxm_prov, "mr_cache_max_size", FI_PARAM_INT,
+			"Maximum number of bytes kept registered by the MR "
+			"cache (default: 1 GiB)");
+	fi_param_define(&rxm_prov, "lmt_chunk_size", FI_PARAM_INT,
+			"Size of the chunks a large message is read in by the "
+			"receiver (default: 1 MiB). 0 reads each registered "
+			"region of the sender in one operation");
+	fi_param_define(&rxm_prov, "lmt_max_reads", FI_PARAM_INT,
+			"Maximum number of chunk reads outstanding per large "
+			"message (default: 4, max: 8)");
+	fi_param_define(&rxm_prov, "eager_connect", FI_PARAM_INT,
+			"Connect in the background to addresses inserted into "
+			"the AV, with at most this many connection requests "
+			"in flight (default: 0, connect on first use)");
+	fi_param_define(&rxm_prov, "use_hugepages", FI_PARAM_BOOL,
+			"Back transmit and receive buffers with huge pages "
+			"when available (default: no)");
+	fi_param_define(&rxm_prov, "numa_node", FI_PARAM_INT,
+			"NUMA node to allocate transmit and receive buffers "
+			"on, usually the one closest to the NIC (default: "
+			"not bound)");
 
 	if (rxm_init_info()) {
 		FI_WARN(&rxm_prov, FI_LOG_CORE, "Unable to initialize rxm_info\n");
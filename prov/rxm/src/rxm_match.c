@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <inttypes.h>
+
+#include "rxm.h"
+
+static inline struct dlist_entry *
+rxm_match_bucket(struct dlist_entry *hash, size_t mask, fi_addr_t addr,
+		 uint64_t tag)
+{
+	uint64_t key = tag ^ (addr * 0x9e3779b97f4a7c15ULL);
+
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return &hash[key & mask];
+}
+
+static struct dlist_entry *rxm_match_hash_alloc(size_t size)
+{
+	struct dlist_entry *hash;
+	size_t i;
+
+	hash = calloc(size, sizeof(*hash));
+	if (!hash)
+		return NULL;
+
+	for (i = 0; i < size; i++)
+		dlist_init(&hash[i]);
+	return hash;
+}
+
+int rxm_recv_match_init(struct rxm_recv_queue *recv_queue, size_t size)
+{
+	size = roundup_power_of_two(MAX(size, 1));
+
+	recv_queue->recv_hash = rxm_match_hash_alloc(size);
+	if (!recv_queue->recv_hash)
+		return -FI_ENOMEM;
+
+	recv_queue->unexp_hash = rxm_match_hash_alloc(size);
+	if (!recv_queue->unexp_hash) {
+		free(recv_queue->recv_hash);
+		recv_queue->recv_hash = NULL;
+		return -FI_ENOMEM;
+	}
+
+	recv_queue->hash_mask = size - 1;
+	recv_queue->seq = 0;
+	dlist_init(&recv_queue->recv_list);
+	dlist_init(&recv_queue->unexp_msg_list);
+	return 0;
+}
+
+void rxm_recv_match_close(struct rxm_recv_queue *recv_queue)
+{
+	free(recv_queue->recv_hash);
+	free(recv_queue->unexp_hash);
+	recv_queue->recv_hash = NULL;
+	recv_queue->unexp_hash = NULL;
+}
+
+void rxm_recv_entry_insert(struct rxm_recv_queue *recv_queue,
+			   struct rxm_recv_entry *recv_entry)
+{
+	struct dlist_entry *head;
+
+	recv_entry->seq = recv_queue->seq++;
+	if (recv_entry->ignore)
+		head = &recv_queue->recv_list;
+	else
+		head = rxm_match_bucket(recv_queue->recv_hash,
+					recv_queue->hash_mask,
+					recv_entry->addr, recv_entry->tag);
+	dlist_insert_tail(&recv_entry->entry, head);
+}
+
+static struct rxm_recv_entry *
+rxm_recv_bucket_find(struct rxm_recv_queue *recv_queue, fi_addr_t addr,
+		     uint64_t tag)
+{
+	struct dlist_entry *bucket, *item;
+	struct rxm_recv_entry *recv_entry;
+
+	bucket = rxm_match_bucket(recv_queue->recv_hash, recv_queue->hash_mask,
+				  addr, tag);
+	dlist_foreach(bucket, item) {
+		recv_entry = container_of(item, struct rxm_recv_entry, entry);
+		if (recv_entry->addr == addr && recv_entry->tag == tag)
+			return recv_entry;
+	}
+	return NULL;
+}
+
+static inline struct rxm_recv_entry *
+rxm_recv_entry_older(struct rxm_recv_entry *a, struct rxm_recv_entry *b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	return (a->seq < b->seq) ? a : b;
+}
+
+/*
+ * A hashed receive matches only if its (addr, tag) is exactly that of the
+ * message, or it was posted with FI_ADDR_UNSPEC and the same tag. Anything
+ * else that could match has ignore bits set and lives on recv_list.
+ */
+struct rxm_recv_entry *
+rxm_recv_entry_match(struct rxm_recv_queue *recv_queue,
+		     struct rxm_recv_match_attr *attr)
+{
+	struct rxm_recv_entry *recv_entry, *match;
+	struct dlist_entry *entry;
+
+	match = rxm_recv_bucket_find(recv_queue, attr->addr, attr->tag);
+	if (attr->addr != FI_ADDR_UNSPEC) {
+		recv_entry = rxm_recv_bucket_find(recv_queue, FI_ADDR_UNSPEC,
+						  attr->tag);
+		match = rxm_recv_entry_older(match, recv_entry);
+	}
+
+	if (!dlist_empty(&recv_queue->recv_list)) {
+		entry = dlist_find_first_match(&recv_queue->recv_list,
+					       recv_queue->match_recv, attr);
+		if (entry) {
+			recv_entry = container_of(entry, struct rxm_recv_entry,
+						  entry);
+			match = rxm_recv_entry_older(match, recv_entry);
+		}
+	}
+
+	if (match)
+		dlist_remove(&match->entry);
+	return match;
+}
+
+static struct rxm_recv_entry *
+rxm_recv_list_find_context(struct dlist_entry *head, void *context)
+{
+	struct rxm_recv_entry *recv_entry;
+
+	dlist_foreach_container(head, struct rxm_recv_entry, recv_entry, entry) {
+		if (recv_entry->context == context)
+			return recv_entry;
+	}
+	return NULL;
+}
+
+/* Cancel is rare, so walking every bucket is acceptable here */
+struct rxm_recv_entry *
+rxm_recv_entry_remove_context(struct rxm_recv_queue *recv_queue, void *context)
+{
+	struct rxm_recv_entry *recv_entry, *match = NULL;
+	size_t i;
+
+	for (i = 0; i <= recv_queue->hash_mask; i++) {
+		recv_entry = rxm_recv_list_find_context(&recv_queue->recv_hash[i],
+							context);
+		match = rxm_recv_entry_older(match, recv_entry);
+	}
+	recv_entry = rxm_recv_list_find_context(&recv_queue->recv_list, context);
+	match = rxm_recv_entry_older(match, recv_entry);
+
+	if (match)
+		dlist_remove(&match->entry);
+	return match;
+}
+
+void rxm_unexp_msg_insert(struct rxm_recv_queue *recv_queue,
+			  struct rxm_unexp_msg *unexp_msg)
+{
+	dlist_insert_tail(&unexp_msg->entry, &recv_queue->unexp_msg_list);
+	dlist_insert_tail(&unexp_msg->hash_entry,
+			  rxm_match_bucket(recv_queue->unexp_hash,
+					   recv_queue->hash_mask,
+					   unexp_msg->addr, unexp_msg->tag));
+}
+
+/*
+ * All messages that can match a receive with no ignore bits share its
+ * (addr, tag) bucket, provided the receive names a source or messages
+ * carry no source. Otherwise fall back to the arrival ordered list.
+ */
+struct rxm_unexp_msg *
+rxm_unexp_msg_match(struct rxm_recv_queue *recv_queue,
+		    struct rxm_recv_match_attr *attr)
+{
+	struct rxm_unexp_msg *unexp_msg;
+	struct dlist_entry *bucket, *entry;
+
+	if (dlist_empty(&recv_queue->unexp_msg_list))
+		return NULL;
+
+	if (!attr->ignore && (attr->addr != FI_ADDR_UNSPEC ||
+			      !recv_queue->msg_src)) {
+		bucket = rxm_match_bucket(recv_queue->unexp_hash,
+					  recv_queue->hash_mask,
+					  attr->addr, attr->tag);
+		dlist_foreach_container(bucket, struct rxm_unexp_msg,
+					unexp_msg, hash_entry) {
+			if (unexp_msg->addr == attr->addr &&
+			    unexp_msg->tag == attr->tag)
+				return unexp_msg;
+		}
+		return NULL;
+	}
+
+	entry = dlist_find_first_match(&recv_queue->unexp_msg_list,
+				       recv_queue->match_unexp, attr);
+	if (!entry)
+		return NULL;
+	return container_of(entry, struct rxm_unexp_msg, entry);
+}
@@ -43,9 +43,12 @@ static int rxm_ep_rma_common(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
 	struct rxm_domain *rxm_domain;
 	struct rxm_tx_entry *tx_entry;
 	struct fi_msg_rma msg_rma;
+	void *desc[RXM_IOV_LIMIT];
 	size_t i;
 	int ret;
 
+	assert(msg->iov_count <= RXM_IOV_LIMIT);
+
 	if (!(tx_entry = rxm_tx_entry_get(&rxm_ep->send_queue)))
 		return -FI_EAGAIN;
 
@@ -67,10 +70,15 @@ static int rxm_ep_rma_common(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
 					 tx_entry->mr);
 		if (ret)
 			goto err;
-		msg_rma.desc = (void **)tx_entry->mr;
+		/* A vectored registration only sets mr[0] */
+		for (i = 0; i < msg_rma.iov_count; i++)
+			desc[i] = fi_mr_desc(tx_entry->mr[i] ? tx_entry->mr[i] :
+					     tx_entry->mr[0]);
+	} else {
+		for (i = 0; i < msg_rma.iov_count; i++)
+			desc[i] = fi_mr_desc(msg->desc[i]);
 	}
-	for (i = 0; i < msg_rma.iov_count; i++)
-		msg_rma.desc[i] = fi_mr_desc(msg_rma.desc[i]);
+	msg_rma.desc = desc;
 
 	return rma_msg(msg_ep, &msg_rma, flags);
 err:
@@ -92,6 +100,9 @@ ssize_t	rxm_ep_readmsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
 	if (ret)
 		return ret;
 	rxm_conn = container_of(handle, struct rxm_conn, handle);
+	/* Keep RMA ordered after sends queued during connection setup */
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_conn->tx_deferred)))
+		return -FI_EAGAIN;
 
 	return rxm_ep_rma_common(rxm_conn->msg_ep, rxm_ep, msg, flags,
 				 fi_readmsg, FI_READ);
@@ -243,6 +254,9 @@ ssize_t	rxm_ep_writemsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
 	if (ret)
 		return ret;
 	rxm_conn = container_of(handle, struct rxm_conn, handle);
+	/* Keep RMA ordered after sends queued during connection setup */
+	if (OFI_UNLIKELY(ofi_atomic_get32(&rxm_conn->tx_deferred)))
+		return -FI_EAGAIN;
 
 	if (flags & FI_INJECT)
 		return rxm_ep_rma_inject(rxm_conn->msg_ep, rxm_ep, msg, flags);
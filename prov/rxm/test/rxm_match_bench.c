@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the cost of matching an incoming message against the posted
+ * receive queue, and a posted receive against the unexpected queue, as the
+ * queue depth grows.  Each depth is timed both with the hashed matcher in
+ * rxm_match.c and with a single arrival ordered list scanned the way rxm
+ * matched before.  Messages are matched newest first, which is the worst
+ * case for the list.  Every match is checked, so this also serves as a
+ * sanity test of the matcher.
+ */
+
+#include <inttypes.h>
+#include <time.h>
+
+#include "../src/rxm.h"
+
+#define BENCH_PEERS	8
+#define BENCH_OPS	(1 << 17)
+
+static uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_match_recv(struct dlist_entry *item, const void *arg)
+{
+	const struct rxm_recv_match_attr *attr = arg;
+	struct rxm_recv_entry *recv_entry;
+
+	recv_entry = container_of(item, struct rxm_recv_entry, entry);
+	return rxm_match_addr(recv_entry->addr, attr->addr) &&
+		rxm_match_tag(recv_entry->tag, recv_entry->ignore, attr->tag);
+}
+
+static int bench_match_unexp(struct dlist_entry *item, const void *arg)
+{
+	const struct rxm_recv_match_attr *attr = arg;
+	struct rxm_unexp_msg *unexp_msg;
+
+	unexp_msg = container_of(item, struct rxm_unexp_msg, entry);
+	return rxm_match_addr(attr->addr, unexp_msg->addr) &&
+		rxm_match_tag(attr->tag, attr->ignore, unexp_msg->tag);
+}
+
+static void bench_attr(struct rxm_recv_match_attr *attr, size_t i)
+{
+	attr->addr = i % BENCH_PEERS;
+	attr->tag = i;
+	attr->ignore = 0;
+}
+
+static uint64_t bench_recv(struct rxm_recv_queue *recv_queue,
+			   struct rxm_recv_entry *entries, size_t depth,
+			   int hashed)
+{
+	struct rxm_recv_match_attr attr;
+	struct rxm_recv_entry *match;
+	struct dlist_entry *item;
+	uint64_t start;
+	size_t i, ops = 0;
+
+	start = bench_now_ns();
+	while (ops < BENCH_OPS) {
+		for (i = 0; i < depth; i++) {
+			bench_attr(&attr, i);
+			entries[i].addr = attr.addr;
+			entries[i].tag = attr.tag;
+			entries[i].ignore = 0;
+			if (hashed)
+				rxm_recv_entry_insert(recv_queue, &entries[i]);
+			else
+				dlist_insert_tail(&entries[i].entry,
+						  &recv_queue->recv_list);
+		}
+
+		for (i = depth; i-- > 0; ops++) {
+			bench_attr(&attr, i);
+			if (hashed) {
+				match = rxm_recv_entry_match(recv_queue, &attr);
+			} else {
+				item = dlist_remove_first_match(&recv_queue->recv_list,
+								bench_match_recv,
+								&attr);
+				match = item ? container_of(item,
+						struct rxm_recv_entry, entry) : NULL;
+			}
+			if (match != &entries[i]) {
+				fprintf(stderr, "recv depth %zu: wrong match "
+					"for tag %" PRIu64 "\n", depth, attr.tag);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	return (bench_now_ns() - start) / ops;
+}
+
+static uint64_t bench_unexp(struct rxm_recv_queue *recv_queue,
+			    struct rxm_unexp_msg *msgs, size_t depth,
+			    int hashed)
+{
+	struct rxm_recv_match_attr attr;
+	struct rxm_unexp_msg *match;
+	struct dlist_entry *item;
+	uint64_t start;
+	size_t i, ops = 0;
+
+	start = bench_now_ns();
+	while (ops < BENCH_OPS) {
+		for (i = 0; i < depth; i++) {
+			bench_attr(&attr, i);
+			msgs[i].addr = attr.addr;
+			msgs[i].tag = attr.tag;
+			if (hashed)
+				rxm_unexp_msg_insert(recv_queue, &msgs[i]);
+			else
+				dlist_insert_tail(&msgs[i].entry,
+						  &recv_queue->unexp_msg_list);
+		}
+
+		for (i = depth; i-- > 0; ops++) {
+			bench_attr(&attr, i);
+			if (hashed) {
+				match = rxm_unexp_msg_match(recv_queue, &attr);
+				if (match)
+					rxm_unexp_msg_remove(match);
+			} else {
+				item = dlist_remove_first_match(&recv_queue->unexp_msg_list,
+								bench_match_unexp,
+								&attr);
+				match = item ? container_of(item,
+						struct rxm_unexp_msg, entry) : NULL;
+			}
+			if (match != &msgs[i]) {
+				fprintf(stderr, "unexp depth %zu: wrong match "
+					"for tag %" PRIu64 "\n", depth, attr.tag);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	return (bench_now_ns() - start) / ops;
+}
+
+int main(int argc, char **argv)
+{
+	struct rxm_recv_queue recv_queue = {
+		.msg_src = 1,
+		.match_recv = bench_match_recv,
+		.match_unexp = bench_match_unexp,
+	};
+	struct rxm_recv_entry *entries;
+	struct rxm_unexp_msg *msgs;
+	size_t depth, max_depth = 1024;
+	uint64_t recv_list, recv_hash, unexp_list, unexp_hash;
+
+	if (argc > 1)
+		max_depth = strtoul(argv[1], NULL, 0);
+
+	entries = calloc(max_depth, sizeof(*entries));
+	msgs = calloc(max_depth, sizeof(*msgs));
+	if (!entries || !msgs) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%8s %16s %16s %16s %16s\n", "depth", "recv list ns",
+	       "recv hash ns", "unexp list ns", "unexp hash ns");
+	for (depth = 1; depth <= max_depth; depth *= 4) {
+		if (rxm_recv_match_init(&recv_queue, depth)) {
+			fprintf(stderr, "out of memory\n");
+			return EXIT_FAILURE;
+		}
+
+		recv_list = bench_recv(&recv_queue, entries, depth, 0);
+		recv_hash = bench_recv(&recv_queue, entries, depth, 1);
+		unexp_list = bench_unexp(&recv_queue, msgs, depth, 0);
+		unexp_hash = bench_unexp(&recv_queue, msgs, depth, 1);
+		printf("%8zu %16" PRIu64 " %16" PRIu64 " %16" PRIu64
+		       " %16" PRIu64 "\n", depth, recv_list, recv_hash,
+		       unexp_list, unexp_hash);
+
+		rxm_recv_match_close(&recv_queue);
+	}
+
+	free(entries);
+	free(msgs);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <rdma/fabric.h>
+#include <rdma/fi_cm.h>
+#include <rdma/fi_domain.h>
+#include <rdma/fi_endpoint.h>
+#include <rdma/fi_eq.h>
+#include <rdma/fi_errno.h>
+#include <rdma/fi_tagged.h>
+
+#include <fi.h>
+#include <fi_enosys.h>
+#include <fi_iov.h>
+#include <fi_list.h>
+#include <fi_mem.h>
+#include <fi_proto.h>
+#include <fi_rbuf.h>
+#include <fi_util.h>
+
+#ifndef _SMR_H_
+#define _SMR_H_
+
+#define SMR_MAJOR_VERSION	1
+#define SMR_MINOR_VERSION	0
+
+extern struct fi_provider smr_prov;
+extern struct util_prov smr_util_prov;
+extern struct fi_info smr_info;
+
+#define SMR_NAME_MAX		64
+#define SMR_MAX_PEERS		64
+#define SMR_CMD_QUEUE_SIZE	64
+#define SMR_MAX_RESP		64
+#define SMR_IOV_LIMIT		4
+#define SMR_CMD_SIZE		256
+
+/*
+ * Shared memory layout
+ *
+ * Every endpoint owns a region named after its address.  The region holds
+ * one command queue per sending peer.  A sender claims a queue in the
+ * receiver's region the first time it sends to it, and is then the only
+ * producer for that queue while the receiving endpoint is its only
+ * consumer, so the queues are accessed without locks.
+ *
+ * Messages up to SMR_MSG_DATA_LEN bytes are copied inline into the
+ * command.  Larger messages carry the sender's iovecs instead, and the
+ * receiver copies the data directly out of the sender's address space
+ * with process_vm_readv.  The receiver then stores the result in a
+ * response slot of the sender's region, which completes the send.  If the
+ * receiver is not permitted to read the sender's memory, it responds with
+ * SMR_STATUS_BOUNCE instead, and the sender copies the message through the
+ * command queue in inline segments tagged with the same response slot.
+ *
+ * A sender gives up its queue by marking it released.  The receiver keeps
+ * reading commands from a released queue and frees it once it is empty.
+ */
+enum {
+	smr_src_inline,
+	smr_src_iov,
+	smr_src_seg,
+};
+
+struct smr_msg_hdr {
+	uint32_t		op;
+	uint16_t		op_src;
+	uint16_t		op_flags;
+	uint64_t		tag;
+	uint64_t		data;
+	uint64_t		size;
+	int32_t			src_pid;
+	uint32_t		resp_id;
+	uint32_t		iov_count;
+	uint32_t		resv;
+};
+
+#define SMR_MSG_DATA_LEN	(SMR_CMD_SIZE - sizeof(struct smr_msg_hdr))
+
+struct smr_cmd {
+	struct smr_msg_hdr	hdr;
+	union {
+		uint8_t		msg[SMR_MSG_DATA_LEN];
+		struct iovec	iov[SMR_IOV_LIMIT];
+	} data;
+};
+
+OFI_DECLARE_CIRQUE(struct smr_cmd, smr_cmd_queue);
+
+enum {
+	SMR_PEER_FREE,
+	SMR_PEER_CLAIMED,
+	SMR_PEER_ACTIVE,
+	SMR_PEER_RELEASED,
+};
+
+struct smr_peer_info {
+	int32_t			state;
+	char			name[SMR_NAME_MAX];
+};
+
+#define SMR_STATUS_PENDING	UINT64_MAX
+#define SMR_STATUS_BOUNCE	(UINT64_MAX - 1)
+
+struct smr_resp {
+	uint64_t		status;
+};
+
+#define SMR_VERSION		1
+
+struct smr_region {
+	uint8_t			version;
+	uint8_t			resv[3];
+	int32_t			pid;
+	size_t			total_size;
+	struct smr_peer_info	peer_info[SMR_MAX_PEERS];
+	struct smr_resp		resp[SMR_MAX_RESP];
+	/* SMR_MAX_PEERS command queues follow */
+};
+
+#define SMR_CMD_QUEUE_BYTES	(sizeof(struct smr_cmd_queue) + \
+				 SMR_CMD_QUEUE_SIZE * sizeof(struct smr_cmd))
+#define SMR_REGION_SIZE		(sizeof(struct smr_region) + \
+				 SMR_MAX_PEERS * SMR_CMD_QUEUE_BYTES)
+
+static inline struct smr_cmd_queue *smr_cmd_queue(struct smr_region *smr,
+						  int id)
+{
+	return (struct smr_cmd_queue *) ((char *) (smr + 1) +
+					 id * SMR_CMD_QUEUE_BYTES);
+}
+
+void smr_region_init(struct smr_region *smr);
+int smr_peer_claim(struct smr_region *peer_smr, const char *name);
+void smr_peer_release(struct smr_region *peer_smr, int id);
+
+extern int smr_ptracer_any;
+
+int smr_fabric(struct fi_fabric_attr *attr, struct fid_fabric **fabric,
+		void *context);
+int smr_domain_open(struct fid_fabric *fabric, struct fi_info *info,
+		struct fid_domain **dom, void *context);
+int smr_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
+		struct fid_cq **cq, void *context);
+
+
+struct smr_av_peer {
+	struct util_shm		shm;
+	struct smr_region	*region;
+};
+
+struct smr_av {
+	struct util_av		util_av;
+	struct smr_av_peer	peers[SMR_MAX_PEERS];
+};
+
+int smr_av_open(struct fid_domain *domain, struct fi_av_attr *attr,
+		struct fid_av **av, void *context);
+
+
+struct smr_rx_entry {
+	struct dlist_entry	entry;
+	void			*context;
+	uint64_t		flags;
+	uint64_t		tag;
+	uint64_t		ignore;
+	struct iovec		iov[SMR_IOV_LIMIT];
+	size_t			iov_count;
+
+	/* Message being copied in through bounce segments */
+	int			peer_id;
+	size_t			offset;
+	struct smr_msg_hdr	hdr;
+};
+
+/* Command received before a matching buffer was posted */
+struct smr_unexp_msg {
+	struct dlist_entry	entry;
+	int			peer_id;
+	char			name[SMR_NAME_MAX];
+	struct smr_cmd		cmd;
+};
+
+/* Send waiting for the receiver to copy its data */
+struct smr_pend_entry {
+	struct dlist_entry	entry;
+	void			*context;
+	uint64_t		flags;
+	uint32_t		op;
+	uint32_t		resp_id;
+
+	/* Used to send the message through the queue if it bounces */
+	fi_addr_t		addr;
+	int			id;
+	struct iovec		iov[SMR_IOV_LIMIT];
+	size_t			iov_count;
+	size_t			size;
+	size_t			offset;
+};
+
+/* Sender mapped by the receiver to post responses */
+struct smr_rx_peer {
+	struct util_shm		shm;
+	struct smr_region	*region;
+	char			name[SMR_NAME_MAX];
+};
+
+struct smr_ep {
+	struct util_ep		util_ep;
+	struct util_shm		shm;
+	struct smr_region	*region;
+	char			name[SMR_NAME_MAX];
+	int			tx_id[SMR_MAX_PEERS];
+
+	struct smr_rx_peer	rx_peer[SMR_MAX_PEERS];
+	struct dlist_entry	recv_queue;
+	struct dlist_entry	trecv_queue;
+	struct dlist_entry	unexp_queue;
+	struct dlist_entry	tunexp_queue;
+	struct dlist_entry	bounce_queue;
+	struct util_buf_pool	*rx_entry_pool;
+	struct util_buf_pool	*unexp_pool;
+
+	struct smr_pend_entry	pend[SMR_MAX_RESP];
+	uint32_t		pend_free[SMR_MAX_RESP];
+	size_t			pend_free_cnt;
+	struct dlist_entry	pend_queue;
+};
+
+int smr_endpoint(struct fid_domain *domain, struct fi_info *info,
+		 struct fid_ep **ep, void *context);
+void smr_ep_progress(struct util_ep *util_ep);
+void smr_ep_release_peer(struct smr_ep *ep, int addr);
+
+int smr_complete_rx(struct smr_ep *ep, struct smr_rx_entry *rx_entry,
+		    int peer_id, const char *peer_name, struct smr_cmd *cmd);
+int smr_complete_tx(struct smr_ep *ep, void *context, uint32_t op,
+		    uint64_t flags, uint64_t err);
+
+static inline int smr_match_tag(uint64_t tag, uint64_t ignore,
+				uint64_t match_tag)
+{
+	return ((tag | ignore) == (match_tag | ignore));
+}
+
+#endif /* _SMR_H_ */
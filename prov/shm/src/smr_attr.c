@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "smr.h"
+
+
+struct fi_tx_attr smr_tx_attr = {
+	.caps = FI_MSG | FI_TAGGED | FI_SEND,
+	.comp_order = FI_ORDER_STRICT,
+	.msg_order = FI_ORDER_SAS,
+	.inject_size = SMR_MSG_DATA_LEN,
+	.size = SMR_CMD_QUEUE_SIZE,
+	.iov_limit = SMR_IOV_LIMIT
+};
+
+struct fi_rx_attr smr_rx_attr = {
+	.caps = FI_MSG | FI_TAGGED | FI_RECV,
+	.comp_order = FI_ORDER_STRICT,
+	.msg_order = FI_ORDER_SAS,
+	.total_buffered_recv = 0,
+	.size = 1024,
+	.iov_limit = SMR_IOV_LIMIT
+};
+
+struct fi_ep_attr smr_ep_attr = {
+	.type = FI_EP_RDM,
+	.protocol = FI_PROTO_UNSPEC,
+	.protocol_version = 0,
+	.max_msg_size = SIZE_MAX,
+	.mem_tag_format = FI_TAG_GENERIC,
+	.tx_ctx_cnt = 1,
+	.rx_ctx_cnt = 1
+};
+
+struct fi_domain_attr smr_domain_attr = {
+	.name = "shm",
+	.threading = FI_THREAD_SAFE,
+	.control_progress = FI_PROGRESS_MANUAL,
+	.data_progress = FI_PROGRESS_MANUAL,
+	.resource_mgmt = FI_RM_ENABLED,
+	.av_type = FI_AV_UNSPEC,
+	.mr_mode = 0,
+	.cq_data_size = sizeof_field(struct smr_msg_hdr, data),
+	.cq_cnt = 256,
+	.ep_cnt = 256,
+	.tx_ctx_cnt = 256,
+	.rx_ctx_cnt = 256,
+	.max_ep_tx_ctx = 1,
+	.max_ep_rx_ctx = 1
+};
+
+struct fi_fabric_attr smr_fabric_attr = {
+	.name = "shm",
+	.prov_version = FI_VERSION(SMR_MAJOR_VERSION, SMR_MINOR_VERSION)
+};
+
+struct fi_info smr_info = {
+	.caps = FI_MSG | FI_TAGGED | FI_SEND | FI_RECV,
+	.addr_format = FI_ADDR_STR,
+	.tx_attr = &smr_tx_attr,
+	.rx_attr = &smr_rx_attr,
+	.ep_attr = &smr_ep_attr,
+	.domain_attr = &smr_domain_attr,
+	.fabric_attr = &smr_fabric_attr
+};
+
+struct util_prov smr_util_prov = {
+	.prov = &smr_prov,
+	.info = &smr_info,
+	.flags = 0,
+};
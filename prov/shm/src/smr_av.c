@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "smr.h"
+
+
+static int smr_av_insert_addr(struct smr_av *av, const char *name,
+			      fi_addr_t *fi_addr)
+{
+	struct smr_av_peer *peer;
+	struct util_shm shm;
+	void *ptr;
+	int ret, index = -1;
+
+	if (!name[0] || strnlen(name, SMR_NAME_MAX) == SMR_NAME_MAX) {
+		FI_WARN(&smr_prov, FI_LOG_AV, "invalid address\n");
+		ret = -FI_EADDRNOTAVAIL;
+		goto out;
+	}
+
+	ret = ofi_shm_map(&shm, name, SMR_REGION_SIZE, 1, &ptr);
+	if (ret) {
+		FI_WARN(&smr_prov, FI_LOG_AV, "unable to map %s\n", name);
+		ret = -FI_EADDRNOTAVAIL;
+		goto out;
+	}
+
+	/* Pairs with the release in smr_region_init() */
+	if (ofi_load_acquire(&((struct smr_region *) ptr)->version) !=
+	    SMR_VERSION) {
+		FI_WARN(&smr_prov, FI_LOG_AV, "version mismatch for %s\n",
+			name);
+		ofi_shm_unmap(&shm);
+		ret = -FI_EADDRNOTAVAIL;
+		goto out;
+	}
+
+	fastlock_acquire(&av->util_av.lock);
+	ret = ofi_av_insert_addr(&av->util_av, name, 0, &index);
+	if (!ret) {
+		peer = &av->peers[index];
+		peer->shm = shm;
+		peer->region = ptr;
+	}
+	fastlock_release(&av->util_av.lock);
+	if (ret)
+		ofi_shm_unmap(&shm);
+out:
+	if (fi_addr)
+		*fi_addr = !ret ? index : FI_ADDR_NOTAVAIL;
+	return ret;
+}
+
+static int smr_av_insert(struct fid_av *av_fid, const void *addr, size_t count,
+			 fi_addr_t *fi_addr, uint64_t flags, void *context)
+{
+	struct smr_av *av;
+	int ret, success_cnt = 0;
+	size_t i;
+
+	av = container_of(av_fid, struct smr_av, util_av.av_fid);
+	if (flags & ~FI_MORE) {
+		FI_WARN(&smr_prov, FI_LOG_AV, "unsupported flags\n");
+		return -FI_EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		ret = smr_av_insert_addr(av, (const char *) addr +
+					 i * SMR_NAME_MAX,
+					 fi_addr ? &fi_addr[i] : NULL);
+		if (!ret)
+			success_cnt++;
+		else if (av->util_av.eq)
+			ofi_av_write_event(&av->util_av, i, -ret, context);
+	}
+
+	if (av->util_av.eq) {
+		ofi_av_write_event(&av->util_av, success_cnt, 0, context);
+		return 0;
+	}
+	return success_cnt;
+}
+
+static int smr_av_remove(struct fid_av *av_fid, fi_addr_t *fi_addr,
+			 size_t count, uint64_t flags)
+{
+	struct smr_av *av;
+	struct util_ep *util_ep;
+	struct dlist_entry *item;
+	int i, index, ret;
+
+	av = container_of(av_fid, struct smr_av, util_av.av_fid);
+	if (flags) {
+		FI_WARN(&smr_prov, FI_LOG_AV, "invalid flags\n");
+		return -FI_EINVAL;
+	}
+
+	for (i = count - 1; i >= 0; i--) {
+		index = (int) fi_addr[i];
+		if (index < 0 || index >= SMR_MAX_PEERS ||
+		    !av->peers[index].region) {
+			FI_WARN(&smr_prov, FI_LOG_AV,
+				"removal of fi_addr %d failed\n", index);
+			continue;
+		}
+
+		fastlock_acquire(&av->util_av.lock);
+		dlist_foreach(&av->util_av.ep_list, item) {
+			util_ep = container_of(item, struct util_ep, av_entry);
+			smr_ep_release_peer(container_of(util_ep, struct smr_ep,
+							 util_ep), index);
+		}
+		fastlock_release(&av->util_av.lock);
+
+		ofi_shm_unmap(&av->peers[index].shm);
+		av->peers[index].region = NULL;
+		ret = ofi_av_remove_addr(&av->util_av, 0, index);
+		if (ret) {
+			FI_WARN(&smr_prov, FI_LOG_AV,
+				"removal of fi_addr %d failed\n", index);
+		}
+	}
+	return 0;
+}
+
+static int smr_av_lookup(struct fid_av *av_fid, fi_addr_t fi_addr, void *addr,
+			 size_t *addrlen)
+{
+	struct smr_av *av;
+	int index;
+
+	av = container_of(av_fid, struct smr_av, util_av.av_fid);
+	index = (int) fi_addr;
+	if (index < 0 || index >= SMR_MAX_PEERS || !av->peers[index].region) {
+		FI_WARN(&smr_prov, FI_LOG_AV, "unknown address\n");
+		return -FI_EINVAL;
+	}
+
+	memcpy(addr, ofi_av_get_addr(&av->util_av, index),
+	       MIN(*addrlen, SMR_NAME_MAX));
+	*addrlen = SMR_NAME_MAX;
+	return 0;
+}
+
+static const char *smr_av_straddr(struct fid_av *av, const void *addr,
+				  char *buf, size_t *len)
+{
+	size_t size;
+
+	size = strnlen(addr, SMR_NAME_MAX) + 1;
+	if (*len) {
+		strncpy(buf, addr, *len - 1);
+		buf[MIN(*len, size) - 1] = '\0';
+	}
+	*len = size;
+	return buf;
+}
+
+static struct fi_ops_av smr_av_ops = {
+	.size = sizeof(struct fi_ops_av),
+	.insert = smr_av_insert,
+	.insertsvc = fi_no_av_insertsvc,
+	.insertsym = fi_no_av_insertsym,
+	.remove = smr_av_remove,
+	.lookup = smr_av_lookup,
+	.straddr = smr_av_straddr,
+};
+
+static int smr_av_close(struct fid *av_fid)
+{
+	struct smr_av *av;
+	int i, ret;
+
+	av = container_of(av_fid, struct smr_av, util_av.av_fid.fid);
+	ret = ofi_av_close(&av->util_av);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < SMR_MAX_PEERS; i++) {
+		if (av->peers[i].region)
+			ofi_shm_unmap(&av->peers[i].shm);
+	}
+	free(av);
+	return 0;
+}
+
+static struct fi_ops smr_av_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = smr_av_close,
+	.bind = ofi_av_bind,
+	.control = fi_no_control,
+	.ops_open = fi_no_ops_open,
+};
+
+int smr_av_open(struct fid_domain *domain_fid, struct fi_av_attr *attr,
+		struct fid_av **av_fid, void *context)
+{
+	struct util_domain *domain;
+	struct util_av_attr util_attr;
+	struct fi_av_attr av_attr;
+	struct smr_av *av;
+	int ret;
+
+	domain = container_of(domain_fid, struct util_domain, domain_fid);
+
+	/* fi_addr values index the per endpoint peer tables */
+	av_attr = *attr;
+	if (!av_attr.count || av_attr.count > SMR_MAX_PEERS)
+		av_attr.count = SMR_MAX_PEERS;
+	if (av_attr.type == FI_AV_UNSPEC)
+		av_attr.type = FI_AV_TABLE;
+
+	util_attr.addrlen = SMR_NAME_MAX;
+	util_attr.overhead = 0;
+	util_attr.flags = 0;
+
+	av = calloc(1, sizeof(*av));
+	if (!av)
+		return -FI_ENOMEM;
+
+	ret = ofi_av_init(domain, &av_attr, &util_attr, &av->util_av, context);
+	if (ret) {
+		free(av);
+		return ret;
+	}
+
+	*av_fid = &av->util_av.av_fid;
+	(*av_fid)->fid.ops = &smr_av_fi_ops;
+	(*av_fid)->ops = &smr_av_ops;
+	return 0;
+}
@@ -0,0 +1,726 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+
+#include "smr.h"
+
+
+void smr_region_init(struct smr_region *smr)
+{
+	int i;
+
+	smr->pid = getpid();
+	smr->total_size = SMR_REGION_SIZE;
+	for (i = 0; i < SMR_MAX_PEERS; i++) {
+		smr->peer_info[i].state = SMR_PEER_FREE;
+		smr->peer_info[i].name[0] = '\0';
+		smr_cmd_queue_init(smr_cmd_queue(smr, i), SMR_CMD_QUEUE_SIZE);
+	}
+	for (i = 0; i < SMR_MAX_RESP; i++)
+		smr->resp[i].status = SMR_STATUS_PENDING;
+
+	/* Peers check the version before using the region */
+	ofi_store_release(&smr->version, SMR_VERSION);
+}
+
+/*
+ * Claim a command queue in a peer's region.  The name is published before
+ * the first command, so the receiver can always map the sender back.
+ */
+int smr_peer_claim(struct smr_region *peer_smr, const char *name)
+{
+	struct smr_peer_info *info;
+	int32_t state;
+	int id;
+
+	for (id = 0; id < SMR_MAX_PEERS; id++) {
+		info = &peer_smr->peer_info[id];
+		state = SMR_PEER_FREE;
+		if (!__atomic_compare_exchange_n(&info->state, &state,
+						 SMR_PEER_CLAIMED, 0,
+						 __ATOMIC_ACQUIRE,
+						 __ATOMIC_RELAXED))
+			continue;
+
+		strncpy(info->name, name, SMR_NAME_MAX);
+		ofi_store_release(&info->state, SMR_PEER_ACTIVE);
+		return id;
+	}
+	return -FI_EAGAIN;
+}
+
+/*
+ * The owner reads any commands left in a released queue before freeing it,
+ * so they are never misrouted to the next sender to claim it.
+ */
+void smr_peer_release(struct smr_region *peer_smr, int id)
+{
+	ofi_store_release(&peer_smr->peer_info[id].state, SMR_PEER_RELEASED);
+}
+
+void smr_ep_release_peer(struct smr_ep *ep, int addr)
+{
+	struct smr_av *av;
+
+	fastlock_acquire(&ep->util_ep.lock);
+	if (ep->tx_id[addr] >= 0) {
+		av = container_of(ep->util_ep.av, struct smr_av, util_av);
+		smr_peer_release(av->peers[addr].region, ep->tx_id[addr]);
+		ep->tx_id[addr] = -1;
+	}
+	fastlock_release(&ep->util_ep.lock);
+}
+
+static int smr_ep_peer_id(struct smr_ep *ep, fi_addr_t addr,
+			  struct smr_region **peer_smr)
+{
+	struct smr_av *av;
+	int id;
+
+	av = container_of(ep->util_ep.av, struct smr_av, util_av);
+	if (addr >= SMR_MAX_PEERS || !av->peers[addr].region)
+		return -FI_EINVAL;
+
+	*peer_smr = av->peers[addr].region;
+	if (ep->tx_id[addr] < 0) {
+		id = smr_peer_claim(*peer_smr, ep->name);
+		if (id < 0) {
+			FI_DBG(&smr_prov, FI_LOG_EP_DATA,
+			       "no free queue at peer %" PRIu64 "\n", addr);
+			return id;
+		}
+		ep->tx_id[addr] = id;
+	}
+	return ep->tx_id[addr];
+}
+
+static int smr_getname(fid_t fid, void *addr, size_t *addrlen)
+{
+	struct smr_ep *ep;
+	size_t len;
+
+	ep = container_of(fid, struct smr_ep, util_ep.ep_fid.fid);
+	len = MIN(*addrlen, SMR_NAME_MAX);
+	memcpy(addr, ep->name, len);
+	*addrlen = SMR_NAME_MAX;
+	return len < SMR_NAME_MAX ? -FI_ETOOSMALL : 0;
+}
+
+static struct fi_ops_cm smr_cm_ops = {
+	.size = sizeof(struct fi_ops_cm),
+	.setname = fi_no_setname,
+	.getname = smr_getname,
+	.getpeer = fi_no_getpeer,
+	.connect = fi_no_connect,
+	.listen = fi_no_listen,
+	.accept = fi_no_accept,
+	.reject = fi_no_reject,
+	.shutdown = fi_no_shutdown,
+	.join = fi_no_join,
+};
+
+static struct fi_ops_ep smr_ep_ops = {
+	.size = sizeof(struct fi_ops_ep),
+	.cancel = fi_no_cancel,
+	.getopt = fi_no_getopt,
+	.setopt = fi_no_setopt,
+	.tx_ctx = fi_no_tx_ctx,
+	.rx_ctx = fi_no_rx_ctx,
+	.rx_size_left = fi_no_rx_size_left,
+	.tx_size_left = fi_no_tx_size_left,
+};
+
+static int smr_match_unexp_msg(struct dlist_entry *item, const void *arg)
+{
+	return 1;
+}
+
+static int smr_match_unexp_tagged(struct dlist_entry *item, const void *arg)
+{
+	const struct smr_rx_entry *rx_entry = arg;
+	struct smr_unexp_msg *unexp;
+
+	unexp = container_of(item, struct smr_unexp_msg, entry);
+	return smr_match_tag(rx_entry->tag, rx_entry->ignore,
+			     unexp->cmd.hdr.tag);
+}
+
+static ssize_t smr_generic_recvmsg(struct smr_ep *ep, const struct iovec *iov,
+				   size_t iov_count, uint64_t tag,
+				   uint64_t ignore, void *context, uint32_t op,
+				   uint64_t flags)
+{
+	struct smr_rx_entry *rx_entry;
+	struct smr_unexp_msg *unexp;
+	struct dlist_entry *item;
+	ssize_t ret = 0;
+
+	assert(iov_count <= SMR_IOV_LIMIT);
+
+	fastlock_acquire(&ep->util_ep.lock);
+	rx_entry = util_buf_alloc(ep->rx_entry_pool);
+	if (!rx_entry) {
+		ret = -FI_EAGAIN;
+		goto out;
+	}
+
+	rx_entry->context = context;
+	rx_entry->flags = flags;
+	rx_entry->tag = tag;
+	rx_entry->ignore = ignore;
+	memcpy(rx_entry->iov, iov, sizeof(*iov) * iov_count);
+	rx_entry->iov_count = iov_count;
+
+	if (op == ofi_op_msg) {
+		item = dlist_find_first_match(&ep->unexp_queue,
+					      smr_match_unexp_msg, rx_entry);
+	} else {
+		item = dlist_find_first_match(&ep->tunexp_queue,
+					      smr_match_unexp_tagged,
+					      rx_entry);
+	}
+
+	if (!item) {
+		dlist_insert_tail(&rx_entry->entry, op == ofi_op_msg ?
+				  &ep->recv_queue : &ep->trecv_queue);
+		goto out;
+	}
+
+	unexp = container_of(item, struct smr_unexp_msg, entry);
+	ret = smr_complete_rx(ep, rx_entry, unexp->peer_id, unexp->name,
+			      &unexp->cmd);
+	if (ret == -FI_EINPROGRESS) {
+		dlist_insert_tail(&rx_entry->entry, &ep->bounce_queue);
+		dlist_remove(&unexp->entry);
+		util_buf_release(ep->unexp_pool, unexp);
+		ret = 0;
+		goto out;
+	}
+	if (ret) {
+		/* CQ is full: leave the message queued for the next receive */
+		util_buf_release(ep->rx_entry_pool, rx_entry);
+		goto out;
+	}
+	dlist_remove(&unexp->entry);
+	util_buf_release(ep->unexp_pool, unexp);
+	util_buf_release(ep->rx_entry_pool, rx_entry);
+out:
+	fastlock_release(&ep->util_ep.lock);
+	return ret;
+}
+
+static ssize_t smr_generic_sendmsg(struct smr_ep *ep, const struct iovec *iov,
+				   size_t iov_count, fi_addr_t addr,
+				   uint64_t tag, uint64_t data, void *context,
+				   uint32_t op, uint64_t flags)
+{
+	struct smr_region *peer_smr;
+	struct smr_cmd_queue *queue;
+	struct smr_pend_entry *pend;
+	struct smr_cmd *cmd;
+	size_t total_len;
+	ssize_t ret = 0;
+	int id;
+
+	assert(iov_count <= SMR_IOV_LIMIT);
+
+	total_len = ofi_total_iov_len(iov, iov_count);
+	if ((flags & FI_INJECT) && total_len > SMR_MSG_DATA_LEN)
+		return -FI_EINVAL;
+
+	fastlock_acquire(&ep->util_ep.lock);
+	id = smr_ep_peer_id(ep, addr, &peer_smr);
+	if (id < 0) {
+		ret = id;
+		goto out;
+	}
+
+	queue = smr_cmd_queue(peer_smr, id);
+	if (ofi_cirque_spsc_isfull(queue) ||
+	    (total_len > SMR_MSG_DATA_LEN && !ep->pend_free_cnt)) {
+		ret = -FI_EAGAIN;
+		goto out;
+	}
+
+	cmd = ofi_cirque_tail(queue);
+	cmd->hdr.op = op;
+	cmd->hdr.op_flags = (flags & FI_REMOTE_CQ_DATA) ? OFI_REMOTE_CQ_DATA : 0;
+	cmd->hdr.tag = tag;
+	cmd->hdr.data = data;
+	cmd->hdr.size = total_len;
+
+	if (total_len <= SMR_MSG_DATA_LEN) {
+		cmd->hdr.op_src = smr_src_inline;
+		ofi_copy_from_iov(cmd->data.msg, total_len, iov, iov_count, 0);
+		/* Write the completion first, so a full CQ fails the send
+		 * before the peer can see it. */
+		ret = smr_complete_tx(ep, context, op, flags, 0);
+		if (ret)
+			goto out;
+		ofi_cirque_spsc_commit(queue);
+		goto out;
+	}
+
+	pend = &ep->pend[ep->pend_free[--ep->pend_free_cnt]];
+	pend->context = context;
+	pend->flags = flags;
+	pend->op = op;
+	pend->addr = addr;
+	pend->id = id;
+	memcpy(pend->iov, iov, sizeof(*iov) * iov_count);
+	pend->iov_count = iov_count;
+	pend->size = total_len;
+	pend->offset = 0;
+	ep->region->resp[pend->resp_id].status = SMR_STATUS_PENDING;
+	dlist_insert_tail(&pend->entry, &ep->pend_queue);
+
+	cmd->hdr.op_src = smr_src_iov;
+	cmd->hdr.src_pid = ep->region->pid;
+	cmd->hdr.resp_id = pend->resp_id;
+	cmd->hdr.iov_count = (uint32_t) iov_count;
+	memcpy(cmd->data.iov, iov, sizeof(*iov) * iov_count);
+	ofi_cirque_spsc_commit(queue);
+out:
+	fastlock_release(&ep->util_ep.lock);
+	return ret;
+}
+
+static ssize_t smr_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
+			   uint64_t flags)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_recvmsg(ep, msg->msg_iov, msg->iov_count, 0, 0,
+				   msg->context, ofi_op_msg,
+				   flags | (ep->util_ep.rx_op_flags &
+					    FI_COMPLETION));
+}
+
+static ssize_t smr_recvv(struct fid_ep *ep_fid, const struct iovec *iov,
+			 void **desc, size_t count, fi_addr_t src_addr,
+			 void *context)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_recvmsg(ep, iov, count, 0, 0, context, ofi_op_msg,
+				   ep->util_ep.rx_op_flags);
+}
+
+static ssize_t smr_recv(struct fid_ep *ep_fid, void *buf, size_t len,
+			void *desc, fi_addr_t src_addr, void *context)
+{
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	return smr_recvv(ep_fid, &iov, &desc, 1, src_addr, context);
+}
+
+static ssize_t smr_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
+			   uint64_t flags)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_sendmsg(ep, msg->msg_iov, msg->iov_count,
+				   msg->addr, 0, msg->data, msg->context,
+				   ofi_op_msg, flags | (ep->util_ep.tx_op_flags &
+							FI_COMPLETION));
+}
+
+static ssize_t smr_sendv(struct fid_ep *ep_fid, const struct iovec *iov,
+			 void **desc, size_t count, fi_addr_t dest_addr,
+			 void *context)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_sendmsg(ep, iov, count, dest_addr, 0, 0, context,
+				   ofi_op_msg, ep->util_ep.tx_op_flags);
+}
+
+static ssize_t smr_send(struct fid_ep *ep_fid, const void *buf, size_t len,
+			void *desc, fi_addr_t dest_addr, void *context)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_sendv(ep_fid, &iov, &desc, 1, dest_addr, context);
+}
+
+static ssize_t smr_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
+			  fi_addr_t dest_addr)
+{
+	struct smr_ep *ep;
+	struct iovec iov;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_generic_sendmsg(ep, &iov, 1, dest_addr, 0, 0, NULL,
+				   ofi_op_msg, FI_INJECT);
+}
+
+static ssize_t smr_senddata(struct fid_ep *ep_fid, const void *buf, size_t len,
+			    void *desc, uint64_t data, fi_addr_t dest_addr,
+			    void *context)
+{
+	struct smr_ep *ep;
+	struct iovec iov;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_generic_sendmsg(ep, &iov, 1, dest_addr, 0, data, context,
+				   ofi_op_msg, ep->util_ep.tx_op_flags |
+				   FI_REMOTE_CQ_DATA);
+}
+
+static ssize_t smr_injectdata(struct fid_ep *ep_fid, const void *buf,
+			      size_t len, uint64_t data, fi_addr_t dest_addr)
+{
+	struct smr_ep *ep;
+	struct iovec iov;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_generic_sendmsg(ep, &iov, 1, dest_addr, 0, data, NULL,
+				   ofi_op_msg, FI_INJECT | FI_REMOTE_CQ_DATA);
+}
+
+static struct fi_ops_msg smr_msg_ops = {
+	.size = sizeof(struct fi_ops_msg),
+	.recv = smr_recv,
+	.recvv = smr_recvv,
+	.recvmsg = smr_recvmsg,
+	.send = smr_send,
+	.sendv = smr_sendv,
+	.sendmsg = smr_sendmsg,
+	.inject = smr_inject,
+	.senddata = smr_senddata,
+	.injectdata = smr_injectdata,
+};
+
+static ssize_t smr_trecvmsg(struct fid_ep *ep_fid,
+			    const struct fi_msg_tagged *msg, uint64_t flags)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_recvmsg(ep, msg->msg_iov, msg->iov_count, msg->tag,
+				   msg->ignore, msg->context, ofi_op_tagged,
+				   flags | (ep->util_ep.rx_op_flags &
+					    FI_COMPLETION));
+}
+
+static ssize_t smr_trecvv(struct fid_ep *ep_fid, const struct iovec *iov,
+			  void **desc, size_t count, fi_addr_t src_addr,
+			  uint64_t tag, uint64_t ignore, void *context)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_recvmsg(ep, iov, count, tag, ignore, context,
+				   ofi_op_tagged, ep->util_ep.rx_op_flags);
+}
+
+static ssize_t smr_trecv(struct fid_ep *ep_fid, void *buf, size_t len,
+			 void *desc, fi_addr_t src_addr, uint64_t tag,
+			 uint64_t ignore, void *context)
+{
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	return smr_trecvv(ep_fid, &iov, &desc, 1, src_addr, tag, ignore,
+			  context);
+}
+
+static ssize_t smr_tsendmsg(struct fid_ep *ep_fid,
+			    const struct fi_msg_tagged *msg, uint64_t flags)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_sendmsg(ep, msg->msg_iov, msg->iov_count,
+				   msg->addr, msg->tag, msg->data, msg->context,
+				   ofi_op_tagged, flags | (ep->util_ep.tx_op_flags &
+							   FI_COMPLETION));
+}
+
+static ssize_t smr_tsendv(struct fid_ep *ep_fid, const struct iovec *iov,
+			  void **desc, size_t count, fi_addr_t dest_addr,
+			  uint64_t tag, void *context)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return smr_generic_sendmsg(ep, iov, count, dest_addr, tag, 0, context,
+				   ofi_op_tagged, ep->util_ep.tx_op_flags);
+}
+
+static ssize_t smr_tsend(struct fid_ep *ep_fid, const void *buf, size_t len,
+			 void *desc, fi_addr_t dest_addr, uint64_t tag,
+			 void *context)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_tsendv(ep_fid, &iov, &desc, 1, dest_addr, tag, context);
+}
+
+static ssize_t smr_tinject(struct fid_ep *ep_fid, const void *buf, size_t len,
+			   fi_addr_t dest_addr, uint64_t tag)
+{
+	struct smr_ep *ep;
+	struct iovec iov;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_generic_sendmsg(ep, &iov, 1, dest_addr, tag, 0, NULL,
+				   ofi_op_tagged, FI_INJECT);
+}
+
+static ssize_t smr_tsenddata(struct fid_ep *ep_fid, const void *buf,
+			     size_t len, void *desc, uint64_t data,
+			     fi_addr_t dest_addr, uint64_t tag, void *context)
+{
+	struct smr_ep *ep;
+	struct iovec iov;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_generic_sendmsg(ep, &iov, 1, dest_addr, tag, data, context,
+				   ofi_op_tagged, ep->util_ep.tx_op_flags |
+				   FI_REMOTE_CQ_DATA);
+}
+
+static ssize_t smr_tinjectdata(struct fid_ep *ep_fid, const void *buf,
+			       size_t len, uint64_t data, fi_addr_t dest_addr,
+			       uint64_t tag)
+{
+	struct smr_ep *ep;
+	struct iovec iov;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return smr_generic_sendmsg(ep, &iov, 1, dest_addr, tag, data, NULL,
+				   ofi_op_tagged, FI_INJECT | FI_REMOTE_CQ_DATA);
+}
+
+static struct fi_ops_tagged smr_tagged_ops = {
+	.size = sizeof(struct fi_ops_tagged),
+	.recv = smr_trecv,
+	.recvv = smr_trecvv,
+	.recvmsg = smr_trecvmsg,
+	.send = smr_tsend,
+	.sendv = smr_tsendv,
+	.sendmsg = smr_tsendmsg,
+	.inject = smr_tinject,
+	.senddata = smr_tsenddata,
+	.injectdata = smr_tinjectdata,
+};
+
+static int smr_ep_close(struct fid *fid)
+{
+	struct smr_ep *ep;
+	struct smr_av *av;
+	int i;
+
+	ep = container_of(fid, struct smr_ep, util_ep.ep_fid.fid);
+	if (ep->util_ep.av) {
+		av = container_of(ep->util_ep.av, struct smr_av, util_av);
+		for (i = 0; i < SMR_MAX_PEERS; i++) {
+			if (ep->tx_id[i] >= 0)
+				smr_peer_release(av->peers[i].region,
+						 ep->tx_id[i]);
+		}
+	}
+
+	for (i = 0; i < SMR_MAX_PEERS; i++) {
+		if (ep->rx_peer[i].region)
+			ofi_shm_unmap(&ep->rx_peer[i].shm);
+	}
+
+	ofi_endpoint_close(&ep->util_ep);
+	ofi_shm_unmap(&ep->shm);
+	util_buf_pool_destroy(ep->unexp_pool);
+	util_buf_pool_destroy(ep->rx_entry_pool);
+	free(ep);
+	return 0;
+}
+
+static int smr_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(ep_fid, struct smr_ep, util_ep.ep_fid.fid);
+	return ofi_ep_bind(&ep->util_ep, bfid, flags);
+}
+
+static int smr_ep_ctrl(struct fid *fid, int command, void *arg)
+{
+	struct smr_ep *ep;
+
+	ep = container_of(fid, struct smr_ep, util_ep.ep_fid.fid);
+	switch (command) {
+	case FI_ENABLE:
+		if (!ep->util_ep.rx_cq || !ep->util_ep.tx_cq)
+			return -FI_ENOCQ;
+		if (!ep->util_ep.av)
+			return -FI_ENOAV;
+		break;
+	default:
+		return -FI_ENOSYS;
+	}
+	return 0;
+}
+
+static struct fi_ops smr_ep_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = smr_ep_close,
+	.bind = smr_ep_bind,
+	.control = smr_ep_ctrl,
+	.ops_open = fi_no_ops_open,
+};
+
+static int smr_ep_init(struct smr_ep *ep, struct fi_info *info)
+{
+	void *ptr;
+	size_t len;
+	int i, ret;
+
+	if (info->src_addr && info->src_addrlen) {
+		len = strnlen(info->src_addr, MIN(info->src_addrlen,
+						  SMR_NAME_MAX));
+		if (len >= SMR_NAME_MAX)
+			return -FI_EINVAL;
+		memcpy(ep->name, info->src_addr, len);
+		ep->name[len] = '\0';
+	} else {
+		snprintf(ep->name, SMR_NAME_MAX, "fi_shm_%d_%" PRIxPTR,
+			 getpid(), (uintptr_t) ep);
+	}
+
+	ret = ofi_shm_map(&ep->shm, ep->name, SMR_REGION_SIZE, 0, &ptr);
+	if (ret)
+		return ret;
+	ep->region = ptr;
+	smr_region_init(ep->region);
+
+	ep->rx_entry_pool = util_buf_pool_create(sizeof(struct smr_rx_entry),
+						 16, 0, info->rx_attr->size);
+	if (!ep->rx_entry_pool) {
+		ret = -FI_ENOMEM;
+		goto err1;
+	}
+
+	ep->unexp_pool = util_buf_pool_create(sizeof(struct smr_unexp_msg),
+					      16, 0, 64);
+	if (!ep->unexp_pool) {
+		ret = -FI_ENOMEM;
+		goto err2;
+	}
+
+	for (i = 0; i < SMR_MAX_PEERS; i++)
+		ep->tx_id[i] = -1;
+	for (i = 0; i < SMR_MAX_RESP; i++) {
+		ep->pend[i].resp_id = i;
+		ep->pend_free[i] = SMR_MAX_RESP - 1 - i;
+	}
+	ep->pend_free_cnt = SMR_MAX_RESP;
+
+	dlist_init(&ep->recv_queue);
+	dlist_init(&ep->trecv_queue);
+	dlist_init(&ep->unexp_queue);
+	dlist_init(&ep->tunexp_queue);
+	dlist_init(&ep->bounce_queue);
+	dlist_init(&ep->pend_queue);
+
+#ifdef PR_SET_PTRACER
+	/* Peers read large messages out of this process with
+	 * process_vm_readv, which Yama restricts to ptrace-capable callers.
+	 * Opening this up to every process is left to the user. */
+	if (smr_ptracer_any)
+		prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0);
+#endif
+	return 0;
+err2:
+	util_buf_pool_destroy(ep->rx_entry_pool);
+err1:
+	ofi_shm_unmap(&ep->shm);
+	return ret;
+}
+
+int smr_endpoint(struct fid_domain *domain, struct fi_info *info,
+		 struct fid_ep **ep_fid, void *context)
+{
+	struct smr_ep *ep;
+	int ret;
+
+	ep = calloc(1, sizeof(*ep));
+	if (!ep)
+		return -FI_ENOMEM;
+
+	ret = ofi_endpoint_init(domain, &smr_util_prov, info, &ep->util_ep,
+				context, smr_ep_progress);
+	if (ret)
+		goto err;
+
+	ret = smr_ep_init(ep, info);
+	if (ret) {
+		ofi_endpoint_close(&ep->util_ep);
+		goto err;
+	}
+
+	*ep_fid = &ep->util_ep.ep_fid;
+	(*ep_fid)->fid.ops = &smr_ep_fi_ops;
+	(*ep_fid)->ops = &smr_ep_ops;
+	(*ep_fid)->cm = &smr_cm_ops;
+	(*ep_fid)->msg = &smr_msg_ops;
+	(*ep_fid)->tagged = &smr_tagged_ops;
+	return 0;
+err:
+	free(ep);
+	return ret;
+}
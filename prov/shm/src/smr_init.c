@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <rdma/fi_errno.h>
+
+#include <prov.h>
+#include "smr.h"
+
+
+static int smr_getinfo(uint32_t version, const char *node, const char *service,
+		       uint64_t flags, const struct fi_info *hints,
+		       struct fi_info **info)
+{
+	return util_getinfo(&smr_util_prov, version, node, service, flags,
+			    hints, info);
+}
+
+static void smr_fini(void)
+{
+	/* yawn */
+}
+
+struct fi_provider smr_prov = {
+	.name = "shm",
+	.version = FI_VERSION(SMR_MAJOR_VERSION, SMR_MINOR_VERSION),
+	.fi_version = FI_VERSION(1, 5),
+	.getinfo = smr_getinfo,
+	.fabric = smr_fabric,
+	.cleanup = smr_fini
+};
+
+int smr_ptracer_any;
+
+SHM_INI
+{
+	fi_param_define(&smr_prov, "ptracer_any", FI_PARAM_BOOL,
+			"Allow any process to ptrace this one, so that peers "
+			"restricted by Yama can read large messages directly "
+			"(default: no, such messages are copied through the "
+			"command queue)");
+	fi_param_get_bool(&smr_prov, "ptracer_any", &smr_ptracer_any);
+
+	return &smr_prov;
+}
@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "smr.h"
+
+
+int smr_complete_tx(struct smr_ep *ep, void *context, uint32_t op,
+		    uint64_t flags, uint64_t err)
+{
+	struct fi_cq_err_entry err_entry = {0};
+	struct util_cq *cq = ep->util_ep.tx_cq;
+	uint64_t comp_flags;
+
+	comp_flags = FI_SEND | (op == ofi_op_tagged ? FI_TAGGED : FI_MSG);
+	if (err) {
+		err_entry.op_context = context;
+		err_entry.flags = comp_flags;
+		err_entry.err = (int) err;
+		err_entry.prov_errno = -(int) err;
+		return ofi_cq_write_error(cq, &err_entry);
+	}
+
+	if (!(flags & FI_COMPLETION))
+		return 0;
+
+	return ofi_cq_write(cq, context, comp_flags, 0, NULL, 0, 0);
+}
+
+/*
+ * Map the region of the peer named 'name', which sent on queue 'id', so its
+ * response slot can be written.  The mapping is cached per queue and
+ * replaced if the name differs, since another process may have claimed the
+ * queue after an unexpected message was received.
+ */
+static struct smr_region *smr_rx_peer_region(struct smr_ep *ep, int id,
+					     const char *name)
+{
+	struct smr_rx_peer *peer = &ep->rx_peer[id];
+	void *ptr;
+
+	if (peer->region && !strncmp(peer->name, name, SMR_NAME_MAX))
+		return peer->region;
+
+	if (peer->region) {
+		ofi_shm_unmap(&peer->shm);
+		peer->region = NULL;
+	}
+
+	if (ofi_shm_map(&peer->shm, name, SMR_REGION_SIZE, 1, &ptr)) {
+		FI_WARN(&smr_prov, FI_LOG_EP_DATA,
+			"unable to map peer region %s\n", name);
+		return NULL;
+	}
+	strncpy(peer->name, name, SMR_NAME_MAX - 1);
+	peer->name[SMR_NAME_MAX - 1] = '\0';
+	peer->region = ptr;
+	return peer->region;
+}
+
+static uint64_t smr_copy_iov(struct smr_cmd *cmd, struct iovec *iov,
+			     size_t iov_count, size_t len)
+{
+	ssize_t ret;
+
+	ret = process_vm_readv(cmd->hdr.src_pid, iov, iov_count,
+			       cmd->data.iov, cmd->hdr.iov_count, 0);
+	if (ret < 0) {
+		FI_WARN(&smr_prov, FI_LOG_EP_DATA,
+			"process_vm_readv failed: %s\n", strerror(errno));
+		return errno;
+	}
+	return (size_t) ret == len ? 0 : FI_EIO;
+}
+
+static size_t smr_truncate_iov(struct iovec *iov, size_t iov_count,
+			       size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < iov_count && len; i++) {
+		if (iov[i].iov_len > len)
+			iov[i].iov_len = len;
+		len -= iov[i].iov_len;
+	}
+	return i;
+}
+
+static int smr_write_rx_comp(struct smr_ep *ep,
+			     struct smr_rx_entry *rx_entry,
+			     const struct smr_msg_hdr *hdr, size_t len,
+			     uint64_t err)
+{
+	struct fi_cq_err_entry err_entry = {0};
+	uint64_t comp_flags;
+
+	comp_flags = FI_RECV | (hdr->op == ofi_op_tagged ? FI_TAGGED : FI_MSG);
+	if (hdr->op_flags & OFI_REMOTE_CQ_DATA)
+		comp_flags |= FI_REMOTE_CQ_DATA;
+
+	if (err) {
+		err_entry.op_context = rx_entry->context;
+		err_entry.flags = comp_flags;
+		err_entry.len = len;
+		err_entry.buf = rx_entry->iov[0].iov_base;
+		err_entry.data = hdr->data;
+		err_entry.tag = hdr->tag;
+		err_entry.olen = hdr->size - len;
+		err_entry.err = (int) err;
+		err_entry.prov_errno = -(int) err;
+		return ofi_cq_write_error(ep->util_ep.rx_cq, &err_entry);
+	}
+
+	if (!(rx_entry->flags & FI_COMPLETION))
+		return 0;
+
+	return ofi_cq_write(ep->util_ep.rx_cq, rx_entry->context, comp_flags,
+			    len, rx_entry->iov[0].iov_base, hdr->data,
+			    hdr->tag);
+}
+
+/* The sender still owns queue id, and is waiting for a response */
+static int smr_rx_peer_active(struct smr_ep *ep, int id, const char *name)
+{
+	struct smr_peer_info *peer = &ep->region->peer_info[id];
+
+	return ofi_load_acquire(&peer->state) == SMR_PEER_ACTIVE &&
+	       !strncmp(peer->name, name, SMR_NAME_MAX);
+}
+
+/*
+ * Copy the message into the posted buffer and write its completion.  The
+ * sender of an iov message is only released once the completion has been
+ * written, so -FI_EAGAIN from a full CQ leaves both sides untouched and the
+ * message can be completed again later.  The same is done if the sender's
+ * region can't be mapped to respond, for as long as the sender is around.
+ *
+ * -FI_EINPROGRESS is returned if the sender was asked to bounce the
+ * message.  The caller then queues rx_entry on bounce_queue.
+ */
+int smr_complete_rx(struct smr_ep *ep, struct smr_rx_entry *rx_entry,
+		    int peer_id, const char *peer_name, struct smr_cmd *cmd)
+{
+	struct smr_region *peer_smr = NULL;
+	struct iovec iov[SMR_IOV_LIMIT];
+	size_t iov_count, len;
+	uint64_t status = 0, err = 0;
+	int ret;
+
+	len = ofi_total_iov_len(rx_entry->iov, rx_entry->iov_count);
+	if (cmd->hdr.size > len)
+		err = FI_ETRUNC;
+	else
+		len = cmd->hdr.size;
+
+	if (cmd->hdr.op_src == smr_src_inline) {
+		ofi_copy_to_iov(rx_entry->iov, rx_entry->iov_count, 0,
+				cmd->data.msg, len);
+	} else {
+		peer_smr = smr_rx_peer_region(ep, peer_id, peer_name);
+		if (!peer_smr) {
+			if (smr_rx_peer_active(ep, peer_id, peer_name))
+				return -FI_EAGAIN;
+			/* The sender is gone along with its buffers */
+			if (!err)
+				err = FI_EIO;
+			goto complete;
+		}
+
+		/* Trim the receive iov, so a truncated transfer is partial
+		 * rather than failed.  The sender only sees copy errors. */
+		memcpy(iov, rx_entry->iov, sizeof(*iov) * rx_entry->iov_count);
+		iov_count = smr_truncate_iov(iov, rx_entry->iov_count, len);
+		status = smr_copy_iov(cmd, iov, iov_count, len);
+		if (status == EPERM) {
+			rx_entry->peer_id = peer_id;
+			rx_entry->offset = 0;
+			rx_entry->hdr = cmd->hdr;
+			ofi_store_release(&peer_smr->resp[cmd->hdr.resp_id].status,
+					  SMR_STATUS_BOUNCE);
+			return -FI_EINPROGRESS;
+		}
+		if (!err)
+			err = status;
+	}
+
+complete:
+	ret = smr_write_rx_comp(ep, rx_entry, &cmd->hdr, len, err);
+	if (ret)
+		return ret;
+
+	if (peer_smr)
+		ofi_store_release(&peer_smr->resp[cmd->hdr.resp_id].status,
+				  status);
+	return 0;
+}
+
+struct smr_seg_key {
+	int		peer_id;
+	uint32_t	resp_id;
+};
+
+static int smr_match_bounce(struct dlist_entry *item, const void *arg)
+{
+	const struct smr_seg_key *key = arg;
+	struct smr_rx_entry *rx_entry;
+
+	rx_entry = container_of(item, struct smr_rx_entry, entry);
+	return rx_entry->peer_id == key->peer_id &&
+	       rx_entry->hdr.resp_id == key->resp_id;
+}
+
+/* Copy in the next segment of a bounced message, completing it on the last */
+static int smr_progress_seg(struct smr_ep *ep, int id, struct smr_cmd *cmd)
+{
+	struct smr_rx_entry *rx_entry;
+	struct dlist_entry *item;
+	struct smr_seg_key key;
+	size_t len;
+	uint64_t err = 0;
+	int ret;
+
+	key.peer_id = id;
+	key.resp_id = cmd->hdr.resp_id;
+	item = dlist_find_first_match(&ep->bounce_queue, smr_match_bounce,
+				      &key);
+	if (!item) {
+		FI_WARN(&smr_prov, FI_LOG_EP_DATA,
+			"dropping segment of unknown message\n");
+		return 0;
+	}
+
+	rx_entry = container_of(item, struct smr_rx_entry, entry);
+	ofi_copy_to_iov(rx_entry->iov, rx_entry->iov_count, rx_entry->offset,
+			cmd->data.msg, cmd->hdr.size);
+	if (rx_entry->offset + cmd->hdr.size < rx_entry->hdr.size) {
+		rx_entry->offset += cmd->hdr.size;
+		return 0;
+	}
+
+	len = ofi_total_iov_len(rx_entry->iov, rx_entry->iov_count);
+	if (rx_entry->hdr.size > len)
+		err = FI_ETRUNC;
+	else
+		len = rx_entry->hdr.size;
+
+	/* A full CQ leaves the segment queued, to be copied again */
+	ret = smr_write_rx_comp(ep, rx_entry, &rx_entry->hdr, len, err);
+	if (ret)
+		return ret;
+
+	dlist_remove(&rx_entry->entry);
+	util_buf_release(ep->rx_entry_pool, rx_entry);
+	return 0;
+}
+
+/*
+ * Free a queue its sender has released once all of its commands have been
+ * read.  Bounced messages still waiting on the sender will never finish.
+ */
+static int smr_progress_released(struct smr_ep *ep, int id)
+{
+	struct smr_rx_entry *rx_entry;
+	struct dlist_entry *tmp;
+
+	dlist_foreach_container_safe(&ep->bounce_queue, rx_entry, entry, tmp) {
+		if (rx_entry->peer_id != id)
+			continue;
+
+		if (smr_write_rx_comp(ep, rx_entry, &rx_entry->hdr,
+				      rx_entry->offset, FI_EIO))
+			return -FI_EAGAIN;
+
+		dlist_remove(&rx_entry->entry);
+		util_buf_release(ep->rx_entry_pool, rx_entry);
+	}
+
+	ofi_store_release(&ep->region->peer_info[id].state, SMR_PEER_FREE);
+	return 0;
+}
+
+/*
+ * Copy a bounced message into the receiver's queue as inline segments.
+ * Returns -FI_EAGAIN while segments remain to be sent.
+ */
+static int smr_progress_bounce(struct smr_ep *ep, struct smr_pend_entry *pend)
+{
+	struct smr_cmd_queue *queue;
+	struct smr_region *peer_smr;
+	struct smr_cmd *cmd;
+	struct smr_av *av;
+	size_t len;
+
+	if (pend->offset == pend->size)
+		return 0;
+
+	av = container_of(ep->util_ep.av, struct smr_av, util_av);
+	peer_smr = av->peers[pend->addr].region;
+	if (ep->tx_id[pend->addr] != pend->id || !peer_smr)
+		return -FI_EIO;
+
+	queue = smr_cmd_queue(peer_smr, pend->id);
+	while (pend->offset < pend->size) {
+		if (ofi_cirque_spsc_isfull(queue))
+			return -FI_EAGAIN;
+
+		len = MIN(SMR_MSG_DATA_LEN, pend->size - pend->offset);
+		cmd = ofi_cirque_tail(queue);
+		memset(&cmd->hdr, 0, sizeof(cmd->hdr));
+		cmd->hdr.op = pend->op;
+		cmd->hdr.op_src = smr_src_seg;
+		cmd->hdr.resp_id = pend->resp_id;
+		cmd->hdr.size = len;
+		ofi_copy_from_iov(cmd->data.msg, len, pend->iov,
+				  pend->iov_count, pend->offset);
+		ofi_cirque_spsc_commit(queue);
+		pend->offset += len;
+	}
+	return 0;
+}
+
+static void smr_progress_resp(struct smr_ep *ep)
+{
+	struct smr_pend_entry *pend;
+	struct dlist_entry *tmp;
+	uint64_t status;
+	int ret;
+
+	dlist_foreach_container_safe(&ep->pend_queue, pend, entry, tmp) {
+		status = ofi_load_acquire(&ep->region->resp[pend->resp_id].status);
+		if (status == SMR_STATUS_PENDING)
+			continue;
+
+		if (status == SMR_STATUS_BOUNCE) {
+			ret = smr_progress_bounce(ep, pend);
+			if (ret == -FI_EAGAIN)
+				continue;
+			status = (uint64_t) -ret;
+		}
+
+		/* Keep the send pending until its completion fits */
+		if (smr_complete_tx(ep, pend->context, pend->op, pend->flags,
+				    status))
+			break;
+
+		dlist_remove(&pend->entry);
+		ep->pend_free[ep->pend_free_cnt++] = pend->resp_id;
+	}
+}
+
+static int smr_match_recv(struct dlist_entry *item, const void *arg)
+{
+	const struct smr_cmd *cmd = arg;
+	struct smr_rx_entry *rx_entry;
+
+	if (cmd->hdr.op == ofi_op_msg)
+		return 1;
+
+	rx_entry = container_of(item, struct smr_rx_entry, entry);
+	return smr_match_tag(rx_entry->tag, rx_entry->ignore, cmd->hdr.tag);
+}
+
+static int smr_progress_cmd(struct smr_ep *ep, int id, struct smr_cmd *cmd)
+{
+	struct smr_rx_entry *rx_entry;
+	struct smr_unexp_msg *unexp;
+	struct dlist_entry *item;
+
+	struct smr_peer_info *peer = &ep->region->peer_info[id];
+	int ret;
+
+	if (cmd->hdr.op_src == smr_src_seg)
+		return smr_progress_seg(ep, id, cmd);
+
+	item = dlist_find_first_match(cmd->hdr.op == ofi_op_msg ?
+				      &ep->recv_queue : &ep->trecv_queue,
+				      smr_match_recv, cmd);
+	if (item) {
+		rx_entry = container_of(item, struct smr_rx_entry, entry);
+		ret = smr_complete_rx(ep, rx_entry, id, peer->name, cmd);
+		if (ret == -FI_EINPROGRESS) {
+			dlist_remove(&rx_entry->entry);
+			dlist_insert_tail(&rx_entry->entry, &ep->bounce_queue);
+			return 0;
+		}
+		if (ret)
+			return ret;
+		dlist_remove(&rx_entry->entry);
+		util_buf_release(ep->rx_entry_pool, rx_entry);
+		return 0;
+	}
+
+	unexp = util_buf_alloc(ep->unexp_pool);
+	if (!unexp)
+		return -FI_ENOMEM;
+
+	/* The queue may be reused by another sender before the message is
+	 * matched, so remember whose region to respond to. */
+	unexp->peer_id = id;
+	memcpy(unexp->name, peer->name, SMR_NAME_MAX);
+	unexp->name[SMR_NAME_MAX - 1] = '\0';
+	memcpy(&unexp->cmd, cmd, sizeof(*cmd));
+	dlist_insert_tail(&unexp->entry, cmd->hdr.op == ofi_op_msg ?
+			  &ep->unexp_queue : &ep->tunexp_queue);
+	return 0;
+}
+
+void smr_ep_progress(struct util_ep *util_ep)
+{
+	struct smr_cmd_queue *queue;
+	struct smr_ep *ep;
+	int32_t state;
+	int id;
+
+	ep = container_of(util_ep, struct smr_ep, util_ep);
+	fastlock_acquire(&ep->util_ep.lock);
+	smr_progress_resp(ep);
+
+	for (id = 0; id < SMR_MAX_PEERS; id++) {
+		state = ofi_load_acquire(&ep->region->peer_info[id].state);
+		if (state != SMR_PEER_ACTIVE && state != SMR_PEER_RELEASED)
+			continue;
+
+		queue = smr_cmd_queue(ep->region, id);
+		while (!ofi_cirque_spsc_isempty(queue)) {
+			if (smr_progress_cmd(ep, id, ofi_cirque_head(queue)))
+				goto out;
+			ofi_cirque_spsc_discard(queue);
+		}
+
+		if (state == SMR_PEER_RELEASED &&
+		    smr_progress_released(ep, id))
+			goto out;
+	}
+out:
+	fastlock_release(&ep->util_ep.lock);
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# Run fi_pingpong between two processes over the shm provider, for both
+# message and tagged transfers across all sizes.  This covers the inline and
+# iov paths and needs nothing beyond a single Linux host.
+#
+
+pp=./util/fi_pingpong
+port=$((47600 + $$ % 1000))
+opts="-p shm -e rdm -I 10 -S all -c"
+
+./util/fi_info -p shm > /dev/null 2>&1 || exit 77
+
+for mode in msg tagged; do
+	timeout 60 $pp $opts -m $mode -B $port &
+	server=$!
+	sleep 1
+	timeout 60 $pp $opts -m $mode -P $port 127.0.0.1
+	client=$?
+	wait $server
+	status=$?
+	if [ $client -ne 0 ] || [ $status -ne 0 ]; then
+		echo "shm pingpong ($mode) failed: client $client server $status"
+		exit 1
+	fi
+done
+exit 0
@@ -152,6 +152,7 @@
 #define SOCK_USE_OP_FLAGS (1ULL << 61)
 #define SOCK_TRIGGERED_OP (1ULL << 62)
 #define SOCK_PE_COMM_BUFF_SZ (1024)
+#define SOCK_PE_MAX_GATHER (2 * SOCK_EP_MAX_IOV_LIMIT + 4)
 #define SOCK_PE_OVERFLOW_COMM_BUFF_SZ (128)
 
 /* it must be adjusted if error data size in CQ/EQ
@@ -217,6 +218,9 @@ struct sock_domain {
 	enum fi_progress	progress_mode;
 	struct ofi_mr_map	mr_map;
 	struct sock_pe		*pe;
+	struct sock_pe		**pe_array;
+	int			pe_count;
+	ofi_atomic32_t		pe_next;
 	struct dlist_entry	dom_list_entry;
 	struct fi_domain_attr	attr;
 };
@@ -522,6 +526,7 @@ struct sock_ep_attr {
 	struct sock_eq *eq;
 	struct sock_av *av;
 	struct sock_domain *domain;
+	struct sock_pe *pe;
 
 	struct sock_rx_ctx *rx_ctx;
 	struct sock_tx_ctx *tx_ctx;
@@ -621,6 +626,7 @@ struct sock_rx_ctx {
 	struct sock_av *av;
 	struct sock_eq *eq;
  	struct sock_domain *domain;
+	struct sock_pe *pe;
 
 	struct dlist_entry pe_entry;
 	struct dlist_entry cq_entry;
@@ -661,6 +667,7 @@ struct sock_tx_ctx {
 	struct sock_av *av;
 	struct sock_eq *eq;
  	struct sock_domain *domain;
+	struct sock_pe *pe;
 
 	struct dlist_entry pe_entry;
 	struct dlist_entry cq_entry;
@@ -750,9 +757,8 @@ struct sock_tx_iov {
 struct sock_tx_pe_entry {
 	struct sock_op tx_op;
 	struct sock_comp *comp;
-	uint8_t header_sent;
 	uint8_t send_done;
-	uint8_t reserved[6];
+	uint8_t reserved[7];
 
 	struct sock_tx_ctx *tx_ctx;
 	struct sock_tx_iov tx_iov[SOCK_EP_MAX_IOV_LIMIT];
@@ -995,6 +1001,7 @@ int sock_dom_check_list(struct sock_domain *domain);
 void sock_dom_remove_from_list(struct sock_domain *domain);
 struct sock_domain *sock_dom_list_head(void);
 int sock_dom_check_manual_progress(struct sock_fabric *fabric);
+struct sock_pe *sock_dom_select_pe(struct sock_domain *domain, int shared);
 int sock_query_atomic(struct fid_domain *domain,
 		      enum fi_datatype datatype, enum fi_op op,
 		      struct fi_atomic_attr *attr, uint64_t flags);
@@ -1155,12 +1162,13 @@ ssize_t sock_rx_claim_recv(struct sock_rx_ctx *rx_ctx, void *context,
 			   size_t iov_count);
 void sock_rx_release_entry(struct sock_rx_entry *rx_entry);
 
-ssize_t sock_comm_send(struct sock_pe_entry *pe_entry, const void *buf, size_t len);
+ssize_t sock_comm_sendv(struct sock_pe_entry *pe_entry,
+			struct iovec *iov, size_t iov_cnt);
 ssize_t sock_comm_recv(struct sock_pe_entry *pe_entry, void *buf, size_t len);
+ssize_t sock_comm_recvv(struct sock_pe_entry *pe_entry,
+			struct iovec *iov, size_t iov_cnt);
 ssize_t sock_comm_peek(struct sock_conn *conn, void *buf, size_t len);
 ssize_t sock_comm_discard(struct sock_pe_entry *pe_entry, size_t len);
-int sock_comm_tx_done(struct sock_pe_entry *pe_entry);
-ssize_t sock_comm_flush(struct sock_pe_entry *pe_entry);
 int sock_comm_is_disconnected(struct sock_pe_entry *pe_entry);
 
 ssize_t sock_ep_recvmsg(struct fid_ep *ep, const struct fi_msg *msg,
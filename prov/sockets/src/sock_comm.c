@@ -44,12 +44,23 @@
 #define SOCK_LOG_DBG(...) _SOCK_LOG_DBG(FI_LOG_EP_DATA, __VA_ARGS__)
 #define SOCK_LOG_ERROR(...) _SOCK_LOG_ERROR(FI_LOG_EP_DATA, __VA_ARGS__)
 
-static ssize_t sock_comm_send_socket(struct sock_conn *conn,
-				     const void *buf, size_t len)
+/*
+ * Headers, control fields and user buffers are gathered by the caller and
+ * written with a single sendmsg, so no payload is copied on the tx path.
+ * Returns the number of bytes written; 0 if the socket would block.
+ */
+ssize_t sock_comm_sendv(struct sock_pe_entry *pe_entry,
+			struct iovec *iov, size_t iov_cnt)
 {
+	struct sock_conn *conn = pe_entry->conn;
+	struct msghdr msg;
 	ssize_t ret;
 
-	ret = ofi_send_socket(conn->sock_fd, buf, len, MSG_NOSIGNAL);
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iov_cnt;
+
+	ret = sendmsg(conn->sock_fd, &msg, MSG_NOSIGNAL);
 	if (ret < 0) {
 		if (OFI_SOCK_TRY_SND_RCV_AGAIN(ofi_sockerr())) {
 			ret = 0;
@@ -68,67 +79,6 @@ static ssize_t sock_comm_send_socket(struct sock_conn *conn,
 	return ret;
 }
 
-ssize_t sock_comm_flush(struct sock_pe_entry *pe_entry)
-{
-	ssize_t ret1, ret2 = 0;
-	size_t endlen, len, xfer_len;
-
-	len = ofi_rbused(&pe_entry->comm_buf);
-	endlen = pe_entry->comm_buf.size -
-		(pe_entry->comm_buf.rcnt & pe_entry->comm_buf.size_mask);
-
-	xfer_len = MIN(len, endlen);
-	ret1 = sock_comm_send_socket(pe_entry->conn, (char*)pe_entry->comm_buf.buf +
-				     (pe_entry->comm_buf.rcnt & pe_entry->comm_buf.size_mask),
-				     xfer_len);
-	if (ret1 > 0)
-		pe_entry->comm_buf.rcnt += ret1;
-
-	if (ret1 == xfer_len && xfer_len < len) {
-		ret2 = sock_comm_send_socket(pe_entry->conn, (char*)pe_entry->comm_buf.buf +
-					     (pe_entry->comm_buf.rcnt & pe_entry->comm_buf.size_mask),
-					     len - xfer_len);
-		if (ret2 > 0)
-			pe_entry->comm_buf.rcnt += ret2;
-		else
-			ret2 = 0;
-	}
-
-	return (ret1 > 0) ? ret1 + ret2 : 0;
-}
-
-ssize_t sock_comm_send(struct sock_pe_entry *pe_entry,
-		       const void *buf, size_t len)
-{
-	ssize_t ret, used;
-
-	if (len > pe_entry->cache_sz) {
-		used = ofi_rbused(&pe_entry->comm_buf);
-		if (used == sock_comm_flush(pe_entry)) {
-			return sock_comm_send_socket(pe_entry->conn, buf, len);
-		} else {
-			return 0;
-		}
-	}
-
-	if (ofi_rbavail(&pe_entry->comm_buf) < len) {
-		ret = sock_comm_flush(pe_entry);
-		if (ret <= 0)
-			return 0;
-	}
-
-	ret = MIN(ofi_rbavail(&pe_entry->comm_buf), len);
-	ofi_rbwrite(&pe_entry->comm_buf, buf, ret);
-	ofi_rbcommit(&pe_entry->comm_buf);
-	SOCK_LOG_DBG("buffered %lu\n", ret);
-	return ret;
-}
-
-int sock_comm_tx_done(struct sock_pe_entry *pe_entry)
-{
-	return ofi_rbempty(&pe_entry->comm_buf);
-}
-
 static ssize_t sock_comm_recv_socket(struct sock_conn *conn,
 			      void *buf, size_t len)
 {
@@ -188,6 +138,58 @@ ssize_t sock_comm_recv(struct sock_pe_entry *pe_entry, void *buf, size_t len)
 	return read_len;
 }
 
+/*
+ * Receive into a list of buffers.  Data already staged in the comm buffer
+ * by an earlier header read is drained first; the remainder is read from
+ * the socket directly into the caller's buffers.  The iov array is used
+ * as scratch space.
+ */
+ssize_t sock_comm_recvv(struct sock_pe_entry *pe_entry,
+			struct iovec *iov, size_t iov_cnt)
+{
+	struct sock_conn *conn = pe_entry->conn;
+	struct msghdr msg;
+	ssize_t ret, len = 0;
+	size_t i = 0, n;
+
+	while (i < iov_cnt && !ofi_rbempty(&pe_entry->comm_buf)) {
+		n = MIN(iov[i].iov_len, ofi_rbused(&pe_entry->comm_buf));
+		ofi_rbread(&pe_entry->comm_buf, iov[i].iov_base, n);
+		len += n;
+		if (n == iov[i].iov_len) {
+			i++;
+		} else {
+			iov[i].iov_base = (char *) iov[i].iov_base + n;
+			iov[i].iov_len -= n;
+		}
+	}
+	if (len)
+		SOCK_LOG_DBG("read from buffer: %lu\n", len);
+	if (i == iov_cnt)
+		return len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov[i];
+	msg.msg_iovlen = iov_cnt - i;
+
+	ret = recvmsg(conn->sock_fd, &msg, 0);
+	if (ret == 0) {
+		conn->connected = 0;
+		SOCK_LOG_DBG("Disconnected: %s:%d\n",
+			     inet_ntoa(conn->addr.sin_addr),
+			     ntohs(conn->addr.sin_port));
+		return len;
+	}
+
+	if (ret < 0) {
+		SOCK_LOG_DBG("read %s\n", strerror(ofi_sockerr()));
+		return len;
+	}
+
+	SOCK_LOG_DBG("read from network: %lu\n", ret);
+	return len + ret;
+}
+
 ssize_t sock_comm_peek(struct sock_conn *conn, void *buf, size_t len)
 {
 	ssize_t ret;
@@ -169,6 +169,56 @@ int sock_verify_domain_attr(uint32_t version, const struct fi_domain_attr *attr)
 	return 0;
 }
 
+static void sock_dom_pe_fini(struct sock_domain *dom)
+{
+	int i;
+
+	for (i = 0; i < dom->pe_count; i++)
+		sock_pe_finalize(dom->pe_array[i]);
+	free(dom->pe_array);
+}
+
+/*
+ * Progress is sharded across FI_SOCKETS_PE_COUNT engines, each with its own
+ * thread, epoll set and PE table.  The first engine also serves shared
+ * contexts, so it is exposed as dom->pe.
+ */
+static int sock_dom_pe_init(struct sock_domain *dom)
+{
+	dom->pe_array = calloc(sock_pe_count, sizeof(*dom->pe_array));
+	if (!dom->pe_array)
+		return -FI_ENOMEM;
+
+	for (dom->pe_count = 0; dom->pe_count < sock_pe_count;
+	     dom->pe_count++) {
+		dom->pe_array[dom->pe_count] = sock_pe_init(dom);
+		if (!dom->pe_array[dom->pe_count]) {
+			sock_dom_pe_fini(dom);
+			return -FI_ENOMEM;
+		}
+	}
+
+	dom->pe = dom->pe_array[0];
+	ofi_atomic_initialize32(&dom->pe_next, 0);
+	return 0;
+}
+
+/*
+ * Endpoints are spread round-robin over the progress engines.  Shared
+ * contexts may be progressed on behalf of several endpoints, so they and the
+ * endpoints that use them stay on the first engine.
+ */
+struct sock_pe *sock_dom_select_pe(struct sock_domain *domain, int shared)
+{
+	int idx;
+
+	if (shared || domain->pe_count == 1)
+		return domain->pe;
+
+	idx = ofi_atomic_inc32(&domain->pe_next) - 1;
+	return domain->pe_array[(unsigned) idx % domain->pe_count];
+}
+
 static int sock_dom_close(struct fid *fid)
 {
 	struct sock_domain *dom;
@@ -176,7 +226,7 @@ static int sock_dom_close(struct fid *fid)
 	if (ofi_atomic_get32(&dom->ref))
 		return -FI_EBUSY;
 
-	sock_pe_finalize(dom->pe);
+	sock_dom_pe_fini(dom);
 	fastlock_destroy(&dom->lock);
 	ofi_mr_map_close(&dom->mr_map);
 	sock_dom_remove_from_list(dom);
@@ -482,8 +532,7 @@ int sock_domain(struct fid_fabric *fabric, struct fi_info *info,
 	else
 		sock_domain->progress_mode = info->domain_attr->data_progress;
 
-	sock_domain->pe = sock_pe_init(sock_domain);
-	if (!sock_domain->pe) {
+	if (sock_dom_pe_init(sock_domain)) {
 		SOCK_LOG_ERROR("Failed to init PE\n");
 		goto err1;
 	}
@@ -505,7 +554,7 @@ int sock_domain(struct fid_fabric *fabric, struct fi_info *info,
 	return 0;
 
 err2:
-	sock_pe_finalize(sock_domain->pe);
+	sock_dom_pe_fini(sock_domain);
 err1:
 	fastlock_destroy(&sock_domain->lock);
 	free(sock_domain);
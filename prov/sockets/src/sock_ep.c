@@ -287,7 +287,7 @@ static int sock_ctx_enable(struct fid_ep *ep)
 	switch (ep->fid.fclass) {
 	case FI_CLASS_RX_CTX:
 		rx_ctx = container_of(ep, struct sock_rx_ctx, ctx.fid);
-		sock_pe_add_rx_ctx(rx_ctx->domain->pe, rx_ctx);
+		sock_pe_add_rx_ctx(rx_ctx->pe, rx_ctx);
 
 		if (!rx_ctx->ep_attr->listener.listener_thread &&
 		    sock_conn_listen(rx_ctx->ep_attr)) {
@@ -298,7 +298,7 @@ static int sock_ctx_enable(struct fid_ep *ep)
 
 	case FI_CLASS_TX_CTX:
 		tx_ctx = container_of(ep, struct sock_tx_ctx, fid.ctx.fid);
-		sock_pe_add_tx_ctx(tx_ctx->domain->pe, tx_ctx);
+		sock_pe_add_tx_ctx(tx_ctx->pe, tx_ctx);
 
 		if (!tx_ctx->ep_attr->listener.listener_thread &&
 		    sock_conn_listen(tx_ctx->ep_attr)) {
@@ -691,7 +691,7 @@ static int sock_ep_close(struct fid *fid)
 		fastlock_release(&sock_ep->attr->av->list_lock);
 	}
 
-	pthread_mutex_lock(&sock_ep->attr->domain->pe->list_lock);
+	pthread_mutex_lock(&sock_ep->attr->pe->list_lock);
 	if (sock_ep->attr->tx_shared) {
 		fastlock_acquire(&sock_ep->attr->tx_ctx->lock);
 		dlist_remove(&sock_ep->attr->tx_ctx_entry);
@@ -703,7 +703,7 @@ static int sock_ep_close(struct fid *fid)
 		dlist_remove(&sock_ep->attr->rx_ctx_entry);
 		fastlock_release(&sock_ep->attr->rx_ctx->lock);
 	}
-	pthread_mutex_unlock(&sock_ep->attr->domain->pe->list_lock);
+	pthread_mutex_unlock(&sock_ep->attr->pe->list_lock);
 
 	if (sock_ep->attr->listener.do_listen) {
 		sock_ep->attr->listener.do_listen = 0;
@@ -756,10 +756,10 @@ static int sock_ep_close(struct fid *fid)
 	if (sock_ep->attr->dest_addr)
 		free(sock_ep->attr->dest_addr);
 
-	fastlock_acquire(&sock_ep->attr->domain->pe->lock);
+	fastlock_acquire(&sock_ep->attr->pe->lock);
 	ofi_idm_reset(&sock_ep->attr->av_idm);
 	sock_conn_map_destroy(sock_ep->attr);
-	fastlock_release(&sock_ep->attr->domain->pe->lock);
+	fastlock_release(&sock_ep->attr->pe->lock);
 
 	ofi_atomic_dec32(&sock_ep->attr->domain->ref);
 	fastlock_destroy(&sock_ep->attr->lock);
@@ -768,6 +768,22 @@ static int sock_ep_close(struct fid *fid)
 	return 0;
 }
 
+/* An endpoint bound to a shared context is progressed by that context's PE */
+static void sock_ep_set_pe(struct sock_ep_attr *attr, struct sock_pe *pe)
+{
+	size_t i;
+
+	attr->pe = pe;
+	for (i = 0; i < attr->ep_attr.tx_ctx_cnt; i++) {
+		if (attr->tx_array[i])
+			attr->tx_array[i]->pe = pe;
+	}
+	for (i = 0; i < attr->ep_attr.rx_ctx_cnt; i++) {
+		if (attr->rx_array[i])
+			attr->rx_array[i]->pe = pe;
+	}
+}
+
 static int sock_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
 {
 	int ret;
@@ -915,6 +931,7 @@ static int sock_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
 
 		ep->attr->tx_ctx->use_shared = 1;
 		ep->attr->tx_ctx->stx_ctx = tx_ctx;
+		sock_ep_set_pe(ep->attr, tx_ctx->pe);
 		break;
 
 	case FI_CLASS_SRX_CTX:
@@ -925,6 +942,7 @@ static int sock_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
 
 		ep->attr->rx_ctx->use_shared = 1;
 		ep->attr->rx_ctx->srx_ctx = rx_ctx;
+		sock_ep_set_pe(ep->attr, rx_ctx->pe);
 		break;
 
 	default:
@@ -1019,11 +1037,11 @@ int sock_ep_enable(struct fid_ep *ep)
 			tx_ctx->enabled = 1;
 			if (tx_ctx->use_shared) {
 				if (tx_ctx->stx_ctx) {
-					sock_pe_add_tx_ctx(tx_ctx->domain->pe, tx_ctx->stx_ctx);
+					sock_pe_add_tx_ctx(tx_ctx->stx_ctx->pe, tx_ctx->stx_ctx);
 					tx_ctx->stx_ctx->enabled = 1;
 				}
 			} else {
-				sock_pe_add_tx_ctx(tx_ctx->domain->pe, tx_ctx);
+				sock_pe_add_tx_ctx(tx_ctx->pe, tx_ctx);
 			}
 		}
 	}
@@ -1034,11 +1052,11 @@ int sock_ep_enable(struct fid_ep *ep)
 			rx_ctx->enabled = 1;
 			if (rx_ctx->use_shared) {
 				if (rx_ctx->srx_ctx) {
-					sock_pe_add_rx_ctx(rx_ctx->domain->pe, rx_ctx->srx_ctx);
+					sock_pe_add_rx_ctx(rx_ctx->srx_ctx->pe, rx_ctx->srx_ctx);
 					rx_ctx->srx_ctx->enabled = 1;
 				}
 			} else {
-				sock_pe_add_rx_ctx(rx_ctx->domain->pe, rx_ctx);
+				sock_pe_add_rx_ctx(rx_ctx->pe, rx_ctx);
 			}
 		}
 	}
@@ -1162,6 +1180,7 @@ static int sock_ep_tx_ctx(struct fid_ep *ep, int index, struct fi_tx_attr *attr,
 	tx_ctx->tx_id = index;
 	tx_ctx->ep_attr = sock_ep->attr;
 	tx_ctx->domain = sock_ep->attr->domain;
+	tx_ctx->pe = sock_ep->attr->pe;
 	if (tx_ctx->rx_ctrl_ctx && tx_ctx->rx_ctrl_ctx->is_ctrl_ctx)
 		tx_ctx->rx_ctrl_ctx->domain = sock_ep->attr->domain;
 	tx_ctx->av = sock_ep->attr->av;
@@ -1205,6 +1224,7 @@ static int sock_ep_rx_ctx(struct fid_ep *ep, int index, struct fi_rx_attr *attr,
 	rx_ctx->rx_id = index;
 	rx_ctx->ep_attr = sock_ep->attr;
 	rx_ctx->domain = sock_ep->attr->domain;
+	rx_ctx->pe = sock_ep->attr->pe;
 	rx_ctx->av = sock_ep->attr->av;
 	dlist_insert_tail(&sock_ep->attr->rx_ctx_entry, &rx_ctx->ep_list);
 
@@ -1268,6 +1288,7 @@ int sock_stx_ctx(struct fid_domain *domain,
 		return -FI_ENOMEM;
 
 	tx_ctx->domain = dom;
+	tx_ctx->pe = sock_dom_select_pe(dom, 1);
 	if (tx_ctx->rx_ctrl_ctx && tx_ctx->rx_ctrl_ctx->is_ctrl_ctx)
 		tx_ctx->rx_ctrl_ctx->domain = dom;
 
@@ -1317,6 +1338,7 @@ int sock_srx_ctx(struct fid_domain *domain,
 		return -FI_ENOMEM;
 
 	rx_ctx->domain = dom;
+	rx_ctx->pe = sock_dom_select_pe(dom, 1);
 	rx_ctx->ctx.fid.fclass = FI_CLASS_SRX_CTX;
 
 	rx_ctx->ctx.fid.ops = &sock_ctx_ops;
@@ -1726,6 +1748,10 @@ int sock_alloc_endpoint(struct fid_domain *domain, struct fi_info *info,
 		sock_ep->attr->ep_attr.rx_ctx_cnt = 1;
 	}
 
+	sock_ep->attr->pe = sock_dom_select_pe(sock_dom,
+					       sock_ep->attr->tx_shared ||
+					       sock_ep->attr->rx_shared);
+
 	sock_ep->attr->tx_array = calloc(sock_ep->attr->ep_attr.tx_ctx_cnt,
 				   sizeof(struct sock_tx_ctx *));
 	if (!sock_ep->attr->tx_array) {
@@ -1750,6 +1776,7 @@ int sock_alloc_endpoint(struct fid_domain *domain, struct fi_info *info,
 		}
 		tx_ctx->ep_attr = sock_ep->attr;
 		tx_ctx->domain = sock_dom;
+		tx_ctx->pe = sock_ep->attr->pe;
 		if (tx_ctx->rx_ctrl_ctx && tx_ctx->rx_ctrl_ctx->is_ctrl_ctx)
 			tx_ctx->rx_ctrl_ctx->domain = sock_dom;
 		tx_ctx->tx_id = 0;
@@ -1766,6 +1793,7 @@ int sock_alloc_endpoint(struct fid_domain *domain, struct fi_info *info,
 		}
 		rx_ctx->ep_attr = sock_ep->attr;
 		rx_ctx->domain = sock_dom;
+		rx_ctx->pe = sock_ep->attr->pe;
 		rx_ctx->rx_id = 0;
 		dlist_insert_tail(&sock_ep->attr->rx_ctx_entry, &rx_ctx->ep_list);
 		sock_ep->attr->rx_array[0] = rx_ctx;
@@ -1814,7 +1842,7 @@ err1:
 
 void sock_ep_remove_conn(struct sock_ep_attr *attr, struct sock_conn *conn)
 {
-	sock_pe_poll_del(attr->domain->pe, conn->sock_fd);
+	sock_pe_poll_del(attr->pe, conn->sock_fd);
 	sock_conn_release_entry(&attr->cmap, conn);
 }
 
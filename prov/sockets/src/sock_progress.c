@@ -85,25 +85,75 @@ static inline int sock_pe_is_data_msg(int msg_id)
 	}
 }
 
-static inline ssize_t sock_pe_send_field(struct sock_pe_entry *pe_entry,
-					 void *field, size_t field_len,
-					 size_t start_offset)
+/*
+ * A message is described as a sequence of fields at increasing offsets.
+ * Fields, or their remainder, that have not been transferred yet according
+ * to done_len are collected into an iovec and moved with a single
+ * sendmsg/recvmsg, so partially transferred messages resume where they
+ * left off.
+ */
+struct sock_pe_gather {
+	struct iovec iov[SOCK_PE_MAX_GATHER];
+	size_t count;
+	size_t len;
+};
+
+static inline void sock_pe_gather_init(struct sock_pe_gather *gather)
 {
-	int ret;
-	size_t offset, data_len;
+	gather->count = 0;
+	gather->len = 0;
+}
 
-	if (pe_entry->done_len >= start_offset + field_len)
+static inline void sock_pe_gather_field(struct sock_pe_entry *pe_entry,
+					struct sock_pe_gather *gather,
+					void *field, size_t field_len,
+					size_t start_offset)
+{
+	size_t offset;
+
+	if (!field_len || pe_entry->done_len >= start_offset + field_len)
+		return;
+
+	offset = (pe_entry->done_len > start_offset) ?
+		 pe_entry->done_len - start_offset : 0;
+
+	assert(gather->count < SOCK_PE_MAX_GATHER);
+	gather->iov[gather->count].iov_base = (char *) field + offset;
+	gather->iov[gather->count].iov_len = field_len - offset;
+	gather->len += field_len - offset;
+	gather->count++;
+}
+
+static inline ssize_t sock_pe_send_gather(struct sock_pe_entry *pe_entry,
+					  struct sock_pe_gather *gather)
+{
+	ssize_t ret;
+
+	if (!gather->count)
 		return 0;
 
-	offset = pe_entry->done_len - start_offset;
-	data_len = field_len - offset;
-	ret = sock_comm_send(pe_entry, (char *) field + offset, data_len);
+	ret = sock_comm_sendv(pe_entry, gather->iov, gather->count);
+	if (ret <= 0)
+		return -1;
+
+	pe_entry->done_len += ret;
+	return ((size_t) ret == gather->len) ? 0 : -1;
+}
+
+static inline ssize_t sock_pe_recv_gather(struct sock_pe_entry *pe_entry,
+					  struct sock_pe_gather *gather)
+{
+	ssize_t ret;
+
+	if (!gather->count)
+		return 0;
 
+	ret = sock_comm_recvv(pe_entry, gather->iov, gather->count);
 	if (ret <= 0)
 		return -1;
 
 	pe_entry->done_len += ret;
-	return (ret == data_len) ? 0 : -1;
+	return ((size_t) ret == gather->len) ? 0 : -1;
 }
 
 static inline ssize_t sock_pe_recv_field(struct sock_pe_entry *pe_entry,
@@ -463,6 +513,7 @@ static void sock_pe_progress_pending_ack(struct sock_pe *pe,
 {
 	int len, data_len, i;
 	struct sock_conn *conn = pe_entry->conn;
+	struct sock_pe_gather gather;
 
 	if (!conn || pe_entry->rem)
 		return;
@@ -478,19 +529,18 @@ static void sock_pe_progress_pending_ack(struct sock_pe *pe,
 		conn->tx_pe_entry = pe_entry;
 	}
 
-	if (sock_pe_send_field(pe_entry, &pe_entry->response,
-			       sizeof(pe_entry->response), 0))
-		return;
+	sock_pe_gather_init(&gather);
+	sock_pe_gather_field(pe_entry, &gather, &pe_entry->response,
+			     sizeof(pe_entry->response), 0);
 	len = sizeof(struct sock_msg_response);
 
 	switch (pe_entry->response.msg_hdr.op_type) {
 	case SOCK_OP_READ_COMPLETE:
 		for (i = 0; i < pe_entry->msg_hdr.dest_iov_len; i++) {
-			if (sock_pe_send_field(
-				    pe_entry,
-				    (char *) (uintptr_t) pe_entry->pe.rx.rx_iov[i].iov.addr,
-				    pe_entry->pe.rx.rx_iov[i].iov.len, len))
-				return;
+			sock_pe_gather_field(
+				pe_entry, &gather,
+				(char *) (uintptr_t) pe_entry->pe.rx.rx_iov[i].iov.addr,
+				pe_entry->pe.rx.rx_iov[i].iov.len, len);
 			len += pe_entry->pe.rx.rx_iov[i].iov.len;
 		}
 		break;
@@ -498,10 +548,9 @@ static void sock_pe_progress_pending_ack(struct sock_pe *pe,
 	case SOCK_OP_ATOMIC_COMPLETE:
 		data_len = pe_entry->total_len - len;
 		if (data_len) {
-			if (sock_pe_send_field(pe_entry,
-					       pe_entry->pe.rx.atomic_cmp,
-					       data_len, len))
-				return;
+			sock_pe_gather_field(pe_entry, &gather,
+					     pe_entry->pe.rx.atomic_cmp,
+					     data_len, len);
 			len += data_len;
 		}
 		break;
@@ -510,10 +559,10 @@ static void sock_pe_progress_pending_ack(struct sock_pe *pe,
 		break;
 	}
 
+	if (sock_pe_send_gather(pe_entry, &gather))
+		return;
+
 	if (pe_entry->total_len == pe_entry->done_len && !pe_entry->rem) {
-		sock_comm_flush(pe_entry);
-		if (!sock_comm_tx_done(pe_entry))
-			return;
 		pe_entry->is_complete = 1;
 		pe_entry->pe.rx.pending_send = 0;
 		pe_entry->conn->tx_pe_entry = NULL;
@@ -628,6 +677,7 @@ static int sock_pe_handle_read_complete(struct sock_pe *pe,
 {
 	struct sock_pe_entry *waiting_entry;
 	struct sock_msg_response *response;
+	struct sock_pe_gather gather;
 	int len, i;
 
 	if (sock_pe_read_response(pe_entry))
@@ -642,15 +692,17 @@ static int sock_pe_handle_read_complete(struct sock_pe *pe,
 	waiting_entry = &pe->pe_table[response->pe_entry_id];
 	assert(waiting_entry->type == SOCK_PE_TX);
 
+	sock_pe_gather_init(&gather);
 	len = sizeof(struct sock_msg_response);
 	for (i = 0; i < waiting_entry->pe.tx.tx_op.dest_iov_len; i++) {
-		if (sock_pe_recv_field(
-			    pe_entry,
-			    (char *) (uintptr_t) waiting_entry->pe.tx.tx_iov[i].dst.iov.addr,
-			    waiting_entry->pe.tx.tx_iov[i].dst.iov.len, len))
-			return 0;
+		sock_pe_gather_field(
+			pe_entry, &gather,
+			(char *) (uintptr_t) waiting_entry->pe.tx.tx_iov[i].dst.iov.addr,
+			waiting_entry->pe.tx.tx_iov[i].dst.iov.len, len);
 		len += waiting_entry->pe.tx.tx_iov[i].dst.iov.len;
 	}
+	if (sock_pe_recv_gather(pe_entry, &gather))
+		return 0;
 
 	sock_pe_report_read_completion(waiting_entry);
 	waiting_entry->is_complete = 1;
@@ -779,6 +831,7 @@ static int sock_pe_process_rx_write(struct sock_pe *pe,
 {
 	int i, ret = 0;
 	struct sock_mr *mr;
+	struct sock_pe_gather gather;
 	uint64_t rem, len, entry_len;
 
 	len = sizeof(struct sock_msg_hdr);
@@ -814,15 +867,17 @@ static int sock_pe_process_rx_write(struct sock_pe *pe,
 	}
 	pe_entry->mr_checked = 1;
 
+	sock_pe_gather_init(&gather);
 	rem = pe_entry->msg_hdr.msg_len - len;
 	for (i = 0; rem > 0 && i < pe_entry->msg_hdr.dest_iov_len; i++) {
-		if (sock_pe_recv_field(pe_entry,
-				       (void *) (uintptr_t) pe_entry->pe.rx.rx_iov[i].iov.addr,
-				       pe_entry->pe.rx.rx_iov[i].iov.len, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, &gather,
+				     (void *) (uintptr_t) pe_entry->pe.rx.rx_iov[i].iov.addr,
+				     pe_entry->pe.rx.rx_iov[i].iov.len, len);
 		len += pe_entry->pe.rx.rx_iov[i].iov.len;
 		rem -= pe_entry->pe.rx.rx_iov[i].iov.len;
 	}
+	if (sock_pe_recv_gather(pe_entry, &gather))
+		return 0;
 	pe_entry->buf = pe_entry->pe.rx.rx_iov[0].iov.addr;
 	pe_entry->data_len = 0;
 	for (i = 0; i < pe_entry->msg_hdr.dest_iov_len; i++) {
@@ -1295,9 +1350,10 @@ static int sock_pe_process_rx_send(struct sock_pe *pe,
 {
 	ssize_t i, ret = 0;
 	struct sock_rx_entry *rx_entry;
-	uint64_t len, rem, offset, data_len, done_data, used;
+	struct iovec iov[SOCK_EP_MAX_IOV_LIMIT];
+	size_t iov_cnt;
+	uint64_t len, rem, data_len, done_data, used;
 
-	offset = 0;
 	len = sizeof(struct sock_msg_hdr);
 
 	if (pe_entry->msg_hdr.op_type == SOCK_OP_TSEND) {
@@ -1356,7 +1412,10 @@ static int sock_pe_process_rx_send(struct sock_pe *pe,
 	rem = pe_entry->data_len - done_data;
 	used = rx_entry->used;
 
-	for (i = 0; rem > 0 && i < rx_entry->rx_op.dest_iov_len; i++) {
+	/* read the payload directly into the unused part of the posted buffers */
+	data_len = 0;
+	for (i = 0, iov_cnt = 0;
+	     data_len < rem && i < rx_entry->rx_op.dest_iov_len; i++) {
 
 		/* skip used contents in rx_entry */
 		if (used >= rx_entry->iov[i].iov.len) {
@@ -1364,18 +1423,23 @@ static int sock_pe_process_rx_send(struct sock_pe *pe,
 			continue;
 		}
 
-		offset = used;
-		data_len = MIN(rx_entry->iov[i].iov.len - used, rem);
-		ret = sock_comm_recv(pe_entry,
-				     (char *) (uintptr_t) rx_entry->iov[i].iov.addr + offset,
-				     data_len);
+		iov[iov_cnt].iov_base =
+			(char *) (uintptr_t) rx_entry->iov[i].iov.addr + used;
+		iov[iov_cnt].iov_len = MIN(rx_entry->iov[i].iov.len - used,
+					   rem - data_len);
+		data_len += iov[iov_cnt].iov_len;
+		if (!pe_entry->buf)
+			pe_entry->buf = rx_entry->iov[i].iov.addr + used;
+		iov_cnt++;
+		used = 0;
+	}
+
+	if (iov_cnt) {
+		ret = sock_comm_recvv(pe_entry, iov, iov_cnt);
 		if (ret <= 0)
 			return ret;
 
-		if (!pe_entry->buf)
-			pe_entry->buf = rx_entry->iov[i].iov.addr + offset;
 		rem -= ret;
-		used = 0;
 		pe_entry->done_len += ret;
 		rx_entry->used += ret;
 		if (ret != data_len)
@@ -1623,7 +1687,7 @@ static int sock_pe_read_hdr(struct sock_pe *pe, struct sock_rx_ctx *rx_ctx,
 
 static int sock_pe_progress_tx_atomic(struct sock_pe *pe,
 				      struct sock_pe_entry *pe_entry,
-				      struct sock_conn *conn)
+				      struct sock_pe_gather *gather)
 {
 	int datatype_sz;
 	union sock_iov iov[SOCK_EP_MAX_IOV_LIMIT];
@@ -1634,14 +1698,13 @@ static int sock_pe_progress_tx_atomic(struct sock_pe *pe,
 
 	len = sizeof(struct sock_msg_hdr);
 	entry_len = sizeof(struct sock_atomic_req) - sizeof(struct sock_msg_hdr);
-	if (sock_pe_send_field(pe_entry, &pe_entry->pe.tx.tx_op, entry_len, len))
-		return 0;
+	sock_pe_gather_field(pe_entry, gather, &pe_entry->pe.tx.tx_op,
+			     entry_len, len);
 	len += entry_len;
 
 	if (pe_entry->flags & FI_REMOTE_CQ_DATA) {
-		if (sock_pe_send_field(pe_entry, &pe_entry->data,
-				       SOCK_CQ_DATA_SIZE, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather, &pe_entry->data,
+				     SOCK_CQ_DATA_SIZE, len);
 		len += SOCK_CQ_DATA_SIZE;
 	}
 
@@ -1653,49 +1716,43 @@ static int sock_pe_progress_tx_atomic(struct sock_pe *pe,
 		iov[i].ioc.key = pe_entry->pe.tx.tx_iov[i].dst.ioc.key;
 	}
 
-	if (sock_pe_send_field(pe_entry, &iov[0], entry_len, len))
-		return 0;
+	sock_pe_gather_field(pe_entry, gather, &iov[0], entry_len, len);
 	len += entry_len;
 
 	datatype_sz = ofi_datatype_size(pe_entry->pe.tx.tx_op.atomic.datatype);
 	if (pe_entry->flags & FI_INJECT) {
 		/* cmp data */
-		if (sock_pe_send_field(pe_entry,
-					&pe_entry->pe.tx.inject[0] + pe_entry->pe.tx.tx_op.src_iov_len,
-					pe_entry->pe.tx.tx_op.atomic.cmp_iov_len, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather,
+				     &pe_entry->pe.tx.inject[0] + pe_entry->pe.tx.tx_op.src_iov_len,
+				     pe_entry->pe.tx.tx_op.atomic.cmp_iov_len, len);
 		len += pe_entry->pe.tx.tx_op.atomic.cmp_iov_len;
 		/* data */
-		if (sock_pe_send_field(pe_entry,
-				       &pe_entry->pe.tx.inject[0],
-				       pe_entry->pe.tx.tx_op.src_iov_len, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather,
+				     &pe_entry->pe.tx.inject[0],
+				     pe_entry->pe.tx.tx_op.src_iov_len, len);
 		len += pe_entry->pe.tx.tx_op.src_iov_len;
 	} else {
 		/* cmp data */
 		for (i = 0; i < pe_entry->pe.tx.tx_op.atomic.cmp_iov_len; i++) {
-			if (sock_pe_send_field(pe_entry,
-						(void *) (uintptr_t) pe_entry->pe.tx.tx_iov[i].cmp.ioc.addr,
-						pe_entry->pe.tx.tx_iov[i].cmp.ioc.count *
-						datatype_sz, len))
-			return 0;
+			sock_pe_gather_field(pe_entry, gather,
+					     (void *) (uintptr_t) pe_entry->pe.tx.tx_iov[i].cmp.ioc.addr,
+					     pe_entry->pe.tx.tx_iov[i].cmp.ioc.count *
+					     datatype_sz, len);
 			len += (pe_entry->pe.tx.tx_iov[i].cmp.ioc.count * datatype_sz);
 		}
 		/* data */
 		for (i = 0; i < pe_entry->pe.tx.tx_op.src_iov_len; i++) {
 			if (pe_entry->pe.tx.tx_op.atomic.op != FI_ATOMIC_READ) {
-				if (sock_pe_send_field(pe_entry,
+				sock_pe_gather_field(pe_entry, gather,
 				    (void *) (uintptr_t) pe_entry->pe.tx.tx_iov[i].src.ioc.addr,
 				    pe_entry->pe.tx.tx_iov[i].src.ioc.count *
-				    datatype_sz, len))
-					return 0;
+				    datatype_sz, len);
 				len += (pe_entry->pe.tx.tx_iov[i].src.ioc.count * datatype_sz);
 			}
 		}
 	}
 
-	sock_comm_flush(pe_entry);
-	if (!sock_comm_tx_done(pe_entry))
+	if (sock_pe_send_gather(pe_entry, gather))
 		return 0;
 
 	if (pe_entry->done_len == pe_entry->total_len) {
@@ -1715,7 +1772,7 @@ static int sock_pe_progress_tx_atomic(struct sock_pe *pe,
 
 static int sock_pe_progress_tx_write(struct sock_pe *pe,
 				     struct sock_pe_entry *pe_entry,
-				     struct sock_conn *conn)
+				     struct sock_pe_gather *gather)
 {
 	union sock_iov dest_iov[SOCK_EP_MAX_IOV_LIMIT];
 	ssize_t len, i, dest_iov_len;
@@ -1725,9 +1782,8 @@ static int sock_pe_progress_tx_write(struct sock_pe *pe,
 
 	len = sizeof(struct sock_msg_hdr);
 	if (pe_entry->flags & FI_REMOTE_CQ_DATA) {
-		if (sock_pe_send_field(pe_entry, &pe_entry->data,
-				       SOCK_CQ_DATA_SIZE, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather, &pe_entry->data,
+				     SOCK_CQ_DATA_SIZE, len);
 		len += SOCK_CQ_DATA_SIZE;
 	}
 
@@ -1738,32 +1794,27 @@ static int sock_pe_progress_tx_write(struct sock_pe *pe,
 		dest_iov[i].iov.len = pe_entry->pe.tx.tx_iov[i].dst.iov.len;
 		dest_iov[i].iov.key = pe_entry->pe.tx.tx_iov[i].dst.iov.key;
 	}
-	if (sock_pe_send_field(pe_entry, &dest_iov[0], dest_iov_len, len))
-		return 0;
+	sock_pe_gather_field(pe_entry, gather, &dest_iov[0], dest_iov_len, len);
 	len += dest_iov_len;
 
 	/* data */
 	if (pe_entry->flags & FI_INJECT) {
-		if (sock_pe_send_field(pe_entry, &pe_entry->pe.tx.inject[0],
-				       pe_entry->pe.tx.tx_op.src_iov_len, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather, &pe_entry->pe.tx.inject[0],
+				     pe_entry->pe.tx.tx_op.src_iov_len, len);
 		len += pe_entry->pe.tx.tx_op.src_iov_len;
 		pe_entry->data_len = pe_entry->pe.tx.tx_op.src_iov_len;
 	} else {
 		pe_entry->data_len = 0;
 		for (i = 0; i < pe_entry->pe.tx.tx_op.src_iov_len; i++) {
-			if (sock_pe_send_field(
-				    pe_entry,
-				    (void *) (uintptr_t) pe_entry->pe.tx.tx_iov[i].src.iov.addr,
-				    pe_entry->pe.tx.tx_iov[i].src.iov.len, len))
-				return 0;
+			sock_pe_gather_field(pe_entry, gather,
+				(void *) (uintptr_t) pe_entry->pe.tx.tx_iov[i].src.iov.addr,
+				pe_entry->pe.tx.tx_iov[i].src.iov.len, len);
 			len += pe_entry->pe.tx.tx_iov[i].src.iov.len;
 			pe_entry->data_len += pe_entry->pe.tx.tx_iov[i].src.iov.len;
 		}
 	}
 
-	sock_comm_flush(pe_entry);
-	if (!sock_comm_tx_done(pe_entry))
+	if (sock_pe_send_gather(pe_entry, gather))
 		return 0;
 
 	if (pe_entry->done_len == pe_entry->total_len) {
@@ -1778,7 +1829,7 @@ static int sock_pe_progress_tx_write(struct sock_pe *pe,
 
 static int sock_pe_progress_tx_read(struct sock_pe *pe,
 				    struct sock_pe_entry *pe_entry,
-				    struct sock_conn *conn)
+				    struct sock_pe_gather *gather)
 {
 	union sock_iov src_iov[SOCK_EP_MAX_IOV_LIMIT];
 	ssize_t len, i, src_iov_len;
@@ -1798,12 +1849,10 @@ static int sock_pe_progress_tx_read(struct sock_pe *pe,
 		pe_entry->data_len += pe_entry->pe.tx.tx_iov[i].src.iov.len;
 	}
 
-	if (sock_pe_send_field(pe_entry, &src_iov[0], src_iov_len, len))
-		return 0;
+	sock_pe_gather_field(pe_entry, gather, &src_iov[0], src_iov_len, len);
 	len += src_iov_len;
 
-	sock_comm_flush(pe_entry);
-	if (!sock_comm_tx_done(pe_entry))
+	if (sock_pe_send_gather(pe_entry, gather))
 		return 0;
 
 	if (pe_entry->done_len == pe_entry->total_len) {
@@ -1819,7 +1868,7 @@ static int sock_pe_progress_tx_read(struct sock_pe *pe,
 
 static int sock_pe_progress_tx_send(struct sock_pe *pe,
 				    struct sock_pe_entry *pe_entry,
-				    struct sock_conn *conn)
+				    struct sock_pe_gather *gather)
 {
 	size_t len, i;
 	if (pe_entry->pe.tx.send_done)
@@ -1827,39 +1876,34 @@ static int sock_pe_progress_tx_send(struct sock_pe *pe,
 
 	len = sizeof(struct sock_msg_hdr);
 	if (pe_entry->pe.tx.tx_op.op == SOCK_OP_TSEND) {
-		if (sock_pe_send_field(pe_entry, &pe_entry->tag,
-				       SOCK_TAG_SIZE, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather, &pe_entry->tag,
+				     SOCK_TAG_SIZE, len);
 		len += SOCK_TAG_SIZE;
 	}
 
 	if (pe_entry->flags & FI_REMOTE_CQ_DATA) {
-		if (sock_pe_send_field(pe_entry, &pe_entry->data,
-				       SOCK_CQ_DATA_SIZE, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather, &pe_entry->data,
+				     SOCK_CQ_DATA_SIZE, len);
 		len += SOCK_CQ_DATA_SIZE;
 	}
 
 	if (pe_entry->flags & FI_INJECT) {
-		if (sock_pe_send_field(pe_entry, pe_entry->pe.tx.inject,
-				       pe_entry->pe.tx.tx_op.src_iov_len, len))
-			return 0;
+		sock_pe_gather_field(pe_entry, gather, pe_entry->pe.tx.inject,
+				     pe_entry->pe.tx.tx_op.src_iov_len, len);
 		len += pe_entry->pe.tx.tx_op.src_iov_len;
 		pe_entry->data_len = pe_entry->pe.tx.tx_op.src_iov_len;
 	} else {
 		pe_entry->data_len = 0;
 		for (i = 0; i < pe_entry->pe.tx.tx_op.src_iov_len; i++) {
-			if (sock_pe_send_field(pe_entry,
-				    (void *) (uintptr_t) pe_entry->pe.tx.tx_iov[i].src.iov.addr,
-				    pe_entry->pe.tx.tx_iov[i].src.iov.len, len))
-				return 0;
+			sock_pe_gather_field(pe_entry, gather,
+				(void *) (uintptr_t) pe_entry->pe.tx.tx_iov[i].src.iov.addr,
+				pe_entry->pe.tx.tx_iov[i].src.iov.len, len);
 			len += pe_entry->pe.tx.tx_iov[i].src.iov.len;
 			pe_entry->data_len += pe_entry->pe.tx.tx_iov[i].src.iov.len;
 		}
 	}
 
-	sock_comm_flush(pe_entry);
-	if (!sock_comm_tx_done(pe_entry))
+	if (sock_pe_send_gather(pe_entry, gather))
 		return 0;
 
 	pe_entry->tag = 0;
@@ -1884,7 +1928,7 @@ static int sock_pe_progress_tx_send(struct sock_pe *pe,
 
 static int sock_pe_progress_tx_conn_msg(struct sock_pe *pe,
 					struct sock_pe_entry *pe_entry,
-					struct sock_conn *conn)
+					struct sock_pe_gather *gather)
 {
 	size_t len;
 	if (pe_entry->pe.tx.send_done)
@@ -1892,14 +1936,12 @@ static int sock_pe_progress_tx_conn_msg(struct sock_pe *pe,
 
 	len = sizeof(struct sock_msg_hdr);
 
-	if (sock_pe_send_field(pe_entry, pe_entry->pe.tx.inject,
-                               pe_entry->pe.tx.tx_op.src_iov_len, len))
-		return 0;
+	sock_pe_gather_field(pe_entry, gather, pe_entry->pe.tx.inject,
+			     pe_entry->pe.tx.tx_op.src_iov_len, len);
 	len += pe_entry->pe.tx.tx_op.src_iov_len;
 	pe_entry->data_len = pe_entry->pe.tx.tx_op.src_iov_len;
 
-	sock_comm_flush(pe_entry);
-	if (!sock_comm_tx_done(pe_entry))
+	if (sock_pe_send_gather(pe_entry, gather))
 		return 0;
 
 	if (pe_entry->done_len == pe_entry->total_len) {
@@ -1917,6 +1959,7 @@ static int sock_pe_progress_tx_entry(struct sock_pe *pe,
 {
 	int ret = 0;
 	struct sock_conn *conn = pe_entry->conn;
+	struct sock_pe_gather gather;
 
 	if (pe_entry->is_complete)
 		goto out;
@@ -1956,29 +1999,26 @@ static int sock_pe_progress_tx_entry(struct sock_pe *pe,
 		goto out;
 	}
 
-	if (!pe_entry->pe.tx.header_sent) {
-		if (sock_pe_send_field(pe_entry, &pe_entry->msg_hdr,
-				       sizeof(struct sock_msg_hdr), 0))
-			goto out;
-		pe_entry->pe.tx.header_sent = 1;
-	}
+	sock_pe_gather_init(&gather);
+	sock_pe_gather_field(pe_entry, &gather, &pe_entry->msg_hdr,
+			     sizeof(struct sock_msg_hdr), 0);
 
 	switch (pe_entry->msg_hdr.op_type) {
 	case SOCK_OP_SEND:
 	case SOCK_OP_TSEND:
-		ret = sock_pe_progress_tx_send(pe, pe_entry, conn);
+		ret = sock_pe_progress_tx_send(pe, pe_entry, &gather);
 		break;
 	case SOCK_OP_WRITE:
-		ret = sock_pe_progress_tx_write(pe, pe_entry, conn);
+		ret = sock_pe_progress_tx_write(pe, pe_entry, &gather);
 		break;
 	case SOCK_OP_READ:
-		ret = sock_pe_progress_tx_read(pe, pe_entry, conn);
+		ret = sock_pe_progress_tx_read(pe, pe_entry, &gather);
 		break;
 	case SOCK_OP_ATOMIC:
-		ret = sock_pe_progress_tx_atomic(pe, pe_entry, conn);
+		ret = sock_pe_progress_tx_atomic(pe, pe_entry, &gather);
 		break;
 	case SOCK_OP_CONN_MSG:
-		ret = sock_pe_progress_tx_conn_msg(pe, pe_entry, conn);
+		ret = sock_pe_progress_tx_conn_msg(pe, pe_entry, &gather);
 		break;
 	default:
 		ret = -FI_ENOSYS;
@@ -2328,16 +2368,16 @@ out:
 
 void sock_pe_remove_tx_ctx(struct sock_tx_ctx *tx_ctx)
 {
-	pthread_mutex_lock(&tx_ctx->domain->pe->list_lock);
+	pthread_mutex_lock(&tx_ctx->pe->list_lock);
 	dlist_remove(&tx_ctx->pe_entry);
-	pthread_mutex_unlock(&tx_ctx->domain->pe->list_lock);
+	pthread_mutex_unlock(&tx_ctx->pe->list_lock);
 }
 
 void sock_pe_remove_rx_ctx(struct sock_rx_ctx *rx_ctx)
 {
-	pthread_mutex_lock(&rx_ctx->domain->pe->list_lock);
+	pthread_mutex_lock(&rx_ctx->pe->list_lock);
 	dlist_remove(&rx_ctx->pe_entry);
-	pthread_mutex_unlock(&rx_ctx->domain->pe->list_lock);
+	pthread_mutex_unlock(&rx_ctx->pe->list_lock);
 }
 
 static int sock_pe_progress_rx_ep(struct sock_pe *pe,
@@ -32,6 +32,8 @@ AC_DEFUN([FI_UDP_CONFIGURE],[
 				[],
 				[udp_shm_happy=1],
 				[udp_shm_happy=0])])
+
+	       AC_CHECK_FUNCS([recvmmsg sendmmsg])
 	      ])
 
 	AS_IF([test $udp_h_happy -eq 1 && \
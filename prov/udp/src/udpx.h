@@ -41,6 +41,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <netinet/udp.h>
 
 #include <rdma/fabric.h>
 #include <rdma/fi_atomic.h>
@@ -83,6 +84,21 @@ int udpx_eq_open(struct fid_fabric *fabric, struct fi_eq_attr *attr,
 
 #define UDPX_FLAG_MULTI_RECV	1
 #define UDPX_IOV_LIMIT		4
+#define UDPX_RX_BATCH		32
+#define UDPX_MAX_RX_BATCH	64
+#define UDPX_MAX_TX_BATCH	64
+#define UDPX_TX_INJECT		1
+
+extern int udpx_rx_batch;
+extern int udpx_tx_batch;
+extern int udpx_gso;
+
+#if !HAVE_RECVMMSG && !HAVE_SENDMMSG
+struct mmsghdr {
+	struct msghdr		msg_hdr;
+	unsigned int		msg_len;
+};
+#endif
 
 struct udpx_ep_entry {
 	void			*context;
@@ -94,18 +110,31 @@ struct udpx_ep_entry {
 
 OFI_DECLARE_CIRQUE(struct udpx_ep_entry, udpx_rx_cirq);
 
+/* Send deferred until the next flush of the transmit queue */
+struct udpx_tx_entry {
+	void			*context;
+	struct iovec		iov[UDPX_IOV_LIMIT];
+	uint8_t			iov_count;
+	uint8_t			flags;
+	size_t			len;
+	socklen_t		addrlen;
+	struct sockaddr_in6	addr;
+};
+
+OFI_DECLARE_CIRQUE(struct udpx_tx_entry, udpx_tx_cirq);
+
 struct udpx_ep;
-typedef void (*udpx_rx_comp_func)(struct udpx_ep *ep, void *context,
-		uint64_t flags, size_t len, void *buf, void *addr);
-typedef void (*udpx_tx_comp_func)(struct udpx_ep *ep, void *context);
+typedef void (*udpx_rx_comp_func)(struct udpx_ep *ep, size_t index,
+		void *context, uint64_t flags, size_t len, void *buf, void *addr);
 
 struct udpx_ep {
 	struct util_ep		util_ep;
 	udpx_rx_comp_func	rx_comp;
-	udpx_tx_comp_func	tx_comp;
 	struct udpx_rx_cirq	*rxq;    /* protected by rx_cq lock */
+	struct udpx_tx_cirq	*txq;    /* protected by tx_cq lock */
 	int			sock;
 	int			is_bound;
+	int			gso;
 	ofi_atomic32_t		ref;
 };
 
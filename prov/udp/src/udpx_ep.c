@@ -195,13 +195,25 @@ static struct fi_ops_cm udpx_cm_ops = {
 int udpx_getopt(fid_t fid, int level, int optname,
 		void *optval, size_t *optlen)
 {
-	return -FI_ENOPROTOOPT;
+	struct udpx_ep *ep;
+
+	if (level != FI_OPT_ENDPOINT || optname != FI_OPT_EP_STATS)
+		return -FI_ENOPROTOOPT;
+
+	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
+	return ofi_ep_getopt_stats(&ep->util_ep, optval, optlen);
 }
 
 int udpx_setopt(fid_t fid, int level, int optname,
 		const void *optval, size_t optlen)
 {
-	return -FI_ENOPROTOOPT;
+	struct udpx_ep *ep;
+
+	if (level != FI_OPT_ENDPOINT || optname != FI_OPT_EP_STATS)
+		return -FI_ENOPROTOOPT;
+
+	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
+	return ofi_ep_setopt_stats(&ep->util_ep, optval, optlen);
 }
 
 static struct fi_ops_ep udpx_ep_ops = {
@@ -216,91 +228,124 @@ static struct fi_ops_ep udpx_ep_ops = {
 };
 
 
-static void udpx_tx_comp(struct udpx_ep *ep, void *context)
+static void udpx_tx_comp(struct udpx_ep *ep, size_t index, void *context)
 {
 	struct fi_cq_tagged_entry *comp;
 
-	comp = ofi_cirque_tail(ep->util_ep.tx_cq->cirq);
+	comp = ofi_cirque_tail_at(ep->util_ep.tx_cq->cirq, index);
 	comp->op_context = context;
 	comp->flags = FI_SEND;
 	comp->len = 0;
 	comp->buf = NULL;
 	comp->data = 0;
-	ofi_cirque_commit(ep->util_ep.tx_cq->cirq);
 }
 
-static void udpx_tx_comp_signal(struct udpx_ep *ep, void *context)
+static void udpx_tx_commit(struct udpx_ep *ep, size_t count)
 {
-	udpx_tx_comp(ep, context);
-	ep->util_ep.tx_cq->wait->signal(ep->util_ep.tx_cq->wait);
+	ofi_cirque_spsc_commit_cnt(ep->util_ep.tx_cq->cirq, count);
+	ofi_ep_stat_add(&ep->util_ep, tx_completed, count);
+	ofi_cq_wakeup(ep->util_ep.tx_cq);
 }
 
-static void udpx_rx_comp(struct udpx_ep *ep, void *context, uint64_t flags,
-			 size_t len, void *buf, void *addr)
+/*
+ * Received completions are written at an offset from the CQ tail and
+ * published together by udpx_ep_progress once the whole batch is filled.
+ */
+static void udpx_rx_comp(struct udpx_ep *ep, size_t index, void *context,
+			 uint64_t flags, size_t len, void *buf, void *addr)
 {
 	struct fi_cq_tagged_entry *comp;
 
-	comp = ofi_cirque_tail(ep->util_ep.rx_cq->cirq);
+	comp = ofi_cirque_tail_at(ep->util_ep.rx_cq->cirq, index);
 	comp->op_context = context;
 	comp->flags = FI_RECV | flags;
 	comp->len = len;
 	comp->buf = buf;
 	comp->data = 0;
-	ofi_cirque_commit(ep->util_ep.rx_cq->cirq);
 }
 
-static void udpx_rx_src_comp(struct udpx_ep *ep, void *context, uint64_t flags,
-			     size_t len, void *buf, void *addr)
+static void udpx_rx_src_comp(struct udpx_ep *ep, size_t index, void *context,
+			     uint64_t flags, size_t len, void *buf, void *addr)
 {
-	ep->util_ep.rx_cq->src[ofi_cirque_windex(ep->util_ep.rx_cq->cirq)] =
+	ep->util_ep.rx_cq->src[ofi_cirque_windex_at(ep->util_ep.rx_cq->cirq,
+						    index)] =
 			ip_av_get_index(ep->util_ep.av, addr);
-	udpx_rx_comp(ep, context, flags, len, buf, addr);
+	udpx_rx_comp(ep, index, context, flags, len, buf, addr);
 }
 
-static void udpx_rx_comp_signal(struct udpx_ep *ep, void *context,
-			uint64_t flags, size_t len, void *buf, void *addr)
+static void udpx_tx_progress(struct udpx_ep *ep);
+
+#if HAVE_RECVMMSG
+static int udpx_recv_batch(struct udpx_ep *ep, struct mmsghdr *msg, int count)
 {
-	udpx_rx_comp(ep, context, flags, len, buf, addr);
-	ep->util_ep.rx_cq->wait->signal(ep->util_ep.rx_cq->wait);
+	return recvmmsg(ep->sock, msg, count, 0, NULL);
 }
-
-static void udpx_rx_src_comp_signal(struct udpx_ep *ep, void *context,
-			uint64_t flags, size_t len, void *buf, void *addr)
+#else
+static int udpx_recv_batch(struct udpx_ep *ep, struct mmsghdr *msg, int count)
 {
-	udpx_rx_src_comp(ep, context, flags, len, buf, addr);
-	ep->util_ep.rx_cq->wait->signal(ep->util_ep.rx_cq->wait);
+	ssize_t ret;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		ret = recvmsg(ep->sock, &msg[i].msg_hdr, 0);
+		if (ret < 0)
+			break;
+		msg[i].msg_len = (unsigned int) ret;
+	}
+	return i ? i : -1;
 }
+#endif
 
 void udpx_ep_progress(struct util_ep *util_ep)
 {
 	struct udpx_ep *ep;
 	struct udpx_ep_entry *entry;
-	struct msghdr hdr;
-	struct sockaddr_in6 addr;
+	struct util_cq *cq;
+	struct mmsghdr msg[UDPX_MAX_RX_BATCH];
+	struct sockaddr_in6 addr[UDPX_MAX_RX_BATCH];
+	size_t count, i;
 	int ret;
 
 	ep = container_of(util_ep, struct udpx_ep, util_ep);
-	hdr.msg_name = &addr;
-	hdr.msg_namelen = sizeof(addr);
-	hdr.msg_control = NULL;
-	hdr.msg_controllen = 0;
-	hdr.msg_flags = 0;
-
-	fastlock_acquire(&ep->util_ep.rx_cq->cq_lock);
-	if (ofi_cirque_isempty(ep->rxq))
+	cq = ep->util_ep.rx_cq;
+
+	fastlock_acquire(&cq->cq_lock);
+	/* Only receive as many datagrams as there are posted buffers and
+	 * room in the CQ to report them. */
+	count = MIN(ofi_cirque_usedcnt(ep->rxq), (size_t) udpx_rx_batch);
+	count = MIN(count, ofi_cirque_spsc_freecnt(cq->cirq));
+	if (!count)
 		goto out;
 
-	entry = ofi_cirque_head(ep->rxq);
-	hdr.msg_iov = entry->iov;
-	hdr.msg_iovlen = entry->iov_count;
+	for (i = 0; i < count; i++) {
+		entry = &ep->rxq->buf[(ep->rxq->rcnt + i) & ep->rxq->size_mask];
+		msg[i].msg_hdr.msg_name = &addr[i];
+		msg[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+		msg[i].msg_hdr.msg_iov = entry->iov;
+		msg[i].msg_hdr.msg_iovlen = entry->iov_count;
+		msg[i].msg_hdr.msg_control = NULL;
+		msg[i].msg_hdr.msg_controllen = 0;
+		msg[i].msg_hdr.msg_flags = 0;
+	}
 
-	ret = recvmsg(ep->sock, &hdr, 0);
-	if (ret >= 0) {
-		ep->rx_comp(ep, entry->context, 0, ret, NULL, &addr);
+	ret = udpx_recv_batch(ep, msg, (int) count);
+	if (ret <= 0)
+		goto out;
+
+	for (i = 0; i < (size_t) ret; i++) {
+		entry = ofi_cirque_head(ep->rxq);
+		ep->rx_comp(ep, i, entry->context, 0, msg[i].msg_len, NULL,
+			    &addr[i]);
 		ofi_cirque_discard(ep->rxq);
 	}
+	ofi_cirque_spsc_commit_cnt(cq->cirq, ret);
+	ofi_ep_stat_add(&ep->util_ep, rx_completed, ret);
+	ofi_cq_wakeup(cq);
 out:
-	fastlock_release(&ep->util_ep.rx_cq->cq_lock);
+	fastlock_release(&cq->cq_lock);
+
+	if (!ofi_cirque_isempty(ep->txq))
+		udpx_tx_progress(ep);
 }
 
 ssize_t udpx_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
@@ -328,6 +373,7 @@ ssize_t udpx_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 	ofi_cirque_commit(ep->rxq);
 	ret = 0;
 out:
+	ofi_ep_stat_rx(&ep->util_ep, ret);
 	fastlock_release(&ep->util_ep.rx_cq->cq_lock);
 	return ret;
 }
@@ -367,6 +413,7 @@ ssize_t udpx_recv(struct fid_ep *ep_fid, void *buf, size_t len, void *desc,
 	ofi_cirque_commit(ep->rxq);
 	ret = 0;
 out:
+	ofi_ep_stat_rx(&ep->util_ep, ret);
 	fastlock_release(&ep->util_ep.rx_cq->cq_lock);
 	return ret;
 }
@@ -386,25 +433,295 @@ udpx_dest_addrlen(struct udpx_ep *ep, fi_addr_t addr, uint64_t flags)
 		ep->util_ep.av->addrlen;
 }
 
-static ssize_t udpx_sendto(struct udpx_ep *ep, const void *buf, size_t len,
-			   const void *addr, size_t addrlen, void *context)
+/* Largest UDP payload that fits in an IPv6 datagram without extensions */
+#define UDPX_GSO_MAX_LEN	(UINT16_MAX - 40 - 8)
+
+union udpx_gso_ctrl {
+	char			buf[CMSG_SPACE(sizeof(uint16_t))];
+	struct cmsghdr		align;
+};
+
+static inline struct udpx_tx_entry *udpx_tx_entry_at(struct udpx_ep *ep,
+						      size_t index)
+{
+	return &ep->txq->buf[(ep->txq->rcnt + index) & ep->txq->size_mask];
+}
+
+/*
+ * A queued send may be appended to a GSO message if it goes to the same
+ * destination, and every send before it has the segment size of the first
+ * one.  Only the last segment may be shorter.
+ */
+static int udpx_tx_can_merge(struct udpx_tx_entry *first,
+			     struct udpx_tx_entry *prev,
+			     struct udpx_tx_entry *next, size_t len)
+{
+	return first->len && prev->len == first->len &&
+	       next->len && next->len <= first->len &&
+	       len + next->len <= UDPX_GSO_MAX_LEN &&
+	       next->addrlen == first->addrlen &&
+	       !memcmp(&next->addr, &first->addr, first->addrlen);
+}
+
+/*
+ * Build one message per queued send, for at most cnt sends.  With GSO,
+ * runs of sends that can be merged are carried by a single message that
+ * the kernel splits back into the original datagrams.  seg_cnt returns the
+ * number of sends per message.
+ */
+static size_t udpx_tx_build(struct udpx_ep *ep, size_t cnt,
+			    struct mmsghdr *msg, struct iovec *iov,
+			    union udpx_gso_ctrl *ctrl, size_t *seg_cnt)
+{
+	struct udpx_tx_entry *first, *entry;
+	struct cmsghdr *cmsg;
+	size_t i, n, iov_cnt, len;
+
+	for (i = 0, n = 0, iov_cnt = 0; i < cnt; n++) {
+		first = udpx_tx_entry_at(ep, i);
+		msg[n].msg_hdr.msg_name = &first->addr;
+		msg[n].msg_hdr.msg_namelen = first->addrlen;
+		msg[n].msg_hdr.msg_iov = &iov[iov_cnt];
+		msg[n].msg_hdr.msg_iovlen = 0;
+		msg[n].msg_hdr.msg_control = NULL;
+		msg[n].msg_hdr.msg_controllen = 0;
+		msg[n].msg_hdr.msg_flags = 0;
+
+		len = 0;
+		seg_cnt[n] = 0;
+		do {
+			entry = udpx_tx_entry_at(ep, i++);
+			memcpy(&iov[iov_cnt], entry->iov,
+			       sizeof(*iov) * entry->iov_count);
+			iov_cnt += entry->iov_count;
+			msg[n].msg_hdr.msg_iovlen += entry->iov_count;
+			len += entry->len;
+			seg_cnt[n]++;
+		} while (ep->gso && i < cnt &&
+			 udpx_tx_can_merge(first, entry,
+					   udpx_tx_entry_at(ep, i), len));
+
+#ifdef UDP_SEGMENT
+		if (seg_cnt[n] > 1) {
+			msg[n].msg_hdr.msg_control = ctrl[n].buf;
+			msg[n].msg_hdr.msg_controllen = sizeof(ctrl[n].buf);
+			cmsg = CMSG_FIRSTHDR(&msg[n].msg_hdr);
+			cmsg->cmsg_level = IPPROTO_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			*(uint16_t *) CMSG_DATA(cmsg) = (uint16_t) first->len;
+		}
+#else
+		(void) cmsg;
+		(void) ctrl;
+#endif
+	}
+	return n;
+}
+
+#if HAVE_SENDMMSG
+static int udpx_send_batch(struct udpx_ep *ep, struct mmsghdr *msg, int count)
+{
+	return sendmmsg(ep->sock, msg, count, 0);
+}
+#else
+static int udpx_send_batch(struct udpx_ep *ep, struct mmsghdr *msg, int count)
+{
+	ssize_t ret;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		ret = sendmsg(ep->sock, &msg[i].msg_hdr, 0);
+		if (ret < 0)
+			break;
+		msg[i].msg_len = (unsigned int) ret;
+	}
+	return i ? i : -1;
+}
+#endif
+
+/* Injected sends own a copy of the data and are not completed */
+static void udpx_tx_discard(struct udpx_ep *ep)
+{
+	struct udpx_tx_entry *entry;
+
+	entry = ofi_cirque_head(ep->txq);
+	if (entry->flags & UDPX_TX_INJECT)
+		free(entry->iov[0].iov_base);
+	ofi_cirque_discard(ep->txq);
+}
+
+static void udpx_tx_complete(struct udpx_ep *ep, size_t count)
+{
+	struct udpx_tx_entry *entry;
+	size_t i, comp_cnt;
+
+	for (i = 0, comp_cnt = 0; i < count; i++) {
+		entry = ofi_cirque_head(ep->txq);
+		if (!(entry->flags & UDPX_TX_INJECT))
+			udpx_tx_comp(ep, comp_cnt++, entry->context);
+		udpx_tx_discard(ep);
+	}
+	if (comp_cnt)
+		udpx_tx_commit(ep, comp_cnt);
+}
+
+static void udpx_tx_error(struct udpx_ep *ep, int err)
+{
+	struct fi_cq_err_entry err_entry;
+	struct udpx_tx_entry *entry;
+
+	ofi_ep_stat_inc(&ep->util_ep, errors);
+	entry = ofi_cirque_head(ep->txq);
+	if (entry->flags & UDPX_TX_INJECT) {
+		udpx_tx_discard(ep);
+		return;
+	}
+
+	memset(&err_entry, 0, sizeof err_entry);
+	err_entry.op_context = entry->context;
+	err_entry.flags = FI_SEND;
+	err_entry.err = err;
+	err_entry.prov_errno = err;
+	udpx_tx_discard(ep);
+
+	if (!ofi_cq_insert_error(ep->util_ep.tx_cq, &err_entry))
+		ofi_cq_wakeup(ep->util_ep.tx_cq);
+}
+
+/*
+ * Caller must hold the tx CQ lock.  The CQ may be shared with receives and
+ * other endpoints, so only as many sends are issued as there is room to
+ * complete them; the rest stay queued until the application reads the CQ
+ * and progress runs again.
+ */
+static void udpx_tx_flush(struct udpx_ep *ep)
+{
+	struct mmsghdr msg[UDPX_MAX_TX_BATCH];
+	struct iovec iov[UDPX_MAX_TX_BATCH * UDPX_IOV_LIMIT];
+	union udpx_gso_ctrl ctrl[UDPX_MAX_TX_BATCH];
+	size_t seg_cnt[UDPX_MAX_TX_BATCH];
+	size_t cnt, comp_cnt, i;
+	int ret, err;
+
+	while (!ofi_cirque_isempty(ep->txq)) {
+		cnt = MIN(ofi_cirque_usedcnt(ep->txq),
+			  ofi_cirque_spsc_freecnt(ep->util_ep.tx_cq->cirq));
+		if (!cnt)
+			break;
+
+		cnt = udpx_tx_build(ep, cnt, msg, iov, ctrl, seg_cnt);
+		ret = udpx_send_batch(ep, msg, (int) cnt);
+		if (ret < 0) {
+			err = errno;
+			if (OFI_SOCK_TRY_SND_RCV_AGAIN(err))
+				break;
+
+			/*
+			 * EINVAL and EIO indicate the route or device cannot
+			 * segment; the sends are retried without GSO.  Any
+			 * other error fails the sends of the first message.
+			 */
+			if (seg_cnt[0] > 1 && (err == EINVAL || err == EIO)) {
+				FI_WARN(&udpx_prov, FI_LOG_EP_DATA,
+					"UDP segmentation offload failed (%s), "
+					"disabling\n", strerror(err));
+				ep->gso = 0;
+				continue;
+			}
+
+			for (i = 0; i < seg_cnt[0]; i++)
+				udpx_tx_error(ep, err);
+			continue;
+		}
+
+		for (i = 0, comp_cnt = 0; i < (size_t) ret; i++)
+			comp_cnt += seg_cnt[i];
+		udpx_tx_complete(ep, comp_cnt);
+	}
+}
+
+static void udpx_tx_progress(struct udpx_ep *ep)
+{
+	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+	udpx_tx_flush(ep);
+	fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+}
+
+/*
+ * Sends are queued instead of issued when the caller indicates more are
+ * coming (FI_MORE), when tx batching is enabled, or to keep them ordered
+ * behind sends that are already queued.
+ */
+static ssize_t udpx_tx_queue(struct udpx_ep *ep, const struct iovec *iov,
+			     size_t count, const void *addr, size_t addrlen,
+			     void *context, uint64_t flags, uint8_t tx_flags)
+{
+	struct udpx_tx_entry *entry;
+	size_t i;
+
+	if (ofi_cirque_isfull(ep->txq))
+		udpx_tx_flush(ep);
+	if (ofi_cirque_isfull(ep->txq))
+		return -FI_EAGAIN;
+
+	assert(count <= UDPX_IOV_LIMIT && addrlen <= sizeof(entry->addr));
+	entry = ofi_cirque_tail(ep->txq);
+	entry->context = context;
+	for (i = 0, entry->len = 0; i < count; i++) {
+		entry->iov[i] = iov[i];
+		entry->len += iov[i].iov_len;
+	}
+	entry->iov_count = (uint8_t) count;
+	entry->flags = tx_flags;
+	memcpy(&entry->addr, addr, addrlen);
+	entry->addrlen = (socklen_t) addrlen;
+	ofi_cirque_commit(ep->txq);
+
+	if (ofi_cirque_isfull(ep->txq) || (!(flags & FI_MORE) &&
+	    ofi_cirque_usedcnt(ep->txq) >= (size_t) udpx_tx_batch))
+		udpx_tx_flush(ep);
+	return 0;
+}
+
+static ssize_t udpx_sendto(struct udpx_ep *ep, const struct iovec *iov,
+			   size_t count, const void *addr, size_t addrlen,
+			   void *context, uint64_t flags)
 {
+	struct msghdr hdr;
 	ssize_t ret;
 
 	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
-	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
+	if (ofi_cirque_spsc_isfull(ep->util_ep.tx_cq->cirq)) {
 		ret = -FI_EAGAIN;
 		goto out;
 	}
 
-	ret = sendto(ep->sock, buf, len, 0, addr, addrlen);
-	if (ret == len) {
-		ep->tx_comp(ep, context);
+	if (udpx_tx_batch || (flags & FI_MORE) ||
+	    !ofi_cirque_isempty(ep->txq)) {
+		ret = udpx_tx_queue(ep, iov, count, addr, addrlen, context,
+				    flags, 0);
+		goto out;
+	}
+
+	hdr.msg_name = (void *) addr;
+	hdr.msg_namelen = (socklen_t) addrlen;
+	hdr.msg_iov = (struct iovec *) iov;
+	hdr.msg_iovlen = count;
+	hdr.msg_control = NULL;
+	hdr.msg_controllen = 0;
+	hdr.msg_flags = 0;
+
+	ret = sendmsg(ep->sock, &hdr, 0);
+	if (ret >= 0) {
+		udpx_tx_comp(ep, 0, context);
+		udpx_tx_commit(ep, 1);
 		ret = 0;
 	} else {
 		ret = -errno;
 	}
 out:
+	ofi_ep_stat_tx(&ep->util_ep, ret);
 	fastlock_release(&ep->util_ep.tx_cq->cq_lock);
 	return ret;
 }
@@ -413,55 +730,39 @@ static ssize_t udpx_send(struct fid_ep *ep_fid, const void *buf, size_t len,
 			 void *desc, fi_addr_t dest_addr, void *context)
 {
 	struct udpx_ep *ep;
+	struct iovec iov;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	return udpx_sendto(ep, buf, len, ip_av_get_addr(ep->util_ep.av, dest_addr),
-			   ep->util_ep.av->addrlen, context);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return udpx_sendto(ep, &iov, 1, ip_av_get_addr(ep->util_ep.av, dest_addr),
+			   ep->util_ep.av->addrlen, context, 0);
 }
 
 static ssize_t udpx_send_mc(struct fid_ep *ep_fid, const void *buf, size_t len,
 			    void *desc, fi_addr_t dest_addr, void *context)
 {
 	struct udpx_ep *ep;
+	struct iovec iov;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	return udpx_sendto(ep, buf, len, (const void *) (uintptr_t) dest_addr,
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return udpx_sendto(ep, &iov, 1, (const void *) (uintptr_t) dest_addr,
 			   ofi_sizeofaddr((const void *) (uintptr_t) dest_addr),
-			   context);
+			   context, 0);
 }
 
 static ssize_t udpx_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 			    uint64_t flags)
 {
 	struct udpx_ep *ep;
-	struct msghdr hdr;
-	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	hdr.msg_name = (void *) udpx_dest_addr(ep, msg->addr, flags);
-	hdr.msg_namelen = udpx_dest_addrlen(ep, msg->addr, flags);
-	hdr.msg_iov = (struct iovec *) msg->msg_iov;
-	hdr.msg_iovlen = msg->iov_count;
-	hdr.msg_control = NULL;
-	hdr.msg_controllen = 0;
-	hdr.msg_flags = 0;
-
-	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
-	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
-		ret = -FI_EAGAIN;
-		goto out;
-	}
-
-	ret = sendmsg(ep->sock, &hdr, 0);
-	if (ret >= 0) {
-		ep->tx_comp(ep, msg->context);
-		ret = 0;
-	} else {
-		ret = -errno;
-	}
-out:
-	fastlock_release(&ep->util_ep.tx_cq->cq_lock);
-	return ret;
+	return udpx_sendto(ep, msg->msg_iov, msg->iov_count,
+			   udpx_dest_addr(ep, msg->addr, flags),
+			   udpx_dest_addrlen(ep, msg->addr, flags),
+			   msg->context, flags);
 }
 
 ssize_t udpx_sendv(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
@@ -491,29 +792,80 @@ ssize_t udpx_sendv_mc(struct fid_ep *ep_fid, const struct iovec *iov,
 	return udpx_sendmsg(ep_fid, &msg, FI_MULTICAST);
 }
 
+/*
+ * Injected data is not retained, so if sends are still queued after a
+ * flush, a copy of it is queued behind them to keep the sends in order.
+ */
+static ssize_t udpx_inject_queued(struct udpx_ep *ep, const void *buf,
+				  size_t len, const void *addr, size_t addrlen)
+{
+	struct iovec iov;
+	ssize_t ret;
+
+	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+	udpx_tx_flush(ep);
+	if (ofi_cirque_isempty(ep->txq)) {
+		ret = sendto(ep->sock, buf, len, 0, addr, (socklen_t) addrlen);
+		ret = (ret == len) ? 0 : -errno;
+		goto out;
+	}
+
+	iov.iov_base = malloc(len);
+	if (!iov.iov_base) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+	memcpy(iov.iov_base, buf, len);
+	iov.iov_len = len;
+
+	ret = udpx_tx_queue(ep, &iov, 1, addr, addrlen, NULL, 0,
+			    UDPX_TX_INJECT);
+	if (ret)
+		free(iov.iov_base);
+out:
+	fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	return ret;
+}
+
+static ssize_t udpx_inject_addr(struct udpx_ep *ep, const void *buf,
+				size_t len, const void *addr, size_t addrlen)
+{
+	ssize_t ret;
+
+	if (!ofi_cirque_isempty(ep->txq)) {
+		ret = udpx_inject_queued(ep, buf, len, addr, addrlen);
+		if (ret)
+			return ret;
+	} else {
+		ret = sendto(ep->sock, buf, len, 0, addr, (socklen_t) addrlen);
+		if (ret != len)
+			return -errno;
+	}
+
+	ofi_ep_stat_inc(&ep->util_ep, tx_posted);
+	return 0;
+}
+
 static ssize_t udpx_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
 			   fi_addr_t dest_addr)
 {
 	struct udpx_ep *ep;
-	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	ret = sendto(ep->sock, buf, len, 0,
-		     ip_av_get_addr(ep->util_ep.av, dest_addr),
-		     ep->util_ep.av->addrlen);
-	return ret == len ? 0 : -errno;
+	return udpx_inject_addr(ep, buf, len,
+				ip_av_get_addr(ep->util_ep.av, dest_addr),
+				ep->util_ep.av->addrlen);
 }
 
 static ssize_t udpx_inject_mc(struct fid_ep *ep_fid, const void *buf,
 			      size_t len, fi_addr_t dest_addr)
 {
 	struct udpx_ep *ep;
-	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	ret = sendto(ep->sock, buf, len, 0, (const void *) (uintptr_t) dest_addr,
-		     ofi_sizeofaddr((const void *) (uintptr_t) dest_addr));
-	return ret == len ? 0 : -errno;
+	return udpx_inject_addr(ep, buf, len,
+				(const void *) (uintptr_t) dest_addr,
+				ofi_sizeofaddr((const void *) (uintptr_t) dest_addr));
 }
 
 static struct fi_ops_msg udpx_msg_ops = {
@@ -542,10 +894,35 @@ static struct fi_ops_msg udpx_msg_mcast_ops = {
 	.injectdata = fi_no_msg_injectdata,
 };
 
+/*
+ * Sends still queued at close are completed with FI_ECANCELED.  If the CQ
+ * has no room for all of them the close fails with -FI_EBUSY, and may be
+ * retried once the application has read the CQ.
+ */
+static int udpx_tx_cancel(struct udpx_ep *ep)
+{
+	struct util_cq *cq = ep->util_ep.tx_cq;
+	int ret = 0;
+
+	fastlock_acquire(&cq->cq_lock);
+	udpx_tx_flush(ep);
+	while (!ofi_cirque_isempty(ep->txq)) {
+		if (!(ofi_cirque_head(ep->txq)->flags & UDPX_TX_INJECT) &&
+		    ofi_cirque_spsc_isfull(cq->cirq)) {
+			ret = -FI_EBUSY;
+			break;
+		}
+		udpx_tx_error(ep, FI_ECANCELED);
+	}
+	fastlock_release(&cq->cq_lock);
+	return ret;
+}
+
 static int udpx_ep_close(struct fid *fid)
 {
 	struct udpx_ep *ep;
 	struct util_wait_fd *wait;
+	int ret;
 
 	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
 	if (ofi_atomic_get32(&ep->ref)) {
@@ -553,6 +930,15 @@ static int udpx_ep_close(struct fid *fid)
 		return -FI_EBUSY;
 	}
 
+	if (ep->util_ep.tx_cq) {
+		ret = udpx_tx_cancel(ep);
+		if (ret) {
+			FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+				"tx CQ full, cannot cancel queued sends\n");
+			return ret;
+		}
+	}
+
 	if (ep->util_ep.rx_cq) {
 		if (ep->util_ep.rx_cq->wait) {
 			wait = container_of(ep->util_ep.rx_cq->wait,
@@ -564,6 +950,13 @@ static int udpx_ep_close(struct fid *fid)
 				&ep->util_ep.ep_fid.fid);
 	}
 
+	if (ep->util_ep.tx_cq) {
+		fid_list_remove(&ep->util_ep.tx_cq->ep_list,
+				&ep->util_ep.tx_cq->ep_list_lock,
+				&ep->util_ep.ep_fid.fid);
+	}
+
+	udpx_tx_cirq_free(ep->txq);
 	udpx_rx_cirq_free(ep->rxq);
 	ofi_close_socket(ep->sock);
 	ofi_endpoint_close(&ep->util_ep);
@@ -584,30 +977,29 @@ static int udpx_ep_bind_cq(struct udpx_ep *ep, struct util_cq *cq,
 	if (flags & FI_TRANSMIT) {
 		ep->util_ep.tx_cq = cq;
 		ofi_atomic_inc32(&cq->ref);
-		ep->tx_comp = cq->wait ? udpx_tx_comp_signal :
-					 udpx_tx_comp;
+
+		/* Reading the tx CQ must flush deferred sends */
+		ret = fid_list_insert(&cq->ep_list,
+				      &cq->ep_list_lock,
+				      &ep->util_ep.ep_fid.fid);
+		if (ret)
+			return ret;
 	}
 
 	if (flags & FI_RECV) {
 		ep->util_ep.rx_cq = cq;
 		ofi_atomic_inc32(&cq->ref);
 
-		if (cq->wait) {
-			ep->rx_comp =
-				(cq->domain->info_domain_caps & FI_SOURCE) ?
-				udpx_rx_src_comp_signal :
-				udpx_rx_comp_signal;
+		ep->rx_comp = (cq->domain->info_domain_caps & FI_SOURCE) ?
+			      udpx_rx_src_comp : udpx_rx_comp;
 
+		if (cq->wait) {
 			wait = container_of(cq->wait,
 					    struct util_wait_fd, util_wait);
 			ret = fi_epoll_add(wait->epoll_fd, ep->sock,
 					   &ep->util_ep.ep_fid.fid);
 			if (ret)
 				return ret;
-		} else {
-			ep->rx_comp =
-				(cq->domain->info_domain_caps & FI_SOURCE) ?
-				udpx_rx_src_comp : udpx_rx_comp;
 		}
 
 		ret = fid_list_insert(&cq->ep_list,
@@ -712,6 +1104,10 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 {
 	int family;
 	int ret;
+#ifdef UDP_SEGMENT
+	socklen_t optlen;
+	int optval;
+#endif
 
 	ofi_atomic_initialize32(&ep->ref, 0);
 	ep->rxq = udpx_rx_cirq_create(info->rx_attr->size);
@@ -720,6 +1116,12 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 		return ret;
 	}
 
+	ep->txq = udpx_tx_cirq_create(UDPX_MAX_TX_BATCH);
+	if (!ep->txq) {
+		ret = -FI_ENOMEM;
+		goto err1;
+	}
+
 	family = info->src_addr ?
 		 ((struct sockaddr *) info->src_addr)->sa_family : AF_INET;
 	ep->sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
@@ -739,10 +1141,18 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 	if (ret)
 		goto err2;
 
+#ifdef UDP_SEGMENT
+	if (udpx_gso) {
+		optlen = sizeof(optval);
+		ep->gso = !getsockopt(ep->sock, IPPROTO_UDP, UDP_SEGMENT,
+				      &optval, &optlen);
+	}
+#endif
 	return 0;
 err2:
 	ofi_close_socket(ep->sock);
 err1:
+	udpx_tx_cirq_free(ep->txq);
 	udpx_rx_cirq_free(ep->rxq);
 	return ret;
 }
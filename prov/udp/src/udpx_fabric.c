@@ -41,7 +41,7 @@ static struct fi_ops_fabric udpx_fabric_ops = {
 	.domain = udpx_domain_open,
 	.passive_ep = fi_no_passive_ep,
 	.eq_open = ofi_eq_create,
-	.wait_open = ofi_wait_fd_open,
+	.wait_open = ofi_wait_fd_open_lazy,
 	.trywait = ofi_trywait
 };
 
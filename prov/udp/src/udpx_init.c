@@ -39,6 +39,9 @@
 #include <ifaddrs.h>
 #include <net/if.h>
 
+int udpx_rx_batch = UDPX_RX_BATCH;
+int udpx_tx_batch = 0;
+int udpx_gso = 1;
 
 #if HAVE_GETIFADDRS
 static void udpx_getinfo_ifs(struct fi_info **info)
@@ -144,5 +147,24 @@ struct fi_provider udpx_prov = {
 
 UDP_INI
 {
+	fi_param_define(&udpx_prov, "rx_batch", FI_PARAM_INT,
+			"Maximum number of datagrams received per progress "
+			"call (default: 32, max: 64)");
+	fi_param_get_int(&udpx_prov, "rx_batch", &udpx_rx_batch);
+	udpx_rx_batch = MIN(MAX(udpx_rx_batch, 1), UDPX_MAX_RX_BATCH);
+
+	fi_param_define(&udpx_prov, "tx_batch", FI_PARAM_INT,
+			"Number of sends queued before they are flushed "
+			"together; queued sends are also flushed by progress "
+			"(default: 0 - only defer sends posted with FI_MORE, "
+			"max: 64)");
+	fi_param_get_int(&udpx_prov, "tx_batch", &udpx_tx_batch);
+	udpx_tx_batch = MIN(MAX(udpx_tx_batch, 0), UDPX_MAX_TX_BATCH);
+
+	fi_param_define(&udpx_prov, "gso", FI_PARAM_BOOL,
+			"Coalesce queued sends to the same destination using "
+			"UDP segmentation offload, if supported (default: yes)");
+	fi_param_get_bool(&udpx_prov, "gso", &udpx_gso);
+
 	return &udpx_prov;
 }
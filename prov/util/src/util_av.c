@@ -205,6 +205,15 @@ int ofi_get_addr(uint32_t addr_format, uint64_t flags,
 	case FI_SOCKADDR_IN6:
 		return fi_get_sockaddr(AF_INET6, flags, node, service,
 				       (struct sockaddr **) addr, addrlen);
+	case FI_ADDR_STR:
+		/* String addresses are the node name itself */
+		if (!node)
+			return -FI_ENODATA;
+		*addr = strdup(node);
+		if (!*addr)
+			return -FI_ENOMEM;
+		*addrlen = strlen(node) + 1;
+		return 0;
 	default:
 		return -FI_ENOSYS;
 	}
@@ -1095,6 +1104,33 @@ static int ofi_cmap_match_peer(struct dlist_entry *entry, const void *addr)
 	return !memcmp(peer->addr, addr, peer->handle->cmap->av->addrlen);
 }
 
+/* Caller must hold cmap->lock */
+static void util_cmap_set_state(struct util_cmap_handle *handle,
+				enum util_cmap_state state)
+{
+	if (handle->state == CMAP_CONNREQ_SENT)
+		handle->cmap->connreq_cnt--;
+	if (state == CMAP_CONNREQ_SENT)
+		handle->cmap->connreq_cnt++;
+	handle->state = state;
+}
+
+/* Caller must hold cmap->lock */
+static void util_cmap_publish_handle(struct util_cmap_handle *handle)
+{
+	if (!handle->peer && handle->state == CMAP_CONNECTED)
+		ofi_store_release(&handle->cmap->handles_conn[handle->fi_addr],
+				  handle);
+}
+
+/* Caller must hold cmap->lock */
+static void util_cmap_unpublish_handle(struct util_cmap_handle *handle)
+{
+	if (!handle->peer)
+		ofi_store_release(&handle->cmap->handles_conn[handle->fi_addr],
+				  NULL);
+}
+
 /* Caller must hold cmap->lock */
 static int util_cmap_del_handle(struct util_cmap_handle *handle)
 {
@@ -1102,6 +1138,7 @@ static int util_cmap_del_handle(struct util_cmap_handle *handle)
 	int ret;
 
 	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL, "Deleting handle\n");
+	util_cmap_unpublish_handle(handle);
 	if (handle->peer) {
 		dlist_remove(&handle->peer->entry);
 		free(handle->peer);
@@ -1111,7 +1148,7 @@ static int util_cmap_del_handle(struct util_cmap_handle *handle)
 	}
 	util_cmap_clear_key(handle);
 
-	handle->state = CMAP_SHUTDOWN;
+	util_cmap_set_state(handle, CMAP_SHUTDOWN);
 	handle->cmap->attr.close(handle);
 	/* Signal event handler thread to delete the handle. This is required
 	 * so that the event handler thread handles any pending events for this
@@ -1201,6 +1238,54 @@ static void util_cmap_move_handle(struct util_cmap_handle *handle,
 	handle->peer = NULL;
 	handle->fi_addr = fi_addr;
 	handle->cmap->handles_av[fi_addr] = handle;
+	util_cmap_publish_handle(handle);
+}
+
+/*
+ * Start connecting to queued AV addresses, keeping at most attr.eager_max
+ * connection requests in flight. Called again whenever a request completes.
+ * Caller must hold cmap->lock.
+ */
+static void util_cmap_eager_connect(struct util_cmap *cmap)
+{
+	struct util_cmap_handle *handle;
+	fi_addr_t fi_addr;
+
+	while (cmap->eager_cnt && cmap->connreq_cnt < cmap->attr.eager_max) {
+		fi_addr = cmap->eager_queue[cmap->eager_head];
+		cmap->eager_head = (cmap->eager_head + 1) % cmap->av->count;
+		cmap->eager_cnt--;
+
+		/* Already connected or being connected, or our own address */
+		if (cmap->handles_av[fi_addr] ||
+		    !ofi_addr_cmp(cmap->av->prov, util_av_get_data(cmap->av,
+								 (int)fi_addr),
+				  cmap->attr.name))
+			continue;
+
+		if (util_cmap_alloc_handle(cmap, fi_addr, CMAP_IDLE, &handle))
+			return;
+		FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL, "Connecting to fi_addr: "
+		       "%" PRIu64 " in the background\n", fi_addr);
+		if (cmap->attr.connect(cmap->ep, handle, fi_addr)) {
+			FI_WARN(cmap->av->prov, FI_LOG_EP_CTRL,
+				"Unable to connect to fi_addr: %" PRIu64 "\n",
+				fi_addr);
+			util_cmap_del_handle(handle);
+			continue;
+		}
+		util_cmap_set_state(handle, CMAP_CONNREQ_SENT);
+	}
+}
+
+/* Caller must hold cmap->lock */
+static void util_cmap_eager_add(struct util_cmap *cmap, fi_addr_t fi_addr)
+{
+	if (!cmap->eager_queue || cmap->eager_cnt == cmap->av->count)
+		return;
+	cmap->eager_queue[(cmap->eager_head + cmap->eager_cnt) %
+			  cmap->av->count] = fi_addr;
+	cmap->eager_cnt++;
 }
 
 void ofi_cmap_update(struct util_cmap *cmap, const void *addr, fi_addr_t fi_addr)
@@ -1209,13 +1294,51 @@ void ofi_cmap_update(struct util_cmap *cmap, const void *addr, fi_addr_t fi_addr
 
 	fastlock_acquire(&cmap->lock);
 	handle = util_cmap_get_handle_peer(cmap, addr);
-	if (!handle)
+	if (!handle) {
+		util_cmap_eager_add(cmap, fi_addr);
+		util_cmap_eager_connect(cmap);
 		goto out;
+	}
 	util_cmap_move_handle(handle, fi_addr);
 out:
 	fastlock_release(&cmap->lock);
 }
 
+/*
+ * Connect in the background to all addresses in the AV, and to addresses
+ * inserted later, if enabled through attr.eager_max. The endpoint must be
+ * able to accept connections when this is called.
+ */
+int ofi_cmap_connect_av(struct util_cmap *cmap)
+{
+	struct util_av *av = cmap->av;
+	int next_free;
+	size_t i;
+
+	if (!cmap->attr.eager_max || cmap->eager_queue)
+		return 0;
+
+	cmap->eager_queue = calloc(av->count, sizeof(*cmap->eager_queue));
+	if (!cmap->eager_queue)
+		return -FI_ENOMEM;
+
+	fastlock_acquire(&av->lock);
+	fastlock_acquire(&cmap->lock);
+	/* The AV free list is kept in index order */
+	next_free = av->free_list;
+	for (i = 0; i < av->count; i++) {
+		if ((int)i == next_free) {
+			next_free = *(int *)util_av_get_data(av, i);
+			continue;
+		}
+		util_cmap_eager_add(cmap, (fi_addr_t)i);
+	}
+	util_cmap_eager_connect(cmap);
+	fastlock_release(&cmap->lock);
+	fastlock_release(&av->lock);
+	return 0;
+}
+
 /* Caller must hold cmap->lock */
 static struct util_cmap_handle *
 util_cmap_get_handle(struct util_cmap *cmap, fi_addr_t fi_addr)
@@ -1242,6 +1365,7 @@ void ofi_cmap_process_shutdown(struct util_cmap *cmap,
 	} else {
 		FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL, "Got local shutdown\n");
 	}
+	util_cmap_eager_connect(cmap);
 	fastlock_release(&cmap->lock);
 }
 
@@ -1252,9 +1376,11 @@ void ofi_cmap_process_connect(struct util_cmap *cmap,
 	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
 		"Processing connect for handle: %p\n", handle);
 	fastlock_acquire(&cmap->lock);
-	handle->state = CMAP_CONNECTED;
+	util_cmap_set_state(handle, CMAP_CONNECTED);
 	if (remote_key)
 		handle->remote_key = *remote_key;
+	util_cmap_publish_handle(handle);
+	util_cmap_eager_connect(cmap);
 	fastlock_release(&cmap->lock);
 }
 
@@ -1281,6 +1407,7 @@ void ofi_cmap_process_reject(struct util_cmap *cmap,
 			"%d when receiving connection reject\n", handle->state);
 		assert(0);
 	}
+	util_cmap_eager_connect(cmap);
 	fastlock_release(&cmap->lock);
 }
 
@@ -1335,7 +1462,7 @@ int ofi_cmap_process_connreq(struct util_cmap *cmap, void *addr,
 			/* Re-use handle. If it receives FI_REJECT the handle
 			 * would not be deleted in this state */
 			handle->cmap->attr.close(handle);
-			handle->state = CMAP_CONNREQ_RECV;
+			util_cmap_set_state(handle, CMAP_CONNREQ_RECV);
 			*handle_ret = handle;
 		}
 		break;
@@ -1353,12 +1480,26 @@ unlock:
 	return ret;
 }
 
+/*
+ * Returns -FI_EAGAIN while the connection is being established. The handle
+ * is still returned in that case, so that the caller may queue operations
+ * on it until the connection completes.
+ */
 int ofi_cmap_get_handle(struct util_cmap *cmap, fi_addr_t fi_addr,
 			struct util_cmap_handle **handle_ret)
 {
 	struct util_cmap_handle *handle;
 	int ret = 0;
 
+	/* Fast path: the connection is already established */
+	if (fi_addr < cmap->av->count) {
+		handle = ofi_load_acquire(&cmap->handles_conn[fi_addr]);
+		if (handle) {
+			*handle_ret = handle;
+			return 0;
+		}
+	}
+
 	fastlock_acquire(&cmap->lock);
 	handle = util_cmap_get_handle(cmap, fi_addr);
 	if (!handle) {
@@ -1375,13 +1516,16 @@ int ofi_cmap_get_handle(struct util_cmap *cmap, fi_addr_t fi_addr,
 			util_cmap_del_handle(handle);
 			goto unlock;
 		}
-		handle->state = CMAP_CONNREQ_SENT;
+		util_cmap_set_state(handle, CMAP_CONNREQ_SENT);
+		*handle_ret = handle;
 		ret = -FI_EAGAIN;
-		// TODO sleep on event fd instead of busy polling
 		break;
 	case CMAP_CONNREQ_SENT:
 	case CMAP_CONNREQ_RECV:
 	case CMAP_ACCEPT:
+		*handle_ret = handle;
+		ret = -FI_EAGAIN;
+		break;
 	case CMAP_SHUTDOWN:
 		ret = -FI_EAGAIN;
 		break;
@@ -1429,6 +1573,8 @@ void ofi_cmap_free(struct util_cmap *cmap)
 
 	fastlock_acquire(&cmap->lock);
 	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL, "Closing cmap\n");
+	/* Do not start connections from events processed during close */
+	cmap->eager_cnt = 0;
 	for (i = 0; i < cmap->av->count; i++) {
 		if (cmap->handles_av[i])
 			util_cmap_del_handle(cmap->handles_av[i]);
@@ -1439,6 +1585,8 @@ void ofi_cmap_free(struct util_cmap *cmap)
 		util_cmap_del_handle(peer->handle);
 	}
 	util_cmap_event_handler_close(cmap);
+	free(cmap->eager_queue);
+	free(cmap->handles_conn);
 	free(cmap->handles_av);
 	free(cmap->attr.name);
 	fastlock_release(&cmap->lock);
@@ -1462,6 +1610,11 @@ struct util_cmap *ofi_cmap_alloc(struct util_ep *ep,
 	if (!cmap->handles_av)
 		goto err1;
 
+	cmap->handles_conn = calloc(cmap->av->count,
+				    sizeof(*cmap->handles_conn));
+	if (!cmap->handles_conn)
+		goto err2;
+
 	cmap->attr = *attr;
 	cmap->attr.name = mem_dup(attr->name, ep->av->addrlen);
 	if (!cmap->attr.name)
@@ -1483,6 +1636,7 @@ struct util_cmap *ofi_cmap_alloc(struct util_ep *ep,
 err3:
 	fastlock_destroy(&cmap->lock);
 err2:
+	free(cmap->handles_conn);
 	free(cmap->handles_av);
 err1:
 	free(cmap);
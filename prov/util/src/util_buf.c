@@ -49,10 +49,72 @@ static inline void util_buf_set_region(union util_buf *buf,
 	}
 }
 
+/*
+ * Huge pages are only attempted until an allocation fails, after which the
+ * pool uses regular pages.  The region is rounded up to whole huge pages,
+ * and the extra space is used for more buffers.
+ */
+static int util_buf_region_alloc(struct util_buf_pool *pool,
+				 struct util_buf_region *buf_region)
+{
+	size_t size, alignment;
+	ssize_t hp_size;
+	int ret;
+
+	size = pool->chunk_cnt * pool->entry_sz;
+	if (pool->flags & UTIL_BUF_POOL_HUGEPAGE) {
+		hp_size = ofi_get_hugepage_size();
+		if (hp_size > 0) {
+			buf_region->size = fi_get_aligned_sz(size, hp_size);
+			ret = ofi_alloc_hugepage_buf((void **) &buf_region->mem_region,
+						     buf_region->size);
+			if (!ret) {
+				buf_region->flags = UTIL_BUF_POOL_HUGEPAGE;
+				goto bind;
+			}
+		}
+		FI_INFO(&core_prov, FI_LOG_CORE,
+			"huge pages unavailable, using regular pages\n");
+		pool->flags &= ~UTIL_BUF_POOL_HUGEPAGE;
+	}
+
+	/* Binding applies to whole pages, so don't share them with malloc */
+	alignment = pool->alignment;
+	buf_region->size = size;
+	if (pool->flags & UTIL_BUF_POOL_NUMA_BIND) {
+		alignment = MAX(alignment, (size_t) ofi_sysconf(_SC_PAGESIZE));
+		buf_region->size = fi_get_aligned_sz(size, alignment);
+	}
+
+	ret = ofi_memalign((void **) &buf_region->mem_region, alignment,
+			   buf_region->size);
+	if (ret)
+		return -FI_ENOMEM;
+bind:
+	if (pool->flags & UTIL_BUF_POOL_NUMA_BIND) {
+		ret = ofi_mbind_node(buf_region->mem_region, buf_region->size,
+				     pool->numa_node);
+		if (ret) {
+			FI_INFO(&core_prov, FI_LOG_CORE,
+				"unable to bind buffers to NUMA node %d: %s\n",
+				pool->numa_node, fi_strerror(-ret));
+		}
+	}
+	return 0;
+}
+
+static void util_buf_region_free(struct util_buf_region *buf_region)
+{
+	if (buf_region->flags & UTIL_BUF_POOL_HUGEPAGE)
+		ofi_free_hugepage_buf(buf_region->mem_region, buf_region->size);
+	else
+		ofi_freealign(buf_region->mem_region);
+}
+
 int util_buf_grow(struct util_buf_pool *pool)
 {
 	int ret;
-	size_t i;
+	size_t i, cnt;
 	union util_buf *util_buf;
 	struct util_buf_region *buf_region;
 
@@ -64,20 +126,20 @@ int util_buf_grow(struct util_buf_pool *pool)
 	if (!buf_region)
 		return -1;
 
-	ret = ofi_memalign((void **)&buf_region->mem_region, pool->alignment,
-			     pool->chunk_cnt * pool->entry_sz);
+	ret = util_buf_region_alloc(pool, buf_region);
 	if (ret)
-		goto err;
+		goto err1;
 
 	if (pool->alloc_hndlr) {
 		ret = pool->alloc_hndlr(pool->ctx, buf_region->mem_region,
-					pool->chunk_cnt * pool->entry_sz,
+					buf_region->size,
 					&buf_region->context);
 		if (ret)
-			goto err;
+			goto err2;
 	}
 
-	for (i = 0; i < pool->chunk_cnt; i++) {
+	cnt = buf_region->size / pool->entry_sz;
+	for (i = 0; i < cnt; i++) {
 		util_buf = (union util_buf *)
 			(buf_region->mem_region + i * pool->entry_sz);
 		util_buf_set_region(util_buf, buf_region, pool);
@@ -85,18 +147,16 @@ int util_buf_grow(struct util_buf_pool *pool)
 	}
 
 	slist_insert_tail(&buf_region->entry, &pool->region_list);
-	pool->num_allocated += pool->chunk_cnt;
+	pool->num_allocated += cnt;
 	return 0;
-err:
+err2:
+	util_buf_region_free(buf_region);
+err1:
 	free(buf_region);
 	return -1;
 }
 
-struct util_buf_pool *util_buf_pool_create_ex(size_t size, size_t alignment,
-					      size_t max_cnt, size_t chunk_cnt,
-					      util_buf_region_alloc_hndlr alloc_hndlr,
-					      util_buf_region_free_hndlr free_hndlr,
-					      void *pool_ctx)
+struct util_buf_pool *util_buf_pool_create_attr(struct util_buf_attr *attr)
 {
 	size_t entry_sz;
 	struct util_buf_pool *buf_pool;
@@ -105,17 +165,19 @@ struct util_buf_pool *util_buf_pool_create_ex(size_t size, size_t alignment,
 	if (!buf_pool)
 		return NULL;
 
-	buf_pool->alloc_hndlr = alloc_hndlr;
-	buf_pool->free_hndlr = free_hndlr;
-	buf_pool->data_sz = size;
-	buf_pool->alignment = alignment;
-	buf_pool->max_cnt = max_cnt;
-	buf_pool->chunk_cnt = chunk_cnt;
-	buf_pool->ctx = pool_ctx;
+	buf_pool->alloc_hndlr = attr->alloc_hndlr;
+	buf_pool->free_hndlr = attr->free_hndlr;
+	buf_pool->data_sz = attr->size;
+	buf_pool->alignment = attr->alignment;
+	buf_pool->max_cnt = attr->max_cnt;
+	buf_pool->chunk_cnt = attr->chunk_cnt;
+	buf_pool->ctx = attr->ctx;
+	buf_pool->flags = attr->flags;
+	buf_pool->numa_node = attr->numa_node;
 
 	entry_sz = util_buf_use_ftr(buf_pool) ?
-		(size + sizeof(struct util_buf_footer)) : size;
-	buf_pool->entry_sz = fi_get_aligned_sz(entry_sz, alignment);
+		(attr->size + sizeof(struct util_buf_footer)) : attr->size;
+	buf_pool->entry_sz = fi_get_aligned_sz(entry_sz, attr->alignment);
 
 	slist_init(&buf_pool->buf_list);
 	slist_init(&buf_pool->region_list);
@@ -163,8 +225,351 @@ void util_buf_pool_destroy(struct util_buf_pool *pool)
 #endif
 		if (pool->free_hndlr)
 			pool->free_hndlr(pool->ctx, buf_region->context);
-		ofi_freealign(buf_region->mem_region);
+		util_buf_region_free(buf_region);
 		free(buf_region);
 	}
 	free(pool);
 }
+
+pthread_key_t util_buf_ts_key;
+static pthread_once_t util_buf_ts_once = PTHREAD_ONCE_INIT;
+static int util_buf_ts_key_valid;
+
+/* Protects pool indices and the binding of caches to pools */
+static pthread_mutex_t util_buf_ts_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct util_buf_ts_pool **util_buf_ts_pools;
+static size_t util_buf_ts_pool_cnt;
+
+/* Called with the cache and pool locks held */
+static void util_buf_cache_flush(struct util_buf_ts_pool *ts_pool,
+				 struct util_buf_cache *cache)
+{
+	uint64_t state = ofi_load_acquire(&cache->state);
+	size_t cnt = util_buf_cache_cnt(state);
+
+	while (cnt)
+		util_buf_release(ts_pool->pool, cache->buf[--cnt]);
+	ofi_store_release(&cache->state,
+			  state - util_buf_cache_cnt(state) + UTIL_BUF_CACHE_GEN);
+}
+
+/* Return a thread's cached buffers to their pools when it exits */
+static void util_buf_ts_tls_free(void *arg)
+{
+	struct util_buf_ts_tls *tls = arg;
+	struct util_buf_ts_pool *ts_pool;
+	struct util_buf_cache *cache;
+	size_t i;
+
+	pthread_mutex_lock(&util_buf_ts_lock);
+	for (i = 0; i < tls->size; i++) {
+		cache = tls->cache[i];
+		if (!cache)
+			continue;
+
+		ts_pool = cache->ts_pool;
+		if (ts_pool) {
+			fastlock_acquire(&cache->lock);
+			fastlock_acquire(&ts_pool->lock);
+			util_buf_cache_flush(ts_pool, cache);
+			dlist_remove(&cache->entry);
+			fastlock_release(&ts_pool->lock);
+			fastlock_release(&cache->lock);
+		}
+		fastlock_destroy(&cache->lock);
+		free(cache);
+	}
+	pthread_mutex_unlock(&util_buf_ts_lock);
+	free(tls);
+}
+
+/*
+ * Providers built as separate libraries carry their own copy of this file,
+ * so the key is created on first use rather than by fi_ini(), and deleted
+ * when the library is unloaded so that its destructor is not called after.
+ */
+static void util_buf_ts_key_init(void)
+{
+	util_buf_ts_key_valid = !pthread_key_create(&util_buf_ts_key,
+						    util_buf_ts_tls_free);
+}
+
+FI_DESTRUCTOR(util_buf_ts_key_fini(void))
+{
+	if (util_buf_ts_key_valid)
+		pthread_key_delete(util_buf_ts_key);
+	util_buf_ts_key_valid = 0;
+}
+
+static struct util_buf_ts_tls *util_buf_ts_tls_get(size_t index)
+{
+	struct util_buf_ts_tls *tls, *new_tls;
+	size_t size;
+
+	tls = pthread_getspecific(util_buf_ts_key);
+	if (tls && index < tls->size)
+		return tls;
+
+	size = MAX(index + 1, tls ? tls->size * 2 : 8);
+	new_tls = calloc(1, sizeof(*tls) + size * sizeof(*tls->cache));
+	if (!new_tls)
+		return NULL;
+
+	new_tls->size = size;
+	if (tls)
+		memcpy(new_tls->cache, tls->cache,
+		       tls->size * sizeof(*tls->cache));
+	if (pthread_setspecific(util_buf_ts_key, new_tls)) {
+		free(new_tls);
+		return NULL;
+	}
+	free(tls);
+	return new_tls;
+}
+
+static struct util_buf_cache *util_buf_cache_get(struct util_buf_ts_pool *ts_pool)
+{
+	struct util_buf_ts_tls *tls;
+	struct util_buf_cache *cache;
+
+	tls = util_buf_ts_tls_get(ts_pool->index);
+	if (!tls)
+		return NULL;
+
+	cache = tls->cache[ts_pool->index];
+	if (!cache) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache)
+			return NULL;
+		fastlock_init(&cache->lock);
+		tls->cache[ts_pool->index] = cache;
+	}
+
+	if (cache->ts_pool != ts_pool) {
+		/* Left behind by a destroyed pool that used the same index */
+		assert(!util_buf_cache_cnt(cache->state));
+		fastlock_acquire(&ts_pool->lock);
+		cache->ts_pool = ts_pool;
+		dlist_insert_tail(&cache->entry, &ts_pool->cache_list);
+		fastlock_release(&ts_pool->lock);
+	}
+	return cache;
+}
+
+/*
+ * Called with ts_pool->lock held when the shared pool is empty.  Caches are
+ * locked with trylock, since their owners take the cache lock before the
+ * pool lock.  A cache whose state changed since the last sweep has been
+ * used and is only noted.  An idle one is emptied by swapping in an empty
+ * state; if its owner got there first, the buffers stay with it.
+ */
+static void util_buf_ts_reclaim(struct util_buf_ts_pool *ts_pool,
+				struct util_buf_cache *self)
+{
+	struct util_buf_cache *cache;
+	void *buf[UTIL_BUF_MAG_SIZE * 2];
+	uint64_t state;
+	size_t i, cnt;
+
+	dlist_foreach_container(&ts_pool->cache_list, struct util_buf_cache,
+				cache, entry) {
+		if (cache == self || fastlock_tryacquire(&cache->lock))
+			continue;
+
+		state = ofi_load_acquire(&cache->state);
+		cnt = util_buf_cache_cnt(state);
+		if (state == cache->seen && cnt) {
+			for (i = 0; i < cnt; i++)
+				buf[i] = ofi_load_relaxed(&cache->buf[i]);
+			state = state - cnt + UTIL_BUF_CACHE_GEN;
+			if (ofi_cas64(&cache->state, cache->seen, state)) {
+				for (i = 0; i < cnt; i++)
+					util_buf_release(ts_pool->pool, buf[i]);
+			}
+		}
+		cache->seen = state;
+		fastlock_release(&cache->lock);
+	}
+}
+
+static void *util_buf_ts_get(struct util_buf_ts_pool *ts_pool,
+			     struct util_buf_cache *self)
+{
+	if (!util_buf_avail(ts_pool->pool)) {
+		util_buf_ts_reclaim(ts_pool, self);
+		if (!util_buf_avail(ts_pool->pool) &&
+		    util_buf_grow(ts_pool->pool))
+			return NULL;
+	}
+	return util_buf_get(ts_pool->pool);
+}
+
+/*
+ * Slow path of util_buf_ts_alloc: the thread's cache is empty, or was
+ * emptied by a sweep.  Holding the cache lock keeps sweeps away while its
+ * state is rewritten.
+ */
+void *util_buf_ts_refill(struct util_buf_ts_pool *ts_pool)
+{
+	struct util_buf_cache *cache;
+	uint64_t state;
+	size_t cnt;
+	void *buf;
+
+	cache = util_buf_cache_get(ts_pool);
+	if (!cache) {
+		fastlock_acquire(&ts_pool->lock);
+		buf = util_buf_ts_get(ts_pool, NULL);
+		fastlock_release(&ts_pool->lock);
+		return buf;
+	}
+
+	fastlock_acquire(&cache->lock);
+	state = cache->state;
+	cnt = util_buf_cache_cnt(state);
+	fastlock_acquire(&ts_pool->lock);
+	while (cnt < UTIL_BUF_MAG_SIZE) {
+		buf = util_buf_ts_get(ts_pool, cache);
+		if (!buf)
+			break;
+		cache->buf[cnt++] = buf;
+	}
+	fastlock_release(&ts_pool->lock);
+
+	buf = cnt ? cache->buf[--cnt] : NULL;
+	ofi_store_release(&cache->state, state - util_buf_cache_cnt(state) +
+			  UTIL_BUF_CACHE_GEN + cnt);
+	fastlock_release(&cache->lock);
+	return buf;
+}
+
+/* Slow path of util_buf_ts_release: the thread's cache is full */
+void util_buf_ts_drain(struct util_buf_ts_pool *ts_pool, void *buf)
+{
+	struct util_buf_cache *cache;
+	uint64_t state;
+	size_t i, cnt;
+
+	cache = util_buf_cache_get(ts_pool);
+	if (!cache) {
+		fastlock_acquire(&ts_pool->lock);
+		util_buf_release(ts_pool->pool, buf);
+		fastlock_release(&ts_pool->lock);
+		return;
+	}
+
+	fastlock_acquire(&cache->lock);
+	state = cache->state;
+	cnt = util_buf_cache_cnt(state);
+	if (cnt == UTIL_BUF_MAG_SIZE * 2) {
+		/* Keep the most recently released, likely cache hot, buffers */
+		fastlock_acquire(&ts_pool->lock);
+		for (i = 0; i < UTIL_BUF_MAG_SIZE; i++)
+			util_buf_release(ts_pool->pool, cache->buf[i]);
+		fastlock_release(&ts_pool->lock);
+
+		memmove(cache->buf, &cache->buf[UTIL_BUF_MAG_SIZE],
+			(cnt - UTIL_BUF_MAG_SIZE) * sizeof(*cache->buf));
+		cnt -= UTIL_BUF_MAG_SIZE;
+	}
+	cache->buf[cnt++] = buf;
+	ofi_store_release(&cache->state, state - util_buf_cache_cnt(state) +
+			  UTIL_BUF_CACHE_GEN + cnt);
+	fastlock_release(&cache->lock);
+}
+
+static int util_buf_ts_index_get(struct util_buf_ts_pool *ts_pool)
+{
+	struct util_buf_ts_pool **pools;
+	size_t i, cnt;
+
+	for (i = 0; i < util_buf_ts_pool_cnt; i++) {
+		if (!util_buf_ts_pools[i])
+			goto out;
+	}
+
+	cnt = MAX(util_buf_ts_pool_cnt * 2, 8);
+	pools = realloc(util_buf_ts_pools, cnt * sizeof(*pools));
+	if (!pools)
+		return -FI_ENOMEM;
+
+	memset(&pools[util_buf_ts_pool_cnt], 0,
+	       (cnt - util_buf_ts_pool_cnt) * sizeof(*pools));
+	util_buf_ts_pools = pools;
+	util_buf_ts_pool_cnt = cnt;
+out:
+	util_buf_ts_pools[i] = ts_pool;
+	ts_pool->index = i;
+	return 0;
+}
+
+struct util_buf_ts_pool *util_buf_ts_pool_create_attr(struct util_buf_attr *attr)
+{
+	struct util_buf_ts_pool *ts_pool;
+	int ret;
+
+	pthread_once(&util_buf_ts_once, util_buf_ts_key_init);
+	if (!util_buf_ts_key_valid)
+		return NULL;
+
+	ts_pool = calloc(1, sizeof(*ts_pool));
+	if (!ts_pool)
+		return NULL;
+
+	ts_pool->pool = util_buf_pool_create_attr(attr);
+	if (!ts_pool->pool)
+		goto err1;
+
+	pthread_mutex_lock(&util_buf_ts_lock);
+	ret = util_buf_ts_index_get(ts_pool);
+	pthread_mutex_unlock(&util_buf_ts_lock);
+	if (ret)
+		goto err2;
+
+	fastlock_init(&ts_pool->lock);
+	dlist_init(&ts_pool->cache_list);
+	return ts_pool;
+err2:
+	util_buf_pool_destroy(ts_pool->pool);
+err1:
+	free(ts_pool);
+	return NULL;
+}
+
+/*
+ * Caches of live threads are emptied and unbound, but stay owned by their
+ * threads.  They are freed on thread exit or rebound by the next pool that
+ * gets the same index.  util_buf_ts_lock keeps exiting threads from
+ * touching the pool while it is torn down.
+ */
+void util_buf_ts_pool_destroy(struct util_buf_ts_pool *ts_pool)
+{
+	struct util_buf_cache *cache;
+	struct dlist_entry cache_list;
+
+	pthread_mutex_lock(&util_buf_ts_lock);
+	dlist_init(&cache_list);
+	fastlock_acquire(&ts_pool->lock);
+	dlist_splice_tail(&cache_list, &ts_pool->cache_list);
+	fastlock_release(&ts_pool->lock);
+
+	while (!dlist_empty(&cache_list)) {
+		cache = container_of(cache_list.next, struct util_buf_cache,
+				     entry);
+		dlist_remove(&cache->entry);
+
+		fastlock_acquire(&cache->lock);
+		fastlock_acquire(&ts_pool->lock);
+		util_buf_cache_flush(ts_pool, cache);
+		fastlock_release(&ts_pool->lock);
+		cache->ts_pool = NULL;
+		fastlock_release(&cache->lock);
+	}
+
+	util_buf_ts_pools[ts_pool->index] = NULL;
+	pthread_mutex_unlock(&util_buf_ts_lock);
+
+	util_buf_pool_destroy(ts_pool->pool);
+	fastlock_destroy(&ts_pool->lock);
+	free(ts_pool);
+}
@@ -32,6 +32,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 
 #include <fi_enosys.h>
 #include <fi_util.h>
@@ -94,8 +95,10 @@ static int ofi_cntr_add(struct fid_cntr *cntr_fid, uint64_t value)
 
 	ofi_atomic_add64(&cntr->cnt, value);
 
-	if(cntr->wait)
+	if(cntr->wait) {
+		ofi_poll_set_ready(&cntr->poll_entry);
 		cntr->wait->signal(cntr->wait);
+	}
 
 	return FI_SUCCESS;
 }
@@ -107,8 +110,10 @@ static int ofi_cntr_adderr(struct fid_cntr *cntr_fid, uint64_t value)
 
 	ofi_atomic_add64(&cntr->err, value);
 
-	if(cntr->wait)
+	if(cntr->wait) {
+		ofi_poll_set_ready(&cntr->poll_entry);
 		cntr->wait->signal(cntr->wait);
+	}
 
 	return FI_SUCCESS;
 }
@@ -120,8 +125,10 @@ static int ofi_cntr_set(struct fid_cntr *cntr_fid, uint64_t value)
 
 	ofi_atomic_initialize64(&cntr->cnt, value);
 
-	if(cntr->wait)
+	if(cntr->wait) {
+		ofi_poll_set_ready(&cntr->poll_entry);
 		cntr->wait->signal(cntr->wait);
+	}
 
 	return FI_SUCCESS;
 }
@@ -133,18 +140,32 @@ static int ofi_cntr_seterr(struct fid_cntr *cntr_fid, uint64_t value)
 
 	ofi_atomic_initialize64(&cntr->err, value);
 
-	if(cntr->wait)
+	if(cntr->wait) {
+		ofi_poll_set_ready(&cntr->poll_entry);
 		cntr->wait->signal(cntr->wait);
+	}
 
 	return FI_SUCCESS;
 }
 
+static int util_cntr_check(struct util_cntr *cntr, uint64_t threshold,
+			   uint64_t err)
+{
+	if (threshold <= ofi_atomic_get64(&cntr->cnt))
+		return FI_SUCCESS;
+	else if (err != ofi_atomic_get64(&cntr->err))
+		return -FI_EAVAIL;
+	return -FI_EAGAIN;
+}
+
 static int ofi_cntr_wait(struct fid_cntr *cntr_fid, uint64_t threshold, int timeout)
 {
 	struct util_cntr *cntr = container_of(cntr_fid, struct util_cntr, cntr_fid);
+	uint64_t start_us, budget;
 	uint64_t current_ms;
 	uint64_t finish_ms;
 	uint64_t err = ofi_cntr_readerr(cntr_fid);
+	int ret;
 
 	assert(cntr->cntr_fid.fid.fclass == FI_CLASS_CNTR);
 
@@ -153,20 +174,31 @@ static int ofi_cntr_wait(struct fid_cntr *cntr_fid, uint64_t threshold, int time
 
 	assert(cntr->wait);
 
+	start_us = fi_gettime_us();
+	budget = ofi_wait_spin_budget(&cntr->spin, timeout);
+	while (budget && fi_gettime_us() - start_us < budget) {
+		cntr->progress(cntr);
+		ret = util_cntr_check(cntr, threshold, err);
+		if (ret != -FI_EAGAIN)
+			goto out;
+		sched_yield();
+	}
+
 	current_ms = fi_gettime_ms();
-	finish_ms = (timeout < 0) ? UINT64_MAX : current_ms + timeout;
+	finish_ms = (timeout < 0) ? UINT64_MAX : start_us / 1000 + timeout;
 	for (; timeout < 0 || current_ms < finish_ms;
 	    current_ms = fi_gettime_ms()) {
 		timeout = timeout < 0 ? timeout : (int)(finish_ms - current_ms);
 		fi_wait(&cntr->wait->wait_fid, timeout);
 		cntr->progress(cntr);
-		if (threshold <= ofi_atomic_get64(&cntr->cnt))
-			return FI_SUCCESS;
-		else if (err != ofi_atomic_get64(&cntr->err))
-			return -FI_EAVAIL;
+		ret = util_cntr_check(cntr, threshold, err);
+		if (ret != -FI_EAGAIN)
+			goto out;
 	}
-
-	return -FI_ETIMEDOUT;
+	ret = -FI_ETIMEDOUT;
+out:
+	ofi_wait_spin_update(&cntr->spin, start_us);
+	return ret;
 }
 
 static struct fi_ops_cntr util_cntr_ops = {
@@ -188,8 +220,11 @@ int ofi_cntr_cleanup(struct util_cntr *cntr)
 	fastlock_destroy(&cntr->ep_list_lock);
 
 	if (cntr->wait) {
-		fi_poll_del(&cntr->wait->pollset->poll_fid,
-			    &cntr->cntr_fid.fid, 0);
+		if (cntr->poll_entry.pollset)
+			ofi_poll_del_entry(&cntr->poll_entry);
+		else
+			fi_poll_del(&cntr->wait->pollset->poll_fid,
+				    &cntr->cntr_fid.fid, 0);
 	}
 
 	ofi_atomic_dec32(&cntr->domain->ref);
@@ -245,6 +280,7 @@ static int fi_cntr_init(struct fid_domain *domain, struct fi_cntr_attr *attr,
 	ofi_atomic_initialize32(&cntr->ref, 0);
 	dlist_init(&cntr->ep_list);
 	fastlock_init(&cntr->ep_list_lock);
+	ofi_poll_entry_init(&cntr->poll_entry, &cntr->cntr_fid.fid);
 
 	cntr->cntr_fid.fid.fclass = FI_CLASS_CNTR;
 	cntr->cntr_fid.fid.context = context;
@@ -322,11 +358,16 @@ int ofi_cntr_init(const struct fi_provider *prov, struct fid_domain *domain,
 
 	/* CNTR must be fully operational before adding to wait set */
 	if (cntr->wait) {
-		ret = fi_poll_add(&cntr->wait->pollset->poll_fid,
-				  &cntr->cntr_fid.fid, 0);
-		if (ret) {
-			ofi_cntr_cleanup(cntr);
-			return ret;
+		if (cntr->domain->data_progress == FI_PROGRESS_AUTO) {
+			ofi_poll_add_entry(cntr->wait->pollset,
+					   &cntr->poll_entry);
+		} else {
+			ret = fi_poll_add(&cntr->wait->pollset->poll_fid,
+					  &cntr->cntr_fid.fid, 0);
+			if (ret) {
+				ofi_cntr_cleanup(cntr);
+				return ret;
+			}
 		}
 	}
 
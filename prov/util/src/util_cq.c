@@ -32,33 +32,69 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 
 #include <fi_enosys.h>
 #include <fi_util.h>
 
 #define UTIL_DEF_CQ_SIZE (1024)
 
-int ofi_cq_write_error(struct util_cq *cq,
-		       const struct fi_cq_err_entry *err_entry)
+static inline void util_cq_acquire(struct util_cq *cq)
+{
+	if (!cq->spsc)
+		fastlock_acquire(&cq->cq_lock);
+}
+
+static inline void util_cq_release(struct util_cq *cq)
+{
+	if (!cq->spsc)
+		fastlock_release(&cq->cq_lock);
+}
+
+/* Caller must hold cq_lock and signal the wait object */
+int ofi_cq_insert_error(struct util_cq *cq,
+			const struct fi_cq_err_entry *err_entry)
 {
 	struct util_cq_err_entry *entry;
 	struct fi_cq_tagged_entry *comp;
 
+	if (ofi_cirque_spsc_isfull(cq->cirq)) {
+		FI_DBG(cq->domain->prov, FI_LOG_CQ, "util_cq cirq is full!\n");
+		return -FI_EAGAIN;
+	}
+
 	if (!(entry = calloc(1, sizeof(*entry))))
 		return -FI_ENOMEM;
 
 	entry->err_entry = *err_entry;
-	fastlock_acquire(&cq->cq_lock);
 	slist_insert_tail(&entry->list_entry, &cq->err_list);
 	comp = ofi_cirque_tail(cq->cirq);
 	comp->flags = UTIL_FLAG_ERROR;
-	ofi_cirque_commit(cq->cirq);
-	fastlock_release(&cq->cq_lock);
-	if (cq->wait)
-		cq->wait->signal(cq->wait);
+	ofi_cirque_spsc_commit(cq->cirq);
 	return 0;
 }
 
+void ofi_cq_wakeup(struct util_cq *cq)
+{
+	if (cq->wait) {
+		ofi_poll_set_ready(&cq->poll_entry);
+		cq->wait->signal(cq->wait);
+	}
+}
+
+int ofi_cq_write_error(struct util_cq *cq,
+		       const struct fi_cq_err_entry *err_entry)
+{
+	int ret;
+
+	fastlock_acquire(&cq->cq_lock);
+	ret = ofi_cq_insert_error(cq, err_entry);
+	fastlock_release(&cq->cq_lock);
+	if (!ret)
+		ofi_cq_wakeup(cq);
+	return ret;
+}
+
 int ofi_cq_write_error_peek(struct util_cq *cq, uint64_t tag, void *context)
 {
 	struct fi_cq_err_entry err_entry = {0};
@@ -77,8 +113,8 @@ int ofi_cq_write(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 	struct fi_cq_tagged_entry *comp;
 	int ret = 0;
 
-	fastlock_acquire(&cq->cq_lock);
-	if (ofi_cirque_isfull(cq->cirq)) {
+	util_cq_acquire(cq);
+	if (ofi_cirque_spsc_isfull(cq->cirq)) {
 		FI_DBG(cq->domain->prov, FI_LOG_CQ, "util_cq cirq is full!\n");
 		ret = -FI_EAGAIN;
 		goto out;
@@ -91,12 +127,48 @@ int ofi_cq_write(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 	comp->buf = buf;
 	comp->data = data;
 	comp->tag = tag;
-	ofi_cirque_commit(cq->cirq);
+	ofi_cirque_spsc_commit(cq->cirq);
+	if (cq->wait)
+		ofi_poll_set_ready(&cq->poll_entry);
 out:
-	fastlock_release(&cq->cq_lock);
+	util_cq_release(cq);
 	return ret;
 }
 
+size_t ofi_cq_write_reserve(struct util_cq *cq, size_t count)
+{
+	size_t avail;
+
+	util_cq_acquire(cq);
+	avail = ofi_cirque_spsc_freecnt(cq->cirq);
+	if (!avail)
+		FI_DBG(cq->domain->prov, FI_LOG_CQ, "util_cq cirq is full!\n");
+	return MIN(avail, count);
+}
+
+void ofi_cq_write_commit(struct util_cq *cq, size_t count)
+{
+	if (count)
+		ofi_cirque_spsc_commit_cnt(cq->cirq, count);
+	util_cq_release(cq);
+
+	if (count)
+		ofi_cq_wakeup(cq);
+}
+
+ssize_t ofi_cq_write_batch(struct util_cq *cq,
+			   const struct fi_cq_tagged_entry *comps, size_t count)
+{
+	size_t i, n;
+
+	n = ofi_cq_write_reserve(cq, count);
+	for (i = 0; i < n; i++)
+		*ofi_cq_reserved_entry(cq, i) = comps[i];
+	ofi_cq_write_commit(cq, n);
+
+	return (n || !count) ? n : -FI_EAGAIN;
+}
+
 int ofi_check_cq_attr(const struct fi_provider *prov,
 		      const struct fi_cq_attr *attr)
 {
@@ -177,22 +249,23 @@ ssize_t ofi_cq_read(struct fid_cq *cq_fid, void *buf, size_t count)
 {
 	struct util_cq *cq;
 	struct fi_cq_tagged_entry *entry;
-	size_t i;
+	size_t i, avail;
 
 	cq = container_of(cq_fid, struct util_cq, cq_fid);
-	fastlock_acquire(&cq->cq_lock);
-	if (ofi_cirque_isempty(cq->cirq)) {
-		fastlock_release(&cq->cq_lock);
+	util_cq_acquire(cq);
+	if (ofi_cirque_spsc_isempty(cq->cirq)) {
+		util_cq_release(cq);
 		cq->progress(cq);
-		fastlock_acquire(&cq->cq_lock);
-		if (ofi_cirque_isempty(cq->cirq)) {
+		util_cq_acquire(cq);
+		if (ofi_cirque_spsc_isempty(cq->cirq)) {
 			i = -FI_EAGAIN;
 			goto out;
 		}
 	}
 
-	if (count > ofi_cirque_usedcnt(cq->cirq))
-		count = ofi_cirque_usedcnt(cq->cirq);
+	avail = ofi_cirque_spsc_usedcnt(cq->cirq);
+	if (count > avail)
+		count = avail;
 
 	for (i = 0; i < count; i++) {
 		entry = ofi_cirque_head(cq->cirq);
@@ -202,10 +275,10 @@ ssize_t ofi_cq_read(struct fid_cq *cq_fid, void *buf, size_t count)
 			break;
 		}
 		cq->read_entry(&buf, entry);
-		ofi_cirque_discard(cq->cirq);
+		ofi_cirque_spsc_discard(cq->cirq);
 	}
 out:
-	fastlock_release(&cq->cq_lock);
+	util_cq_release(cq);
 	return i;
 }
 
@@ -214,6 +287,7 @@ ssize_t ofi_cq_readfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 {
 	struct util_cq *cq;
 	struct fi_cq_tagged_entry *entry;
+	size_t avail;
 	ssize_t i;
 
 	cq = container_of(cq_fid, struct util_cq, cq_fid);
@@ -226,19 +300,20 @@ ssize_t ofi_cq_readfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 		return i;
 	}
 
-	fastlock_acquire(&cq->cq_lock);
-	if (ofi_cirque_isempty(cq->cirq)) {
-		fastlock_release(&cq->cq_lock);
+	util_cq_acquire(cq);
+	if (ofi_cirque_spsc_isempty(cq->cirq)) {
+		util_cq_release(cq);
 		cq->progress(cq);
-		fastlock_acquire(&cq->cq_lock);
-		if (ofi_cirque_isempty(cq->cirq)) {
+		util_cq_acquire(cq);
+		if (ofi_cirque_spsc_isempty(cq->cirq)) {
 			i = -FI_EAGAIN;
 			goto out;
 		}
 	}
 
-	if (count > ofi_cirque_usedcnt(cq->cirq))
-		count = ofi_cirque_usedcnt(cq->cirq);
+	avail = ofi_cirque_spsc_usedcnt(cq->cirq);
+	if (count > avail)
+		count = avail;
 
 	for (i = 0; i < (ssize_t)count; i++) {
 		entry = ofi_cirque_head(cq->cirq);
@@ -249,10 +324,10 @@ ssize_t ofi_cq_readfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 		}
 		src_addr[i] = cq->src[ofi_cirque_rindex(cq->cirq)];
 		cq->read_entry(&buf, entry);
-		ofi_cirque_discard(cq->cirq);
+		ofi_cirque_spsc_discard(cq->cirq);
 	}
 out:
-	fastlock_release(&cq->cq_lock);
+	util_cq_release(cq);
 	return i;
 }
 
@@ -271,13 +346,13 @@ ssize_t ofi_cq_readerr(struct fid_cq *cq_fid, struct fi_cq_err_entry *buf,
 	api_version = cq->domain->fabric->fabric_fid.api_version;
 
 	fastlock_acquire(&cq->cq_lock);
-	if (ofi_cirque_isempty(cq->cirq) ||
+	if (ofi_cirque_spsc_isempty(cq->cirq) ||
 	    !(ofi_cirque_head(cq->cirq)->flags & UTIL_FLAG_ERROR)) {
 		ret = -FI_EAGAIN;
 		goto unlock;
 	}
 
-	ofi_cirque_discard(cq->cirq);
+	ofi_cirque_spsc_discard(cq->cirq);
 	entry = slist_remove_head(&cq->err_list);
 	err = container_of(entry, struct util_cq_err_entry, list_entry);
 	if ((FI_VERSION_GE(api_version, FI_VERSION(1, 5))) && buf->err_data_size) {
@@ -297,26 +372,55 @@ unlock:
 	return ret;
 }
 
-ssize_t ofi_cq_sread(struct fid_cq *cq_fid, void *buf, size_t count,
-		const void *cond, int timeout)
+static ssize_t util_cq_read(struct fid_cq *cq_fid, void *buf, size_t count,
+			    fi_addr_t *src_addr)
+{
+	return src_addr ? ofi_cq_readfrom(cq_fid, buf, count, src_addr) :
+			  ofi_cq_read(cq_fid, buf, count);
+}
+
+static ssize_t util_cq_sread(struct fid_cq *cq_fid, void *buf, size_t count,
+			     fi_addr_t *src_addr, int timeout)
 {
 	struct util_cq *cq;
+	uint64_t start_us, budget, spin_us;
+	ssize_t ret;
 
 	cq = container_of(cq_fid, struct util_cq, cq_fid);
 	assert(cq->wait && cq->internal_wait);
+
+	start_us = fi_gettime_us();
+	budget = ofi_wait_spin_budget(&cq->spin, timeout);
+	if (budget) {
+		do {
+			ret = util_cq_read(cq_fid, buf, count, src_addr);
+			if (ret != -FI_EAGAIN)
+				goto out;
+			sched_yield();
+			spin_us = fi_gettime_us() - start_us;
+		} while (spin_us < budget);
+
+		if (timeout >= 0)
+			timeout -= (int) (spin_us / 1000);
+	}
+
 	fi_wait(&cq->wait->wait_fid, timeout);
-	return ofi_cq_read(cq_fid, buf, count);
+	ret = util_cq_read(cq_fid, buf, count, src_addr);
+out:
+	ofi_wait_spin_update(&cq->spin, start_us);
+	return ret;
+}
+
+ssize_t ofi_cq_sread(struct fid_cq *cq_fid, void *buf, size_t count,
+		const void *cond, int timeout)
+{
+	return util_cq_sread(cq_fid, buf, count, NULL, timeout);
 }
 
 ssize_t ofi_cq_sreadfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 		fi_addr_t *src_addr, const void *cond, int timeout)
 {
-	struct util_cq *cq;
-
-	cq = container_of(cq_fid, struct util_cq, cq_fid);
-	assert(cq->wait && cq->internal_wait);
-	fi_wait(&cq->wait->wait_fid, timeout);
-	return ofi_cq_readfrom(cq_fid, buf, count, src_addr);
+	return util_cq_sread(cq_fid, buf, count, src_addr, timeout);
 }
 
 int ofi_cq_signal(struct fid_cq *cq_fid)
@@ -325,7 +429,7 @@ int ofi_cq_signal(struct fid_cq *cq_fid)
 
 	cq = container_of(cq_fid, struct util_cq, cq_fid);
 	assert(cq->wait);
-	cq->wait->signal(cq->wait);
+	ofi_cq_wakeup(cq);
 	return 0;
 }
 
@@ -364,8 +468,11 @@ int ofi_cq_cleanup(struct util_cq *cq)
 	}
 
 	if (cq->wait) {
-		fi_poll_del(&cq->wait->pollset->poll_fid,
-			    &cq->cq_fid.fid, 0);
+		if (cq->poll_entry.pollset)
+			ofi_poll_del_entry(&cq->poll_entry);
+		else
+			fi_poll_del(&cq->wait->pollset->poll_fid,
+				    &cq->cq_fid.fid, 0);
 		if (cq->internal_wait)
 			fi_close(&cq->wait->wait_fid.fid);
 	}
@@ -410,7 +517,10 @@ static int fi_cq_init(struct fid_domain *domain, struct fi_cq_attr *attr,
 	fastlock_init(&cq->ep_list_lock);
 	fastlock_init(&cq->cq_lock);
 	slist_init(&cq->err_list);
+	ofi_poll_entry_init(&cq->poll_entry, &cq->cq_fid.fid);
 	cq->read_entry = read_entry;
+	cq->spsc = (cq->domain->threading == FI_THREAD_DOMAIN ||
+		    cq->domain->threading == FI_THREAD_COMPLETION);
 
 	cq->cq_fid.fid.fclass = FI_CLASS_CQ;
 	cq->cq_fid.fid.context = context;
@@ -521,13 +631,20 @@ int ofi_cq_init(const struct fi_provider *prov, struct fid_domain *domain,
 	if (ret)
 		return ret;
 
-	/* CQ must be fully operational before adding to wait set */
+	/* CQ must be fully operational before adding to wait set.  With
+	 * automatic progress, completions are written without fi_cq_read
+	 * being called, so the poll set only needs to check the CQ once
+	 * it has been marked ready. */
 	if (cq->wait) {
-		ret = fi_poll_add(&cq->wait->pollset->poll_fid,
-				  &cq->cq_fid.fid, 0);
-		if (ret) {
-			ofi_cq_cleanup(cq);
-			return ret;
+		if (cq->domain->data_progress == FI_PROGRESS_AUTO) {
+			ofi_poll_add_entry(cq->wait->pollset, &cq->poll_entry);
+		} else {
+			ret = fi_poll_add(&cq->wait->pollset->poll_fid,
+					  &cq->cq_fid.fid, 0);
+			if (ret) {
+				ofi_cq_cleanup(cq);
+				return ret;
+			}
 		}
 	}
 
@@ -82,6 +82,8 @@ static int util_domain_init(struct util_domain *domain,
 	domain->mr_mode = info->domain_attr->mr_mode;
 	domain->addr_format = info->addr_format;
 	domain->av_type = info->domain_attr->av_type;
+	domain->threading = info->domain_attr->threading;
+	domain->data_progress = info->domain_attr->data_progress;
 	domain->name = strdup(info->domain_attr->name);
 	return domain->name ? 0 : -FI_ENOMEM;
 }
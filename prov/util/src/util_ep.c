@@ -30,6 +30,7 @@
  * SOFTWARE.
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -199,8 +200,80 @@ int ofi_endpoint_init(struct fid_domain *domain, const struct util_prov *util_pr
 	return 0;
 }
 
+int ofi_ep_getopt_stats(struct util_ep *ep, void *optval, size_t *optlen)
+{
+	struct fi_ep_stats *stats = optval;
+
+	if (*optlen < sizeof(*stats)) {
+		*optlen = sizeof(*stats);
+		return -FI_ETOOSMALL;
+	}
+
+	stats->tx_posted = ofi_load_relaxed(&ep->stats.tx_posted);
+	stats->tx_completed = ofi_load_relaxed(&ep->stats.tx_completed);
+	stats->rx_posted = ofi_load_relaxed(&ep->stats.rx_posted);
+	stats->rx_completed = ofi_load_relaxed(&ep->stats.rx_completed);
+	stats->errors = ofi_load_relaxed(&ep->stats.errors);
+	stats->eagain = ofi_load_relaxed(&ep->stats.eagain);
+	stats->unexp_total = ofi_load_relaxed(&ep->stats.unexp_total);
+	stats->unexp_cur = ofi_load_relaxed(&ep->stats.unexp_cur);
+	stats->unexp_max = ofi_load_relaxed(&ep->stats.unexp_max);
+	stats->retransmits = ofi_load_relaxed(&ep->stats.retransmits);
+	stats->rndv = ofi_load_relaxed(&ep->stats.rndv);
+	stats->buf_exhausted = ofi_load_relaxed(&ep->stats.buf_exhausted);
+	*optlen = sizeof(*stats);
+	return 0;
+}
+
+/* Setting the option resets the counters; its value is ignored. */
+int ofi_ep_setopt_stats(struct util_ep *ep, const void *optval,
+			size_t optlen)
+{
+	if (optlen != sizeof(struct fi_ep_stats))
+		return -FI_EINVAL;
+
+	ofi_store_relaxed(&ep->stats.tx_posted, 0);
+	ofi_store_relaxed(&ep->stats.tx_completed, 0);
+	ofi_store_relaxed(&ep->stats.rx_posted, 0);
+	ofi_store_relaxed(&ep->stats.rx_completed, 0);
+	ofi_store_relaxed(&ep->stats.errors, 0);
+	ofi_store_relaxed(&ep->stats.eagain, 0);
+	ofi_store_relaxed(&ep->stats.unexp_total, 0);
+	ofi_store_relaxed(&ep->stats.unexp_max,
+			  ofi_load_relaxed(&ep->stats.unexp_cur));
+	ofi_store_relaxed(&ep->stats.retransmits, 0);
+	ofi_store_relaxed(&ep->stats.rndv, 0);
+	ofi_store_relaxed(&ep->stats.buf_exhausted, 0);
+	return 0;
+}
+
+/* Logged regardless of FI_LOG_LEVEL, since it was explicitly requested */
+static void ofi_ep_stats_print(struct util_ep *ep)
+{
+	struct fi_ep_stats stats;
+	size_t len = sizeof(stats);
+
+	ofi_ep_getopt_stats(ep, &stats, &len);
+	if (!stats.tx_posted && !stats.rx_posted)
+		return;
+
+	fi_log(ep->domain->prov, FI_LOG_INFO, FI_LOG_EP_DATA, __func__,
+	       __LINE__, "ep %p: tx posted %" PRIu64 " completed %" PRIu64
+	       ", rx posted %" PRIu64 " completed %" PRIu64 ", errors %"
+	       PRIu64 ", eagain %" PRIu64 ", unexpected %" PRIu64
+	       " (cur %" PRIu64 " max %" PRIu64 "), retransmits %" PRIu64
+	       ", rendezvous %" PRIu64 ", buffers exhausted %" PRIu64 "\n",
+	       (void *) ep, stats.tx_posted, stats.tx_completed,
+	       stats.rx_posted, stats.rx_completed, stats.errors, stats.eagain,
+	       stats.unexp_total, stats.unexp_cur, stats.unexp_max,
+	       stats.retransmits, stats.rndv, stats.buf_exhausted);
+}
+
 int ofi_endpoint_close(struct util_ep *util_ep)
 {
+	if (ofi_ep_stats_log)
+		ofi_ep_stats_print(util_ep);
+
 	fastlock_destroy(&util_ep->lock);
 
 	if (util_ep->tx_cq) {
@@ -107,8 +107,10 @@ static ssize_t util_eq_write(struct fid_eq *eq_fid, uint32_t event,
 	slist_insert_tail(&entry->entry, &eq->list);
 	fastlock_release(&eq->lock);
 
-	if (eq->wait)
+	if (eq->wait) {
+		ofi_poll_set_ready(&eq->poll_entry);
 		eq->wait->signal(eq->wait);
+	}
 
 	return len;
 }
@@ -171,8 +173,7 @@ static int util_eq_close(struct fid *fid)
 	}
 
 	if (eq->wait) {
-		fi_poll_del(&eq->wait->pollset->poll_fid,
-			    &eq->eq_fid.fid, 0);
+		ofi_poll_del_entry(&eq->poll_entry);
 		if (eq->internal_wait)
 			fi_close(&eq->wait->wait_fid.fid);
 	}
@@ -210,6 +211,7 @@ static int util_eq_init(struct fid_fabric *fabric, struct util_eq *eq,
 	ofi_atomic_initialize32(&eq->ref, 0);
 	slist_init(&eq->list);
 	fastlock_init(&eq->lock);
+	ofi_poll_entry_init(&eq->poll_entry, &eq->eq_fid.fid);
 
 	switch (attr->wait_obj) {
 	case FI_WAIT_NONE:
@@ -305,15 +307,10 @@ int ofi_eq_create(struct fid_fabric *fabric_fid, struct fi_eq_attr *attr,
 
 	ofi_atomic_inc32(&fabric->ref);
 
-	/* EQ must be fully operational before adding to wait set */
-	if (eq->wait) {
-		ret = fi_poll_add(&eq->wait->pollset->poll_fid,
-				  &eq->eq_fid.fid, 0);
-		if (ret) {
-			util_eq_close(&eq->eq_fid.fid);
-			return ret;
-		}
-	}
+	/* EQ must be fully operational before adding to wait set.  Events
+	 * are only inserted by util_eq_write, which marks the EQ ready. */
+	if (eq->wait)
+		ofi_poll_add_entry(eq->wait->pollset, &eq->poll_entry);
 
 	*eq_fid = &eq->eq_fid;
 	return 0;
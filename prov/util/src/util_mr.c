@@ -31,6 +31,7 @@
  */
 #include <config.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <fi_enosys.h>
 #include <fi_util.h>
 #include <assert.h>
@@ -185,3 +186,209 @@ void ofi_mr_map_close(struct ofi_mr_map *map)
 {
 	rbtDelete(map->rbtree);
 }
+
+static int ofi_mr_cache_compare(void *key1, void *key2)
+{
+	struct ofi_mr_cache_entry *entry1 = key1, *entry2 = key2;
+
+	if (entry1->iov.iov_base != entry2->iov.iov_base)
+		return ((uintptr_t) entry1->iov.iov_base <
+			(uintptr_t) entry2->iov.iov_base) ? -1 : 1;
+	if (entry1->iov.iov_len != entry2->iov.iov_len)
+		return (entry1->iov.iov_len < entry2->iov.iov_len) ? -1 : 1;
+	if (entry1->access != entry2->access)
+		return (entry1->access < entry2->access) ? -1 : 1;
+	return 0;
+}
+
+int ofi_mr_cache_init(const struct fi_provider *prov,
+		      struct ofi_mr_cache *cache)
+{
+	assert(cache->add_region && cache->delete_region);
+
+	cache->rbtree = rbtNew(ofi_mr_cache_compare);
+	if (!cache->rbtree)
+		return -FI_ENOMEM;
+
+	cache->prov = prov;
+	dlist_init(&cache->lru_list);
+	cache->cached_cnt = 0;
+	cache->cached_size = 0;
+	cache->uncached_cnt = 0;
+	cache->search_cnt = 0;
+	cache->hit_cnt = 0;
+	fastlock_init(&cache->lock);
+	return 0;
+}
+
+static void ofi_mr_cache_free_entry(struct ofi_mr_cache *cache,
+				    struct ofi_mr_cache_entry *entry)
+{
+	cache->delete_region(cache, entry);
+	free(entry);
+}
+
+/* Caller must hold cache->lock */
+static void ofi_mr_cache_evict(struct ofi_mr_cache *cache,
+			       struct ofi_mr_cache_entry *entry)
+{
+	void *itr;
+
+	FI_DBG(cache->prov, FI_LOG_MR, "evicting %p (len: %zu)\n",
+	       entry->iov.iov_base, entry->iov.iov_len);
+
+	itr = rbtFind(cache->rbtree, entry);
+	assert(itr);
+	rbtErase(cache->rbtree, itr);
+	dlist_remove(&entry->lru_entry);
+	cache->cached_cnt--;
+	cache->cached_size -= entry->iov.iov_len;
+	ofi_mr_cache_free_entry(cache, entry);
+}
+
+/* Caller must hold cache->lock */
+static int ofi_mr_cache_make_room(struct ofi_mr_cache *cache, size_t len)
+{
+	struct ofi_mr_cache_entry *entry;
+
+	while (cache->cached_cnt >= cache->max_cached_cnt ||
+	       cache->cached_size + len > cache->max_cached_size) {
+		if (dlist_empty(&cache->lru_list))
+			return 0;
+		entry = container_of(cache->lru_list.next,
+				     struct ofi_mr_cache_entry, lru_entry);
+		ofi_mr_cache_evict(cache, entry);
+	}
+	return 1;
+}
+
+/*
+ * Regions still in use would be released through the cache after it is
+ * gone, so the cache is left intact and -FI_EBUSY returned until they are.
+ */
+int ofi_mr_cache_cleanup(struct ofi_mr_cache *cache)
+{
+	struct ofi_mr_cache_entry *entry;
+	void *itr, *key_ptr;
+	size_t busy_cnt;
+
+	fastlock_acquire(&cache->lock);
+	busy_cnt = cache->uncached_cnt;
+	for (itr = rbtBegin(cache->rbtree); itr;
+	     itr = rbtNext(cache->rbtree, itr)) {
+		rbtKeyValue(cache->rbtree, itr, &key_ptr, (void **) &entry);
+		if (entry->use_cnt)
+			busy_cnt++;
+	}
+	fastlock_release(&cache->lock);
+
+	if (busy_cnt) {
+		FI_WARN(cache->prov, FI_LOG_MR,
+			"%zu registered regions still in use\n", busy_cnt);
+		return -FI_EBUSY;
+	}
+
+	FI_INFO(cache->prov, FI_LOG_MR, "MR cache stats: searches %" PRIu64
+		", hits %" PRIu64 "\n", cache->search_cnt, cache->hit_cnt);
+
+	while ((itr = rbtBegin(cache->rbtree))) {
+		rbtKeyValue(cache->rbtree, itr, &key_ptr, (void **) &entry);
+		ofi_mr_cache_evict(cache, entry);
+	}
+	assert(dlist_empty(&cache->lru_list));
+	rbtDelete(cache->rbtree);
+	fastlock_destroy(&cache->lock);
+	return 0;
+}
+
+/* Caller must hold cache->lock */
+static struct ofi_mr_cache_entry *
+ofi_mr_cache_find(struct ofi_mr_cache *cache, struct ofi_mr_cache_entry *key)
+{
+	struct ofi_mr_cache_entry *item;
+	void *itr, *key_ptr;
+
+	itr = rbtFind(cache->rbtree, key);
+	if (!itr)
+		return NULL;
+
+	rbtKeyValue(cache->rbtree, itr, &key_ptr, (void **) &item);
+	if (!item->use_cnt++)
+		dlist_remove(&item->lru_entry);
+	cache->hit_cnt++;
+	return item;
+}
+
+/*
+ * The region is registered without the lock held, so registrations by
+ * other threads are not serialized behind it.  If another thread cached
+ * the same region meanwhile, that entry is used and ours is dropped.
+ */
+int ofi_mr_cache_search(struct ofi_mr_cache *cache, const struct iovec *iov,
+			uint64_t access, struct ofi_mr_cache_entry **entry)
+{
+	struct ofi_mr_cache_entry key, *item, *found;
+	int ret;
+
+	key.iov = *iov;
+	key.access = access;
+
+	fastlock_acquire(&cache->lock);
+	cache->search_cnt++;
+	found = ofi_mr_cache_find(cache, &key);
+	fastlock_release(&cache->lock);
+	if (found) {
+		*entry = found;
+		return 0;
+	}
+
+	item = calloc(1, sizeof(*item) + cache->entry_data_size);
+	if (!item)
+		return -FI_ENOMEM;
+
+	item->iov = *iov;
+	item->access = access;
+	item->use_cnt = 1;
+	ret = cache->add_region(cache, item);
+	if (ret) {
+		free(item);
+		return ret;
+	}
+
+	fastlock_acquire(&cache->lock);
+	found = ofi_mr_cache_find(cache, &key);
+	if (found) {
+		fastlock_release(&cache->lock);
+		ofi_mr_cache_free_entry(cache, item);
+		*entry = found;
+		return 0;
+	}
+
+	if (ofi_mr_cache_make_room(cache, iov->iov_len)) {
+		item->cached = 1;
+		rbtInsert(cache->rbtree, item, item);
+		cache->cached_cnt++;
+		cache->cached_size += iov->iov_len;
+	} else {
+		cache->uncached_cnt++;
+	}
+	fastlock_release(&cache->lock);
+	*entry = item;
+	return 0;
+}
+
+void ofi_mr_cache_delete(struct ofi_mr_cache *cache,
+			 struct ofi_mr_cache_entry *entry)
+{
+	fastlock_acquire(&cache->lock);
+	assert(entry->use_cnt);
+	if (!--entry->use_cnt) {
+		if (entry->cached) {
+			dlist_insert_tail(&entry->lru_entry, &cache->lru_list);
+		} else {
+			cache->uncached_cnt--;
+			ofi_mr_cache_free_entry(cache, entry);
+		}
+	}
+	fastlock_release(&cache->lock);
+}
@@ -71,63 +71,190 @@ static int util_poll_del(struct fid_poll *poll_fid, struct fid *event_fid,
 	return 0;
 }
 
-static int util_poll_run(struct fid_poll *poll_fid, void **context, int count)
+static int util_poll_check(struct fid *fid)
 {
-	struct util_poll *pollset;
 	struct util_eq *eq;
 	struct util_cq *cq;
 	struct util_cntr *cntr;
+	uint64_t val;
+	int ret;
+
+	switch (fid->fclass) {
+	case FI_CLASS_CQ:
+		cq = container_of(fid, struct util_cq, cq_fid.fid);
+		ret = fi_cq_read(&cq->cq_fid, NULL, 0);
+		if (ret == 0 || ret == -FI_EAVAIL)
+			ret = 1;
+		break;
+	case FI_CLASS_CNTR:
+		cntr = container_of(fid, struct util_cntr, cntr_fid.fid);
+		val = fi_cntr_read(&cntr->cntr_fid);
+		if ((ret = (val != cntr->checkpoint_cnt))) {
+			cntr->checkpoint_cnt = val;
+		} else {
+			val = fi_cntr_readerr(&cntr->cntr_fid);
+			if ((ret = (val != cntr->checkpoint_err)))
+				cntr->checkpoint_err = val;
+		}
+		break;
+	case FI_CLASS_EQ:
+		eq = container_of(fid, struct util_eq, eq_fid.fid);
+		ret = fi_eq_read(&eq->eq_fid, NULL, NULL, 0, FI_PEEK);
+		if (ret == 0 || ret == -FI_EAVAIL)
+			ret = 1;
+		break;
+	default:
+		ret = -FI_EINVAL;
+		break;
+	}
+	return ret;
+}
+
+/*
+ * Only entries that were marked ready since they were last found empty are
+ * checked.  Entries that still report events stay on the ready list, so
+ * that events left unread by the caller are reported again.  Writers only
+ * take ready_lock, which is never held while checking an entry, so events
+ * may be written from within a check.
+ */
+static int util_poll_run(struct fid_poll *poll_fid, void **context, int count)
+{
+	struct util_poll *pollset;
+	struct util_poll_entry *entry;
 	struct fid_list_entry *fid_entry;
-	struct dlist_entry *item;
+	struct dlist_entry *item, *tmp, check_list;
 	int ret, i = 0, err = 0;
-	uint64_t val;
 
 	pollset = container_of(poll_fid, struct util_poll, poll_fid.fid);
+	dlist_init(&check_list);
 
 	fastlock_acquire(&pollset->lock);
-	dlist_foreach(&pollset->fid_list, item) {
-		fid_entry = container_of(item, struct fid_list_entry, entry);
-		switch (fid_entry->fid->fclass) {
-		case FI_CLASS_CQ:
-			cq = container_of(fid_entry->fid, struct util_cq,
-					  cq_fid.fid);
-			ret = fi_cq_read(&cq->cq_fid, NULL, 0);
-			if (ret == 0 || ret == -FI_EAVAIL)
-				ret = 1;
-			break;
-		case FI_CLASS_CNTR:
-			cntr = container_of(fid_entry->fid, struct util_cntr,
-					    cntr_fid.fid);
-			val = fi_cntr_read(&cntr->cntr_fid);
-			if ((ret = (val != cntr->checkpoint_cnt))) {
-				cntr->checkpoint_cnt = val;
-			} else {
-				val = fi_cntr_readerr(&cntr->cntr_fid);
-				if ((ret = (val != cntr->checkpoint_err)))
-					cntr->checkpoint_err = val;
-			}
-			break;
-		case FI_CLASS_EQ:
-			eq = container_of(fid_entry->fid, struct util_eq,
-					  eq_fid.fid);
-			ret = fi_eq_read(&eq->eq_fid, NULL, NULL, 0, FI_PEEK);
-			if (ret == 0 || ret == -FI_EAVAIL)
-				ret = 1;
-			break;
-		default:
-			ret = -FI_EINVAL;
-			break;
+again:
+	fastlock_acquire(&pollset->ready_lock);
+	if (pollset->scan) {
+		pollset->scan = 0;
+		dlist_foreach_container(&pollset->entry_list,
+					struct util_poll_entry, entry, entry) {
+			if (dlist_empty(&entry->ready_entry))
+				dlist_insert_tail(&entry->ready_entry,
+						  &pollset->ready_list);
+		}
+	}
+	dlist_splice_tail(&check_list, &pollset->ready_list);
+	dlist_foreach_container(&check_list, struct util_poll_entry,
+				entry, ready_entry)
+		entry->ready = 0;
+	fastlock_release(&pollset->ready_lock);
+
+	dlist_foreach_container(&check_list, struct util_poll_entry,
+				entry, ready_entry) {
+		ret = util_poll_check(entry->fid);
+		if (ret > 0) {
+			fastlock_acquire(&pollset->ready_lock);
+			entry->ready = 1;
+			fastlock_release(&pollset->ready_lock);
+			if (i < count)
+				context[i++] = entry->fid->context;
+		} else if (ret < 0 && ret != -FI_EAGAIN) {
+			err = ret;
 		}
+	}
 
+	dlist_foreach(&pollset->fid_list, item) {
+		fid_entry = container_of(item, struct fid_list_entry, entry);
+		ret = util_poll_check(fid_entry->fid);
 		if (ret > 0 && i < count)
 			context[i++] = fid_entry->fid->context;
 		else if (ret < 0 && ret != -FI_EAGAIN)
 			err = ret;
 	}
+
+	fastlock_acquire(&pollset->ready_lock);
+	dlist_foreach_container_safe(&check_list, entry, ready_entry, tmp) {
+		if (!entry->ready) {
+			dlist_remove(&entry->ready_entry);
+			dlist_init(&entry->ready_entry);
+		}
+	}
+	dlist_splice_tail(&pollset->ready_list, &check_list);
+
+	/* Entries may have been marked by progress driven from a check,
+	 * after they were checked or without being checked at all. */
+	if (!i && !err && !dlist_empty(&pollset->ready_list)) {
+		fastlock_release(&pollset->ready_lock);
+		goto again;
+	}
+	fastlock_release(&pollset->ready_lock);
 	fastlock_release(&pollset->lock);
 	return i ? i : err;
 }
 
+void ofi_poll_entry_init(struct util_poll_entry *entry, struct fid *fid)
+{
+	dlist_init(&entry->entry);
+	dlist_init(&entry->ready_entry);
+	entry->pollset = NULL;
+	entry->fid = fid;
+	entry->ready = 0;
+}
+
+void ofi_poll_add_entry(struct util_poll *pollset,
+			struct util_poll_entry *entry)
+{
+	fastlock_acquire(&pollset->lock);
+	dlist_insert_tail(&entry->entry, &pollset->entry_list);
+	entry->pollset = pollset;
+	fastlock_release(&pollset->lock);
+
+	/* The object may already hold events */
+	ofi_poll_set_ready(entry);
+}
+
+void ofi_poll_del_entry(struct util_poll_entry *entry)
+{
+	struct util_poll *pollset = entry->pollset;
+
+	if (!pollset)
+		return;
+
+	fastlock_acquire(&pollset->lock);
+	fastlock_acquire(&pollset->ready_lock);
+	if (!dlist_empty(&entry->ready_entry)) {
+		dlist_remove(&entry->ready_entry);
+		dlist_init(&entry->ready_entry);
+	}
+	entry->pollset = NULL;
+	entry->ready = 0;
+	fastlock_release(&pollset->ready_lock);
+	dlist_remove(&entry->entry);
+	dlist_init(&entry->entry);
+	fastlock_release(&pollset->lock);
+}
+
+void ofi_poll_set_ready(struct util_poll_entry *entry)
+{
+	struct util_poll *pollset = entry->pollset;
+
+	if (!pollset)
+		return;
+
+	fastlock_acquire(&pollset->ready_lock);
+	if (!entry->ready) {
+		entry->ready = 1;
+		if (dlist_empty(&entry->ready_entry))
+			dlist_insert_tail(&entry->ready_entry,
+					  &pollset->ready_list);
+	}
+	fastlock_release(&pollset->ready_lock);
+}
+
+void ofi_poll_scan(struct util_poll *pollset)
+{
+	fastlock_acquire(&pollset->ready_lock);
+	pollset->scan = 1;
+	fastlock_release(&pollset->ready_lock);
+}
+
 static int util_poll_close(struct fid *fid)
 {
 	struct util_poll *pollset;
@@ -138,6 +265,8 @@ static int util_poll_close(struct fid *fid)
 
 	if (pollset->domain)
 		ofi_atomic_dec32(&pollset->domain->ref);
+	fastlock_destroy(&pollset->ready_lock);
+	fastlock_destroy(&pollset->lock);
 	free(pollset);
 	return 0;
 }
@@ -186,6 +315,9 @@ int fi_poll_create_(const struct fi_provider *prov, struct fid_domain *domain,
 	ofi_atomic_initialize32(&pollset->ref, 0);
 	dlist_init(&pollset->fid_list);
 	fastlock_init(&pollset->lock);
+	dlist_init(&pollset->entry_list);
+	dlist_init(&pollset->ready_list);
+	fastlock_init(&pollset->ready_lock);
 
 	pollset->poll_fid.fid.fclass = FI_CLASS_POLL;
 	pollset->poll_fid.fid.ops = &util_poll_fi_ops;
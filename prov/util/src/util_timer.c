@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fi_util.h>
+
+#define OFI_TIMER_RANGE(level)	(1ULL << (((level) + 1) * OFI_TIMER_BITS))
+
+void ofi_timer_wheel_init(struct ofi_timer_wheel *wheel, uint64_t now)
+{
+	int level, i;
+
+	wheel->now = now;
+	for (level = 0; level < OFI_TIMER_LEVELS; level++) {
+		wheel->cnt[level] = 0;
+		for (i = 0; i < OFI_TIMER_SLOTS; i++)
+			dlist_init(&wheel->slot[level][i]);
+	}
+}
+
+/*
+ * A timer is placed in the lowest level whose range covers its expiration.
+ * Timers beyond the range of the top level are parked at its far end, and
+ * are placed again when that slot is cascaded.
+ */
+static void ofi_timer_insert(struct ofi_timer_wheel *wheel,
+			     struct ofi_timer *timer)
+{
+	uint64_t expires, delta;
+	int level;
+
+	expires = MAX(timer->expires, wheel->now);
+	delta = expires - wheel->now;
+	for (level = 0; level < OFI_TIMER_LEVELS - 1; level++) {
+		if (delta < OFI_TIMER_RANGE(level))
+			break;
+	}
+	if (delta >= OFI_TIMER_RANGE(level))
+		expires = wheel->now + OFI_TIMER_RANGE(level) - 1;
+
+	timer->level = level;
+	wheel->cnt[level]++;
+	dlist_insert_tail(&timer->entry, &wheel->slot[level]
+			  [(expires >> (level * OFI_TIMER_BITS)) & OFI_TIMER_MASK]);
+}
+
+void ofi_timer_start(struct ofi_timer_wheel *wheel, struct ofi_timer *timer,
+		     uint64_t expires)
+{
+	ofi_timer_stop(wheel, timer);
+	timer->expires = expires;
+	ofi_timer_insert(wheel, timer);
+}
+
+void ofi_timer_stop(struct ofi_timer_wheel *wheel, struct ofi_timer *timer)
+{
+	if (!ofi_timer_pending(timer))
+		return;
+
+	wheel->cnt[timer->level]--;
+	dlist_remove(&timer->entry);
+	dlist_init(&timer->entry);
+}
+
+static struct ofi_timer *ofi_timer_pop(struct ofi_timer_wheel *wheel,
+				       struct dlist_entry *list, int level)
+{
+	struct ofi_timer *timer;
+
+	timer = container_of(list->next, struct ofi_timer, entry);
+	dlist_remove(&timer->entry);
+	dlist_init(&timer->entry);
+	wheel->cnt[level]--;
+	return timer;
+}
+
+/*
+ * Called when the current time crosses a level 0 boundary.  The slots of
+ * the upper levels that now fall within range of the level below are
+ * redistributed; each level is only cascaded when the one below wrapped.
+ */
+static void ofi_timer_cascade(struct ofi_timer_wheel *wheel)
+{
+	struct dlist_entry *slot;
+	struct ofi_timer *timer;
+	size_t idx;
+	int level;
+
+	for (level = 1; level < OFI_TIMER_LEVELS; level++) {
+		idx = (wheel->now >> (level * OFI_TIMER_BITS)) & OFI_TIMER_MASK;
+		slot = &wheel->slot[level][idx];
+		while (!dlist_empty(slot)) {
+			timer = ofi_timer_pop(wheel, slot, level);
+			ofi_timer_insert(wheel, timer);
+		}
+		if (idx)
+			break;
+	}
+}
+
+/*
+ * Expire all timers due at or before 'now'.  Callbacks may start or stop
+ * any timer, including the one being expired.
+ */
+void ofi_timer_wheel_run(struct ofi_timer_wheel *wheel, uint64_t now)
+{
+	struct dlist_entry *slot, expired;
+	struct ofi_timer *timer;
+	uint64_t mask;
+	int level;
+
+	while (wheel->now <= now) {
+		for (level = 0; level < OFI_TIMER_LEVELS && !wheel->cnt[level];
+		     level++)
+			;
+		if (level == OFI_TIMER_LEVELS) {
+			wheel->now = now + 1;
+			break;
+		}
+
+		/* Nothing can expire before the next boundary of the lowest
+		 * non-empty level, so skip directly to it. */
+		if (level) {
+			mask = (1ULL << (level * OFI_TIMER_BITS)) - 1;
+			wheel->now = MIN((wheel->now + mask) & ~mask, now + 1);
+			if (wheel->now > now)
+				break;
+		}
+
+		if (!(wheel->now & OFI_TIMER_MASK))
+			ofi_timer_cascade(wheel);
+
+		/* Detach the expired slot before running callbacks, so that
+		 * timers restarted from a callback are not run again. */
+		slot = &wheel->slot[0][wheel->now & OFI_TIMER_MASK];
+		wheel->now++;
+		dlist_init(&expired);
+		dlist_splice_tail(&expired, slot);
+
+		while (!dlist_empty(&expired)) {
+			timer = ofi_timer_pop(wheel, &expired, 0);
+			timer->cb(wheel, timer);
+		}
+	}
+}
@@ -37,6 +37,7 @@
 #include <fi_enosys.h>
 #include <fi_util.h>
 
+#define UTIL_WAIT_FD_EVENTS	8
 
 int ofi_trywait(struct fid_fabric *fabric, struct fid **fids, int count)
 {
@@ -142,6 +143,40 @@ int fi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
 	return 0;
 }
 
+/*
+ * Calls that usually waited longer than the limit are better off sleeping
+ * right away.  Otherwise poll for about twice the average wait.  Samples
+ * are clamped so that a single long sleep does not disable polling for
+ * long after completions start arriving quickly again.
+ */
+uint64_t ofi_wait_spin_budget(struct util_wait_spin *spin, int timeout)
+{
+	uint64_t max;
+
+	if (ofi_wait_spin_max <= 0)
+		return 0;
+
+	max = (uint64_t) ofi_wait_spin_max;
+	if (timeout >= 0)
+		max = MIN(max, (uint64_t) timeout * 1000);
+	if (spin->avg_us > max)
+		return 0;
+
+	return spin->avg_us ? MIN(spin->avg_us * 2, max) : max;
+}
+
+void ofi_wait_spin_update(struct util_wait_spin *spin, uint64_t start_us)
+{
+	uint64_t sample;
+
+	if (ofi_wait_spin_max <= 0)
+		return;
+
+	sample = MIN(fi_gettime_us() - start_us,
+		     (uint64_t) ofi_wait_spin_max * 16);
+	spin->avg_us = (spin->avg_us * 7 + sample) / 8;
+}
+
 static int ofi_wait_fd_match(struct dlist_entry *item, const void *arg)
 {
 	struct ofi_wait_fd_entry *fd_entry;
@@ -209,19 +244,26 @@ out:
 	return ret;
 }
 
+/*
+ * The event being signaled was published before this call.  Reading
+ * sleepers with a read-modify-write orders it after that store, so either
+ * the waiter sees the event when it checks after announcing itself, or
+ * the signal sees the waiter.
+ */
 static void util_wait_fd_signal(struct util_wait *util_wait)
 {
 	struct util_wait_fd *wait;
 	wait = container_of(util_wait, struct util_wait_fd, util_wait);
-	fd_signal_set(&wait->signal);
+	if (!wait->lazy || ofi_atomic_add32(&wait->sleepers, 0))
+		fd_signal_set(&wait->signal);
 }
 
 static int util_wait_fd_try(struct util_wait *wait)
 {
 	struct ofi_wait_fd_entry *fd_entry;
 	struct util_wait_fd *wait_fd;
-	void *context;
-	int ret;
+	void *context, *ep_context[UTIL_WAIT_FD_EVENTS];
+	int ret, i;
 
 	wait_fd = container_of(wait, struct util_wait_fd, util_wait);
 	fd_signal_reset(&wait_fd->signal);
@@ -235,6 +277,19 @@ static int util_wait_fd_try(struct util_wait *wait)
 		}
 	}
 	fastlock_release(&wait_fd->lock);
+
+	/* Events on fds other than the signal, such as provider sockets or
+	 * CQs, are only turned into completions by progress, which marks no
+	 * poll set entry beforehand.  Check every entry if any is readable. */
+	ret = fi_epoll_wait(wait_fd->epoll_fd, ep_context,
+			    UTIL_WAIT_FD_EVENTS, 0);
+	for (i = 0; i < ret; i++) {
+		if (ep_context[i] != &wait->wait_fid.fid) {
+			ofi_poll_scan(wait->pollset);
+			break;
+		}
+	}
+
 	ret = fi_poll(&wait->pollset->poll_fid, &context, 1);
 	return (ret > 0) ? -FI_EAGAIN : ret;
 }
@@ -249,19 +304,27 @@ static int util_wait_fd_run(struct fid_wait *wait_fid, int timeout)
 	wait = container_of(wait_fid, struct util_wait_fd, util_wait.wait_fid);
 	start = (timeout >= 0) ? fi_gettime_ms() : 0;
 
+	ofi_atomic_inc32(&wait->sleepers);
 	while (1) {
 		ret = wait->util_wait.try(&wait->util_wait);
-		if (ret)
-			return ret == -FI_EAGAIN ? 0 : ret;
+		if (ret) {
+			if (ret == -FI_EAGAIN)
+				ret = 0;
+			break;
+		}
 
 		if (timeout >= 0) {
 			timeout -= (int) (fi_gettime_ms() - start);
-			if (timeout <= 0)
-				return -FI_ETIMEDOUT;
+			if (timeout <= 0) {
+				ret = -FI_ETIMEDOUT;
+				break;
+			}
 		}
 
 		fi_epoll_wait(wait->epoll_fd, ep_context, 1, timeout);
 	}
+	ofi_atomic_dec32(&wait->sleepers);
+	return ret;
 }
 
 static int util_wait_fd_control(struct fid *fid, int command, void *arg)
@@ -274,6 +337,12 @@ static int util_wait_fd_control(struct fid *fid, int command, void *arg)
 	case FI_GETWAIT:
 #ifdef HAVE_EPOLL
 		*(int *) arg = wait->epoll_fd;
+		fastlock_acquire(&wait->lock);
+		if (!wait->exported) {
+			wait->exported = 1;
+			ofi_atomic_inc32(&wait->sleepers);
+		}
+		fastlock_release(&wait->lock);
 		ret = 0;
 #else
 		ret = -FI_ENOSYS;
@@ -342,8 +411,9 @@ static int util_verify_wait_fd_attr(const struct fi_provider *prov,
 	return 0;
 }
 
-int ofi_wait_fd_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
-		    struct fid_wait **waitset)
+static int util_wait_fd_open(struct fid_fabric *fabric_fid,
+			     struct fi_wait_attr *attr, int lazy,
+			     struct fid_wait **waitset)
 {
 	struct util_fabric *fabric;
 	struct util_wait_fd *wait;
@@ -382,6 +452,8 @@ int ofi_wait_fd_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
 
 	dlist_init(&wait->fd_list);
 	fastlock_init(&wait->lock);
+	ofi_atomic_initialize32(&wait->sleepers, 0);
+	wait->lazy = lazy;
 
 	*waitset = &wait->util_wait.wait_fid;
 	return 0;
@@ -396,3 +468,15 @@ err1:
 	free(wait);
 	return ret;
 }
+
+int ofi_wait_fd_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
+		    struct fid_wait **waitset)
+{
+	return util_wait_fd_open(fabric_fid, attr, 0, waitset);
+}
+
+int ofi_wait_fd_open_lazy(struct fid_fabric *fabric_fid,
+			  struct fi_wait_attr *attr, struct fid_wait **waitset)
+{
+	return util_wait_fd_open(fabric_fid, attr, 1, waitset);
+}
@@ -57,10 +57,300 @@ struct ofi_prov {
 
 static struct ofi_prov *prov_head, *prov_tail;
 int ofi_init = 0;
+int ofi_ep_stats_log;
+int ofi_wait_spin_max;
 pthread_mutex_t ofi_ini_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static struct fi_filter prov_filter;
 
+/*
+ * Optional cache of fi_getinfo results, keyed by the full set of input
+ * arguments.  Enabled by setting FI_GETINFO_CACHE_TTL.
+ */
+#define OFI_GETINFO_CACHE_MAX	64
+
+struct ofi_getinfo_entry {
+	struct dlist_entry	entry;
+	uint32_t		version;
+	char			*node;
+	char			*service;
+	uint64_t		flags;
+	struct fi_info		*hints;
+	struct fi_info		*info;
+	uint64_t		expires;
+};
+
+static int getinfo_cache_ttl;
+static size_t getinfo_cache_cnt;
+static DEFINE_LIST(getinfo_cache);
+static pthread_mutex_t getinfo_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int ofi_str_eq(const char *a, const char *b)
+{
+	return a == b || (a && b && !strcmp(a, b));
+}
+
+static int ofi_mem_eq(const void *a, const void *b, size_t len)
+{
+	return a == b || (a && b && !memcmp(a, b, len));
+}
+
+static int ofi_tx_attr_eq(const struct fi_tx_attr *a,
+			  const struct fi_tx_attr *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return a->caps == b->caps &&
+	       a->mode == b->mode &&
+	       a->op_flags == b->op_flags &&
+	       a->msg_order == b->msg_order &&
+	       a->comp_order == b->comp_order &&
+	       a->inject_size == b->inject_size &&
+	       a->size == b->size &&
+	       a->iov_limit == b->iov_limit &&
+	       a->rma_iov_limit == b->rma_iov_limit;
+}
+
+static int ofi_rx_attr_eq(const struct fi_rx_attr *a,
+			  const struct fi_rx_attr *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return a->caps == b->caps &&
+	       a->mode == b->mode &&
+	       a->op_flags == b->op_flags &&
+	       a->msg_order == b->msg_order &&
+	       a->comp_order == b->comp_order &&
+	       a->total_buffered_recv == b->total_buffered_recv &&
+	       a->size == b->size &&
+	       a->iov_limit == b->iov_limit;
+}
+
+static int ofi_ep_attr_eq(const struct fi_ep_attr *a,
+			  const struct fi_ep_attr *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return a->type == b->type &&
+	       a->protocol == b->protocol &&
+	       a->protocol_version == b->protocol_version &&
+	       a->max_msg_size == b->max_msg_size &&
+	       a->msg_prefix_size == b->msg_prefix_size &&
+	       a->max_order_raw_size == b->max_order_raw_size &&
+	       a->max_order_war_size == b->max_order_war_size &&
+	       a->max_order_waw_size == b->max_order_waw_size &&
+	       a->mem_tag_format == b->mem_tag_format &&
+	       a->tx_ctx_cnt == b->tx_ctx_cnt &&
+	       a->rx_ctx_cnt == b->rx_ctx_cnt &&
+	       a->auth_key_size == b->auth_key_size &&
+	       ofi_mem_eq(a->auth_key, b->auth_key, a->auth_key_size);
+}
+
+static int ofi_domain_attr_eq(const struct fi_domain_attr *a,
+			      const struct fi_domain_attr *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return a->domain == b->domain &&
+	       ofi_str_eq(a->name, b->name) &&
+	       a->threading == b->threading &&
+	       a->control_progress == b->control_progress &&
+	       a->data_progress == b->data_progress &&
+	       a->resource_mgmt == b->resource_mgmt &&
+	       a->av_type == b->av_type &&
+	       a->mr_mode == b->mr_mode &&
+	       a->mr_key_size == b->mr_key_size &&
+	       a->cq_data_size == b->cq_data_size &&
+	       a->cq_cnt == b->cq_cnt &&
+	       a->ep_cnt == b->ep_cnt &&
+	       a->tx_ctx_cnt == b->tx_ctx_cnt &&
+	       a->rx_ctx_cnt == b->rx_ctx_cnt &&
+	       a->max_ep_tx_ctx == b->max_ep_tx_ctx &&
+	       a->max_ep_rx_ctx == b->max_ep_rx_ctx &&
+	       a->max_ep_stx_ctx == b->max_ep_stx_ctx &&
+	       a->max_ep_srx_ctx == b->max_ep_srx_ctx &&
+	       a->cntr_cnt == b->cntr_cnt &&
+	       a->mr_iov_limit == b->mr_iov_limit &&
+	       a->caps == b->caps &&
+	       a->mode == b->mode &&
+	       a->auth_key_size == b->auth_key_size &&
+	       ofi_mem_eq(a->auth_key, b->auth_key, a->auth_key_size) &&
+	       a->max_err_data == b->max_err_data &&
+	       a->mr_cnt == b->mr_cnt;
+}
+
+static int ofi_fabric_attr_eq(const struct fi_fabric_attr *a,
+			      const struct fi_fabric_attr *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return a->fabric == b->fabric &&
+	       ofi_str_eq(a->name, b->name) &&
+	       ofi_str_eq(a->prov_name, b->prov_name) &&
+	       a->prov_version == b->prov_version &&
+	       a->api_version == b->api_version;
+}
+
+static int ofi_hints_eq(const struct fi_info *a, const struct fi_info *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return a->caps == b->caps &&
+	       a->mode == b->mode &&
+	       a->addr_format == b->addr_format &&
+	       a->src_addrlen == b->src_addrlen &&
+	       a->dest_addrlen == b->dest_addrlen &&
+	       ofi_mem_eq(a->src_addr, b->src_addr, a->src_addrlen) &&
+	       ofi_mem_eq(a->dest_addr, b->dest_addr, a->dest_addrlen) &&
+	       a->handle == b->handle &&
+	       ofi_tx_attr_eq(a->tx_attr, b->tx_attr) &&
+	       ofi_rx_attr_eq(a->rx_attr, b->rx_attr) &&
+	       ofi_ep_attr_eq(a->ep_attr, b->ep_attr) &&
+	       ofi_domain_attr_eq(a->domain_attr, b->domain_attr) &&
+	       ofi_fabric_attr_eq(a->fabric_attr, b->fabric_attr);
+}
+
+static struct fi_info *ofi_dupinfo_list(const struct fi_info *info)
+{
+	struct fi_info *head = NULL, *tail = NULL, *cur;
+
+	for (; info; info = info->next) {
+		cur = fi_dupinfo(info);
+		if (!cur) {
+			fi_freeinfo(head);
+			return NULL;
+		}
+
+		if (!head)
+			head = cur;
+		else
+			tail->next = cur;
+		tail = cur;
+	}
+	return head;
+}
+
+static void ofi_getinfo_entry_free(struct ofi_getinfo_entry *entry)
+{
+	free(entry->node);
+	free(entry->service);
+	fi_freeinfo(entry->hints);
+	fi_freeinfo(entry->info);
+	free(entry);
+}
+
+static void ofi_getinfo_cache_remove(struct ofi_getinfo_entry *entry)
+{
+	dlist_remove(&entry->entry);
+	getinfo_cache_cnt--;
+	ofi_getinfo_entry_free(entry);
+}
+
+static void ofi_getinfo_cache_fini(void)
+{
+	struct ofi_getinfo_entry *entry;
+
+	pthread_mutex_lock(&getinfo_cache_lock);
+	while (!dlist_empty(&getinfo_cache)) {
+		entry = container_of(getinfo_cache.next,
+				     struct ofi_getinfo_entry, entry);
+		ofi_getinfo_cache_remove(entry);
+	}
+	pthread_mutex_unlock(&getinfo_cache_lock);
+}
+
+/*
+ * Returns a copy of a cached result in *info, or -FI_ENODATA if there is
+ * no matching, unexpired entry.  Hits are moved to the head of the list,
+ * so that the tail holds the least recently used entry.
+ */
+static int ofi_getinfo_cache_get(uint32_t version, const char *node,
+				 const char *service, uint64_t flags,
+				 const struct fi_info *hints,
+				 struct fi_info **info)
+{
+	struct ofi_getinfo_entry *entry;
+	struct dlist_entry *item, *tmp;
+	uint64_t now;
+	int ret = -FI_ENODATA;
+
+	now = fi_gettime_ms();
+	pthread_mutex_lock(&getinfo_cache_lock);
+	dlist_foreach_safe(&getinfo_cache, item, tmp) {
+		entry = container_of(item, struct ofi_getinfo_entry, entry);
+		if (getinfo_cache_ttl > 0 && now >= entry->expires) {
+			ofi_getinfo_cache_remove(entry);
+			continue;
+		}
+
+		if (entry->version != version || entry->flags != flags ||
+		    !ofi_str_eq(entry->node, node) ||
+		    !ofi_str_eq(entry->service, service) ||
+		    !ofi_hints_eq(entry->hints, hints))
+			continue;
+
+		*info = ofi_dupinfo_list(entry->info);
+		if (!*info) {
+			ret = -FI_ENOMEM;
+			break;
+		}
+
+		dlist_remove(&entry->entry);
+		dlist_insert_head(&entry->entry, &getinfo_cache);
+		ret = 0;
+		break;
+	}
+	pthread_mutex_unlock(&getinfo_cache_lock);
+	return ret;
+}
+
+/* Caching is best effort; failures here are not reported to the caller */
+static void ofi_getinfo_cache_put(uint32_t version, const char *node,
+				  const char *service, uint64_t flags,
+				  const struct fi_info *hints,
+				  const struct fi_info *info)
+{
+	struct ofi_getinfo_entry *entry;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+
+	entry->version = version;
+	entry->flags = flags;
+	if ((node && !(entry->node = strdup(node))) ||
+	    (service && !(entry->service = strdup(service))))
+		goto err;
+
+	if (hints && !(entry->hints = fi_dupinfo(hints)))
+		goto err;
+
+	entry->info = ofi_dupinfo_list(info);
+	if (!entry->info)
+		goto err;
+
+	entry->expires = fi_gettime_ms() + getinfo_cache_ttl;
+
+	pthread_mutex_lock(&getinfo_cache_lock);
+	if (getinfo_cache_cnt == OFI_GETINFO_CACHE_MAX) {
+		ofi_getinfo_cache_remove(container_of(getinfo_cache.prev,
+					 struct ofi_getinfo_entry, entry));
+	}
+	dlist_insert_head(&entry->entry, &getinfo_cache);
+	getinfo_cache_cnt++;
+	pthread_mutex_unlock(&getinfo_cache_lock);
+	return;
+
+err:
+	ofi_getinfo_entry_free(entry);
+}
+
 
 static int ofi_find_name(char **names, const char *name)
 {
@@ -116,8 +406,10 @@ static void cleanup_provider(struct fi_provider *provider, void *dlhandle)
 	}
 
 #ifdef HAVE_LIBDL
-	if (dlhandle)
+	if (dlhandle) {
+		ofi_trace_forget();
 		dlclose(dlhandle);
+	}
 #endif
 }
 
@@ -396,8 +688,26 @@ void fi_ini(void)
 			" (default: no). Setting this to yes could improve"
 			" performance at the expense of making fork() potentially"
 			" unsafe");
+	fi_param_define(NULL, "getinfo_cache_ttl", FI_PARAM_INT,
+			"Cache fi_getinfo results for the given number of"
+			" milliseconds, and return copies of the cached results"
+			" for repeated calls with identical arguments.  A"
+			" negative value caches results until the library is"
+			" unloaded (default: 0, caching disabled)");
 	fi_param_get_str(NULL, "provider", &param_val);
 	ofi_create_filter(&prov_filter, param_val);
+	fi_param_get_int(NULL, "getinfo_cache_ttl", &getinfo_cache_ttl);
+	fi_param_define(NULL, "ep_stats", FI_PARAM_BOOL,
+			"Log the statistics of each endpoint that was used"
+			" when it is closed (default: no)");
+	fi_param_get_bool(NULL, "ep_stats", &ofi_ep_stats_log);
+	fi_param_define(NULL, "wait_spin_max", FI_PARAM_INT,
+			"Maximum number of microseconds that blocking CQ reads"
+			" and counter waits poll for completions before"
+			" sleeping.  The time actually spent polling adapts to"
+			" how long recent calls had to wait (default: 0,"
+			" polling disabled)");
+	fi_param_get_int(NULL, "wait_spin_max", &ofi_wait_spin_max);
 
 #ifdef HAVE_LIBDL
 	int n = 0;
@@ -450,6 +760,8 @@ libdl_done:
 			ofi_register_provider(RXD_INIT, NULL);
 	}
 
+	ofi_register_provider(SHM_INIT, NULL);
+
 	/* Initialize the socket(s) provider last.  This will result in
 	 * it being the least preferred provider. */
 	ofi_register_provider(UDP_INIT, NULL);
@@ -478,6 +790,7 @@ FI_DESTRUCTOR(fi_fini(void))
 		free(prov);
 	}
 
+	ofi_getinfo_cache_fini();
 	ofi_free_filter(&prov_filter);
 	fi_log_fini();
 	fi_param_fini();
@@ -632,10 +945,9 @@ static int ofi_layering_ok(const struct fi_provider *provider,
 	return 1;
 }
 
-__attribute__((visibility ("default")))
-int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
-		const char *service, uint64_t flags,
-		const struct fi_info *hints, struct fi_info **info)
+static int ofi_getinfo_provs(uint32_t version, const char *node,
+			     const char *service, uint64_t flags,
+			     const struct fi_info *hints, struct fi_info **info)
 {
 	struct ofi_prov *prov;
 	struct fi_info *tail, *cur;
@@ -643,19 +955,6 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 	size_t util_len = 0, core_len = 0;
 	int ret;
 
-	if (!ofi_init)
-		fi_ini();
-
-	if (FI_VERSION_LT(fi_version(), version)) {
-		FI_WARN(&core_prov, FI_LOG_CORE,
-			"Requested version is newer than library\n");
-		return -FI_ENOSYS;
-	}
-
-	if (flags == FI_PROV_ATTR_ONLY) {
-		return ofi_getprovinfo(info);
-	}
-
 	if (hints && hints->fabric_attr && hints->fabric_attr->prov_name) {
 		util_name = ofi_util_name(hints->fabric_attr->prov_name,
 					  &util_len);
@@ -710,6 +1009,45 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 
 	return *info ? 0 : -FI_ENODATA;
 }
+
+__attribute__((visibility ("default")))
+int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
+		const char *service, uint64_t flags,
+		const struct fi_info *hints, struct fi_info **info)
+{
+	int ret;
+
+	if (!ofi_init)
+		fi_ini();
+
+	if (FI_VERSION_LT(fi_version(), version)) {
+		FI_WARN(&core_prov, FI_LOG_CORE,
+			"Requested version is newer than library\n");
+		return -FI_ENOSYS;
+	}
+
+	if (flags == FI_PROV_ATTR_ONLY) {
+		return ofi_getprovinfo(info);
+	}
+
+	if (!getinfo_cache_ttl)
+		return ofi_getinfo_provs(version, node, service, flags,
+					 hints, info);
+
+	ret = ofi_getinfo_cache_get(version, node, service, flags, hints, info);
+	if (ret != -FI_ENODATA) {
+		if (!ret)
+			FI_DBG(&core_prov, FI_LOG_CORE,
+			       "returning cached fi_getinfo results\n");
+		return ret;
+	}
+
+	ret = ofi_getinfo_provs(version, node, service, flags, hints, info);
+	if (!ret)
+		ofi_getinfo_cache_put(version, node, service, flags,
+				      hints, *info);
+	return ret;
+}
 CURRENT_SYMVER(fi_getinfo_, fi_getinfo);
 
 struct fi_info *ofi_allocinfo_internal(void)
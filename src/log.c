@@ -123,10 +123,13 @@ void fi_log_init(void)
 			log_mask |= (1 << (i + FI_LOG_SUBSYS_OFFSET));
 	}
 	ofi_free_filter(&subsys_filter);
+
+	ofi_trace_init();
 }
 
 void fi_log_fini(void)
 {
+	ofi_trace_fini();
 	ofi_free_filter(&prov_log_filter);
 }
 
@@ -153,6 +156,13 @@ void DEFAULT_SYMVER_PRE(fi_log)(const struct fi_provider *prov, enum fi_log_leve
 
 	va_list vargs;
 
+	if (ofi_trace_enabled) {
+		va_start(vargs, fmt);
+		ofi_trace_log(prov, level, subsys, func, line, fmt, vargs);
+		va_end(vargs);
+		return;
+	}
+
 	size = snprintf(buf, sizeof(buf), "%s:%s:%s:%s():%d<%s> ", PACKAGE,
 			prov->name, log_subsys[subsys], func, line,
 			log_levels[level]);
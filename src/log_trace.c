@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <rdma/fi_errno.h>
+
+#include "fi.h"
+#include "fi_list.h"
+#include "fi_trace.h"
+
+
+/*
+ * Each logging thread owns a ring that only it writes.  A flusher thread
+ * drains all rings to the trace file, so logging never takes a lock or
+ * formats a message.  Records that do not fit in a full ring are counted
+ * and dropped.
+ *
+ * Strings are identified in the file by a hash of their contents, and each
+ * ring caches the ids of the strings it has defined by address.  Unloading
+ * a provider bumps trace_gen, which empties the caches, since its strings'
+ * addresses may be reused by the next library loaded.
+ */
+#define OFI_TRACE_SEEN		256
+#define OFI_TRACE_REC_WORDS	128
+#define OFI_TRACE_FLUSH_MS	100
+
+struct ofi_trace_seen {
+	const void		*str;
+	uint64_t		id;
+};
+
+struct ofi_trace_ring {
+	struct dlist_entry	entry;
+	size_t			head;
+	size_t			tail;
+	size_t			drops;
+	size_t			drops_reported;
+	size_t			exited;
+	size_t			mask;
+	uint32_t		thread;
+	size_t			gen;
+	/* Strings this thread has already written, indexed by address */
+	struct ofi_trace_seen	seen[OFI_TRACE_SEEN];
+	uint8_t			*buf;
+};
+
+int ofi_trace_enabled;
+
+static size_t trace_ring_size = 1 << 20;
+static FILE *trace_file;
+static pthread_key_t trace_key;
+static pthread_t trace_thread;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trace_cond;
+static struct dlist_entry trace_rings;
+static uint32_t trace_thread_cnt;
+static size_t trace_gen;
+static int trace_stop;
+
+static size_t ofi_trace_ring_used(struct ofi_trace_ring *ring)
+{
+	return ring->head - ofi_load_acquire(&ring->tail);
+}
+
+static void ofi_trace_ring_write(struct ofi_trace_ring *ring,
+				 const void *data, size_t len)
+{
+	size_t off, cnt;
+
+	off = ring->head & ring->mask;
+	cnt = MIN(len, ring->mask + 1 - off);
+	memcpy(ring->buf + off, data, cnt);
+	memcpy(ring->buf, (const uint8_t *) data + cnt, len - cnt);
+	ofi_store_release(&ring->head, ring->head + len);
+}
+
+static void ofi_trace_ring_exit(void *arg)
+{
+	struct ofi_trace_ring *ring = arg;
+
+	ofi_store_release(&ring->exited, 1);
+}
+
+static struct ofi_trace_ring *ofi_trace_ring_get(void)
+{
+	struct ofi_trace_ring *ring;
+
+	ring = pthread_getspecific(trace_key);
+	if (ring)
+		return ring;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	ring->buf = malloc(trace_ring_size);
+	if (!ring->buf)
+		goto err;
+
+	ring->mask = trace_ring_size - 1;
+	if (pthread_setspecific(trace_key, ring))
+		goto err;
+
+	pthread_mutex_lock(&trace_lock);
+	ring->thread = trace_thread_cnt++;
+	dlist_insert_tail(&ring->entry, &trace_rings);
+	pthread_mutex_unlock(&trace_lock);
+	return ring;
+err:
+	free(ring->buf);
+	free(ring);
+	return NULL;
+}
+
+static int ofi_trace_put(struct ofi_trace_ring *ring, void *rec, size_t words)
+{
+	struct ofi_trace_hdr *hdr = rec;
+
+	if (words * 8 > ring->mask + 1 - ofi_trace_ring_used(ring)) {
+		ofi_store_release(&ring->drops, ring->drops + 1);
+		return -FI_EAGAIN;
+	}
+
+	hdr->len = (uint16_t) words;
+	hdr->thread = ring->thread;
+	ofi_trace_ring_write(ring, rec, words * 8);
+	return 0;
+}
+
+/* FNV-1a */
+static uint64_t ofi_trace_hash(const char *str, size_t len)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (len--) {
+		hash ^= (uint8_t) *str++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/* Write a string definition the first time this thread references it */
+static int ofi_trace_def(struct ofi_trace_ring *ring, const char *str,
+			 uint64_t *id)
+{
+	uint64_t rec[OFI_TRACE_REC_WORDS] = {0};
+	struct ofi_trace_str *def = (struct ofi_trace_str *) rec;
+	struct ofi_trace_seen *seen;
+	size_t len;
+
+	seen = &ring->seen[((uintptr_t) str >> 3) % OFI_TRACE_SEEN];
+	if (seen->str == str) {
+		*id = seen->id;
+		return 0;
+	}
+
+	len = strnlen(str, sizeof(rec) - sizeof(*def) - 1);
+	def->hdr.type = OFI_TRACE_STR;
+	def->id = ofi_trace_hash(str, len);
+	memcpy(def->str, str, len);
+	if (ofi_trace_put(ring, rec, ofi_trace_words(sizeof(*def) + len + 1)))
+		return -FI_EAGAIN;
+
+	seen->str = str;
+	seen->id = def->id;
+	*id = def->id;
+	return 0;
+}
+
+void ofi_trace_log(const struct fi_provider *prov, enum fi_log_level level,
+		   enum fi_log_subsys subsys, const char *func, int line,
+		   const char *fmt, va_list vargs)
+{
+	uint64_t rec[OFI_TRACE_REC_WORDS];
+	struct ofi_trace_log *log = (struct ofi_trace_log *) rec;
+	struct ofi_trace_ring *ring;
+	struct ofi_trace_conv conv;
+	size_t words, max, len;
+	uint64_t prov_id, func_id, fmt_id;
+	const char *str;
+	int64_t sval;
+	double dval;
+	size_t gen;
+	int i;
+
+	ring = ofi_trace_ring_get();
+	if (!ring)
+		return;
+
+	gen = ofi_load_acquire(&trace_gen);
+	if (ring->gen != gen) {
+		memset(ring->seen, 0, sizeof(ring->seen));
+		ring->gen = gen;
+	}
+
+	if (ofi_trace_def(ring, prov->name, &prov_id) ||
+	    ofi_trace_def(ring, func, &func_id) ||
+	    ofi_trace_def(ring, fmt, &fmt_id))
+		return;
+
+	memset(log, 0, sizeof(*log));
+	log->hdr.type = OFI_TRACE_LOG;
+	log->time = fi_gettime_us();
+	log->prov = prov_id;
+	log->func = func_id;
+	log->fmt = fmt_id;
+	log->line = line;
+	log->level = level;
+	log->subsys = subsys;
+
+	words = sizeof(*log) / 8;
+	max = OFI_TRACE_REC_WORDS;
+	while ((fmt = ofi_trace_parse(fmt, &conv))) {
+		if (words + conv.stars + 1 > max) {
+			log->hdr.flags |= OFI_TRACE_TRUNC;
+			break;
+		}
+
+		for (i = 0; i < conv.stars; i++)
+			rec[words++] = (int64_t) va_arg(vargs, int);
+
+		switch (conv.type) {
+		case OFI_TRACE_ARG_NONE:
+			continue;
+		case OFI_TRACE_ARG_INT:
+			sval = conv.is_signed ? (int64_t) va_arg(vargs, int) :
+			       (int64_t) va_arg(vargs, unsigned int);
+			break;
+		case OFI_TRACE_ARG_LONG:
+			sval = conv.is_signed ? (int64_t) va_arg(vargs, long) :
+			       (int64_t) va_arg(vargs, unsigned long);
+			break;
+		case OFI_TRACE_ARG_LLONG:
+			sval = (int64_t) va_arg(vargs, long long);
+			break;
+		case OFI_TRACE_ARG_INTMAX:
+			sval = (int64_t) va_arg(vargs, intmax_t);
+			break;
+		case OFI_TRACE_ARG_SIZE:
+			sval = (int64_t) va_arg(vargs, size_t);
+			break;
+		case OFI_TRACE_ARG_PTRDIFF:
+			sval = (int64_t) va_arg(vargs, ptrdiff_t);
+			break;
+		case OFI_TRACE_ARG_DOUBLE:
+			dval = va_arg(vargs, double);
+			memcpy(&sval, &dval, sizeof(sval));
+			break;
+		case OFI_TRACE_ARG_LDOUBLE:
+			dval = (double) va_arg(vargs, long double);
+			memcpy(&sval, &dval, sizeof(sval));
+			break;
+		case OFI_TRACE_ARG_PTR:
+			sval = (int64_t) (uintptr_t) va_arg(vargs, void *);
+			break;
+		case OFI_TRACE_ARG_STR:
+			str = va_arg(vargs, const char *);
+			if (!str)
+				str = "(null)";
+			len = MIN(strnlen(str, OFI_TRACE_STR_MAX),
+				  (max - words - 1) * 8);
+			rec[words++] = len;
+			memcpy(&rec[words], str, len);
+			words += ofi_trace_words(len);
+			continue;
+		}
+		rec[words++] = (uint64_t) sval;
+	}
+
+	ofi_trace_put(ring, rec, words);
+}
+
+static void ofi_trace_flush_ring(struct ofi_trace_ring *ring)
+{
+	struct ofi_trace_drop drop = {{0}};
+	size_t head, tail, off, cnt, drops;
+
+	head = ofi_load_acquire(&ring->head);
+	tail = ring->tail;
+	if (head != tail) {
+		off = tail & ring->mask;
+		cnt = MIN(head - tail, ring->mask + 1 - off);
+		fwrite(ring->buf + off, 1, cnt, trace_file);
+		fwrite(ring->buf, 1, head - tail - cnt, trace_file);
+		ofi_store_release(&ring->tail, head);
+	}
+
+	drops = ofi_load_acquire(&ring->drops);
+	if (drops != ring->drops_reported) {
+		drop.hdr.type = OFI_TRACE_DROP;
+		drop.hdr.len = sizeof(drop) / 8;
+		drop.hdr.thread = ring->thread;
+		drop.count = drops - ring->drops_reported;
+		fwrite(&drop, 1, sizeof(drop), trace_file);
+		ring->drops_reported = drops;
+	}
+}
+
+/* Called with trace_lock held */
+static void ofi_trace_flush(void)
+{
+	struct ofi_trace_ring *ring;
+	struct dlist_entry *tmp;
+
+	dlist_foreach_container_safe(&trace_rings, ring, entry, tmp) {
+		ofi_trace_flush_ring(ring);
+		if (ofi_load_acquire(&ring->exited) &&
+		    ofi_load_acquire(&ring->head) == ring->tail) {
+			dlist_remove(&ring->entry);
+			free(ring->buf);
+			free(ring);
+		}
+	}
+	fflush(trace_file);
+}
+
+static void *ofi_trace_flusher(void *arg)
+{
+	pthread_mutex_lock(&trace_lock);
+	while (!trace_stop) {
+		fi_wait_cond(&trace_cond, &trace_lock, OFI_TRACE_FLUSH_MS);
+		ofi_trace_flush();
+	}
+	pthread_mutex_unlock(&trace_lock);
+	return NULL;
+}
+
+void ofi_trace_init(void)
+{
+	struct ofi_trace_file_hdr hdr = {{0}};
+	char *path = NULL, *name;
+	int size = 0;
+
+	fi_param_define(NULL, "log_trace_file", FI_PARAM_STRING,
+			"Write log messages to a binary trace file instead "
+			"of formatting them to stderr.  The process id is "
+			"appended to the file name.  Use fi_tracedump to "
+			"decode the file (default: disabled)");
+	fi_param_define(NULL, "log_trace_size", FI_PARAM_INT,
+			"Size of each thread's trace buffer, rounded up to a "
+			"power of two (default: 1 MiB)");
+
+	fi_param_get_str(NULL, "log_trace_file", &path);
+	if (!path || !*path)
+		return;
+
+	fi_param_get_int(NULL, "log_trace_size", &size);
+	if (size > 0)
+		trace_ring_size = roundup_power_of_two(MAX(size, 4096));
+
+	if (asprintf(&name, "%s.%d", path, getpid()) < 0)
+		return;
+
+	trace_file = fopen(name, "wb");
+	free(name);
+	if (!trace_file)
+		return;
+
+	memcpy(hdr.magic, OFI_TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = OFI_TRACE_VERSION;
+	hdr.pid = getpid();
+	fwrite(&hdr, 1, sizeof(hdr), trace_file);
+
+	dlist_init(&trace_rings);
+	pthread_cond_init(&trace_cond, NULL);
+	if (pthread_key_create(&trace_key, ofi_trace_ring_exit))
+		goto err1;
+
+	if (pthread_create(&trace_thread, NULL, ofi_trace_flusher, NULL))
+		goto err2;
+
+	ofi_trace_enabled = 1;
+	return;
+err2:
+	pthread_key_delete(trace_key);
+err1:
+	pthread_cond_destroy(&trace_cond);
+	fclose(trace_file);
+	trace_file = NULL;
+}
+
+/* Called before a provider library is unloaded */
+void ofi_trace_forget(void)
+{
+	if (ofi_trace_enabled)
+		ofi_store_release(&trace_gen, trace_gen + 1);
+}
+
+/*
+ * Other threads may still be logging and nothing says when they are done,
+ * so the rings are never freed here; they are reclaimed at process exit.
+ * Records written after the final flush are lost.  The key is deleted so
+ * its destructor is not called once the library has been unloaded.
+ */
+void ofi_trace_fini(void)
+{
+	if (!ofi_trace_enabled)
+		return;
+
+	ofi_trace_enabled = 0;
+	pthread_mutex_lock(&trace_lock);
+	trace_stop = 1;
+	pthread_cond_signal(&trace_cond);
+	pthread_mutex_unlock(&trace_lock);
+	pthread_join(trace_thread, NULL);
+
+	pthread_key_delete(trace_key);
+	pthread_mutex_lock(&trace_lock);
+	ofi_trace_flush();
+	fclose(trace_file);
+	trace_file = NULL;
+	pthread_mutex_unlock(&trace_lock);
+	pthread_cond_destroy(&trace_cond);
+}
@@ -45,6 +45,11 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
 #include "fi.h"
 #include "fi_osd.h"
 #include "fi_file.h"
@@ -146,6 +151,12 @@ int ofi_shm_map(struct util_shm *shm, const char *name, size_t size,
 
 	*mapped = shm->ptr;
 	shm->size = size;
+
+	/* Only the creator removes the name when the segment is unmapped */
+	if (readonly) {
+		free(fname);
+		shm->name = NULL;
+	}
 	return ret;
 
 failed:
@@ -203,3 +214,78 @@ int fi_read_file(const char *dir, const char *file, char *buf, size_t size)
 }
 
 
+
+/* Size of the default huge page, or a negative error if there is none */
+ssize_t ofi_get_hugepage_size(void)
+{
+	static ssize_t hugepage_size;
+	char line[128];
+	FILE *fd;
+	size_t val;
+
+	if (hugepage_size)
+		return hugepage_size;
+
+	fd = fopen("/proc/meminfo", "r");
+	if (!fd)
+		return hugepage_size = -FI_ENOSYS;
+
+	hugepage_size = -FI_ENOENT;
+	while (fgets(line, sizeof(line), fd)) {
+		if (sscanf(line, "Hugepagesize: %zu kB", &val) == 1) {
+			hugepage_size = val * 1024;
+			break;
+		}
+	}
+	fclose(fd);
+	return hugepage_size;
+}
+
+int ofi_alloc_hugepage_buf(void **memptr, size_t size)
+{
+#ifdef MAP_HUGETLB
+	*memptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (*memptr == MAP_FAILED) {
+		*memptr = NULL;
+		return -errno;
+	}
+	return 0;
+#else
+	OFI_UNUSED(memptr);
+	OFI_UNUSED(size);
+	return -FI_ENOSYS;
+#endif
+}
+
+int ofi_free_hugepage_buf(void *memptr, size_t size)
+{
+	return munmap(memptr, size) ? -errno : 0;
+}
+
+/*
+ * Prefer allocating the pages of a page aligned range on the given NUMA
+ * node, moving any that are already resident.  The kernel falls back to
+ * other nodes when the preferred one is out of memory.
+ */
+int ofi_mbind_node(void *addr, size_t len, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	unsigned long mask[4] = {0};
+	size_t bits = sizeof(mask) * 8;
+
+	if (node < 0 || (size_t) node >= bits)
+		return -FI_EINVAL;
+
+	mask[node / (sizeof(*mask) * 8)] = 1UL << (node % (sizeof(*mask) * 8));
+	if (syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask, bits + 1,
+		    MPOL_MF_MOVE))
+		return -errno;
+	return 0;
+#else
+	OFI_UNUSED(addr);
+	OFI_UNUSED(len);
+	OFI_UNUSED(node);
+	return -FI_ENOSYS;
+#endif
+}
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fi_trace.h>
+
+
+static const char * const log_subsys[] = {
+	"core", "fabric", "domain", "ep_ctrl", "ep_data",
+	"av", "cq", "eq", "mr", "cntr",
+};
+
+static const char * const log_levels[] = {
+	"warn", "trace", "info", "debug",
+};
+
+struct str_entry {
+	uint64_t id;
+	const char *str;
+};
+
+struct log_entry {
+	const struct ofi_trace_log *log;
+	const char *prov;
+	const char *func;
+	const char *fmt;
+	size_t seq;
+};
+
+static struct str_entry *strs;
+static size_t str_size;
+
+static const char **str_slot(uint64_t id)
+{
+	size_t i;
+
+	for (i = (id >> 3) % str_size; strs[i].str; i = (i + 1) % str_size) {
+		if (strs[i].id == id)
+			break;
+	}
+	strs[i].id = id;
+	return &strs[i].str;
+}
+
+static const char *str_get(uint64_t id)
+{
+	const char **str = str_slot(id);
+
+	return *str ? *str : "?";
+}
+
+static int log_cmp(const void *a, const void *b)
+{
+	const struct log_entry *x = a, *y = b;
+
+	if (x->log->time != y->log->time)
+		return x->log->time < y->log->time ? -1 : 1;
+	return x->seq < y->seq ? -1 : 1;
+}
+
+static void print_arg(const struct ofi_trace_conv *conv, const uint64_t *arg)
+{
+	char spec[64];
+	int w[2] = {0};
+	double d;
+	int i;
+
+	if (conv->len >= sizeof(spec))
+		return;
+
+	memcpy(spec, conv->start, conv->len);
+	spec[conv->len] = '\0';
+	for (i = 0; i < conv->stars; i++)
+		w[i] = (int) *arg++;
+
+#define PRINT(val)							\
+	do {								\
+		if (conv->stars == 2)					\
+			printf(spec, w[0], w[1], val);			\
+		else if (conv->stars == 1)				\
+			printf(spec, w[0], val);			\
+		else							\
+			printf(spec, val);				\
+	} while (0)
+
+	switch (conv->type) {
+	case OFI_TRACE_ARG_INT:
+		PRINT((int) *arg);
+		break;
+	case OFI_TRACE_ARG_LONG:
+		PRINT((long) *arg);
+		break;
+	case OFI_TRACE_ARG_LLONG:
+		PRINT((long long) *arg);
+		break;
+	case OFI_TRACE_ARG_INTMAX:
+		PRINT((intmax_t) *arg);
+		break;
+	case OFI_TRACE_ARG_SIZE:
+		PRINT((size_t) *arg);
+		break;
+	case OFI_TRACE_ARG_PTRDIFF:
+		PRINT((ptrdiff_t) *arg);
+		break;
+	case OFI_TRACE_ARG_DOUBLE:
+		memcpy(&d, arg, sizeof(d));
+		PRINT(d);
+		break;
+	case OFI_TRACE_ARG_LDOUBLE:
+		memcpy(&d, arg, sizeof(d));
+		PRINT((long double) d);
+		break;
+	case OFI_TRACE_ARG_PTR:
+		if (conv->start[conv->len - 1] == 'p')
+			PRINT((void *) (uintptr_t) *arg);
+		break;
+	case OFI_TRACE_ARG_STR:
+		/* Already copied out, see print_log */
+		break;
+	case OFI_TRACE_ARG_NONE:
+		if (conv->start[conv->len - 1] == '%')
+			putchar('%');
+		break;
+	}
+#undef PRINT
+}
+
+static void print_log(const struct log_entry *entry)
+{
+	const struct ofi_trace_log *log = entry->log;
+	const uint64_t *arg = log->args;
+	const uint64_t *end = (const uint64_t *) log + log->hdr.len;
+	const char *fmt = entry->fmt, *next;
+	struct ofi_trace_conv conv;
+	char spec[64], *str;
+	size_t len;
+
+	printf("[%llu.%06llu] t%u libfabric:%s:%s:%s():%u<%s> ",
+	       (unsigned long long) (log->time / 1000000),
+	       (unsigned long long) (log->time % 1000000), log->hdr.thread,
+	       entry->prov,
+	       log->subsys < sizeof(log_subsys) / sizeof(*log_subsys) ?
+	       log_subsys[log->subsys] : "?", entry->func, log->line,
+	       log->level < sizeof(log_levels) / sizeof(*log_levels) ?
+	       log_levels[log->level] : "?");
+
+	while ((next = ofi_trace_parse(fmt, &conv))) {
+		fwrite(fmt, 1, conv.start - fmt, stdout);
+		fmt = next;
+		if (arg + conv.stars + (conv.type != OFI_TRACE_ARG_NONE) > end)
+			break;
+
+		if (conv.type != OFI_TRACE_ARG_STR) {
+			print_arg(&conv, arg);
+			arg += conv.stars + (conv.type != OFI_TRACE_ARG_NONE);
+			continue;
+		}
+
+		len = (size_t) arg[conv.stars];
+		if (arg + conv.stars + 1 + ofi_trace_words(len) > end ||
+		    conv.len >= sizeof(spec))
+			break;
+
+		str = strndup((const char *) &arg[conv.stars + 1], len);
+		memcpy(spec, conv.start, conv.len);
+		spec[conv.len] = '\0';
+		if (conv.stars == 2)
+			printf(spec, (int) arg[0], (int) arg[1], str);
+		else if (conv.stars == 1)
+			printf(spec, (int) arg[0], str);
+		else
+			printf(spec, str);
+		free(str);
+		arg += conv.stars + 1 + ofi_trace_words(len);
+	}
+
+	if (next || (log->hdr.flags & OFI_TRACE_TRUNC))
+		printf("...\n");
+	else
+		fputs(fmt, stdout);
+}
+
+static int dump(const char *path)
+{
+	const struct ofi_trace_file_hdr *file_hdr;
+	const struct ofi_trace_hdr *hdr;
+	const struct ofi_trace_str *def;
+	const struct ofi_trace_log *log;
+	struct log_entry *logs = NULL, *tmp;
+	size_t size, off, log_cnt = 0, log_size = 0, i;
+	uint8_t *buf;
+	long len;
+	FILE *fd;
+	int ret = EXIT_FAILURE;
+
+	fd = fopen(path, "rb");
+	if (!fd) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+
+	fseek(fd, 0, SEEK_END);
+	len = ftell(fd);
+	rewind(fd);
+	if (len < (long) sizeof(*file_hdr)) {
+		fprintf(stderr, "%s: not a trace file\n", path);
+		goto close;
+	}
+
+	size = (size_t) len;
+	buf = malloc(size);
+	if (!buf || fread(buf, 1, size, fd) != size) {
+		fprintf(stderr, "%s: unable to read file\n", path);
+		goto free;
+	}
+
+	file_hdr = (const struct ofi_trace_file_hdr *) buf;
+	if (memcmp(file_hdr->magic, OFI_TRACE_MAGIC, sizeof(file_hdr->magic)) ||
+	    file_hdr->version != OFI_TRACE_VERSION) {
+		fprintf(stderr, "%s: not a trace file\n", path);
+		goto free;
+	}
+
+	/* Every record is at least 8 bytes, so this bounds the strings */
+	str_size = size / 8 + 1;
+	strs = calloc(str_size, sizeof(*strs));
+	if (!strs)
+		goto free;
+
+	printf("pid %u\n", file_hdr->pid);
+	for (off = sizeof(*file_hdr); off + sizeof(*hdr) <= size;
+	     off += hdr->len * 8) {
+		hdr = (const struct ofi_trace_hdr *) (buf + off);
+		if (!hdr->len || off + hdr->len * 8 > size) {
+			fprintf(stderr, "%s: truncated at offset %zu\n",
+				path, off);
+			break;
+		}
+
+		switch (hdr->type) {
+		case OFI_TRACE_STR:
+			def = (const struct ofi_trace_str *) hdr;
+			((uint8_t *) hdr)[hdr->len * 8 - 1] = '\0';
+			*str_slot(def->id) = def->str;
+			break;
+		case OFI_TRACE_LOG:
+			if (log_cnt == log_size) {
+				log_size = log_size ? log_size * 2 : 1024;
+				tmp = realloc(logs, log_size * sizeof(*logs));
+				if (!tmp)
+					goto free;
+				logs = tmp;
+			}
+			log = (const struct ofi_trace_log *) hdr;
+			logs[log_cnt].log = log;
+			logs[log_cnt].prov = str_get(log->prov);
+			logs[log_cnt].func = str_get(log->func);
+			logs[log_cnt].fmt = str_get(log->fmt);
+			logs[log_cnt].seq = log_cnt;
+			log_cnt++;
+			break;
+		case OFI_TRACE_DROP:
+			printf("t%u dropped %llu records\n", hdr->thread,
+			       (unsigned long long)
+			       ((const struct ofi_trace_drop *) hdr)->count);
+			break;
+		default:
+			break;
+		}
+	}
+
+	qsort(logs, log_cnt, sizeof(*logs), log_cmp);
+	for (i = 0; i < log_cnt; i++)
+		print_log(&logs[i]);
+	ret = EXIT_SUCCESS;
+free:
+	free(logs);
+	free(strs);
+	strs = NULL;
+	free(buf);
+close:
+	fclose(fd);
+	return ret;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s FILE...\n", argv0);
+	printf("\n");
+	printf("Decodes binary log traces written with FI_LOG_TRACE_FILE,\n");
+	printf("printing the messages of all threads in time order.\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int i, ret = EXIT_SUCCESS;
+
+	if (argc < 2 || !strcmp(argv[1], "-h")) {
+		usage(argv[0]);
+		return argc < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (dump(argv[i]))
+			ret = EXIT_FAILURE;
+	}
+	return ret;
+}